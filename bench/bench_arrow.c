@@ -0,0 +1,205 @@
+/*
+ * bench-arrow benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark exports synthetic scans (see synth.h) with Arrow writer (see wifi_arrow.h)
+ *  and compares write time and size with CSV of the same data written with fprintf.
+ *
+ *  Each scan sees the population with some BSSes missing and signals varying.
+ *  The Arrow file can be checked with any Arrow reader, e.g.
+ *  python3 -c "import pyarrow as pa; print(pa.ipc.open_file('bench-arrow.arrow').read_all())"
+ *
+ *  Examples:
+ *  bench-arrow
+ *  bench-arrow -s 10000 -n 200 -r 4096 /tmp/scans.arrow
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+#include "../wifi_arrow.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h> //strlen
+#include <unistd.h> //getopt
+
+void Usage(char **argv);
+long file_size(const char *path);
+// the scan of population as seen at time, returns the number of BSSes
+int observe(const struct bss_info *population, int length, int scan, struct bss_info *seen);
+
+int main(int argc, char **argv)
+{
+	int scans = 1000, bss_count = 100, batch_rows = 0, opt, s, i, p;
+	const char *path = "bench-arrow.arrow";
+	char csv_path[256];
+
+	while((opt = getopt(argc, argv, "s:n:r:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 's': scans = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			case 'r': batch_rows = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(optind < argc)
+		path = argv[optind];
+
+	if(scans <= 0 || bss_count <= 0 || batch_rows < 0 || strlen(path) + 5 > sizeof(csv_path))
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	snprintf(csv_path, sizeof(csv_path), "%s.csv", path);
+	wifi_scan_register_log_callback(silent_log);
+
+	struct synth_population population;
+	struct synth_dump dump;
+	struct bss_info *bss = malloc(sizeof(struct bss_info) * bss_count);
+	struct bss_info *seen = malloc(sizeof(struct bss_info) * bss_count);
+	size_t offset = 0;
+	uint64_t total = 0, start, arrow_ns, csv_ns;
+	int scanned = 0, length;
+
+	synth_population_default(&population, bss_count);
+	if(!bss || !seen || !synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to generate population");
+		return 1;
+	}
+	for(p = 0; p < dump.parts && scanned >= 0; offset += dump.part_lengths[p++])
+		scanned = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[p], bss, bss_count, scanned);
+	synth_dump_free(&dump);
+
+	if(scanned < 0)
+	{
+		perror("Unable to parse population");
+		return 1;
+	}
+	bss_count = scanned < bss_count ? scanned : bss_count;
+
+	//Arrow
+	struct wifi_arrow_writer *writer = wifi_arrow_create(path, batch_rows);
+
+	if(writer == NULL)
+	{
+		perror("Unable to create Arrow file");
+		return 1;
+	}
+
+	start = now_ns();
+	for(s = 0; s < scans; ++s)
+	{
+		length = observe(bss, bss_count, s, seen);
+		total += length;
+		if(wifi_arrow_append(writer, 1500000000000000000ULL + s * 10000000000ULL, s % 16, seen, length) == -1)
+		{
+			perror("Unable to append scan");
+			return 1;
+		}
+	}
+	if(wifi_arrow_finish(writer) == -1)
+	{
+		perror("Unable to finish Arrow file");
+		return 1;
+	}
+	arrow_ns = now_ns() - start;
+
+	//CSV
+	FILE *csv = fopen(csv_path, "w");
+
+	if(csv == NULL)
+	{
+		perror("Unable to create CSV file");
+		return 1;
+	}
+
+	start = now_ns();
+	fprintf(csv, "timestamp,device_id,bssid,ssid,frequency,signal_mbm,seen_ms_ago,status\n");
+	for(s = 0; s < scans; ++s)
+	{
+		length = observe(bss, bss_count, s, seen);
+		for(i = 0; i < length; ++i)
+			fprintf(csv, "%llu,%d,%02x:%02x:%02x:%02x:%02x:%02x,%s,%u,%d,%d,%d\n", 1500000000000000000ULL + s * 10000000000ULL, s % 16,
+				seen[i].bssid[0], seen[i].bssid[1], seen[i].bssid[2], seen[i].bssid[3], seen[i].bssid[4], seen[i].bssid[5],
+				seen[i].ssid, seen[i].frequency, seen[i].signal_mbm, seen[i].seen_ms_ago, seen[i].status);
+	}
+	if(fclose(csv) != 0)
+	{
+		perror("Unable to write CSV file");
+		return 1;
+	}
+	csv_ns = now_ns() - start;
+
+	printf("%d scans, %llu BSSes\n\n", scans, (unsigned long long)total);
+	printf("%-8s %12s %10s %12s %14s\n", "format", "bytes", "per BSS", "ns/BSS", "MB/s");
+	printf("%-8s %12ld %10.1f %12.2f %14.1f\n", "Arrow", file_size(path), (double)file_size(path) / total, (double)arrow_ns / total, file_size(path) * 1000.0 / arrow_ns);
+	printf("%-8s %12ld %10.1f %12.2f %14.1f\n", "CSV", file_size(csv_path), (double)file_size(csv_path) / total, (double)csv_ns / total, file_size(csv_path) * 1000.0 / csv_ns);
+
+	free(seen);
+	free(bss);
+
+	return 0;
+}
+
+int observe(const struct bss_info *population, int length, int scan, struct bss_info *seen)
+{
+	int i, count = 0;
+	uint32_t random;
+
+	for(i = 0; i < length; ++i)
+	{
+		random = (uint32_t)(scan + 1) * 2654435761u ^ (uint32_t)(i + 1) * 2246822519u;
+		random ^= random >> 15;
+		random *= 2654435761u;
+
+		//roughly every 10th BSS is missed in the scan
+		if(random % 10 == 0)
+			continue;
+
+		seen[count] = population[i];
+		seen[count].signal_mbm += (int32_t)(random >> 8) % 600 - 300;
+		seen[count].seen_ms_ago = (random >> 16) % 5000;
+		++count;
+	}
+	return count;
+}
+
+long file_size(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	long size = -1;
+
+	if(file && fseek(file, 0, SEEK_END) == 0)
+		size = ftell(file);
+	if(file)
+		fclose(file);
+	return size;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-s scans] [-n bss_count] [-r batch_rows] [arrow_file]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -s 10000 -n 200 -r 4096 /tmp/scans.arrow\n", argv[0]);
+}
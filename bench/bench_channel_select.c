@@ -0,0 +1,254 @@
+/*
+ * bench-channel-select benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures channel selection (see wifi_channel_select.h) update and ranking speed
+ *  against rebuilding the state from the latest scans.
+ *
+ *  Synthetic population (see synth.h) is scanned repeatedly, in each scan some BSSes change signal
+ *  and some are missed. Every few scans survey with random busy time comes. Regulatory domain
+ *  is US-like (DFS channels flagged as radar).
+ *
+ *  After each scan the candidates are ranked. At the end costs are recomputed with floating point
+ *  by brute force over neighbours seen in the last max_age_scans and compared.
+ *
+ *  Examples:
+ *  bench-channel-select
+ *  bench-channel-select -b 2000 -s 5000 -w 160
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_channel_select.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <math.h> //log10, pow, floor
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h> //memset
+#include <unistd.h> //getopt
+
+#define CHANNELS_MAX 128
+#define MAX_AGE_SCANS 3
+
+void Usage(char **argv);
+// US-like regulatory domain
+int regulatory(struct wifi_channel *channels);
+// interference (mBm) and co-channel BSSes of choice from neighbours seen recently (as they were seen)
+void brute_force(const struct bss_info *seen, const uint32_t *last_seen, int bss_count, uint32_t scans,
+	const struct wifi_channel_choice *choice, int32_t *interference_mbm, int *cochannel);
+
+int main(int argc, char **argv)
+{
+	int bss_count = 500, scans = 1000, width = 80, opt, i, s, b, count, found = 0;
+	struct wifi_channel channels[CHANNELS_MAX];
+	struct channel_survey surveys[CHANNELS_MAX];
+	struct wifi_channel_choice choices[CHANNELS_MAX];
+	struct synth_population synth;
+	struct synth_dump dump;
+	uint32_t random = 2016;
+	uint64_t start, add_ns = 0, rank_ns = 0, rebuild_ns = 0;
+	bool same = true;
+
+	while((opt = getopt(argc, argv, "b:s:w:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'b': bss_count = atoi(optarg); break;
+			case 's': scans = atoi(optarg); break;
+			case 'w': width = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(bss_count <= 0 || scans <= MAX_AGE_SCANS || (width != 20 && width != 40 && width != 80 && width != 160))
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	wifi_scan_register_log_callback(silent_log);
+
+	int channels_count = regulatory(channels);
+	struct wifi_channel_select_config config = {width, WIFI_CHANNEL_NO_IR | WIFI_CHANNEL_RADAR, MAX_AGE_SCANS, -9500, 1, 1, 10};
+	struct bss_info *population = malloc(bss_count * sizeof(struct bss_info));
+	struct bss_info *scan = malloc(bss_count * sizeof(struct bss_info));
+	struct bss_info *seen = malloc(bss_count * sizeof(struct bss_info));
+	uint32_t *last_seen = calloc(bss_count, sizeof(uint32_t));
+	struct wifi_channel_select *select = wifi_channel_select_new(channels, channels_count, &config);
+
+	synth_population_default(&synth, bss_count);
+	synth.malformed_percent = 0;
+
+	if(!population || !scan || !seen || !last_seen || !select || !synth_scan_dump(&synth, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to allocate memory");
+		return 1;
+	}
+
+	size_t offset = 0;
+	for(i = 0, s = 0; i < dump.parts && s >= 0; offset += dump.part_lengths[i++])
+		s = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[i], population, bss_count, s);
+	synth_dump_free(&dump);
+
+	for(s = 1; s <= scans; ++s)
+	{
+		//10% of BSSes change signal, 5% are missed
+		for(b = 0, count = 0; b < bss_count; ++b)
+		{
+			if(xorshift32(&random) % 10 == 0)
+			{
+				population[b].signal_mbm += (int32_t)(xorshift32(&random) % 601) - 300;
+				if(population[b].signal_mbm > -3000) population[b].signal_mbm = -3000;
+				if(population[b].signal_mbm < -9900) population[b].signal_mbm = -9900;
+			}
+			if(xorshift32(&random) % 20 == 0)
+				continue;
+			scan[count++] = seen[b] = population[b];
+			last_seen[b] = s;
+		}
+
+		if(s % 10 == 0)
+		{
+			for(i = 0; i < channels_count; ++i)
+			{
+				memset(&surveys[i], 0, sizeof(struct channel_survey));
+				surveys[i].frequency = channels[i].frequency;
+				surveys[i].busy_percent = xorshift32(&random) % 101;
+			}
+			wifi_channel_select_add_survey(select, surveys, channels_count);
+		}
+
+		start = now_ns();
+		if(wifi_channel_select_add_scan(select, scan, count) == -1)
+		{
+			perror("wifi_channel_select_add_scan failed");
+			return 1;
+		}
+		add_ns += now_ns() - start;
+
+		start = now_ns();
+		found = wifi_channel_select_rank(select, choices, CHANNELS_MAX);
+		rank_ns += now_ns() - start;
+
+		//what it would cost to aggregate the recent scans from scratch
+		if(s % 100 == 0)
+		{
+			start = now_ns();
+			struct wifi_channel_select *rebuilt = wifi_channel_select_new(channels, channels_count, &config);
+			for(i = 0; i < MAX_AGE_SCANS; ++i)
+				wifi_channel_select_add_scan(rebuilt, scan, count);
+			wifi_channel_select_rank(rebuilt, choices, CHANNELS_MAX);
+			rebuild_ns += now_ns() - start;
+			wifi_channel_select_free(rebuilt);
+			found = wifi_channel_select_rank(select, choices, CHANNELS_MAX);
+		}
+	}
+
+	for(i = 0; i < found && i < CHANNELS_MAX; ++i)
+	{
+		int32_t interference_mbm;
+		int cochannel;
+
+		brute_force(seen, last_seen, bss_count, scans, &choices[i], &interference_mbm, &cochannel);
+
+		if(abs(interference_mbm - choices[i].interference_mbm) > 5 || cochannel != choices[i].cochannel)
+			same = false;
+		if(i > 0 && choices[i].cost < choices[i - 1].cost)
+			same = false;
+	}
+
+	printf("%d BSSes, %d channels, %d candidates of %d MHz, %d scans\n", bss_count, channels_count, found, width, scans);
+	printf("%-22s %12s\n", "", "us");
+	printf("%-22s %12.2f\n", "incremental scan", add_ns / 1000.0 / scans);
+	printf("%-22s %12.2f\n", "rank", rank_ns / 1000.0 / scans);
+	printf("%-22s %12.2f\n", "rebuild and rank", rebuild_ns / 1000.0 / (scans / 100 ? scans / 100 : 1));
+	printf("brute force: %s\n\n", same ? "same" : "DIFFERENT");
+
+	printf("%8s %8s %6s %8s %8s %6s %6s\n", "center", "primary", "width", "cost", "dBm", "busy", "co-ch");
+	for(i = 0; i < 5 && i < found; ++i)
+		printf("%8u %8u %6u %8d %8.1f %6d %6u\n", choices[i].center_frequency, choices[i].primary_frequency, choices[i].width_mhz,
+			choices[i].cost, choices[i].interference_mbm / 100.0, choices[i].busy_percent, choices[i].cochannel);
+
+	wifi_channel_select_free(select);
+	free(population);
+	free(scan);
+	free(seen);
+	free(last_seen);
+
+	return same ? 0 : 1;
+}
+
+int regulatory(struct wifi_channel *channels)
+{
+	int count = 0, c;
+
+	for(c = 1; c <= 11; ++c, ++count)
+		channels[count] = (struct wifi_channel){2407 + 5 * c, 0, 3000};
+	for(c = 36; c <= 144; c += 4, ++count)
+		channels[count] = (struct wifi_channel){5000 + 5 * c, c >= 52 ? WIFI_CHANNEL_RADAR : 0, c >= 52 ? 2400 : 2300};
+	for(c = 149; c <= 177; c += 4, ++count)
+		channels[count] = (struct wifi_channel){5000 + 5 * c, 0, 3000};
+	for(c = 1; c <= 233 && count < CHANNELS_MAX; c += 4, ++count)
+		channels[count] = (struct wifi_channel){5950 + 5 * c, 0, 2400};
+
+	return count;
+}
+
+void brute_force(const struct bss_info *seen, const uint32_t *last_seen, int bss_count, uint32_t scans,
+	const struct wifi_channel_choice *choice, int32_t *interference_mbm, int *cochannel)
+{
+	static const uint32_t SEGMENT_WIDTH_MHZ[] = {20, 40, 80, 160, 80, 320};
+	uint32_t low = choice->center_frequency - choice->width_mhz / 2, high = low + choice->width_mhz;
+	double power_mw = 0;
+	int b, s;
+
+	*cochannel = 0;
+
+	for(b = 0; b < bss_count; ++b)
+	{
+		const struct bss_info *bss = &seen[b];
+		uint32_t width = SEGMENT_WIDTH_MHZ[bss->channel_width], overlap = 0;
+		uint32_t centers[2] = {bss->center_frequency, bss->center_frequency2};
+		int segments = bss->channel_width == BSS_CHANNEL_WIDTH_80P80 ? 2 : 1;
+
+		if(last_seen[b] == 0 || scans - last_seen[b] >= MAX_AGE_SCANS)
+			continue;
+
+		for(s = 0; s < segments; ++s)
+		{
+			uint32_t from = centers[s] - width / 2 > low ? centers[s] - width / 2 : low;
+			uint32_t to = centers[s] + width / 2 < high ? centers[s] + width / 2 : high;
+			overlap += to > from ? to - from : 0;
+		}
+
+		//the library has 1 dB resolution (half up)
+		power_mw += pow(10, floor(bss->signal_mbm / 100.0 + 0.5) / 10) * overlap / (width * segments);
+		*cochannel += bss->frequency >= low + 10 && bss->frequency + 10 <= high;
+	}
+
+	*interference_mbm = power_mw > 0 ? (int32_t)lround(1000 * log10(power_mw)) : -12000;
+	if(*interference_mbm < -12000)
+		*interference_mbm = -12000;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-b bss_count] [-s scans] [-w candidate_width_mhz]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -b 2000 -s 5000 -w 160\n", argv[0]);
+}
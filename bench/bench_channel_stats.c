@@ -0,0 +1,257 @@
+/*
+ * bench-channel-stats benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures channel statistics (see wifi_channel_stats.h) aggregation and query speed
+ *  against recomputing the same rollups from raw scans.
+ *
+ *  Synthetic population (see synth.h) is scanned at fixed interval, signals and channel
+ *  utilization of BSSes wander randomly and BSSes are missed now and then. Scans are aggregated
+ *  by minute (last hour), hour (last week) and day (last month).
+ *
+ *  Then hourly rollups of the busiest channel and of each band over the whole time are queried
+ *  and recomputed from raw scans, the results are compared.
+ *
+ *  Examples:
+ *  bench-channel-stats
+ *  bench-channel-stats -b 500 -d 7 -i 5
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_channel_stats.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h> //memset, memcmp
+#include <unistd.h> //getopt
+
+#define HOUR_MS 3600000ULL
+
+void Usage(char **argv);
+int band_of(uint32_t frequency);
+// hourly rollups recomputed from raw scans, frequency 0 for band
+void recompute(const struct bss_info *population, int bss_count, const int32_t *signals, const int16_t *utilizations, int scans, int interval_s,
+	uint32_t frequency, int band, struct wifi_channel_rollup *rollups, int hours);
+
+int main(int argc, char **argv)
+{
+	const struct wifi_channel_granularity GRANULARITIES[] = { {60000, 60}, {HOUR_MS, 24 * 7}, {24 * HOUR_MS, 30} };
+	int bss_count = 200, days = 1, interval_s = 10, opt, i, s, b, hours, scans, channels, busiest = 0;
+	struct synth_population synth;
+	struct synth_dump dump;
+	uint32_t frequencies[256], random = 2016;
+	uint64_t start, add_ns, query_ns, recompute_ns;
+	bool same = true;
+
+	while((opt = getopt(argc, argv, "b:d:i:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'b': bss_count = atoi(optarg); break;
+			case 'd': days = atoi(optarg); break;
+			case 'i': interval_s = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(bss_count <= 0 || days <= 0 || days > 7 || interval_s <= 0)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	wifi_scan_register_log_callback(silent_log);
+
+	hours = days * 24;
+	scans = hours * 3600 / interval_s;
+
+	struct bss_info *population = malloc(bss_count * sizeof(struct bss_info));
+	struct bss_info *scan = malloc(bss_count * sizeof(struct bss_info));
+	int32_t *signals = malloc((size_t)scans * bss_count * sizeof(int32_t)); //0 for missed BSS
+	int16_t *utilizations = malloc((size_t)scans * bss_count * sizeof(int16_t));
+	struct wifi_channel_rollup *queried = malloc(hours * sizeof(struct wifi_channel_rollup));
+	struct wifi_channel_rollup *expected = malloc(hours * sizeof(struct wifi_channel_rollup));
+	struct wifi_channel_stats *stats = wifi_channel_stats_new(GRANULARITIES, 3);
+
+	synth_population_default(&synth, bss_count);
+	synth.malformed_percent = 0;
+
+	if(!population || !scan || !signals || !utilizations || !queried || !expected || !stats || !synth_scan_dump(&synth, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to allocate memory");
+		return 1;
+	}
+
+	size_t offset = 0;
+	for(i = 0, s = 0; i < dump.parts && s >= 0; offset += dump.part_lengths[i++])
+		s = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[i], population, bss_count, s);
+	synth_dump_free(&dump);
+
+	//the scans, BSS missed in 10% of scans, random walk of signal and utilization
+	for(s = 0; s < scans; ++s)
+		for(b = 0; b < bss_count; ++b)
+		{
+			int32_t *signal = &signals[(size_t)s * bss_count + b];
+			int16_t *utilization = &utilizations[(size_t)s * bss_count + b];
+			int32_t previous = s ? signals[(size_t)(s - 1) * bss_count + b] : 0;
+
+			*signal = (previous ? previous : population[b].signal_mbm) + (int32_t)(xorshift32(&random) % 401) - 200;
+			if(*signal > -3000) *signal = -3000;
+			if(*signal < -9900) *signal = -9900;
+			*utilization = population[b].channel_utilization < 0 ? -1 : (int16_t)(xorshift32(&random) % 256);
+			if(xorshift32(&random) % 10 == 0)
+				*signal = 0;
+		}
+
+	start = now_ns();
+
+	for(s = 0; s < scans; ++s)
+	{
+		int count = 0;
+		for(b = 0; b < bss_count; ++b)
+			if(signals[(size_t)s * bss_count + b])
+			{
+				scan[count] = population[b];
+				scan[count].signal_mbm = signals[(size_t)s * bss_count + b];
+				scan[count].channel_utilization = utilizations[(size_t)s * bss_count + b];
+				++count;
+			}
+
+		if(wifi_channel_stats_add(stats, (uint64_t)s * interval_s * 1000, scan, count) == -1)
+		{
+			perror("wifi_channel_stats_add failed");
+			return 1;
+		}
+	}
+
+	add_ns = now_ns() - start;
+
+	channels = wifi_channel_stats_channels(stats, frequencies, 256);
+
+	//the channel with the most BSSes
+	for(i = 0; i < channels; ++i)
+	{
+		int count = 0, busiest_count = 0;
+		for(b = 0; b < bss_count; ++b)
+		{
+			count += population[b].frequency == frequencies[i];
+			busiest_count += population[b].frequency == frequencies[busiest];
+		}
+		if(count > busiest_count)
+			busiest = i;
+	}
+
+	printf("%d BSSes on %d channels, %d scans every %d s over %d days\n", bss_count, channels, scans, interval_s, days);
+	printf("aggregation: %.1f us/scan, %.1f ns/bss\n", add_ns / 1000.0 / scans, (double)add_ns / scans / bss_count);
+
+	printf("%-14s %12s %14s %8s\n", "rollups", "query us", "recompute us", "same");
+
+	for(i = -1; i < WIFI_BANDS; ++i)
+	{
+		char name[32];
+		int returned;
+
+		start = now_ns();
+		if(i == -1)
+			returned = wifi_channel_stats_query(stats, 1, frequencies[busiest], 0, hours * HOUR_MS, queried, hours);
+		else
+			returned = wifi_channel_stats_query_band(stats, 1, i, 0, hours * HOUR_MS, queried, hours);
+		query_ns = now_ns() - start;
+
+		start = now_ns();
+		recompute(population, bss_count, signals, utilizations, scans, interval_s, i == -1 ? frequencies[busiest] : 0, i, expected, hours);
+		recompute_ns = now_ns() - start;
+
+		bool equal = returned == hours;
+		for(s = 0; s < hours && equal; ++s)
+			equal = memcmp(&queried[s], &expected[s], sizeof(struct wifi_channel_rollup)) == 0 || (queried[s].bss == 0 && expected[s].bss == 0);
+		same = same && equal;
+
+		if(i == -1)
+			snprintf(name, sizeof(name), "channel %u", frequencies[busiest]);
+		else
+			snprintf(name, sizeof(name), "band %s", i == WIFI_BAND_2GHZ ? "2.4 GHz" : i == WIFI_BAND_5GHZ ? "5 GHz" : "6 GHz");
+
+		printf("%-14s %12.1f %14.1f %8s\n", name, query_ns / 1000.0, recompute_ns / 1000.0, equal ? "ok" : "FAIL");
+	}
+
+	wifi_channel_stats_free(stats);
+	free(population);
+	free(scan);
+	free(signals);
+	free(utilizations);
+	free(queried);
+	free(expected);
+
+	return same ? 0 : 1;
+}
+
+void recompute(const struct bss_info *population, int bss_count, const int32_t *signals, const int16_t *utilizations, int scans, int interval_s,
+	uint32_t frequency, int band, struct wifi_channel_rollup *rollups, int hours)
+{
+	int s, b, h;
+
+	memset(rollups, 0, hours * sizeof(struct wifi_channel_rollup));
+
+	for(h = 0; h < hours; ++h)
+		rollups[h].start_ms = h * HOUR_MS;
+
+	for(s = 0; s < scans; ++s)
+	{
+		struct wifi_channel_rollup *rollup = &rollups[(uint64_t)s * interval_s * 1000 / HOUR_MS];
+		++rollup->scans;
+
+		for(b = 0; b < bss_count; ++b)
+		{
+			int32_t signal = signals[(size_t)s * bss_count + b];
+			int16_t utilization = utilizations[(size_t)s * bss_count + b];
+			int bin;
+
+			if(signal == 0 || (frequency ? population[b].frequency != frequency : band_of(population[b].frequency) != band))
+				continue;
+
+			if(rollup->bss == 0 || signal > rollup->max_signal_mbm)
+				rollup->max_signal_mbm = signal;
+			++rollup->bss;
+
+			bin = signal < WIFI_CHANNEL_STATS_SIGNAL_FLOOR_DBM * 100 ? 0 : 1 + (signal / 100 - (signal % 100 != 0) - WIFI_CHANNEL_STATS_SIGNAL_FLOOR_DBM) / WIFI_CHANNEL_STATS_SIGNAL_STEP_DB;
+			++rollup->signal[bin < WIFI_CHANNEL_STATS_SIGNAL_BINS ? bin : WIFI_CHANNEL_STATS_SIGNAL_BINS - 1];
+
+			if(utilization >= 0)
+			{
+				++rollup->utilization_samples;
+				rollup->utilization_sum += utilization;
+				++rollup->utilization[utilization * WIFI_CHANNEL_STATS_UTILIZATION_BINS / 256];
+				rollup->stations += population[b].station_count;
+			}
+		}
+	}
+}
+
+int band_of(uint32_t frequency)
+{
+	return frequency < 2500 ? WIFI_BAND_2GHZ : frequency < 5925 ? WIFI_BAND_5GHZ : WIFI_BAND_6GHZ;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-b bss_count] [-d days (at most 7)] [-i scan_interval_s]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -b 500 -d 7 -i 5\n", argv[0]);
+}
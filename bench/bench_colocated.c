@@ -0,0 +1,207 @@
+/*
+ * bench-colocated benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures 6 GHz discovery (see 6 GHZ DISCOVERY in wifi_scan.h) time
+ *  of colocated scan against blind sweeps of 6 GHz channels.
+ *
+ *  Each run scans all the channels (like wifi_scan_all), the 6 GHz BSSes reported in
+ *  Reduced Neighbor Report elements are then scanned for in colocated mode.
+ *  After that all the 6 GHz channels and only the preferred scanning channels (PSC) are swept.
+ *
+ *  With existing wireless interface as argument it measures the real device (triggering needs permissions).
+ *  Without it, it runs against local fake backend (see wifi_scan_init_fake) with synthetic population
+ *  where some 2.4/5 GHz BSSes report colocated 6 GHz BSS (see synth.h).
+ *
+ *  Examples:
+ *  bench-colocated                      (fake backend)
+ *  bench-colocated -n 500 -t 20 -r 5
+ *  sudo bench-colocated -r 3 wlan0      (real device)
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //atoi
+#include <unistd.h> //getopt
+
+enum {BSS_INFOS=1024, CHANNELS_MAX=256};
+enum bench_scan {SCAN_FULL, SCAN_COLOCATED, SCAN_6GHZ, SCAN_PSC, SCANS};
+
+static const char *SCAN_NAMES[SCANS] = {"full scan", "colocated", "6 GHz sweep", "PSC sweep"};
+
+void Usage(char **argv);
+// 6 GHz channels of the radio, all or only preferred scanning channels (5 + 16 * n)
+int channels_6ghz(struct wifi_scan *wifi, bool psc, uint32_t *frequencies);
+// 6 GHz BSSes in scan results (by frequency), the fake serves the same results whatever is scanned
+int count_6ghz(const struct bss_info *bss, int found);
+
+int main(int argc, char **argv)
+{
+	static struct bss_info bss[BSS_INFOS];
+	static struct wifi_colocated_bss colocated[WIFI_SCAN_COLOCATED_MAX];
+	uint32_t frequencies[SCANS][CHANNELS_MAX];
+	struct scan_params params[SCANS] = { {SCAN_MODE_TRIGGERED}, {SCAN_MODE_COLOCATED} };
+	uint64_t total_ns[SCANS] = {0};
+	int runs = 3, bss_count = 100, opt, r, s, i, found[SCANS] = {0}, errors[SCANS] = {0}, reported = 0, channels = 0, psc = 0;
+	uint32_t channel_time_ms = 10;
+	struct scan_timings timings;
+	struct wifi_scan *wifi;
+
+	while((opt = getopt(argc, argv, "r:t:n:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': runs = atoi(optarg); break;
+			case 't': channel_time_ms = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(runs <= 0 || bss_count <= 0)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	if(optind < argc && wifi_interface_exists(argv[optind]))
+	{
+		printf("measuring %s\n", argv[optind]);
+		wifi = wifi_scan_init(argv[optind]);
+	}
+	else
+	{
+		struct synth_population population;
+		struct synth_dump dump;
+
+		if(optind < argc)
+			printf("no interface %s, ", argv[optind]);
+		printf("measuring fake backend with %d BSSes and %u ms per channel\n", bss_count, channel_time_ms);
+
+		synth_population_default(&population, bss_count);
+		if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		{
+			perror("Unable to generate population");
+			return 1;
+		}
+		wifi = wifi_scan_init_fake(dump.data, dump.length, channel_time_ms);
+		synth_dump_free(&dump);
+		wifi_scan_register_log_callback(silent_log);
+	}
+
+	if(wifi == NULL)
+		return 1;
+
+	params[SCAN_6GHZ] = (struct scan_params){SCAN_MODE_TRIGGERED, frequencies[SCAN_6GHZ], channels_6ghz(wifi, false, frequencies[SCAN_6GHZ])};
+	params[SCAN_PSC] = (struct scan_params){SCAN_MODE_TRIGGERED, frequencies[SCAN_PSC], channels_6ghz(wifi, true, frequencies[SCAN_PSC])};
+
+	if(params[SCAN_6GHZ].frequencies_length == 0)
+	{
+		printf("the radio has no 6 GHz channels\n");
+		wifi_scan_close(wifi);
+		return 1;
+	}
+
+	for(r = 0; r < runs; ++r)
+		for(s = 0; s < SCANS; ++s)
+		{
+			int status = wifi_scan_all_params(wifi, &params[s], bss, BSS_INFOS);
+
+			if(status == -1)
+			{
+				++errors[s];
+				continue;
+			}
+
+			wifi_scan_last_timings(wifi, &timings);
+			total_ns[s] += timings.total_ns;
+			found[s] += count_6ghz(bss, status < BSS_INFOS ? status : BSS_INFOS);
+
+			//what the full scan reported is what colocated scan looks for
+			if(s == SCAN_FULL)
+			{
+				reported = wifi_scan_colocated(wifi, colocated, WIFI_SCAN_COLOCATED_MAX);
+
+				for(i = 0, channels = 0, psc = 0; i < reported && i < WIFI_SCAN_COLOCATED_MAX; ++i)
+				{
+					int j;
+					for(j = 0; j < i && colocated[j].frequency != colocated[i].frequency; ++j)
+						;
+					channels += j == i;
+					psc += (colocated[i].frequency - 5950) / 5 % 16 == 5;
+				}
+			}
+		}
+
+	printf("%d 6 GHz BSSes reported on %d channels (%d BSSes on PSC)\n\n", reported, channels, psc);
+	printf("%-12s %10s %8s %10s %10s\n", "", "channels", "errors", "ms", "6 GHz bss");
+	for(s = 0; s < SCANS; ++s)
+	{
+		int ok = runs - errors[s];
+		char count[16] = "all";
+
+		if(s != SCAN_FULL)
+			snprintf(count, sizeof(count), "%d", s == SCAN_COLOCATED ? channels : params[s].frequencies_length);
+
+		printf("%-12s %10s %8d %10.1f %10.1f\n", SCAN_NAMES[s], count, errors[s],
+			ok ? total_ns[s] / 1000000.0 / ok : 0.0, ok ? (double)found[s] / ok : 0.0);
+	}
+
+	wifi_scan_close(wifi);
+
+	return 0;
+}
+
+int channels_6ghz(struct wifi_scan *wifi, bool psc, uint32_t *frequencies)
+{
+	struct wifi_channel channels[CHANNELS_MAX];
+	int count = wifi_scan_channels(wifi, channels, CHANNELS_MAX), i, length = 0;
+
+	for(i = 0; i < count && i < CHANNELS_MAX; ++i)
+	{
+		if(channels[i].frequency < 5955 || (channels[i].flags & WIFI_CHANNEL_DISABLED))
+			continue;
+		if(psc && (channels[i].frequency - 5950) / 5 % 16 != 5)
+			continue;
+		frequencies[length++] = channels[i].frequency;
+	}
+
+	return length;
+}
+
+int count_6ghz(const struct bss_info *bss, int found)
+{
+	int i, count = 0;
+
+	for(i = 0; i < found; ++i)
+		count += bss[i].frequency >= 5955;
+
+	return count;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-r runs] [-t channel_time_ms] [-n bss_count] [interface]\n\n", argv[0]);
+	printf("-t and -n apply to fake backend used when there is no interface\n\n");
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -n 500 -t 20 -r 5\n", argv[0]);
+	printf("sudo %s -r 3 wlan0\n", argv[0]);
+}
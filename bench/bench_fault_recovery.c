@@ -0,0 +1,356 @@
+/*
+ * bench-fault-recovery benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark injects faults (see wifi_scan_set_faults) and measures how long it takes
+ *  to get a good scan again with simple retry policy (call wifi_scan_all again on error,
+ *  wait a bit first if device is busy, e.g. scanning after trigger which acknowledgement was lost).
+ *
+ *  Scripted mode (default) injects burst of each fault at first opportunity, then retries
+ *  until scan returns as many BSSes as clean scan (or attempts run out).
+ *  Probabilistic mode (-p) injects all the faults with given chance at every opportunity.
+ *
+ *  Reported for each fault:
+ *  - recovered - runs that ended with good scan
+ *  - attempts - average wifi_scan_all calls per run
+ *  - short - calls that succeeded with fewer BSSes than clean scan (silently lost data)
+ *  - masked - calls that succeeded although fault was injected during the call
+ *             (e.g. results read after lost notification may be older, interrupted dump was retrieved again)
+ *  - retries - dumps retrieved again by the library because they were interrupted (see struct scan_timings)
+ *  - time to good scan percentiles and p50 overhead over clean scan
+ *
+ *  With existing wireless interface as argument it measures the real device (triggering needs permissions).
+ *  Without it, it runs against local fake backend (see wifi_scan_init_fake) with synthetic population.
+ *
+ *  Examples:
+ *  bench-fault-recovery                      (fake backend, all faults once)
+ *  bench-fault-recovery -b 3 -f truncated    (fake backend, 3 truncated replies in a row)
+ *  bench-fault-recovery -p 50 -r 200         (fake backend, 5% chance of each fault)
+ *  sudo bench-fault-recovery -r 10 wlan0     (real device)
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi, qsort
+#include <string.h>
+#include <errno.h>
+#include <time.h> //clock_gettime
+#include <unistd.h> //getopt
+
+enum {BSS_INFOS=1024};
+
+static const char *FAULT_NAMES[SCAN_FAULT_TYPES] = {"clean", "busy", "overrun", "truncated", "dump-error", "interrupted"};
+
+// single run from the first call until good scan
+struct recovery
+{
+	uint64_t ns; //time to good scan (or until attempts ran out)
+	int attempts; //wifi_scan_all calls
+	int bss; //BSSes found by the last successful call
+	int shorts; //calls succeeded with too few BSSes
+	int masked; //calls succeeded with fault injected during the call
+	int dump_retries; //sum of scan_timings dump_retries
+	int error; //errno of the last failed call, 0 if none failed
+	bool recovered;
+};
+
+void Usage(char **argv);
+int parse_faults(const char *list, bool faults[SCAN_FAULT_TYPES]);
+void recover(struct wifi_scan *wifi, int expected, int max_attempts, int backoff_ms, struct recovery *run);
+void summary(const char *name, const struct recovery *runs, int length, uint32_t injected, uint64_t clean_p50_ns);
+uint64_t percentile(uint64_t *sorted, int length, int percent);
+uint32_t total_faults(struct wifi_scan *wifi);
+int compare_u64(const void *a, const void *b);
+
+int main(int argc, char **argv)
+{
+	bool faults[SCAN_FAULT_TYPES] = {false, true, true, true, true, true};
+	int runs = 20, burst = 1, max_attempts = 10, backoff_ms = 20, permille = 0, bss_count = 100, expected = 0, opt, f, r;
+	uint32_t channel_time_ms = 2, seed = 1;
+	uint32_t injected[SCAN_FAULT_TYPES];
+	struct wifi_scan *wifi;
+
+	while((opt = getopt(argc, argv, "r:b:a:w:p:s:f:t:n:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': runs = atoi(optarg); break;
+			case 'b': burst = atoi(optarg); break;
+			case 'a': max_attempts = atoi(optarg); break;
+			case 'w': backoff_ms = atoi(optarg); break;
+			case 'p': permille = atoi(optarg); break;
+			case 's': seed = atoi(optarg); break;
+			case 'f': if(parse_faults(optarg, faults) == -1) { Usage(argv); return 1; } break;
+			case 't': channel_time_ms = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(runs <= 0 || max_attempts <= 0)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	if(optind < argc && wifi_interface_exists(argv[optind]))
+	{
+		printf("measuring %s\n", argv[optind]);
+		wifi = wifi_scan_init(argv[optind]);
+	}
+	else
+	{
+		struct synth_population population;
+		struct synth_dump dump;
+
+		if(optind < argc)
+			printf("no interface %s, ", argv[optind]);
+		printf("measuring fake backend with %d BSSes and %u ms per channel\n", bss_count, channel_time_ms);
+
+		synth_population_default(&population, bss_count);
+		if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		{
+			perror("Unable to generate population");
+			return 1;
+		}
+		wifi = wifi_scan_init_fake(dump.data, dump.length, channel_time_ms);
+		synth_dump_free(&dump);
+	}
+
+	if(wifi == NULL)
+		return 1;
+
+	//the library logs every recovered fault
+	wifi_scan_register_log_callback(silent_log);
+
+	struct recovery *results = malloc(sizeof(struct recovery) * runs);
+	uint64_t *clean = malloc(sizeof(uint64_t) * runs);
+
+	//clean scans tell what good scan is and how long it takes
+	for(r = 0; r < runs; ++r)
+	{
+		recover(wifi, 0, 1, backoff_ms, &results[r]);
+		clean[r] = results[r].ns;
+		if(results[r].bss > expected)
+			expected = results[r].bss;
+	}
+
+	qsort(clean, runs, sizeof(uint64_t), compare_u64);
+
+	printf("clean scan returns %d BSSes, %s mode, at most %d attempts, %d ms backoff when busy\n\n", expected, permille ? "probabilistic" : "scripted", max_attempts, backoff_ms);
+	printf("%-12s %5s %8s %9s %8s %6s %6s %7s %10s %10s %10s %11s  %s\n", "fault", "runs", "injected", "recovered", "attempts",
+		"short", "masked", "retries", "p50 ms", "p90 ms", "max ms", "p50 over ms", "last error");
+
+	summary(FAULT_NAMES[SCAN_FAULT_NONE], results, runs, 0, clean[(runs * 50 + 99) / 100 - 1]);
+
+	if(permille)
+	{
+		struct scan_faults schedule = { NULL, 0, {0}, seed };
+
+		for(f = SCAN_FAULT_NONE + 1; f < SCAN_FAULT_TYPES; ++f)
+			if(faults[f])
+				schedule.permille[f] = permille;
+
+		wifi_scan_set_faults(wifi, &schedule);
+
+		for(r = 0; r < runs; ++r)
+			recover(wifi, expected, max_attempts, backoff_ms, &results[r]);
+
+		wifi_scan_fault_counts(wifi, injected);
+
+		for(f = SCAN_FAULT_NONE + 1; f < SCAN_FAULT_TYPES; ++f)
+			if(faults[f])
+				printf("%-12s %5s %8u\n", FAULT_NAMES[f], "", injected[f]);
+
+		summary("mixed", results, runs, total_faults(wifi), clean[(runs * 50 + 99) / 100 - 1]);
+		wifi_scan_set_faults(wifi, NULL);
+	}
+	else
+	{
+		for(f = SCAN_FAULT_NONE + 1; f < SCAN_FAULT_TYPES; ++f)
+		{
+			struct scan_fault_rule rule = { f, 0, burst };
+			struct scan_faults schedule = { &rule, 1 };
+			uint32_t total = 0;
+
+			if(!faults[f])
+				continue;
+
+			for(r = 0; r < runs; ++r)
+			{
+				//fresh schedule (and counters) for each run, the fault hits the first opportunity
+				wifi_scan_set_faults(wifi, &schedule);
+				recover(wifi, expected, max_attempts, backoff_ms, &results[r]);
+				total += total_faults(wifi);
+				//settle down before the next run (e.g. read notifications left by fault)
+				wifi_scan_set_faults(wifi, NULL);
+				recover(wifi, 0, max_attempts, backoff_ms, &(struct recovery){0});
+			}
+
+			summary(FAULT_NAMES[f], results, runs, total, clean[(runs * 50 + 99) / 100 - 1]);
+		}
+	}
+
+	free(clean);
+	free(results);
+	wifi_scan_close(wifi);
+
+	return 0;
+}
+
+// expected = 0 means any successful scan is good
+void recover(struct wifi_scan *wifi, int expected, int max_attempts, int backoff_ms, struct recovery *run)
+{
+	struct timespec backoff = { backoff_ms / 1000, (backoff_ms % 1000) * 1000000L };
+	static struct bss_info bss[BSS_INFOS];
+	struct timespec start, end;
+	struct scan_timings timings;
+	uint32_t before;
+	int status;
+
+	memset(run, 0, sizeof(struct recovery));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while(run->attempts < max_attempts && !run->recovered)
+	{
+		before = total_faults(wifi);
+		++run->attempts;
+
+		status = wifi_scan_all(wifi, bss, BSS_INFOS);
+		wifi_scan_last_timings(wifi, &timings);
+		run->dump_retries += timings.dump_retries;
+
+		if(status == -1)
+		{
+			run->error = errno;
+			if(run->error == EBUSY && run->attempts < max_attempts)
+				nanosleep(&backoff, NULL);
+			continue;
+		}
+
+		run->bss = status;
+
+		if(total_faults(wifi) != before)
+			++run->masked;
+
+		if(status < expected)
+			++run->shorts;
+		else
+			run->recovered = true;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	run->ns = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+}
+
+// nearest rank percentiles of time to good scan over recovered runs
+void summary(const char *name, const struct recovery *runs, int length, uint32_t injected, uint64_t clean_p50_ns)
+{
+	uint64_t *values = malloc(sizeof(uint64_t) * length);
+	int recovered = 0, attempts = 0, shorts = 0, masked = 0, retries = 0, error = 0, r;
+
+	for(r = 0; r < length; ++r)
+	{
+		attempts += runs[r].attempts;
+		shorts += runs[r].shorts;
+		masked += runs[r].masked;
+		retries += runs[r].dump_retries;
+		if(runs[r].error)
+			error = runs[r].error;
+		if(runs[r].recovered)
+			values[recovered++] = runs[r].ns;
+	}
+
+	printf("%-12s %5d %8u %9d %8.2f %6d %6d %7d ", name, length, injected, recovered, (double)attempts / length, shorts, masked, retries);
+
+	if(recovered)
+	{
+		qsort(values, recovered, sizeof(uint64_t), compare_u64);
+		printf("%10.3f %10.3f %10.3f %11.3f", percentile(values, recovered, 50) / 1e6, percentile(values, recovered, 90) / 1e6,
+			values[recovered - 1] / 1e6, ((double)percentile(values, recovered, 50) - (double)clean_p50_ns) / 1e6);
+	}
+	else
+		printf("%10s %10s %10s %11s", "-", "-", "-", "-");
+
+	printf("  %s\n", error ? strerror(error) : "-");
+
+	free(values);
+}
+
+uint64_t percentile(uint64_t *sorted, int length, int percent)
+{
+	return sorted[(length * percent + 99) / 100 - 1];
+}
+
+uint32_t total_faults(struct wifi_scan *wifi)
+{
+	uint32_t injected[SCAN_FAULT_TYPES], total = 0;
+	int f;
+
+	wifi_scan_fault_counts(wifi, injected);
+
+	for(f = 0; f < SCAN_FAULT_TYPES; ++f)
+		total += injected[f];
+
+	return total;
+}
+
+int parse_faults(const char *list, bool faults[SCAN_FAULT_TYPES])
+{
+	char copy[256], *token, *save;
+	int f;
+
+	memset(faults, 0, sizeof(bool) * SCAN_FAULT_TYPES);
+	snprintf(copy, sizeof(copy), "%s", list);
+
+	for(token = strtok_r(copy, ",", &save); token; token = strtok_r(NULL, ",", &save))
+	{
+		for(f = SCAN_FAULT_NONE + 1; f < SCAN_FAULT_TYPES && strcmp(token, FAULT_NAMES[f]) != 0; ++f)
+			;
+		if(f == SCAN_FAULT_TYPES)
+		{
+			fprintf(stderr, "unknown fault %s\n", token);
+			return -1;
+		}
+		faults[f] = true;
+	}
+	return 0;
+}
+
+int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-r runs] [-b burst] [-a max_attempts] [-w backoff_ms] [-p permille] [-s seed] [-f fault,...] [-t channel_time_ms] [-n bss_count] [wireless_interface]\n\n", argv[0]);
+	printf("faults: busy,overrun,truncated,dump-error,interrupted (default all)\n");
+	printf("-b faults in a row at first opportunity (scripted mode, default)\n");
+	printf("-w wait before retrying when device is busy\n");
+	printf("-p chance of each fault at every opportunity out of 1000 (probabilistic mode)\n");
+	printf("-t and -n apply to fake backend used when there is no interface\n\n");
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -b 3 -f truncated\n", argv[0]);
+	printf("%s -p 50 -r 200\n", argv[0]);
+	printf("%s -r 10 wlan0\n", argv[0]);
+}
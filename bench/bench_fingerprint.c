@@ -0,0 +1,225 @@
+/*
+ * bench-fingerprint benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures k nearest neighbour queries of fingerprint database (see wifi_fingerprint.h)
+ *  with each distance kernel supported by CPU. Results of all kernels are checked against scalar one.
+ *
+ *  Synthetic site is 500 x 200 m with access points at random positions and log-distance path loss
+ *  (exponent 3.5) with gaussian noise. References are on regular grid, queries at random positions.
+ *  Localisation error is the distance to the average position of the k nearest references.
+ *
+ *  Examples:
+ *  bench-fingerprint
+ *  bench-fingerprint -r 200000 -a 1000 -q 2000 -k 5
+ *
+ */
+
+#include "common.h"
+#include "../wifi_fingerprint.h"
+
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h> //memcmp
+#include <math.h> //log10, sqrt
+#include <unistd.h> //getopt
+
+#define SITE_WIDTH_M 500.0
+#define SITE_HEIGHT_M 200.0
+
+struct position
+{
+	double x;
+	double y;
+};
+
+void Usage(char **argv);
+double uniform(uint32_t *state);
+double gaussian(uint32_t *state);
+// scan at position as wifi_scan_all would see it, returns the number of bss
+int measure(const struct position *at, const struct position *aps, int ap_count, uint32_t *random, struct bss_info *bss);
+
+int main(int argc, char **argv)
+{
+	int references = 100000, ap_count = 500, queries = 1000, k = 4, opt, i, q, j;
+	enum wifi_fingerprint_kernel kernels[] = {WIFI_FINGERPRINT_SCALAR, WIFI_FINGERPRINT_AVX2, WIFI_FINGERPRINT_NEON};
+
+	while((opt = getopt(argc, argv, "r:a:q:k:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': references = atoi(optarg); break;
+			case 'a': ap_count = atoi(optarg); break;
+			case 'q': queries = atoi(optarg); break;
+			case 'k': k = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(references <= 0 || ap_count <= 0 || queries <= 0 || k <= 0)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	struct wifi_fingerprint_db *db = wifi_fingerprint_db_new();
+	struct position *aps = malloc(sizeof(struct position) * ap_count);
+	struct position *grid = malloc(sizeof(struct position) * references);
+	struct bss_info *bss = malloc(sizeof(struct bss_info) * ap_count);
+	struct wifi_fingerprint_match *scalar = malloc(sizeof(struct wifi_fingerprint_match) * k * queries);
+	struct wifi_fingerprint_match *matches = malloc(sizeof(struct wifi_fingerprint_match) * k);
+	uint32_t random = 2463534242u;
+	uint64_t start, build_ns, seen = 0;
+	int columns = (int)sqrt(references * SITE_WIDTH_M / SITE_HEIGHT_M) + 1, errors = 0;
+
+	if(db == NULL)
+	{
+		perror("Unable to create database");
+		return 1;
+	}
+
+	for(i = 0; i < ap_count; ++i)
+	{
+		aps[i].x = uniform(&random) * SITE_WIDTH_M;
+		aps[i].y = uniform(&random) * SITE_HEIGHT_M;
+	}
+
+	start = now_ns();
+	for(i = 0; i < references; ++i)
+	{
+		int n;
+
+		grid[i].x = (i % columns + 0.5) * SITE_WIDTH_M / columns;
+		grid[i].y = (i / columns + 0.5) * SITE_WIDTH_M / columns;
+		n = measure(&grid[i], aps, ap_count, &random, bss);
+
+		if(wifi_fingerprint_db_add(db, i, bss, n) == -1)
+		{
+			perror("Unable to add reference");
+			return 1;
+		}
+		seen += n;
+	}
+	build_ns = now_ns() - start;
+
+	printf("%d references, %d columns, %.1f BSS per reference, built in %.1f ms\n\n", wifi_fingerprint_db_references(db),
+		wifi_fingerprint_db_columns(db), (double)seen / references, build_ns / 1e6);
+	printf("%-8s %10s %10s %10s %8s\n", "kernel", "queries", "us/query", "error m", "results");
+
+	for(j = 0; j < (int)(sizeof(kernels) / sizeof(kernels[0])); ++j)
+	{
+		uint64_t elapsed = 0;
+		uint32_t query_random = 88675123u;
+		double error = 0;
+		int different = 0;
+
+		if(wifi_fingerprint_db_set_kernel(db, kernels[j]) == -1)
+			continue;
+
+		for(q = 0; q < queries; ++q)
+		{
+			struct position at = {uniform(&query_random) * SITE_WIDTH_M, uniform(&query_random) * SITE_HEIGHT_M}, estimate = {0, 0};
+			int n = measure(&at, aps, ap_count, &query_random, bss), found;
+
+			start = now_ns();
+			found = wifi_fingerprint_db_knn(db, bss, n, matches, k);
+			elapsed += now_ns() - start;
+
+			if(found <= 0)
+			{
+				perror("Query failed");
+				return 1;
+			}
+
+			for(i = 0; i < found; ++i)
+			{
+				estimate.x += grid[matches[i].label].x / found;
+				estimate.y += grid[matches[i].label].y / found;
+			}
+			error += sqrt((estimate.x - at.x) * (estimate.x - at.x) + (estimate.y - at.y) * (estimate.y - at.y));
+
+			//scalar kernel runs first and is the reference
+			if(kernels[j] == WIFI_FINGERPRINT_SCALAR)
+				memcpy(scalar + q * k, matches, sizeof(struct wifi_fingerprint_match) * found);
+			else
+				different += memcmp(scalar + q * k, matches, sizeof(struct wifi_fingerprint_match) * found) != 0;
+		}
+
+		errors += different;
+
+		printf("%-8s %10d %10.1f %10.2f %8s\n", wifi_fingerprint_db_kernel(db), queries, elapsed / 1e3 / queries,
+			error / queries, different ? "WRONG" : "ok");
+	}
+
+	printf("\n%s\n", errors ? "RESULTS DIFFER BETWEEN KERNELS" : "results are the same for all kernels");
+
+	wifi_fingerprint_db_free(db);
+	free(aps);
+	free(grid);
+	free(bss);
+	free(scalar);
+	free(matches);
+
+	return errors ? 1 : 0;
+}
+
+int measure(const struct position *at, const struct position *aps, int ap_count, uint32_t *random, struct bss_info *bss)
+{
+	int i, n = 0;
+
+	for(i = 0; i < ap_count; ++i)
+	{
+		double dx = aps[i].x - at->x, dy = aps[i].y - at->y;
+		double distance = sqrt(dx * dx + dy * dy) + 1.0;
+		double signal_dbm = -30.0 - 35.0 * log10(distance) + 4.0 * gaussian(random);
+
+		if(signal_dbm < WIFI_FINGERPRINT_FLOOR_DBM)
+			continue;
+
+		memset(&bss[n], 0, sizeof(struct bss_info));
+		bss[n].bssid[0] = 0x02;
+		bss[n].bssid[4] = i >> 8;
+		bss[n].bssid[5] = i & 0xFF;
+		bss[n].signal_mbm = (int32_t)(signal_dbm * 100);
+		++n;
+	}
+
+	return n;
+}
+
+double uniform(uint32_t *state)
+{
+	return xorshift32(state) / 4294967296.0;
+}
+
+// approximation with the sum of uniform variables
+double gaussian(uint32_t *state)
+{
+	double sum = 0;
+	int i;
+
+	for(i = 0; i < 12; ++i)
+		sum += uniform(state);
+
+	return sum - 6.0;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-r references] [-a access_points] [-q queries] [-k neighbours]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -r 200000 -a 1000 -q 2000 -k 5\n", argv[0]);
+}
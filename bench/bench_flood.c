@@ -0,0 +1,206 @@
+/*
+ * bench-flood benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures wifi_scan_all under beacon flood with and without flood guard.
+ *  Synthetic populations (see synth.h) of growing size are replayed, the associated BSS
+ *  is in the middle of the dump.
+ *
+ *  For each population and eviction policy prints:
+ *  - scan time per call
+ *  - the number of BSSes returned (what caller has to keep)
+ *  - flood status
+ *  - if the kept BSSes are exactly the best ones and associated BSS is first
+ *
+ *  Program takes optional arguments, e.g:
+ *  bench-flood                      (populations of 50, 5000 and 50000 BSSes, guard of 256 BSSes)
+ *  bench-flood -m 64 -i 20 1000     (guard of 64 BSSes, 20 iterations, 1000 BSSes)
+ *  bench-flood -f 500 -r 100 5000   (flood over 500 BSSes or 100 repeats of SSID/OUI)
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi, qsort
+#include <string.h>
+#include <unistd.h> //getopt, unlink
+
+void Usage(char **argv);
+int bench_population(const struct synth_population *population, const struct scan_flood_guard *guard, int iterations);
+int scan(const char *capture_file, const struct scan_flood_guard *guard, int iterations, struct bss_info *bss, int bss_length, double *scan_ns, struct scan_flood_status *status);
+int compare_keys(const void *a, const void *b);
+long long key(const struct bss_info *bss, enum scan_eviction eviction);
+
+int main(int argc, char **argv)
+{
+	static const int DEFAULT_POPULATIONS[] = {50, 5000, 50000};
+	struct scan_flood_guard guard = {256, SCAN_EVICT_NONE, 1000, 200};
+	int iterations = 10, opt, i;
+
+	while((opt = getopt(argc, argv, "i:m:f:r:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'i': iterations = atoi(optarg); break;
+			case 'm': guard.max_bss = atoi(optarg); break;
+			case 'f': guard.flood_bss = atoi(optarg); break;
+			case 'r': guard.flood_repeats = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	//flood is logged by the library, don't measure the terminal
+	wifi_scan_register_log_callback(silent_log);
+
+	printf("%8s %14s %10s %10s %10s %8s %8s %8s %6s\n",
+		"bss", "eviction", "scan ms", "returned", "caller KB", "ssid rep", "oui rep", "flood", "best");
+
+	for(i = optind; i < argc || (optind == argc && i - optind < 3); ++i)
+	{
+		struct synth_population population;
+		synth_population_default(&population, optind == argc ? DEFAULT_POPULATIONS[i - optind] : atoi(argv[i]));
+		population.associated = population.bss_count / 2;
+
+		if(bench_population(&population, &guard, iterations) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+int bench_population(const struct synth_population *population, const struct scan_flood_guard *guard, int iterations)
+{
+	static const char *EVICTIONS[] = {"none", "weakest", "least recent"};
+	struct bss_info *all = malloc(sizeof(struct bss_info) * population->bss_count);
+	struct bss_info *kept = malloc(sizeof(struct bss_info) * population->bss_count);
+	long long *keys = malloc(sizeof(long long) * population->bss_count);
+	struct scan_flood_status status;
+	char capture_file[256];
+	double scan_ns;
+	int e, i, returned;
+
+	snprintf(capture_file, sizeof(capture_file), "/tmp/bench-flood-%d-%d.bin", (int)getpid(), population->bss_count);
+
+	if(all == NULL || kept == NULL || keys == NULL || !synth_write_capture(capture_file, population, 1))
+	{
+		perror("Unable to generate population");
+		return -1;
+	}
+
+	//without guard the caller has to size the table for the whole flood
+	returned = scan(capture_file, NULL, iterations, all, population->bss_count, &scan_ns, &status);
+
+	if(returned < 0)
+		return -1;
+
+	printf("%8d %14s %10.3f %10d %10.1f %8s %8s %8s %6s\n", population->bss_count, "no guard", scan_ns / 1000000.0,
+		returned, returned * sizeof(struct bss_info) / 1024.0, "-", "-", "-", "-");
+
+	for(e = SCAN_EVICT_NONE; e <= SCAN_EVICT_LEAST_RECENT; ++e)
+	{
+		struct scan_flood_guard evicting = *guard;
+		int length = guard->max_bss > 0 && guard->max_bss < population->bss_count ? guard->max_bss : population->bss_count;
+		bool best = true;
+
+		evicting.eviction = e;
+
+		returned = scan(capture_file, &evicting, iterations, kept, length, &scan_ns, &status);
+
+		if(returned < 0)
+			return -1;
+
+		if(e != SCAN_EVICT_NONE)
+		{	//the worst kept is not worse than the best dropped, ties aside
+			long long worst_kept = key(kept + 1, e);
+
+			for(i = 0; i < population->bss_count; ++i)
+				keys[i] = key(all + i, e);
+			qsort(keys, population->bss_count, sizeof(long long), compare_keys);
+
+			for(i = 1; i < length; ++i)
+				if(key(kept + i, e) < worst_kept)
+					worst_kept = key(kept + i, e);
+
+			best = length < 2 || worst_kept == keys[length - 2];
+		}
+
+		best = best && kept[0].status == BSS_ASSOCIATED;
+
+		printf("%8d %14s %10.3f %10d %10.1f %8d %8d %8s %6s\n", population->bss_count, EVICTIONS[e], scan_ns / 1000000.0,
+			returned, returned * sizeof(struct bss_info) / 1024.0, status.max_ssid_repeats, status.max_oui_repeats,
+			status.flood ? "yes" : "no", best ? "ok" : "FAIL");
+	}
+
+	unlink(capture_file);
+	free(all);
+	free(kept);
+	free(keys);
+	return 0;
+}
+
+int scan(const char *capture_file, const struct scan_flood_guard *guard, int iterations, struct bss_info *bss, int bss_length, double *scan_ns, struct scan_flood_status *status)
+{
+	struct wifi_scan *wifi = wifi_scan_init_replay(capture_file, true);
+	double start;
+	int i, returned = 0;
+
+	if(wifi == NULL || wifi_scan_set_flood_guard(wifi, guard) == -1)
+	{
+		perror("Unable to init replay");
+		return -1;
+	}
+
+	start = now_ns();
+
+	for(i = 0; i < iterations; ++i)
+		if((returned = wifi_scan_all(wifi, bss, bss_length)) < 0)
+		{
+			perror("wifi_scan_all failed on replay");
+			return -1;
+		}
+
+	*scan_ns = (now_ns() - start) / iterations;
+	wifi_scan_last_flood_status(wifi, status);
+	wifi_scan_close(wifi);
+
+	return returned;
+}
+
+//descending
+int compare_keys(const void *a, const void *b)
+{
+	long long x = *(const long long*)a, y = *(const long long*)b;
+	return (x < y) - (x > y);
+}
+
+//associated BSS is pinned, skip it
+long long key(const struct bss_info *bss, enum scan_eviction eviction)
+{
+	if(bss->status == BSS_ASSOCIATED)
+		return -(1LL << 62);
+	return eviction == SCAN_EVICT_WEAKEST ? bss->signal_mbm : -(long long)bss->seen_ms_ago;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-i iterations] [-m max_bss] [-f flood_bss] [-r flood_repeats] [bss_count ...]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -m 64 -i 20 1000\n", argv[0]);
+	printf("%s -f 500 -r 100 5000\n", argv[0]);
+}
@@ -0,0 +1,243 @@
+/*
+ * bench-ftm benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures FTM ranging (see FTM RANGING in wifi_scan.h) against full scan.
+ *
+ *  Each run scans all the channels (like wifi_scan_all) to find FTM responders, strongest first.
+ *  Then it ranges against them and collects the results in batches, doing other work
+ *  (sleeping) for a while between collections the way an application polling the library would.
+ *
+ *  For scan and ranging prints the time, for ranging also time to the first result,
+ *  the number of collections (batches) and results, mean distance and its standard deviation.
+ *
+ *  With existing wireless interface as argument it measures the real device (triggering and ranging
+ *  need permissions, the radio and the APs have to support FTM). Without it, it runs against local
+ *  fake backend (see wifi_scan_init_fake) with synthetic population (see synth.h).
+ *
+ *  Examples:
+ *  bench-ftm                          (fake backend)
+ *  bench-ftm -n 500 -t 20 -r 5 -w 100
+ *  sudo bench-ftm -r 3 wlan0          (real device)
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <errno.h> //errno
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //atoi, qsort
+#include <unistd.h> //getopt, usleep
+
+enum {BSS_INFOS=1024, RESULTS_MAX=64, RESULTS_TIMEOUT_MS=2000};
+
+void Usage(char **argv);
+// strongest signal first
+int signal_compare(const void *a, const void *b);
+// BSSes advertising FTM responder role
+int count_responders(const struct bss_info *bss, int found);
+uint64_t isqrt(uint64_t x);
+
+int main(int argc, char **argv)
+{
+	static struct bss_info bss[BSS_INFOS];
+	struct wifi_ftm_result results[RESULTS_MAX];
+	struct scan_params params = {SCAN_MODE_TRIGGERED};
+	struct wifi_capabilities capabilities;
+	struct scan_timings timings;
+	struct wifi_scan *wifi;
+	uint64_t scan_ns = 0, first_ns = 0, ranging_ns = 0, start, distance_mm = 0, deviation_mm = 0;
+	int runs = 3, bss_count = 200, opt, r, i, errors = 0, scanned = 0, responders = 0, peers = 0, batches = 0, received = 0, successes = 0;
+	uint32_t channel_time_ms = 10, work_ms = 50;
+
+	while((opt = getopt(argc, argv, "r:t:n:w:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': runs = atoi(optarg); break;
+			case 't': channel_time_ms = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			case 'w': work_ms = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(runs <= 0 || bss_count <= 0 || bss_count > BSS_INFOS)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	if(optind < argc && wifi_interface_exists(argv[optind]))
+	{
+		printf("measuring %s\n", argv[optind]);
+		wifi = wifi_scan_init(argv[optind]);
+	}
+	else
+	{
+		struct synth_population population;
+		struct synth_dump dump;
+
+		if(optind < argc)
+			printf("no interface %s, ", argv[optind]);
+		printf("measuring fake backend with %d BSSes and %u ms per channel\n", bss_count, channel_time_ms);
+
+		synth_population_default(&population, bss_count);
+		if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		{
+			perror("Unable to generate population");
+			return 1;
+		}
+		wifi = wifi_scan_init_fake(dump.data, dump.length, channel_time_ms);
+		synth_dump_free(&dump);
+		wifi_scan_register_log_callback(silent_log);
+	}
+
+	if(wifi == NULL)
+		return 1;
+
+	wifi_scan_capabilities(wifi, &capabilities);
+	printf("the radio ranges %d peers at once, results collected every %u ms\n", capabilities.ftm_max_peers, work_ms);
+
+	for(r = 0; r < runs; ++r)
+	{
+		int found = wifi_scan_all_params(wifi, &params, bss, BSS_INFOS), count;
+		bool first = true;
+
+		if(found == -1)
+		{
+			perror("scan failed");
+			++errors;
+			continue;
+		}
+
+		wifi_scan_last_timings(wifi, &timings);
+		found = found < BSS_INFOS ? found : BSS_INFOS;
+		responders = count_responders(bss, found);
+
+		qsort(bss, found, sizeof(struct bss_info), signal_compare);
+
+		start = now_ns();
+
+		if((peers = wifi_scan_ftm_start(wifi, bss, found, NULL)) == -1)
+		{
+			perror("ranging failed");
+			++errors;
+			continue;
+		}
+
+		//the first collection waits, the next ones take what came while we were busy
+		while((count = wifi_scan_ftm_results(wifi, results, RESULTS_MAX, RESULTS_TIMEOUT_MS)) > 0)
+		{
+			if(first)
+				first_ns += now_ns() - start;
+			first = false;
+
+			++batches;
+			received += count;
+
+			for(i = 0; i < count; ++i)
+			{
+				if(results[i].status != WIFI_FTM_SUCCESS)
+					continue;
+				++successes;
+				distance_mm += results[i].distance_mm;
+				deviation_mm += isqrt(results[i].distance_variance_mm2);
+			}
+
+			usleep(work_ms * 1000);
+		}
+
+		//ENOENT once all the results are collected
+		if(count == 0 || errno != ENOENT || first)
+		{
+			fprintf(stderr, "collecting results failed (%s)\n", count == 0 ? "timeout" : "error");
+			++errors;
+			continue;
+		}
+
+		ranging_ns += now_ns() - start;
+		scan_ns += timings.total_ns;
+		scanned += found;
+	}
+
+	if(runs > errors)
+	{
+		int ok = runs - errors;
+
+		printf("%d FTM responders in scan results, %d peers ranged\n\n", responders, peers);
+		printf("%-12s %10s %10s %10s %10s %10s\n", "", "ms", "ms first", "batches", "results", "successes");
+		printf("%-12s %10.1f %10s %10s %10.1f %10s\n", "full scan", scan_ns / 1000000.0 / ok, "-", "-", (double)scanned / ok, "-");
+		printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f\n", "ftm ranging", ranging_ns / 1000000.0 / ok, first_ns / 1000000.0 / ok,
+			(double)batches / ok, (double)received / ok, (double)successes / ok);
+
+		//work between collections is part of the ranging time
+		if(successes)
+			printf("\nmean distance %.2f m, mean standard deviation %.2f m\n", distance_mm / 1000.0 / successes, deviation_mm / 1000.0 / successes);
+	}
+
+	wifi_scan_close(wifi);
+
+	return errors == runs;
+}
+
+int count_responders(const struct bss_info *bss, int found)
+{
+	int i, count = 0;
+
+	for(i = 0; i < found; ++i)
+		count += (bss[i].ftm & BSS_FTM_RESPONDER) != 0;
+
+	return count;
+}
+
+int signal_compare(const void *a, const void *b)
+{
+	int32_t sa = ((const struct bss_info *)a)->signal_mbm, sb = ((const struct bss_info *)b)->signal_mbm;
+	return (sa < sb) - (sa > sb);
+}
+
+uint64_t isqrt(uint64_t x)
+{
+	uint64_t r = 0, bit = 1ULL << 62;
+
+	while(bit > x)
+		bit >>= 2;
+
+	for(; bit; bit >>= 2)
+		if(x >= r + bit)
+		{
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		}
+		else
+			r >>= 1;
+
+	return r;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-r runs] [-t channel_time_ms] [-n bss_count] [-w work_ms] [interface]\n\n", argv[0]);
+	printf("-w is the time between collections of results\n");
+	printf("-t and -n apply to fake backend used when there is no interface\n\n");
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -n 500 -t 20 -r 5 -w 100\n", argv[0]);
+	printf("sudo %s -r 3 wlan0\n", argv[0]);
+}
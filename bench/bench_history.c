@@ -0,0 +1,285 @@
+/*
+ * bench-history benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark fills history store (see wifi_history.h) with days of synthetic scans (see synth.h)
+ *  from a few devices, reopens it and measures queries:
+ *  - point: single BSSID on single device in random hour
+ *  - range: all BSSes on single frequency in random day
+ *  - the same range read without index (all BSSes of the day filtered by frequency)
+ *  Query results are checked against the generated data.
+ *
+ *  The directory is emptied of segment files first.
+ *
+ *  Examples:
+ *  bench-history
+ *  bench-history -d 90 -i 60 -g 24 /tmp/history
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+#include "../wifi_history.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h>
+#include <unistd.h> //getopt, unlink
+#include <dirent.h> //opendir
+
+#define BASE_NS 1500000000000000000ULL
+#define SECOND_NS 1000000000ULL
+#define HOUR_NS (3600 * SECOND_NS)
+#define DAY_NS (24 * HOUR_NS)
+
+void Usage(char **argv);
+// the scan of population as seen at time, returns the number of BSSes
+int observe(const struct bss_info *population, int length, int scan, struct bss_info *seen);
+// remove segment files from directory
+void clean(const char *directory);
+// count records matching query in generated data
+int expected(const struct bss_info *population, int length, int scans, uint64_t interval_ns, int devices, const struct wifi_history_query *query, struct bss_info *seen);
+
+int main(int argc, char **argv)
+{
+	int days = 30, interval_s = 300, bss_count = 50, devices = 4, segment_hours = 1, queries = 1000, opt, s, i, p;
+	const char *directory = "bench-history.d";
+
+	while((opt = getopt(argc, argv, "d:i:n:D:g:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'd': days = atoi(optarg); break;
+			case 'i': interval_s = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			case 'D': devices = atoi(optarg); break;
+			case 'g': segment_hours = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(optind < argc)
+		directory = argv[optind];
+
+	if(days <= 0 || interval_s <= 0 || bss_count <= 0 || devices <= 0 || segment_hours <= 0)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	struct synth_population population;
+	struct synth_dump dump;
+	struct bss_info *bss = malloc(sizeof(struct bss_info) * bss_count);
+	struct bss_info *seen = malloc(sizeof(struct bss_info) * bss_count);
+	int records_length = 1 << 20;
+	struct wifi_history_record *records = malloc(sizeof(struct wifi_history_record) * records_length);
+	uint64_t interval_ns = interval_s * SECOND_NS, start, write_ns, open_ns, total = 0, offset = 0;
+	int scans = (int)(days * DAY_NS / interval_ns), scanned = 0, length;
+
+	synth_population_default(&population, bss_count);
+	if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to generate population");
+		return 1;
+	}
+	for(p = 0; p < dump.parts && scanned >= 0; offset += dump.part_lengths[p++])
+		scanned = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[p], bss, bss_count, scanned);
+	synth_dump_free(&dump);
+
+	if(scanned < 0)
+	{
+		perror("Unable to parse population");
+		return 1;
+	}
+	bss_count = scanned < bss_count ? scanned : bss_count;
+
+	//write
+	clean(directory);
+
+	struct wifi_history *history = wifi_history_open(directory, segment_hours * HOUR_NS);
+
+	if(history == NULL)
+	{
+		perror("Unable to open history");
+		return 1;
+	}
+
+	start = now_ns();
+	for(s = 0; s < scans; ++s)
+	{
+		length = observe(bss, bss_count, s, seen);
+		total += length;
+		if(wifi_history_append(history, BASE_NS + s * interval_ns, s % devices, seen, length) == -1)
+		{
+			perror("Unable to append scan");
+			return 1;
+		}
+	}
+	if(wifi_history_close(history) == -1)
+	{
+		perror("Unable to close history");
+		return 1;
+	}
+	write_ns = now_ns() - start;
+
+	//reopen
+	start = now_ns();
+	if((history = wifi_history_open(directory, segment_hours * HOUR_NS)) == NULL)
+	{
+		perror("Unable to reopen history");
+		return 1;
+	}
+	open_ns = now_ns() - start;
+
+	//queries
+	struct wifi_history_query query;
+	uint32_t random = 2463534242u, device;
+	uint64_t point_ns = 0, range_ns = 0, full_ns = 0, point_records = 0, range_records = 0;
+	int errors = 0, result, ranges = queries / 10 + 1;
+
+	for(i = 0; i < queries; ++i)
+	{
+		memset(&query, 0, sizeof(query));
+		device = xorshift32(&random) % devices;
+		query.bssid = bss[xorshift32(&random) % bss_count].bssid;
+		query.device_id = &device;
+		query.from_ns = BASE_NS + (xorshift32(&random) % (days * 24)) * HOUR_NS;
+		query.to_ns = query.from_ns + HOUR_NS;
+
+		start = now_ns();
+		result = wifi_history_query(history, &query, records, records_length);
+		point_ns += now_ns() - start;
+		point_records += result;
+
+		if(i < 10)
+			errors += result != expected(bss, bss_count, scans, interval_ns, devices, &query, seen);
+	}
+
+	for(i = 0; i < ranges; ++i)
+	{
+		memset(&query, 0, sizeof(query));
+		query.frequency = bss[xorshift32(&random) % bss_count].frequency;
+		query.from_ns = BASE_NS + (xorshift32(&random) % days) * DAY_NS;
+		query.to_ns = query.from_ns + DAY_NS;
+
+		start = now_ns();
+		result = wifi_history_query(history, &query, records, records_length);
+		range_ns += now_ns() - start;
+		range_records += result;
+
+		if(i < 3)
+			errors += result != expected(bss, bss_count, scans, interval_ns, devices, &query, seen);
+
+		//the same without index, filtered here
+		uint32_t frequency = query.frequency;
+		int filtered = 0, all, r;
+
+		query.frequency = 0;
+		start = now_ns();
+		all = wifi_history_query(history, &query, records, records_length);
+		for(r = 0; r < all && r < records_length; ++r)
+			filtered += records[r].bss.frequency == frequency;
+		full_ns += now_ns() - start;
+
+		errors += filtered != result;
+	}
+
+	printf("%d days, %d scans, %llu BSSes, %d devices, %d segments, %s\n\n", days, scans, (unsigned long long)total, devices,
+		wifi_history_segments(history), errors ? "QUERY RESULTS DIFFER" : "query results match");
+	printf("%-28s %10.2f ns/BSS\n", "append", (double)write_ns / total);
+	printf("%-28s %10.2f ms\n", "open", open_ns / 1000000.0);
+	printf("%-28s %10.3f ms (%.1f records)\n", "point (BSSID, device, hour)", point_ns / 1000000.0 / queries, (double)point_records / queries);
+	printf("%-28s %10.3f ms (%.1f records)\n", "range (frequency, day)", range_ns / 1000000.0 / ranges, (double)range_records / ranges);
+	printf("%-28s %10.3f ms\n", "range without index", full_ns / 1000000.0 / ranges);
+
+	wifi_history_close(history);
+	free(records);
+	free(seen);
+	free(bss);
+
+	return errors ? 1 : 0;
+}
+
+int expected(const struct bss_info *population, int length, int scans, uint64_t interval_ns, int devices, const struct wifi_history_query *query, struct bss_info *seen)
+{
+	int s, i, count, matching = 0;
+
+	for(s = 0; s < scans; ++s)
+	{
+		uint64_t timestamp_ns = BASE_NS + s * interval_ns;
+
+		if(timestamp_ns < query->from_ns || timestamp_ns >= query->to_ns || (query->device_id && (uint32_t)(s % devices) != *query->device_id))
+			continue;
+
+		count = observe(population, length, s, seen);
+
+		for(i = 0; i < count; ++i)
+			matching += (!query->bssid || !memcmp(seen[i].bssid, query->bssid, BSSID_LENGTH)) && (!query->frequency || seen[i].frequency == query->frequency);
+	}
+
+	return matching;
+}
+
+int observe(const struct bss_info *population, int length, int scan, struct bss_info *seen)
+{
+	int i, count = 0;
+	uint32_t random;
+
+	for(i = 0; i < length; ++i)
+	{
+		random = (uint32_t)(scan + 1) * 2654435761u ^ (uint32_t)(i + 1) * 2246822519u;
+		random ^= random >> 15;
+		random *= 2654435761u;
+
+		//roughly every 10th BSS is missed in the scan
+		if(random % 10 == 0)
+			continue;
+
+		seen[count] = population[i];
+		seen[count].signal_mbm += (int32_t)(random >> 8) % 600 - 300;
+		seen[count].seen_ms_ago = (random >> 16) % 5000;
+		++count;
+	}
+	return count;
+}
+
+void clean(const char *directory)
+{
+	char path[4096];
+	struct dirent *entry;
+	DIR *dir = opendir(directory);
+
+	if(dir == NULL)
+		return;
+
+	while((entry = readdir(dir)) != NULL)
+		if(strstr(entry->d_name, ".snapshot") || strstr(entry->d_name, ".index"))
+		{
+			snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+			unlink(path);
+		}
+
+	closedir(dir);
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-d days] [-i scan_interval_s] [-n bss_count] [-D devices] [-g segment_hours] [directory]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -d 90 -i 60 -g 24 /tmp/history\n", argv[0]);
+}
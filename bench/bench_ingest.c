@@ -0,0 +1,215 @@
+/*
+ * bench-ingest benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures offline ingest (see wifi_ingest.h) throughput with growing number of threads.
+ *  Synthetic capture files (see synth.h) and one raw netlink stream are written first.
+ *
+ *  The baseline is single threaded replay of the captures through wifi_scan_all.
+ *  Each run checks that scans come in order and hashes them, the hash has to be the same for all runs.
+ *
+ *  Examples:
+ *  bench-ingest
+ *  bench-ingest -f 8 -s 2000 -n 300 -t 16
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+#include "../wifi_ingest.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h>
+#include <errno.h>
+#include <unistd.h> //getopt, unlink, sysconf
+
+// what the callback sees
+struct ingest_check
+{
+	int file;
+	int64_t dump;
+	bool ordered;
+	uint64_t scans;
+	uint64_t hash;
+};
+
+void Usage(char **argv);
+int check_scan(const struct wifi_ingest_scan *scan, void *user);
+// write raw stream of dumps of population, false on error
+bool write_raw(const char *path, const struct synth_population *population, int dumps);
+
+int main(int argc, char **argv)
+{
+	int files = 4, scans = 500, bss_count = 200, max_threads = 0, opt, f, t;
+
+	while((opt = getopt(argc, argv, "f:s:n:t:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'f': files = atoi(optarg); break;
+			case 's': scans = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			case 't': max_threads = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(files <= 0 || scans <= 0 || bss_count <= 0 || max_threads < 0)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	if(max_threads == 0)
+		max_threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+	wifi_scan_register_log_callback(silent_log);
+
+	//the last file is raw stream, the others are captures
+	char **paths = calloc(files + 1, sizeof(char*));
+	struct synth_population population;
+
+	for(f = 0; f <= files; ++f)
+	{
+		paths[f] = malloc(64);
+		synth_population_default(&population, bss_count);
+		population.seed += f;
+		snprintf(paths[f], 64, f < files ? "bench-ingest-%d.bin" : "bench-ingest-raw.bin", f);
+
+		if(f < files ? !synth_write_capture(paths[f], &population, scans) : !write_raw(paths[f], &population, scans))
+		{
+			perror("Unable to write input file");
+			return 1;
+		}
+	}
+
+	//baseline, captures replayed through wifi_scan_all
+	struct bss_info *bss = malloc(sizeof(struct bss_info) * bss_count);
+	uint64_t start = now_ns(), replay_ns, replay_scans = 0;
+
+	for(f = 0; f < files; ++f)
+	{
+		struct wifi_scan *replay = wifi_scan_init_replay(paths[f], false);
+
+		if(replay == NULL)
+		{
+			perror("Unable to replay capture");
+			return 1;
+		}
+		while(wifi_scan_all(replay, bss, bss_count) >= 0)
+			++replay_scans;
+		wifi_scan_close(replay);
+	}
+	replay_ns = now_ns() - start;
+
+	printf("%d captures and 1 raw stream, %d scans of %d BSSes each, %d CPUs online\n\n", files, scans, bss_count, (int)sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%-18s %8s %8s %8s %10s %10s %8s %8s\n", "", "threads", "chunks", "steals", "MB/s", "scans/s", "speedup", "order");
+	printf("%-18s %8d %8s %8s %10s %10.0f %8s %8s\n", "replay scan_all", 1, "-", "-", "-", replay_scans * 1e9 / replay_ns, "-", "-");
+
+	struct wifi_ingest_stats stats;
+	uint64_t single_ns = 0, hash = 0, elapsed;
+	int errors = 0;
+
+	for(t = 1; t <= max_threads; t = t * 2 <= max_threads || t == max_threads ? t * 2 : max_threads)
+	{
+		struct ingest_check check = {-1, -1, true, 0, 0};
+
+		start = now_ns();
+		if(wifi_ingest((const char * const *)paths, files + 1, t, check_scan, &check, &stats) == -1)
+		{
+			perror("Ingest failed");
+			return 1;
+		}
+		elapsed = now_ns() - start;
+
+		if(t == 1)
+		{
+			single_ns = elapsed;
+			hash = check.hash;
+		}
+
+		errors += !check.ordered || check.hash != hash || check.scans != stats.dumps - stats.failed_dumps;
+
+		printf("%-18s %8d %8d %8llu %10.1f %10.0f %8.2f %8s\n", "ingest", stats.threads, stats.chunks, (unsigned long long)stats.steals,
+			stats.bytes * 1e3 / elapsed, check.scans * 1e9 / elapsed, (double)single_ns / elapsed, check.ordered ? "ok" : "WRONG");
+	}
+
+	printf("\n%s\n", errors ? "RESULTS DIFFER BETWEEN RUNS" : "results are the same for all runs");
+
+	for(f = 0; f <= files; ++f)
+	{
+		unlink(paths[f]);
+		free(paths[f]);
+	}
+	free(paths);
+	free(bss);
+
+	return errors ? 1 : 0;
+}
+
+int check_scan(const struct wifi_ingest_scan *scan, void *user)
+{
+	struct ingest_check *check = user;
+	int i, b;
+
+	if(scan->file < check->file || (scan->file == check->file && (int64_t)scan->dump <= check->dump))
+		check->ordered = false;
+
+	check->file = scan->file;
+	check->dump = scan->dump;
+	++check->scans;
+
+	check->hash = check->hash * 1099511628211ULL ^ (scan->file * 1000003ULL + scan->dump);
+	for(i = 0; i < scan->bss_count; ++i)
+	{
+		check->hash = check->hash * 1099511628211ULL ^ (uint32_t)scan->bss[i].signal_mbm ^ (uint64_t)scan->bss[i].frequency << 32;
+		for(b = 0; b < BSSID_LENGTH; ++b)
+			check->hash = check->hash * 1099511628211ULL ^ scan->bss[i].bssid[b];
+	}
+
+	return 0;
+}
+
+bool write_raw(const char *path, const struct synth_population *population, int dumps)
+{
+	struct synth_dump dump;
+	FILE *file = fopen(path, "wb");
+	bool ok = file != NULL;
+	int d;
+
+	if(!ok || !synth_scan_dump(population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		if(file)
+			fclose(file);
+		return false;
+	}
+
+	for(d = 0; d < dumps && ok; ++d)
+		ok = fwrite(dump.data, dump.length, 1, file) == 1;
+
+	synth_dump_free(&dump);
+	return fclose(file) == 0 && ok;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-f capture_files] [-s scans_per_file] [-n bss_count] [-t max_threads]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -f 8 -s 2000 -n 300 -t 16\n", argv[0]);
+}
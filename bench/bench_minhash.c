@@ -0,0 +1,214 @@
+/*
+ * bench-minhash benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures MinHash sketching, LSH index insert and query (see wifi_minhash.h)
+ *  against brute force comparison with all stored sketches.
+ *
+ *  Synthetic fleet scans locations on 100 x 100 grid, each cell has 4 APs.
+ *  Scan sees APs of its own and neighbouring cells with probability 0.85 and 2 random transient BSSIDs.
+ *
+ *  Recall is the fraction of scans found by brute force with similarity over threshold
+ *  which were also found by the index. Location hit is the fraction of queries with the best match
+ *  from the same cell.
+ *
+ *  Examples:
+ *  bench-minhash
+ *  bench-minhash -n 1000000 -q 1000 -b 50 -s 0.6
+ *
+ */
+
+#include "common.h"
+#include "../wifi_minhash.h"
+
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi, atof
+#include <string.h> //memset
+#include <unistd.h> //getopt
+
+#define GRID 100
+#define CELL_APS 4
+#define TRANSIENT 2
+#define MATCHES 1024
+
+void Usage(char **argv);
+// scan at cell, returns the number of bss
+int scan_cell(int cell, uint32_t *random, struct bss_info *bss);
+
+int main(int argc, char **argv)
+{
+	int scans = 200000, queries = 1000, brute_queries = 100, opt, i, q, j;
+	float threshold = 0.5f;
+
+	while((opt = getopt(argc, argv, "n:q:b:s:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': scans = atoi(optarg); break;
+			case 'q': queries = atoi(optarg); break;
+			case 'b': brute_queries = atoi(optarg); break;
+			case 's': threshold = atof(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(scans <= 0 || queries <= 0 || brute_queries < 0 || brute_queries > queries || threshold <= 0 || threshold > 1)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	struct wifi_minhash_index *index = wifi_minhash_index_new();
+	struct wifi_minhash *sketches = malloc(sizeof(struct wifi_minhash) * scans);
+	struct wifi_minhash_match *matches = malloc(sizeof(struct wifi_minhash_match) * MATCHES);
+	struct bss_info bss[9 * CELL_APS + TRANSIENT];
+	uint32_t random = 2463534242u;
+	uint64_t start, sketch_ns = 0, add_ns = 0, query_ns = 0, brute_ns = 0, bss_total = 0, matched = 0;
+	int hits = 0, brute_found = 0, brute_recalled = 0, n;
+
+	if(index == NULL)
+	{
+		perror("Unable to create index");
+		return 1;
+	}
+
+	for(i = 0; i < scans; ++i)
+	{
+		int cell = xorshift32(&random) % (GRID * GRID);
+
+		n = scan_cell(cell, &random, bss);
+		bss_total += n;
+
+		start = now_ns();
+		wifi_minhash_sketch(bss, n, &sketches[i]);
+		sketch_ns += now_ns() - start;
+
+		start = now_ns();
+		if(wifi_minhash_index_add(index, &sketches[i], cell) == -1)
+		{
+			perror("Unable to add sketch");
+			return 1;
+		}
+		add_ns += now_ns() - start;
+	}
+
+	for(q = 0; q < queries; ++q)
+	{
+		struct wifi_minhash sketch;
+		int cell = xorshift32(&random) % (GRID * GRID), found;
+
+		n = scan_cell(cell, &random, bss);
+		wifi_minhash_sketch(bss, n, &sketch);
+
+		start = now_ns();
+		found = wifi_minhash_index_query(index, &sketch, threshold, matches, MATCHES);
+		query_ns += now_ns() - start;
+
+		if(found == -1)
+		{
+			perror("Query failed");
+			return 1;
+		}
+
+		matched += found;
+		hits += found > 0 && matches[0].label == (uint64_t)cell;
+
+		if(q >= brute_queries)
+			continue;
+
+		//the index results are sorted by similarity, then by id
+		start = now_ns();
+		for(i = 0; i < scans; ++i)
+		{
+			if(wifi_minhash_similarity(&sketch, &sketches[i]) < threshold)
+				continue;
+
+			++brute_found;
+			for(j = 0; j < found; ++j)
+				if(matches[j].id == i)
+				{
+					++brute_recalled;
+					break;
+				}
+		}
+		brute_ns += now_ns() - start;
+	}
+
+	printf("%d scans, %.1f BSS per scan, %d byte sketches, threshold %.2f\n\n", wifi_minhash_index_size(index), (double)bss_total / scans,
+		(int)sizeof(struct wifi_minhash), threshold);
+	printf("sketch                %10.1f ns/scan\n", (double)sketch_ns / scans);
+	printf("index add             %10.1f ns/scan\n", (double)add_ns / scans);
+	printf("index query           %10.1f us/query\n", query_ns / 1e3 / queries);
+	if(brute_queries)
+		printf("brute force query     %10.1f us/query\n", brute_ns / 1e3 / brute_queries);
+	printf("matches               %10.1f per query\n", (double)matched / queries);
+	printf("location hit          %10.1f %%\n", 100.0 * hits / queries);
+	if(brute_found)
+		printf("recall                %10.1f %%\n", 100.0 * brute_recalled / brute_found);
+
+	wifi_minhash_index_free(index);
+	free(sketches);
+	free(matches);
+
+	return 0;
+}
+
+int scan_cell(int cell, uint32_t *random, struct bss_info *bss)
+{
+	int x = cell % GRID, y = cell / GRID, dx, dy, a, n = 0;
+
+	for(dy = -1; dy <= 1; ++dy)
+		for(dx = -1; dx <= 1; ++dx)
+		{
+			if(x + dx < 0 || x + dx >= GRID || y + dy < 0 || y + dy >= GRID)
+				continue;
+
+			for(a = 0; a < CELL_APS; ++a)
+			{
+				uint32_t ap = ((y + dy) * GRID + x + dx) * CELL_APS + a;
+
+				if(xorshift32(random) % 100 >= 85)
+					continue;
+
+				memset(&bss[n], 0, sizeof(struct bss_info));
+				bss[n].bssid[0] = 0x02;
+				bss[n].bssid[3] = ap >> 16;
+				bss[n].bssid[4] = ap >> 8;
+				bss[n].bssid[5] = ap;
+				++n;
+			}
+		}
+
+	//phones and other transient hotspots
+	for(a = 0; a < TRANSIENT; ++a)
+	{
+		uint32_t transient = xorshift32(random);
+
+		memset(&bss[n], 0, sizeof(struct bss_info));
+		bss[n].bssid[0] = 0x06;
+		memcpy(bss[n].bssid + 2, &transient, sizeof(transient));
+		++n;
+	}
+
+	return n;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-n scans] [-q queries] [-b brute_force_queries] [-s similarity_threshold]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -n 1000000 -q 1000 -b 50 -s 0.6\n", argv[0]);
+}
@@ -0,0 +1,232 @@
+/*
+ * bench-multi-bssid benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures Multiple BSSID expansion (see MULTIPLE BSSID in wifi_scan.h)
+ *  on local fake backend (see wifi_scan_init_fake) with synthetic populations (see synth.h)
+ *  where growing share of BSSes advertises nontransmitted BSS profiles.
+ *
+ *  Each population is dumped twice - the way older kernels do it (only transmitted BSSes,
+ *  the library makes the rest from profiles) and the way newer kernels do it (nontransmitted
+ *  BSSes as separate records, the library only links them).
+ *
+ *  For each population and kernel prints:
+ *  - the number of records the kernel reported and the library returned
+ *  - nontransmitted and expanded (made from profile) records
+ *  - radios (distinct transmitter_bssid)
+ *  - dump time per call
+ *  - if every nontransmitted record links to transmitted record in the results
+ *
+ *  Examples:
+ *  bench-multi-bssid
+ *  bench-multi-bssid -n 100 -i 200
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //atoi, qsort
+#include <string.h> //memcmp
+#include <unistd.h> //getopt
+
+enum {BSS_INFOS=4096};
+
+static const int MULTI_BSSID_PERCENTS[] = {0, 5, 10, 25};
+static const int MULTI_BSSID_PERCENTS_LENGTH = sizeof(MULTI_BSSID_PERCENTS) / sizeof(MULTI_BSSID_PERCENTS[0]);
+
+struct result
+{
+	int kernel; //records in the dump
+	int returned;
+	int nontransmitted;
+	int expanded;
+	int radios;
+	double dump_us;
+	bool linked;
+};
+
+void Usage(char **argv);
+// scan population dumped by older or newer kernel iterations times, false on error
+bool measure(int bss_count, int multi_bssid_percent, bool reported, int iterations, struct bss_info *bss, struct result *result);
+// distinct transmitter_bssid of results, sorts them
+int count_radios(struct bss_info *bss, int found);
+// every nontransmitted BSS has its transmitted BSS in results
+bool check_links(const struct bss_info *bss, int found);
+int transmitter_compare(const void *a, const void *b);
+
+int main(int argc, char **argv)
+{
+	static struct bss_info bss[BSS_INFOS];
+	int bss_count = 200, iterations = 100, opt, p, k;
+	bool same = true;
+
+	while((opt = getopt(argc, argv, "n:i:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': bss_count = atoi(optarg); break;
+			case 'i': iterations = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(bss_count <= 0 || iterations <= 0 || bss_count >= BSS_INFOS / 8)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	wifi_scan_register_log_callback(silent_log);
+
+	printf("%d BSSes, %d iterations\n\n", bss_count, iterations);
+	printf("%8s %-10s %8s %8s %8s %8s %8s %10s %8s\n", "multi %", "kernel", "records", "returned", "nontx", "expanded", "radios", "dump us", "links");
+
+	for(p = 0; p < MULTI_BSSID_PERCENTS_LENGTH; ++p)
+	{
+		struct result results[2];
+
+		for(k = 0; k < 2; ++k)
+		{
+			struct result *r = &results[k];
+
+			if(!measure(bss_count, MULTI_BSSID_PERCENTS[p], k, iterations, bss, r))
+			{
+				perror("measure failed");
+				return 1;
+			}
+
+			printf("%8d %-10s %8d %8d %8d %8d %8d %10.1f %8s\n", MULTI_BSSID_PERCENTS[p], k ? "reporting" : "profiles",
+				r->kernel, r->returned, r->nontransmitted, r->expanded, r->radios, r->dump_us, r->linked ? "ok" : "BROKEN");
+
+			same = same && r->linked;
+		}
+
+		//the library makes up for older kernel (unless there are more profiles than it links)
+		if(results[0].nontransmitted < WIFI_SCAN_MULTIPLE_BSSID_MAX)
+			same = same && results[0].returned == results[1].returned && results[0].radios == results[1].radios
+				&& results[1].expanded == 0 && results[0].radios == bss_count;
+	}
+
+	printf("\nolder and newer kernel: %s\n", same ? "same" : "DIFFERENT");
+
+	return same ? 0 : 1;
+}
+
+bool measure(int bss_count, int multi_bssid_percent, bool reported, int iterations, struct bss_info *bss, struct result *result)
+{
+	struct synth_population population;
+	struct synth_dump dump;
+	struct scan_params params = {SCAN_MODE_CACHED};
+	struct scan_timings timings;
+	struct wifi_scan *wifi;
+	uint64_t dump_ns = 0;
+	int i, found = 0;
+	size_t offset;
+
+	synth_population_default(&population, bss_count);
+	population.multi_bssid_percent = multi_bssid_percent;
+	population.multi_bssid_reported = reported;
+
+	if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		return false;
+
+	//what the kernel sends, without linking
+	for(i = 0, offset = 0, result->kernel = 0; i < dump.parts && result->kernel >= 0; offset += dump.part_lengths[i++])
+		result->kernel = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[i], bss, BSS_INFOS, result->kernel);
+
+	wifi = wifi_scan_init_fake(dump.data, dump.length, 0);
+	synth_dump_free(&dump);
+
+	if(wifi == NULL)
+		return false;
+
+	for(i = 0; i < iterations; ++i)
+	{
+		if((found = wifi_scan_all_params(wifi, &params, bss, BSS_INFOS)) == -1)
+		{
+			wifi_scan_close(wifi);
+			return false;
+		}
+		wifi_scan_last_timings(wifi, &timings);
+		dump_ns += timings.dump_ns;
+	}
+
+	wifi_scan_close(wifi);
+
+	found = found < BSS_INFOS ? found : BSS_INFOS;
+	result->returned = found;
+	result->nontransmitted = result->expanded = 0;
+
+	for(i = 0; i < found; ++i)
+	{
+		result->nontransmitted += (bss[i].multiple_bssid & BSS_MULTIPLE_BSSID_NONTRANSMITTED) != 0;
+		result->expanded += (bss[i].multiple_bssid & BSS_MULTIPLE_BSSID_EXPANDED) != 0;
+	}
+
+	result->linked = check_links(bss, found);
+	result->radios = count_radios(bss, found);
+	result->dump_us = dump_ns / 1000.0 / iterations;
+
+	return true;
+}
+
+bool check_links(const struct bss_info *bss, int found)
+{
+	int i, j;
+
+	for(i = 0; i < found; ++i)
+	{
+		if(!(bss[i].multiple_bssid & BSS_MULTIPLE_BSSID_NONTRANSMITTED))
+			continue;
+
+		for(j = 0; j < found; ++j)
+			if((bss[j].multiple_bssid & BSS_MULTIPLE_BSSID_TRANSMITTED) && !memcmp(bss[j].bssid, bss[i].transmitter_bssid, BSSID_LENGTH))
+				break;
+
+		if(j == found)
+			return false;
+	}
+
+	return true;
+}
+
+int count_radios(struct bss_info *bss, int found)
+{
+	int i, radios = found > 0;
+
+	qsort(bss, found, sizeof(struct bss_info), transmitter_compare);
+
+	for(i = 1; i < found; ++i)
+		radios += transmitter_compare(&bss[i - 1], &bss[i]) != 0;
+
+	return radios;
+}
+
+int transmitter_compare(const void *a, const void *b)
+{
+	return memcmp(((const struct bss_info *)a)->transmitter_bssid, ((const struct bss_info *)b)->transmitter_bssid, BSSID_LENGTH);
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-n bss_count] [-i iterations]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -n 100 -i 200\n", argv[0]);
+}
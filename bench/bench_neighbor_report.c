@@ -0,0 +1,260 @@
+/*
+ * bench-neighbor-report benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures roaming candidate discovery time of full scan against
+ *  neighbor report (see NEIGHBOR REPORT in wifi_scan.h) followed by scan of neighbour channels only.
+ *
+ *  Each run scans all the channels (like wifi_scan_all) and counts candidates - other BSSes
+ *  of the associated SSID. Then it asks the associated AP for neighbours and scans their channels,
+ *  candidates are neighbours found in that scan.
+ *
+ *  With existing wireless interface as argument it measures the real device (triggering and sending
+ *  frames needs permissions, the AP has to support 802.11k and wpa_supplicant may hold the registration).
+ *  Without it, it runs against local fake backend (see wifi_scan_init_fake) with synthetic population
+ *  (see synth.h) where we are associated with BSS of the most common SSID.
+ *
+ *  Examples:
+ *  bench-neighbor-report                      (fake backend)
+ *  bench-neighbor-report -n 500 -t 20 -r 5
+ *  sudo bench-neighbor-report -r 3 wlan0      (real device)
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //atoi
+#include <string.h> //strcmp, memcmp
+#include <unistd.h> //getopt
+
+enum {BSS_INFOS=1024, NEIGHBORS_MAX=64, CHANNELS_MAX=64};
+enum bench_scan {SCAN_FULL, SCAN_NEIGHBORS, SCANS};
+
+static const char *SCAN_NAMES[SCANS] = {"full scan", "neighbors"};
+
+void Usage(char **argv);
+// index of the first BSS with the most common non-empty SSID in the population, -1 on error
+int most_common_ssid(const struct synth_population *population);
+// other BSSes of the associated SSID in scan results
+int count_candidates(const struct bss_info *bss, int found);
+// BSSes of scan results reported as neighbours
+int count_neighbors(const struct bss_info *bss, int found, const struct wifi_neighbor *neighbors, int neighbors_length);
+
+int main(int argc, char **argv)
+{
+	static struct bss_info bss[BSS_INFOS];
+	struct wifi_neighbor neighbors[NEIGHBORS_MAX];
+	uint32_t frequencies[CHANNELS_MAX];
+	struct scan_params params[SCANS] = { {SCAN_MODE_TRIGGERED}, {SCAN_MODE_TRIGGERED, frequencies} };
+	uint64_t total_ns[SCANS] = {0}, report_ns = 0, start;
+	int runs = 3, bss_count = 200, opt, r, s, found[SCANS] = {0}, errors[SCANS] = {0}, reported = 0;
+	uint32_t channel_time_ms = 10;
+	struct scan_timings timings;
+	struct wifi_scan *wifi;
+
+	while((opt = getopt(argc, argv, "r:t:n:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': runs = atoi(optarg); break;
+			case 't': channel_time_ms = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(runs <= 0 || bss_count <= 0 || bss_count > BSS_INFOS)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	if(optind < argc && wifi_interface_exists(argv[optind]))
+	{
+		printf("measuring %s\n", argv[optind]);
+		wifi = wifi_scan_init(argv[optind]);
+	}
+	else
+	{
+		struct synth_population population;
+		struct synth_dump dump;
+
+		if(optind < argc)
+			printf("no interface %s, ", argv[optind]);
+		printf("measuring fake backend with %d BSSes and %u ms per channel\n", bss_count, channel_time_ms);
+
+		//choosing associated BSS doesn't change what is generated
+		synth_population_default(&population, bss_count);
+		population.associated = most_common_ssid(&population);
+
+		if(population.associated == -1 || !synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		{
+			perror("Unable to generate population");
+			return 1;
+		}
+		wifi = wifi_scan_init_fake(dump.data, dump.length, channel_time_ms);
+		synth_dump_free(&dump);
+		wifi_scan_register_log_callback(silent_log);
+	}
+
+	if(wifi == NULL)
+		return 1;
+
+	for(r = 0; r < runs; ++r)
+	{
+		int status = wifi_scan_all_params(wifi, &params[SCAN_FULL], bss, BSS_INFOS);
+
+		if(status == -1)
+			++errors[SCAN_FULL];
+		else
+		{
+			wifi_scan_last_timings(wifi, &timings);
+			total_ns[SCAN_FULL] += timings.total_ns;
+			found[SCAN_FULL] += count_candidates(bss, status < BSS_INFOS ? status : BSS_INFOS);
+		}
+
+		start = now_ns();
+
+		if((reported = wifi_scan_neighbor_report(wifi, neighbors, NEIGHBORS_MAX, WIFI_NEIGHBOR_TIMEOUT_MS)) == -1)
+		{
+			perror("neighbor report failed");
+			++errors[SCAN_NEIGHBORS];
+			continue;
+		}
+
+		report_ns += now_ns() - start;
+		params[SCAN_NEIGHBORS].frequencies_length = wifi_scan_neighbor_frequencies(wifi, neighbors, reported, frequencies, CHANNELS_MAX);
+
+		//nobody around, nothing to scan
+		if(params[SCAN_NEIGHBORS].frequencies_length == 0)
+		{
+			total_ns[SCAN_NEIGHBORS] += now_ns() - start;
+			continue;
+		}
+
+		if(params[SCAN_NEIGHBORS].frequencies_length > CHANNELS_MAX)
+			params[SCAN_NEIGHBORS].frequencies_length = CHANNELS_MAX;
+
+		if((status = wifi_scan_all_params(wifi, &params[SCAN_NEIGHBORS], bss, BSS_INFOS)) == -1)
+		{
+			++errors[SCAN_NEIGHBORS];
+			continue;
+		}
+
+		total_ns[SCAN_NEIGHBORS] += now_ns() - start;
+		found[SCAN_NEIGHBORS] += count_neighbors(bss, status < BSS_INFOS ? status : BSS_INFOS, neighbors, reported < NEIGHBORS_MAX ? reported : NEIGHBORS_MAX);
+	}
+
+	printf("%d neighbours reported on %d channels\n\n", reported > 0 ? reported : 0, reported > 0 ? params[SCAN_NEIGHBORS].frequencies_length : 0);
+	printf("%-12s %10s %8s %10s %11s\n", "", "channels", "errors", "ms", "candidates");
+	for(s = 0; s < SCANS; ++s)
+	{
+		int ok = runs - errors[s];
+		char count[16] = "all";
+
+		if(s != SCAN_FULL)
+			snprintf(count, sizeof(count), "%d", params[s].frequencies_length);
+
+		printf("%-12s %10s %8d %10.1f %11.1f\n", SCAN_NAMES[s], count, errors[s],
+			ok ? total_ns[s] / 1000000.0 / ok : 0.0, ok ? (double)found[s] / ok : 0.0);
+	}
+
+	if(runs > errors[SCAN_NEIGHBORS])
+		printf("\nneighbor report alone %.1f ms\n", report_ns / 1000000.0 / (runs - errors[SCAN_NEIGHBORS]));
+
+	wifi_scan_close(wifi);
+
+	return 0;
+}
+
+int most_common_ssid(const struct synth_population *population)
+{
+	static struct bss_info bss[BSS_INFOS];
+	struct synth_dump dump;
+	int i, j, found = 0, best = -1, best_count = 0;
+	size_t offset = 0;
+
+	if(!synth_scan_dump(population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		return -1;
+
+	for(i = 0; i < dump.parts && found >= 0; offset += dump.part_lengths[i++])
+		found = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[i], bss, BSS_INFOS, found);
+	synth_dump_free(&dump);
+
+	//records come in population order (nontransmitted BSSes are not reported separately)
+	for(i = 0; i < found && i < BSS_INFOS; ++i)
+	{
+		int count = 0;
+
+		if(bss[i].ssid[0] == '\0')
+			continue;
+
+		for(j = 0; j < found && j < BSS_INFOS; ++j)
+			count += !strcmp(bss[i].ssid, bss[j].ssid);
+
+		if(count > best_count)
+		{
+			best = i;
+			best_count = count;
+		}
+	}
+
+	return best;
+}
+
+int count_candidates(const struct bss_info *bss, int found)
+{
+	int i, associated, count = 0;
+
+	for(associated = 0; associated < found && bss[associated].status != BSS_ASSOCIATED; ++associated)
+		;
+
+	if(associated == found || bss[associated].ssid[0] == '\0')
+		return 0;
+
+	for(i = 0; i < found; ++i)
+		count += i != associated && !strcmp(bss[i].ssid, bss[associated].ssid);
+
+	return count;
+}
+
+int count_neighbors(const struct bss_info *bss, int found, const struct wifi_neighbor *neighbors, int neighbors_length)
+{
+	int i, n, count = 0;
+
+	for(i = 0; i < found; ++i)
+		for(n = 0; n < neighbors_length; ++n)
+			if(!memcmp(bss[i].bssid, neighbors[n].bssid, BSSID_LENGTH))
+			{
+				++count;
+				break;
+			}
+
+	return count;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-r runs] [-t channel_time_ms] [-n bss_count] [interface]\n\n", argv[0]);
+	printf("-t and -n apply to fake backend used when there is no interface\n\n");
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -n 500 -t 20 -r 5\n", argv[0]);
+	printf("sudo %s -r 3 wlan0\n", argv[0]);
+}
@@ -0,0 +1,387 @@
+/*
+ * bench-parser benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark runs the functions of the parse path in isolation over fixed netlink fixtures:
+ *  - handle_NL80211_CMD_NEW_SCAN_RESULTS (whole message)
+ *  - parse_NL80211_ATTR_BSS (nested BSS attribute)
+ *  - parse_NL80211_BSS_INFORMATION_ELEMENTS (IEs binary data)
+ *  - validate (through mnl_attr_parse_nested of BSS attribute)
+ *  - handle_NL80211_CMD_NEW_STATION (whole message)
+ *  - mnl_cb_run of received parts (what receive_nl_message does)
+ * 
+ *  It reports ns per message, ns per BSS and heap allocations per iteration.
+ * 
+ *  The library is compiled into the benchmark to reach its static functions.
+ *  Fixtures are synthetic with fixed seeds (see synth.h) so the numbers are comparable
+ *  between library versions. Capture files may be passed to use recorded scan results as well, e.g:
+ *  bench-parser
+ *  bench-parser -i 1000 capture.bin
+ * 
+ */
+
+#include "../wifi_scan.c"
+#include "common.h"
+#include "synth.h"
+
+#include <unistd.h> //getopt
+
+// FIXTURES
+
+enum {MAX_FIXTURES=16, MAX_NAME=64};
+
+struct fixture
+{
+	char name[MAX_NAME];
+	char *data; //received parts one after another
+	size_t length;
+	size_t *part_lengths;
+	int parts;
+	int messages; //NL80211_CMD_NEW_SCAN_RESULTS messages
+};
+
+// pointers into fixture data gathered once, so that each benchmark measures only its function
+struct fixture_index
+{
+	const struct nlmsghdr **messages;
+	struct nlattr **bss;
+	struct nlattr **ies;
+	int messages_length, bss_length, ies_length;
+};
+
+// ALLOCATION COUNTING - wraps glibc allocator
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocations = 0;
+
+void *malloc(size_t size) { ++allocations; return __libc_malloc(size); }
+void *calloc(size_t nmemb, size_t size) { ++allocations; return __libc_calloc(nmemb, size); }
+void *realloc(void *ptr, size_t size) { ++allocations; return __libc_realloc(ptr, size); }
+
+void Usage(char **argv);
+bool synthetic_fixture(struct fixture *fixture, const char *name, int bss_count, int vendor_ies, int multi_bssid_percent);
+int capture_fixtures(struct fixture *fixtures, int length, const char *capture_file);
+void index_fixture(const struct fixture *fixture, struct fixture_index *index);
+struct nlmsghdr *station_message(char *buf);
+void report(const char *fixture, const char *function, double ns, int iterations, int messages, int bss, unsigned long allocs);
+void bench_fixture(const struct fixture *fixture, int iterations);
+void bench_station(int iterations);
+
+int main(int argc, char **argv)
+{
+	struct fixture fixtures[MAX_FIXTURES];
+	int fixtures_length = 0, iterations = 200, opt, i;
+
+	while((opt = getopt(argc, argv, "i:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'i': iterations = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	wifi_scan_register_log_callback(silent_log);
+
+	if(!synthetic_fixture(&fixtures[fixtures_length++], "typical-50", 50, 3, 10)
+	|| !synthetic_fixture(&fixtures[fixtures_length++], "dense-500", 500, 3, 10)
+	|| !synthetic_fixture(&fixtures[fixtures_length++], "heavy-ies-500", 500, 12, 50))
+	{
+		perror("Unable to generate fixtures");
+		return 1;
+	}
+
+	for(i = optind; i < argc; ++i)
+		fixtures_length += capture_fixtures(fixtures + fixtures_length, MAX_FIXTURES - fixtures_length, argv[i]);
+
+	printf("%-24s %-44s %10s %12s %10s %12s\n", "fixture", "function", "messages", "ns/message", "ns/bss", "allocs/iter");
+
+	for(i = 0; i < fixtures_length; ++i)
+		bench_fixture(&fixtures[i], iterations);
+
+	bench_station(iterations * 100);
+
+	return 0;
+}
+
+void bench_fixture(const struct fixture *fixture, int iterations)
+{
+	struct fixture_index index;
+	struct bss_info *bss = __libc_malloc(sizeof(struct bss_info) * (fixture->messages + 1));
+	struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { bss, fixture->messages, 0 };
+	struct netlink_channel channel = { 0 };
+	struct bss_info decoded;
+	unsigned long allocs;
+	double start;
+	int i, j;
+
+	channel.context = &scan_results;
+	index_fixture(fixture, &index);
+
+	//receive path - whole parts through mnl_cb_run
+	allocs = allocations;
+	start = now_ns();
+	for(i = 0; i < iterations; ++i)
+	{
+		size_t offset = 0;
+		scan_results.scanned = 0;
+		for(j = 0; j < fixture->parts; offset += fixture->part_lengths[j++])
+			mnl_cb_run(fixture->data + offset, fixture->part_lengths[j], 0, 0, handle_NL80211_CMD_NEW_SCAN_RESULTS, &channel);
+	}
+	report(fixture->name, "mnl_cb_run(parts)", now_ns() - start, iterations, index.messages_length, index.bss_length, allocations - allocs);
+
+	allocs = allocations;
+	start = now_ns();
+	for(i = 0; i < iterations; ++i)
+	{
+		scan_results.scanned = 0;
+		for(j = 0; j < index.messages_length; ++j)
+			handle_NL80211_CMD_NEW_SCAN_RESULTS(index.messages[j], &channel);
+	}
+	report(fixture->name, "handle_NL80211_CMD_NEW_SCAN_RESULTS", now_ns() - start, iterations, index.messages_length, index.bss_length, allocations - allocs);
+
+	allocs = allocations;
+	start = now_ns();
+	for(i = 0; i < iterations; ++i)
+	{
+		scan_results.scanned = 0;
+		for(j = 0; j < index.bss_length; ++j)
+			parse_NL80211_ATTR_BSS(index.bss[j], &channel);
+	}
+	report(fixture->name, "parse_NL80211_ATTR_BSS", now_ns() - start, iterations, index.bss_length, index.bss_length, allocations - allocs);
+
+	allocs = allocations;
+	start = now_ns();
+	for(i = 0; i < iterations; ++i)
+		for(j = 0; j < index.ies_length; ++j)
+			parse_NL80211_BSS_INFORMATION_ELEMENTS(index.ies[j], &decoded);
+	report(fixture->name, "parse_NL80211_BSS_INFORMATION_ELEMENTS", now_ns() - start, iterations, index.ies_length, index.ies_length, allocations - allocs);
+
+	allocs = allocations;
+	start = now_ns();
+	for(i = 0; i < iterations; ++i)
+		for(j = 0; j < index.bss_length; ++j)
+		{
+			struct nlattr *tb[NL80211_BSS_MAX + 1] = {};
+			struct validation_data vd = { tb, NL80211_BSS_MAX, NL80211_BSS_VALIDATION, NL80211_BSS_VALIDATION_LENGTH };
+			mnl_attr_parse_nested(index.bss[j], validate, &vd);
+		}
+	report(fixture->name, "validate(BSS attributes)", now_ns() - start, iterations, index.bss_length, index.bss_length, allocations - allocs);
+
+	free(index.messages);
+	free(index.bss);
+	free(index.ies);
+	free(bss);
+}
+
+void bench_station(int iterations)
+{
+	char buf[MNL_SOCKET_BUFFER_SIZE];
+	struct station_info station;
+	struct context_NL80211_CMD_NEW_STATION station_results = { &station };
+	struct netlink_channel channel = { 0 };
+	struct nlmsghdr *nlh = station_message(buf);
+	unsigned long allocs;
+	double start;
+	int i;
+
+	channel.context = &station_results;
+
+	allocs = allocations;
+	start = now_ns();
+	for(i = 0; i < iterations; ++i)
+		handle_NL80211_CMD_NEW_STATION(nlh, &channel);
+	report("station", "handle_NL80211_CMD_NEW_STATION", now_ns() - start, iterations, 1, 0, allocations - allocs);
+}
+
+void report(const char *fixture, const char *function, double ns, int iterations, int messages, int bss, unsigned long allocs)
+{
+	printf("%-24s %-44s %10d %12.1f ", fixture, function, messages, messages ? ns / iterations / messages : 0.0);
+	if(bss)
+		printf("%10.1f", ns / iterations / bss);
+	else
+		printf("%10s", "-");
+	printf(" %12.2f\n", (double)allocs / iterations);
+}
+
+bool synthetic_fixture(struct fixture *fixture, const char *name, int bss_count, int vendor_ies, int multi_bssid_percent)
+{
+	struct synth_population population;
+	struct synth_dump dump;
+
+	synth_population_default(&population, bss_count);
+	population.vendor_ies = vendor_ies;
+	population.multi_bssid_percent = multi_bssid_percent;
+
+	if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		return false;
+
+	snprintf(fixture->name, MAX_NAME, "%s", name);
+	fixture->data = dump.data;
+	fixture->length = dump.length;
+	fixture->part_lengths = dump.part_lengths;
+	fixture->parts = dump.parts;
+	fixture->messages = bss_count;
+	return true;
+}
+
+// each scan dump received on commands channel becomes a fixture
+int capture_fixtures(struct fixture *fixtures, int length, const char *capture_file)
+{
+	struct wifi_scan_capture_header header;
+	struct wifi_scan_capture_record record;
+	struct fixture *fixture = NULL;
+	FILE *file = fopen(capture_file, "rb");
+	char part[MNL_SOCKET_DUMP_SIZE];
+	int count = 0;
+
+	if(file == NULL || fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, WIFI_SCAN_CAPTURE_MAGIC, sizeof(header.magic)) != 0)
+	{
+		fprintf(stderr, "%s is not a capture file, ignoring\n", capture_file);
+		if(file)
+			fclose(file);
+		return 0;
+	}
+
+	while(fread(&record, sizeof(record), 1, file) == 1)
+	{
+		if(record.result > (int32_t)sizeof(part) || (record.result > 0 && fread(part, record.result, 1, file) != 1))
+			break;
+
+		if(record.channel != WIFI_SCAN_CHANNEL_COMMANDS || record.direction != WIFI_SCAN_CAPTURE_RECEIVE || record.result <= 0)
+		{
+			fixture = NULL;
+			continue;
+		}
+
+		const struct nlmsghdr *nlh = (const struct nlmsghdr*)part;
+		bool scan_results = nlh->nlmsg_type != NLMSG_ERROR && nlh->nlmsg_type != NLMSG_DONE
+		                 && ((struct genlmsghdr*)mnl_nlmsg_get_payload(nlh))->cmd == NL80211_CMD_NEW_SCAN_RESULTS;
+
+		if(fixture == NULL && scan_results && count < length)
+		{ //start of the next dump
+			fixture = fixtures + count++;
+			memset(fixture, 0, sizeof(*fixture));
+			snprintf(fixture->name, MAX_NAME, "%.40s#%d", capture_file, count);
+		}
+
+		if(fixture == NULL)
+			continue;
+
+		fixture->data = realloc(fixture->data, fixture->length + record.result);
+		fixture->part_lengths = realloc(fixture->part_lengths, (fixture->parts + 1) * sizeof(size_t));
+		memcpy(fixture->data + fixture->length, part, record.result);
+		fixture->length += record.result;
+		fixture->part_lengths[fixture->parts++] = record.result;
+
+		int remaining = record.result;
+		for(; mnl_nlmsg_ok(nlh, remaining); nlh = mnl_nlmsg_next(nlh, &remaining))
+			if(nlh->nlmsg_type == NLMSG_DONE)
+				fixture = NULL;
+			else if(nlh->nlmsg_type != NLMSG_ERROR)
+				++fixture->messages;
+	}
+
+	fclose(file);
+	return count;
+}
+
+void index_fixture(const struct fixture *fixture, struct fixture_index *index)
+{
+	size_t offset = 0;
+	int p;
+
+	memset(index, 0, sizeof(*index));
+	index->messages = __libc_malloc(sizeof(struct nlmsghdr*) * (fixture->messages + 1));
+	index->bss = __libc_malloc(sizeof(struct nlattr*) * (fixture->messages + 1));
+	index->ies = __libc_malloc(sizeof(struct nlattr*) * (fixture->messages + 1));
+
+	for(p = 0; p < fixture->parts; offset += fixture->part_lengths[p++])
+	{
+		const struct nlmsghdr *nlh = (const struct nlmsghdr*)(fixture->data + offset);
+		int remaining = fixture->part_lengths[p];
+
+		for(; mnl_nlmsg_ok(nlh, remaining) && index->messages_length < fixture->messages; nlh = mnl_nlmsg_next(nlh, &remaining))
+		{
+			struct nlattr *attr, *bss_attr = NULL;
+
+			if(nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR)
+				continue;
+
+			index->messages[index->messages_length++] = nlh;
+
+			mnl_attr_for_each(attr, nlh, sizeof(struct genlmsghdr))
+				if(mnl_attr_get_type(attr) == NL80211_ATTR_BSS)
+					bss_attr = attr;
+
+			if(bss_attr == NULL)
+				continue;
+
+			index->bss[index->bss_length++] = bss_attr;
+
+			mnl_attr_for_each_nested(attr, bss_attr)
+				if(mnl_attr_get_type(attr) == NL80211_BSS_INFORMATION_ELEMENTS)
+					index->ies[index->ies_length++] = attr;
+		}
+	}
+}
+
+// what the kernel typically answers to NL80211_CMD_GET_STATION
+struct nlmsghdr *station_message(char *buf)
+{
+	struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+	struct genlmsghdr *genl = (struct genlmsghdr*)mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+	uint8_t mac[BSSID_LENGTH] = {0x00, 0x50, 0xf2, 0x00, 0x00, 0x01};
+
+	nlh->nlmsg_type = 0x1c;
+	genl->cmd = NL80211_CMD_NEW_STATION;
+	genl->version = 1;
+
+	mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, 3);
+	mnl_attr_put(nlh, NL80211_ATTR_MAC, BSSID_LENGTH, mac);
+	mnl_attr_put_u32(nlh, NL80211_ATTR_GENERATION, 42);
+
+	struct nlattr *sta_info = mnl_attr_nest_start(nlh, NL80211_ATTR_STA_INFO);
+	mnl_attr_put_u32(nlh, NL80211_STA_INFO_INACTIVE_TIME, 120);
+	mnl_attr_put_u64(nlh, NL80211_STA_INFO_RX_BYTES64, 123456789);
+	mnl_attr_put_u64(nlh, NL80211_STA_INFO_TX_BYTES64, 23456789);
+	mnl_attr_put_u32(nlh, NL80211_STA_INFO_RX_PACKETS, 123456);
+	mnl_attr_put_u32(nlh, NL80211_STA_INFO_TX_PACKETS, 23456);
+	mnl_attr_put_u32(nlh, NL80211_STA_INFO_TX_RETRIES, 12);
+	mnl_attr_put_u32(nlh, NL80211_STA_INFO_TX_FAILED, 1);
+	mnl_attr_put_u8(nlh, NL80211_STA_INFO_SIGNAL, (uint8_t)-52);
+	mnl_attr_put_u8(nlh, NL80211_STA_INFO_SIGNAL_AVG, (uint8_t)-54);
+	struct nlattr *rate = mnl_attr_nest_start(nlh, NL80211_STA_INFO_TX_BITRATE);
+	mnl_attr_put_u16(nlh, NL80211_RATE_INFO_BITRATE, 8667);
+	mnl_attr_put_u32(nlh, NL80211_RATE_INFO_BITRATE32, 8667);
+	mnl_attr_put_u8(nlh, NL80211_RATE_INFO_VHT_MCS, 9);
+	mnl_attr_put_u8(nlh, NL80211_RATE_INFO_VHT_NSS, 2);
+	mnl_attr_nest_end(nlh, rate);
+	mnl_attr_put_u64(nlh, NL80211_STA_INFO_RX_DURATION, 987654);
+	mnl_attr_nest_end(nlh, sta_info);
+
+	return nlh;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-i iterations] [capture_file ...]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -i 1000 capture.bin\n", argv[0]);
+}
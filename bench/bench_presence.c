@@ -0,0 +1,312 @@
+/*
+ * bench-presence benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures presence detector (see wifi_presence.h) update time with many places
+ *  and compares similarities with brute force weighted Jaccard of the scan and each place.
+ *
+ *  Synthetic site is 100 x 100 grid of cells with 4 APs each. Scan sees APs of its own cell
+ *  (strong signal) and neighbouring cells (weaker) with random misses, noise and 2 transient BSSIDs.
+ *  Places are random cells with 3 reference scans each. The device dwells in cell for some scans
+ *  and then moves to neighbouring cell or jumps to random place.
+ *
+ *  Detection is run with the given thresholds and without hysteresis (single threshold, single scan)
+ *  to show the number of false enters (device not in place cell).
+ *
+ *  Examples:
+ *  bench-presence
+ *  bench-presence -p 1000 -s 100000 -d 20 -e 0.5 -l 0.3 -c 2
+ *
+ */
+
+#include "common.h"
+#include "../wifi_presence.h"
+
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi, atof
+#include <string.h> //memset
+#include <math.h> //fabs
+#include <unistd.h> //getopt
+
+#define GRID 100
+#define CELL_APS 4
+#define TRANSIENT 2
+#define SCAN_MAX (9 * CELL_APS + TRANSIENT)
+
+void Usage(char **argv);
+double gaussian(uint32_t *state);
+// scan at cell, returns the number of bss
+int scan_cell(int cell, uint32_t *random, struct bss_info *bss);
+// AP index from BSSID or -1 for transient
+int bss_ap(const struct bss_info *bss);
+int level(int32_t signal_mbm);
+// run the walk, returns false on error
+bool run(const struct wifi_presence_config *config, int places, int scans, int dwell, bool check);
+
+int main(int argc, char **argv)
+{
+	struct wifi_presence_config config = {0.5f, 0.3f, 2}, single;
+	int places = 300, scans = 20000, dwell = 30, opt;
+
+	while((opt = getopt(argc, argv, "p:s:d:e:l:c:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'p': places = atoi(optarg); break;
+			case 's': scans = atoi(optarg); break;
+			case 'd': dwell = atoi(optarg); break;
+			case 'e': config.enter = atof(optarg); break;
+			case 'l': config.leave = atof(optarg); break;
+			case 'c': config.confirm_scans = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(places <= 0 || places > GRID * GRID || scans <= 0 || dwell <= 0 || config.leave > config.enter || config.confirm_scans < 1)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	single.enter = single.leave = (config.enter + config.leave) / 2;
+	single.confirm_scans = 1;
+
+	printf("%d places, %d scans, dwell %d scans\n\n", places, scans, dwell);
+	printf("%-32s %10s %10s %8s %8s %8s %8s\n", "", "us/update", "us/brute", "visits", "enters", "false", "results");
+
+	if(!run(&config, places, scans, dwell, true) || !run(&single, places, scans, dwell, false))
+		return 1;
+
+	return 0;
+}
+
+bool run(const struct wifi_presence_config *config, int places, int scans, int dwell, bool check)
+{
+	struct wifi_presence *presence = wifi_presence_new(config);
+	struct wifi_presence_event *events = malloc(sizeof(struct wifi_presence_event) * places);
+	int *place_cells = malloc(sizeof(int) * places), *cell_place = malloc(sizeof(int) * GRID * GRID);
+	uint8_t *place_levels = calloc((size_t)places * GRID * GRID * CELL_APS, 1), *place_max;
+	int32_t *place_mass = calloc(places, sizeof(int32_t));
+	struct bss_info bss[SCAN_MAX];
+	uint32_t random = 2463534242u;
+	uint64_t start, update_ns = 0, brute_ns = 0;
+	int p, s, i, n, r, cell, visits = 0, enters = 0, false_enters = 0, different = 0;
+	char title[64];
+
+	if(presence == NULL)
+	{
+		perror("Unable to create detector");
+		return false;
+	}
+
+	for(i = 0; i < GRID * GRID; ++i)
+		cell_place[i] = -1;
+
+	for(p = 0; p < places; ++p)
+	{
+		do
+			cell = xorshift32(&random) % (GRID * GRID);
+		while(cell_place[cell] != -1);
+
+		place_cells[p] = cell;
+		cell_place[cell] = p;
+		place_max = place_levels + (size_t)p * GRID * GRID * CELL_APS;
+
+		for(r = 0; r < 3; ++r)
+		{
+			n = scan_cell(cell, &random, bss);
+
+			if((r == 0 ? wifi_presence_add_place(presence, bss, n) : wifi_presence_extend_place(presence, p, bss, n)) == -1)
+			{
+				perror("Unable to add place");
+				return false;
+			}
+
+			//transient BSSIDs of references are never seen again but count in the place mass
+			for(i = 0; i < n; ++i)
+				if(bss_ap(&bss[i]) == -1)
+					place_mass[p] += level(bss[i].signal_mbm);
+				else if(level(bss[i].signal_mbm) > place_max[bss_ap(&bss[i])])
+					place_max[bss_ap(&bss[i])] = level(bss[i].signal_mbm);
+		}
+	}
+
+	for(p = 0; p < places; ++p)
+		for(i = 0, place_max = place_levels + (size_t)p * GRID * GRID * CELL_APS; i < GRID * GRID * CELL_APS; ++i)
+			place_mass[p] += place_max[i];
+
+	cell = place_cells[0];
+
+	for(s = 0; s < scans; ++s)
+	{
+		if(s && s % dwell == 0)
+		{
+			int previous = cell;
+
+			if(xorshift32(&random) % 100 < 30)
+				cell = place_cells[xorshift32(&random) % places];
+			else
+			{
+				int x = cell % GRID + (int)(xorshift32(&random) % 3) - 1, y = cell / GRID + (int)(xorshift32(&random) % 3) - 1;
+				x = x < 0 ? 0 : x >= GRID ? GRID - 1 : x;
+				y = y < 0 ? 0 : y >= GRID ? GRID - 1 : y;
+				cell = y * GRID + x;
+			}
+			visits += cell_place[cell] != -1 && cell != previous;
+		}
+		else if(s == 0)
+			visits = 1;
+
+		n = scan_cell(cell, &random, bss);
+
+		start = now_ns();
+		int found = wifi_presence_update(presence, bss, n, events, places);
+		update_ns += now_ns() - start;
+
+		if(found == -1)
+		{
+			perror("Update failed");
+			return false;
+		}
+
+		for(i = 0; i < found; ++i)
+			if(events[i].type == WIFI_PRESENCE_ENTER)
+			{
+				++enters;
+				false_enters += place_cells[events[i].place] != cell;
+			}
+
+		if(!check)
+			continue;
+
+		//brute force weighted Jaccard over the places
+		start = now_ns();
+		int32_t scan_mass = 0;
+		for(i = 0; i < n; ++i)
+			scan_mass += level(bss[i].signal_mbm);
+
+		for(p = 0; p < places; ++p)
+		{
+			int32_t overlap = 0;
+			place_max = place_levels + (size_t)p * GRID * GRID * CELL_APS;
+
+			for(i = 0; i < n; ++i)
+				if(bss_ap(&bss[i]) != -1)
+				{
+					int l = level(bss[i].signal_mbm), m = place_max[bss_ap(&bss[i])];
+					overlap += l < m ? l : m;
+				}
+
+			float similarity = (float)overlap / (scan_mass + place_mass[p] - overlap);
+			different += fabs(similarity - wifi_presence_similarity(presence, p)) > 1e-6;
+		}
+		brute_ns += now_ns() - start;
+	}
+
+	snprintf(title, sizeof(title), "enter %.2f leave %.2f confirm %d", config->enter, config->leave, config->confirm_scans);
+	if(check)
+		printf("%-32s %10.2f %10.2f %8d %8d %8d %8s\n", title, update_ns / 1e3 / scans, brute_ns / 1e3 / scans, visits, enters, false_enters, different ? "WRONG" : "ok");
+	else
+		printf("%-32s %10.2f %10s %8d %8d %8d %8s\n", title, update_ns / 1e3 / scans, "-", visits, enters, false_enters, "-");
+
+	wifi_presence_free(presence);
+	free(events);
+	free(place_cells);
+	free(cell_place);
+	free(place_levels);
+	free(place_mass);
+
+	return different == 0;
+}
+
+int scan_cell(int cell, uint32_t *random, struct bss_info *bss)
+{
+	int x = cell % GRID, y = cell / GRID, dx, dy, a, n = 0;
+
+	for(dy = -1; dy <= 1; ++dy)
+		for(dx = -1; dx <= 1; ++dx)
+		{
+			bool own = dx == 0 && dy == 0;
+
+			if(x + dx < 0 || x + dx >= GRID || y + dy < 0 || y + dy >= GRID)
+				continue;
+
+			for(a = 0; a < CELL_APS; ++a)
+			{
+				uint32_t ap = ((y + dy) * GRID + x + dx) * CELL_APS + a;
+
+				if(xorshift32(random) % 100 >= (own ? 90u : 70u))
+					continue;
+
+				memset(&bss[n], 0, sizeof(struct bss_info));
+				bss[n].bssid[0] = 0x02;
+				bss[n].bssid[3] = ap >> 16;
+				bss[n].bssid[4] = ap >> 8;
+				bss[n].bssid[5] = ap;
+				bss[n].signal_mbm = (int32_t)(((own ? -50 : -72) + 4 * gaussian(random)) * 100);
+				++n;
+			}
+		}
+
+	//phones and other transient hotspots
+	for(a = 0; a < TRANSIENT; ++a)
+	{
+		uint32_t transient = xorshift32(random);
+
+		memset(&bss[n], 0, sizeof(struct bss_info));
+		bss[n].bssid[0] = 0x06;
+		memcpy(bss[n].bssid + 2, &transient, sizeof(transient));
+		bss[n].signal_mbm = (int32_t)((-80 + 4 * gaussian(random)) * 100);
+		++n;
+	}
+
+	return n;
+}
+
+int bss_ap(const struct bss_info *bss)
+{
+	return bss->bssid[0] == 0x02 ? bss->bssid[3] << 16 | bss->bssid[4] << 8 | bss->bssid[5] : -1;
+}
+
+int level(int32_t signal_mbm)
+{
+	int dbm = signal_mbm / 100, l;
+
+	if(dbm < WIFI_PRESENCE_FLOOR_DBM)
+		return 0;
+
+	l = (dbm - WIFI_PRESENCE_FLOOR_DBM) / WIFI_PRESENCE_LEVEL_DB + 1;
+	return l > WIFI_PRESENCE_MAX_LEVEL ? WIFI_PRESENCE_MAX_LEVEL : l;
+}
+
+// approximation with the sum of uniform variables
+double gaussian(uint32_t *state)
+{
+	double sum = 0;
+	int i;
+
+	for(i = 0; i < 12; ++i)
+		sum += xorshift32(state) / 4294967296.0;
+
+	return sum - 6.0;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-p places] [-s scans] [-d dwell_scans] [-e enter] [-l leave] [-c confirm_scans]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -p 1000 -s 100000 -d 20 -e 0.5 -l 0.3 -c 2\n", argv[0]);
+}
@@ -0,0 +1,229 @@
+/*
+ * bench-rogue benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures rogue AP detector (see wifi_rogue.h) check time per record
+ *  in a venue with thousands of BSSes and verifies that injected anomalies alert in the same scan.
+ *
+ *  The venue has SSIDs with ~25 BSSIDs each and one of typical security setups
+ *  (open, WPA2-PSK, WPA3-SAE, WPA2/WPA3 transition, WPA2-Enterprise). It is trusted first.
+ *  Then each scan is the whole venue with anomalies:
+ *  - evil twins (known SSID, new BSSID, open)
+ *  - security downgrades of known BSSIDs (SAE to PSK, PSK to open, MFP dropped)
+ *  - known BSSIDs moved to 6 GHz channel not used by the SSID
+ *
+ *  Anomalies are new in each scan (except twins which are repeated once to check deduplication).
+ *
+ *  Examples:
+ *  bench-rogue
+ *  bench-rogue -b 10000 -s 500 -n 200 -a 10
+ *
+ */
+
+#include "common.h"
+#include "../wifi_rogue.h"
+
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h> //memcpy
+#include <unistd.h> //getopt
+
+#define CIPHER_CCMP 4
+#define AKM_8021X 1
+#define AKM_PSK 2
+#define AKM_SAE 8
+
+void Usage(char **argv);
+void venue(struct bss_info *bss, int bss_count, int ssids, uint32_t *random);
+void security_setup(int setup, struct bss_security *security);
+
+int main(int argc, char **argv)
+{
+	int bss_count = 5000, ssids = 200, scans = 100, anomalies = 5, opt, s, a, i;
+
+	while((opt = getopt(argc, argv, "b:s:n:a:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'b': bss_count = atoi(optarg); break;
+			case 's': ssids = atoi(optarg); break;
+			case 'n': scans = atoi(optarg); break;
+			case 'a': anomalies = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(bss_count <= 0 || ssids <= 0 || ssids > bss_count || scans <= 0 || anomalies < 0 || 2 * anomalies * scans > bss_count)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	struct wifi_rogue *rogue = wifi_rogue_new();
+	struct bss_info *trusted = malloc(sizeof(struct bss_info) * bss_count);
+	struct bss_info *scan = malloc(sizeof(struct bss_info) * (bss_count + 2 * anomalies));
+	struct wifi_rogue_alert *alerts = malloc(sizeof(struct wifi_rogue_alert) * (bss_count + 2 * anomalies));
+	struct bss_info last_twin;
+	uint32_t random = 2463534242u, twin = 0;
+	uint64_t start, trust_ns, check_ns = 0, records = 0;
+	int expected = 0, raised = 0, false_alerts = 0, next = 0, found;
+
+	if(rogue == NULL)
+	{
+		perror("Unable to create detector");
+		return 1;
+	}
+
+	venue(trusted, bss_count, ssids, &random);
+
+	start = now_ns();
+	if(wifi_rogue_trust(rogue, trusted, bss_count) == -1)
+	{
+		perror("Unable to trust venue");
+		return 1;
+	}
+	trust_ns = now_ns() - start;
+
+	for(s = 0; s < scans; ++s)
+	{
+		int n = bss_count;
+
+		memcpy(scan, trusted, sizeof(struct bss_info) * bss_count);
+
+		//each known BSSID is changed at most once in the run
+		for(a = 0; a < anomalies; ++a, ++next)
+		{
+			struct bss_info *bss = &scan[next * (bss_count / (2 * anomalies * scans))];
+			struct bss_security *security = &bss->security;
+
+			if(a % 2 == 0)
+			{
+				bss->frequency = 5955 + 20 * (a % 59);
+				bss->channel_width = BSS_CHANNEL_WIDTH_80;
+			}
+			else if(security->akm_suites & (1 << AKM_SAE))
+				security->akm_suites = 1 << AKM_PSK;
+			else if(security->protocols)
+				memset(security, 0, sizeof(struct bss_security));
+			else
+				security_setup(1, security);
+			++expected;
+		}
+
+		//evil twins, the last one of previous scan again
+		if(s > 0 && anomalies > 0)
+			scan[n++] = last_twin;
+
+		for(a = 0; a < anomalies; ++a, ++expected)
+		{
+			struct bss_info *bss = &scan[n++];
+
+			*bss = trusted[xorshift32(&random) % bss_count];
+			memset(&bss->security, 0, sizeof(struct bss_security));
+			bss->bssid[0] = 0x0a;
+			bss->bssid[4] = ++twin >> 8;
+			bss->bssid[5] = twin;
+			last_twin = *bss;
+		}
+
+		start = now_ns();
+		found = wifi_rogue_check(rogue, scan, n, alerts, n);
+		check_ns += now_ns() - start;
+		records += n;
+
+		if(found == -1)
+		{
+			perror("Check failed");
+			return 1;
+		}
+
+		raised += found;
+
+		//known BSSIDs may alert only for changed parameters
+		for(i = 0; i < found; ++i)
+			if(alerts[i].bss.bssid[0] != 0x0a && (alerts[i].reasons & WIFI_ROGUE_UNKNOWN_BSSID))
+				++false_alerts;
+	}
+
+	printf("%d BSSes, %d SSID profiles, %d scans\n\n", bss_count, wifi_rogue_profiles(rogue), scans);
+	printf("trust                 %10.1f ns/record\n", (double)trust_ns / bss_count);
+	printf("check                 %10.1f ns/record\n", (double)check_ns / records);
+	printf("check                 %10.1f us/scan\n", check_ns / 1e3 / scans);
+	printf("anomalies             %10d\n", expected);
+	printf("alerts                %10d\n", raised);
+	printf("missed                %10d\n", expected > raised ? expected - raised : 0);
+	printf("false alerts          %10d\n", false_alerts + (raised > expected ? raised - expected : 0));
+
+	wifi_rogue_free(rogue);
+	free(trusted);
+	free(scan);
+	free(alerts);
+
+	return raised == expected && false_alerts == 0 ? 0 : 1;
+}
+
+void venue(struct bss_info *bss, int bss_count, int ssids, uint32_t *random)
+{
+	static const uint32_t FREQUENCIES[] = {2412, 2437, 2462, 5180, 5200, 5220, 5240, 5500, 5520, 5540, 5560, 5745, 5765, 5785, 5805};
+	const int frequencies = sizeof(FREQUENCIES) / sizeof(FREQUENCIES[0]);
+	int i;
+
+	for(i = 0; i < bss_count; ++i)
+	{
+		int ssid = i % ssids;
+
+		memset(&bss[i], 0, sizeof(struct bss_info));
+		bss[i].bssid[0] = 0x02;
+		bss[i].bssid[3] = i >> 16;
+		bss[i].bssid[4] = i >> 8;
+		bss[i].bssid[5] = i;
+		snprintf(bss[i].ssid, SSID_MAX_LENGTH_WITH_NULL, "venue-%d", ssid);
+		bss[i].frequency = FREQUENCIES[xorshift32(random) % frequencies];
+		bss[i].channel = bss[i].frequency < 3000 ? (bss[i].frequency - 2407) / 5 : (bss[i].frequency - 5000) / 5;
+		bss[i].channel_width = bss[i].frequency < 3000 ? BSS_CHANNEL_WIDTH_20 : BSS_CHANNEL_WIDTH_80;
+		bss[i].signal_mbm = -9000 + (int32_t)(xorshift32(random) % 6000);
+		security_setup(ssid % 5, &bss[i].security);
+		bss[i].capability = bss[i].security.protocols ? 0x0411 : 0x0401;
+	}
+}
+
+void security_setup(int setup, struct bss_security *security)
+{
+	memset(security, 0, sizeof(struct bss_security));
+
+	if(setup == 0) //open
+		return;
+
+	security->protocols = BSS_SECURITY_RSN;
+	security->group_cipher = CIPHER_CCMP;
+	security->pairwise_ciphers = 1 << CIPHER_CCMP;
+
+	switch(setup)
+	{
+		case 1: security->akm_suites = 1 << AKM_PSK; break;
+		case 2: security->akm_suites = 1 << AKM_SAE; security->rsn_capabilities = 0xC0; break;
+		case 3: security->akm_suites = 1 << AKM_PSK | 1 << AKM_SAE; security->rsn_capabilities = 0x80; break;
+		default: security->akm_suites = 1 << AKM_8021X; security->rsn_capabilities = 0x80; break;
+	}
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-b bss_count] [-s ssids] [-n scans] [-a anomalies_per_scan]\n\n", argv[0]);
+	printf("anomalies * scans * 2 can't exceed bss_count\n\n");
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -b 10000 -s 500 -n 200 -a 10\n", argv[0]);
+}
@@ -0,0 +1,173 @@
+/*
+ * bench-scale benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures how the parser and wifi_scan_all scale with the number of BSSes around.
+ *  Synthetic populations (see synth.h) are parsed directly with wifi_scan_parse_scan_results
+ *  and through wifi_scan_all replaying synthetic capture.
+ * 
+ *  For each population prints parse throughput and memory per BSS:
+ *  - wire bytes the kernel sends per BSS
+ *  - bytes of struct bss_info the caller keeps per BSS
+ *  - heap bytes allocated by the library while parsing per BSS
+ * 
+ *  Program takes optional arguments, e.g:
+ *  bench-scale                       (populations of 50, 500 and 5000 BSSes)
+ *  bench-scale -m 5 -i 200 100 1000  (5% malformed records, 200 iterations, 100 and 1000 BSSes)
+ *  bench-scale -w capture 5000       (also keep synthetic capture as capture-5000.bin)
+ * 
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h>
+#include <unistd.h> //getopt, unlink
+#include <malloc.h> //mallinfo2
+
+void Usage(char **argv);
+long heap_in_use(void);
+int bench_population(const struct synth_population *population, int iterations, const char *capture_prefix);
+
+int main(int argc, char **argv)
+{
+	static const int DEFAULT_POPULATIONS[] = {50, 500, 5000};
+	int iterations = 100, malformed_percent = 0, opt, i;
+	const char *capture_prefix = NULL;
+
+	while((opt = getopt(argc, argv, "i:m:w:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'i': iterations = atoi(optarg); break;
+			case 'm': malformed_percent = atoi(optarg); break;
+			case 'w': capture_prefix = optarg; break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	//malformed records are logged by the library, don't measure the terminal
+	wifi_scan_register_log_callback(silent_log);
+
+	printf("%8s %8s %12s %10s %10s %14s %12s %10s %10s %10s\n",
+		"bss", "parsed", "parse ns/bss", "parse MB/s", "scan ms", "scan_all ns/bss", "wire B/bss", "info B/bss", "heap B/bss", "malformed");
+
+	for(i = optind; i < argc || (optind == argc && i - optind < 3); ++i)
+	{
+		struct synth_population population;
+		synth_population_default(&population, optind == argc ? DEFAULT_POPULATIONS[i - optind] : atoi(argv[i]));
+		population.malformed_percent = malformed_percent;
+
+		if(bench_population(&population, iterations, capture_prefix) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+int bench_population(const struct synth_population *population, int iterations, const char *capture_prefix)
+{
+	struct synth_dump dump;
+	struct bss_info *bss = malloc(sizeof(struct bss_info) * (population->bss_count + 1));
+	char capture_file[256];
+	double start, parse_ns, scan_ns;
+	long heap_before, heap_after;
+	int i, p, scanned = 0;
+
+	if(bss == NULL || !synth_scan_dump(population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to generate population");
+		return -1;
+	}
+
+	//the parser directly, dump is received in parts
+	heap_before = heap_in_use();
+	start = now_ns();
+
+	for(i = 0; i < iterations; ++i)
+	{
+		size_t offset = 0;
+		scanned = 0;
+		for(p = 0; p < dump.parts && scanned >= 0; offset += dump.part_lengths[p++])
+			scanned = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[p], bss, population->bss_count, scanned);
+	}
+
+	parse_ns = (now_ns() - start) / iterations;
+	heap_after = heap_in_use();
+
+	//wifi_scan_all replaying capture (notifications, trigger, dump), memory copies and sequence checks included
+	if(capture_prefix)
+		snprintf(capture_file, sizeof(capture_file), "%s-%d.bin", capture_prefix, population->bss_count);
+	else
+		snprintf(capture_file, sizeof(capture_file), "/tmp/bench-scale-%d-%d.bin", (int)getpid(), population->bss_count);
+
+	if(!synth_write_capture(capture_file, population, 1))
+	{
+		perror("Unable to write synthetic capture");
+		return -1;
+	}
+
+	struct wifi_scan *wifi = wifi_scan_init_replay(capture_file, true);
+
+	if(!capture_prefix)
+		unlink(capture_file);
+
+	if(wifi == NULL)
+		return -1;
+
+	start = now_ns();
+
+	for(i = 0; i < iterations; ++i)
+		if(wifi_scan_all(wifi, bss, population->bss_count) < 0)
+		{
+			perror("wifi_scan_all failed on replay");
+			return -1;
+		}
+
+	scan_ns = (now_ns() - start) / iterations;
+
+	wifi_scan_close(wifi);
+
+	printf("%8d %8d %12.1f %10.1f %10.3f %14.1f %12.1f %10zu %10.1f %9d%%\n",
+		population->bss_count, scanned,
+		parse_ns / population->bss_count, dump.length / parse_ns * 1000.0,
+		scan_ns / 1000000.0, scan_ns / population->bss_count,
+		(double)dump.length / population->bss_count, sizeof(struct bss_info),
+		(double)(heap_after - heap_before) / population->bss_count,
+		population->malformed_percent);
+
+	synth_dump_free(&dump);
+	free(bss);
+	return 0;
+}
+
+long heap_in_use(void)
+{
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-i iterations] [-m malformed_percent] [-w capture_prefix] [bss_count ...]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -m 5 -i 200 100 1000\n", argv[0]);
+	printf("%s -w capture 5000\n", argv[0]);
+}
@@ -0,0 +1,301 @@
+/*
+ * bench-scan-latency benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark repeatedly runs scans in each mode and station queries, records phase timings
+ *  (see struct scan_timings) and discovered BSS counts, prints percentile summary and optionally CSV.
+ * 
+ *  Modes:
+ *  - triggered - like wifi_scan_all
+ *  - targeted - triggered scan of some frequencies only (-f)
+ *  - cached - results cached by the driver
+ *  - observe - wait for scan triggered by somebody else (may block for long on real interface)
+ *  - station - wifi_scan_station
+ * 
+ *  With existing wireless interface as argument it measures the real device (triggering needs permissions).
+ *  Without it, it runs against local fake backend (see wifi_scan_init_fake) with synthetic population.
+ * 
+ *  Examples:
+ *  bench-scan-latency                                (fake backend, all modes)
+ *  sudo bench-scan-latency -r 50 -c scans.csv wlan0  (real device, all modes but observe)
+ *  bench-scan-latency -m targeted,cached -f 2412,5180 -t 10 -n 500
+ * 
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi, qsort
+#include <string.h>
+#include <errno.h>
+#include <unistd.h> //getopt
+
+enum bench_mode {MODE_TRIGGERED, MODE_TARGETED, MODE_CACHED, MODE_OBSERVE, MODE_STATION, MODES};
+enum bench_phase {PHASE_NOTIFICATIONS, PHASE_TRIGGER, PHASE_WAIT, PHASE_DUMP, PHASE_STATION, PHASE_TOTAL, PHASES};
+enum {MAX_FREQUENCIES=64, BSS_INFOS=1024};
+
+static const char *MODE_NAMES[MODES] = {"triggered", "targeted", "cached", "observe", "station"};
+static const char *PHASE_NAMES[PHASES] = {"notifications", "trigger", "wait", "dump", "station", "total"};
+
+// single measured call
+struct run
+{
+	uint64_t phase_ns[PHASES];
+	int bss; //the number of discovered BSSes (or 1 for station)
+	int error; //errno if the call failed, 0 otherwise
+	bool triggered;
+};
+
+void Usage(char **argv);
+int parse_modes(const char *list, bool modes[MODES]);
+int parse_frequencies(char *list, uint32_t *frequencies);
+void measure(struct wifi_scan *wifi, enum bench_mode mode, const struct scan_params *targeted, struct run *run);
+void summary(enum bench_mode mode, const struct run *runs, int length);
+void csv(FILE *file, enum bench_mode mode, const struct run *runs, int length);
+int compare_u64(const void *a, const void *b);
+
+int main(int argc, char **argv)
+{
+	bool modes[MODES] = {true, true, true, true, true};
+	uint32_t frequencies[MAX_FREQUENCIES] = {2412, 2437, 2462};
+	int frequencies_length = 3, runs = 20, bss_count = 100, opt, m;
+	uint32_t channel_time_ms = 5;
+	const char *csv_file = NULL;
+	bool modes_given = false;
+	struct wifi_scan *wifi;
+
+	while((opt = getopt(argc, argv, "r:m:f:c:t:n:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r': runs = atoi(optarg); break;
+			case 'm': if(parse_modes(optarg, modes) == -1) { Usage(argv); return 1; } modes_given = true; break;
+			case 'f': frequencies_length = parse_frequencies(optarg, frequencies); break;
+			case 'c': csv_file = optarg; break;
+			case 't': channel_time_ms = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(optind < argc && wifi_interface_exists(argv[optind]))
+	{
+		printf("measuring %s\n", argv[optind]);
+		wifi = wifi_scan_init(argv[optind]);
+		//nobody may scan for us on real device
+		if(!modes_given)
+			modes[MODE_OBSERVE] = false;
+	}
+	else
+	{
+		struct synth_population population;
+		struct synth_dump dump;
+
+		if(optind < argc)
+			printf("no interface %s, ", argv[optind]);
+		printf("measuring fake backend with %d BSSes and %u ms per channel\n", bss_count, channel_time_ms);
+
+		synth_population_default(&population, bss_count);
+		if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+		{
+			perror("Unable to generate population");
+			return 1;
+		}
+		wifi = wifi_scan_init_fake(dump.data, dump.length, channel_time_ms);
+		synth_dump_free(&dump);
+		wifi_scan_register_log_callback(silent_log);
+	}
+
+	if(wifi == NULL)
+		return 1;
+
+	struct scan_params targeted = { SCAN_MODE_TRIGGERED, frequencies, frequencies_length };
+	struct run *results = malloc(sizeof(struct run) * runs);
+	FILE *file = NULL;
+
+	if(csv_file)
+	{
+		file = strcmp(csv_file, "-") == 0 ? stdout : fopen(csv_file, "w");
+		if(file == NULL)
+		{
+			perror("Unable to create CSV file");
+			return 1;
+		}
+		fprintf(file, "mode,run,error,bss,triggered,notifications_us,trigger_us,wait_us,dump_us,station_us,total_us\n");
+	}
+
+	printf("%-10s %-14s %6s %6s %8s %10s %10s %10s %10s\n", "mode", "phase", "runs", "errors", "bss", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+	for(m = 0; m < MODES; ++m)
+	{
+		int r;
+
+		if(!modes[m])
+			continue;
+
+		for(r = 0; r < runs; ++r)
+			measure(wifi, m, &targeted, &results[r]);
+
+		summary(m, results, runs);
+
+		if(file)
+			csv(file, m, results, runs);
+	}
+
+	if(file && file != stdout)
+		fclose(file);
+
+	free(results);
+	wifi_scan_close(wifi);
+
+	return 0;
+}
+
+void measure(struct wifi_scan *wifi, enum bench_mode mode, const struct scan_params *targeted, struct run *run)
+{
+	static struct bss_info bss[BSS_INFOS];
+	struct station_info station;
+	struct scan_params params = { SCAN_MODE_TRIGGERED };
+	struct scan_timings timings;
+	int status;
+
+	if(mode == MODE_CACHED)
+		params.mode = SCAN_MODE_CACHED;
+	else if(mode == MODE_OBSERVE)
+		params.mode = SCAN_MODE_OBSERVE;
+
+	errno = 0;
+
+	if(mode == MODE_STATION)
+		status = wifi_scan_station(wifi, &station);
+	else
+		status = wifi_scan_all_params(wifi, mode == MODE_TARGETED ? targeted : &params, bss, BSS_INFOS);
+
+	wifi_scan_last_timings(wifi, &timings);
+
+	run->error = status < 0 ? errno : 0;
+	run->bss = status < 0 ? 0 : status;
+	run->triggered = timings.triggered;
+	run->phase_ns[PHASE_NOTIFICATIONS] = timings.notifications_ns;
+	run->phase_ns[PHASE_TRIGGER] = timings.trigger_ns;
+	run->phase_ns[PHASE_WAIT] = timings.wait_ns;
+	run->phase_ns[PHASE_DUMP] = timings.dump_ns;
+	run->phase_ns[PHASE_STATION] = timings.station_ns;
+	run->phase_ns[PHASE_TOTAL] = timings.total_ns;
+}
+
+// nearest rank percentiles of successful runs for each phase that happened
+void summary(enum bench_mode mode, const struct run *runs, int length)
+{
+	uint64_t *values = malloc(sizeof(uint64_t) * length);
+	int errors = 0, ok = 0, bss = 0, p, r;
+
+	for(r = 0; r < length; ++r)
+		if(runs[r].error)
+			++errors;
+		else
+			bss += runs[r].bss;
+
+	for(p = 0; p < PHASES; ++p)
+	{
+		for(r = 0, ok = 0; r < length; ++r)
+			if(!runs[r].error)
+				values[ok++] = runs[r].phase_ns[p];
+
+		if(ok == 0 || (p != PHASE_TOTAL && values[0] == 0 && values[ok - 1] == 0))
+			continue;
+
+		qsort(values, ok, sizeof(uint64_t), compare_u64);
+
+		if(values[ok - 1] == 0)
+			continue;
+
+		printf("%-10s %-14s %6d %6d %8.1f %10.3f %10.3f %10.3f %10.3f\n",
+			MODE_NAMES[mode], PHASE_NAMES[p], length, errors, (double)bss / ok,
+			values[(ok * 50 + 99) / 100 - 1] / 1e6, values[(ok * 90 + 99) / 100 - 1] / 1e6,
+			values[(ok * 99 + 99) / 100 - 1] / 1e6, values[ok - 1] / 1e6);
+	}
+
+	if(errors == length)
+		printf("%-10s %-14s %6d %6d (all failed, last error: %s)\n", MODE_NAMES[mode], "-", length, errors, strerror(runs[length - 1].error));
+
+	free(values);
+}
+
+void csv(FILE *file, enum bench_mode mode, const struct run *runs, int length)
+{
+	int r, p;
+
+	for(r = 0; r < length; ++r)
+	{
+		fprintf(file, "%s,%d,%d,%d,%d", MODE_NAMES[mode], r, runs[r].error, runs[r].bss, runs[r].triggered);
+		for(p = 0; p < PHASES; ++p)
+			fprintf(file, ",%.1f", runs[r].phase_ns[p] / 1000.0);
+		fprintf(file, "\n");
+	}
+}
+
+int parse_modes(const char *list, bool modes[MODES])
+{
+	char copy[256], *token, *save;
+	int m;
+
+	memset(modes, 0, sizeof(bool) * MODES);
+	snprintf(copy, sizeof(copy), "%s", list);
+
+	for(token = strtok_r(copy, ",", &save); token; token = strtok_r(NULL, ",", &save))
+	{
+		for(m = 0; m < MODES && strcmp(token, MODE_NAMES[m]) != 0; ++m)
+			;
+		if(m == MODES)
+		{
+			fprintf(stderr, "unknown mode %s\n", token);
+			return -1;
+		}
+		modes[m] = true;
+	}
+	return 0;
+}
+
+int parse_frequencies(char *list, uint32_t *frequencies)
+{
+	char *token, *save;
+	int length = 0;
+
+	for(token = strtok_r(list, ",", &save); token && length < MAX_FREQUENCIES; token = strtok_r(NULL, ",", &save))
+		frequencies[length++] = atoi(token);
+
+	return length;
+}
+
+int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-r runs] [-m mode,...] [-f MHz,...] [-c csv_file|-] [-t channel_time_ms] [-n bss_count] [wireless_interface]\n\n", argv[0]);
+	printf("modes: triggered,targeted,cached,observe,station (default all, without observe for real interface)\n");
+	printf("-t and -n apply to fake backend used when there is no interface\n\n");
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -r 50 -c scans.csv wlan0\n", argv[0]);
+	printf("%s -m targeted,cached -f 2412,5180 -t 10 -n 500\n", argv[0]);
+}
@@ -0,0 +1,180 @@
+/*
+ * bench-series benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark encodes synthetic signal histories of BSSIDs (see wifi_series.h)
+ *  and compares the size with raw records of the same data. Then it measures sequential
+ *  decoding and seeking to random time. Decoded data is checked against the original.
+ *
+ *  Each BSSID is scanned roughly every interval_ms with some jitter,
+ *  the signal walks randomly in whole dB with occasional fractional values.
+ *
+ *  Examples:
+ *  bench-series
+ *  bench-series -n 1000 -s 10000 -i 5000
+ *
+ */
+
+#include "common.h"
+#include "../wifi_series.h"
+
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <unistd.h> //getopt
+
+// raw records the encoding is compared with
+struct raw_record
+{
+	uint64_t timestamp_ms;
+	int32_t signal_mbm;
+	uint32_t padding;
+};
+
+void Usage(char **argv);
+// synthetic history of single BSSID
+void generate(uint32_t seed, int samples, int interval_ms, uint64_t *timestamps_ms, int32_t *signals_mbm);
+
+int main(int argc, char **argv)
+{
+	int bssids = 100, samples = 10000, interval_ms = 10000, seeks = 100000, opt, b, i;
+
+	while((opt = getopt(argc, argv, "n:s:i:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n': bssids = atoi(optarg); break;
+			case 's': samples = atoi(optarg); break;
+			case 'i': interval_ms = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(bssids <= 0 || samples <= 0 || interval_ms <= 0)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	struct wifi_series **series = calloc(bssids, sizeof(struct wifi_series *));
+	uint64_t *timestamps_ms = malloc(sizeof(uint64_t) * samples);
+	int32_t *signals_mbm = malloc(sizeof(int32_t) * samples);
+	uint64_t start, append_ns = 0, decode_ns = 0, seek_ns = 0, total = (uint64_t)bssids * samples, chunks = 0, checksum = 0;
+	struct wifi_series_cursor cursor;
+	uint64_t timestamp_ms;
+	int32_t signal_mbm;
+	uint32_t random = 2463534242u;
+	int errors = 0;
+
+	//encode
+	for(b = 0; b < bssids; ++b)
+	{
+		if((series[b] = wifi_series_new()) == NULL)
+		{
+			perror("Unable to create series");
+			return 1;
+		}
+		generate(b + 1, samples, interval_ms, timestamps_ms, signals_mbm);
+
+		start = now_ns();
+		for(i = 0; i < samples; ++i)
+			if(wifi_series_append(series[b], timestamps_ms[i], signals_mbm[i]) == -1)
+			{
+				perror("Unable to append sample");
+				return 1;
+			}
+		append_ns += now_ns() - start;
+		chunks += wifi_series_chunks(series[b]);
+	}
+
+	//decode
+	start = now_ns();
+	for(b = 0; b < bssids; ++b)
+		for(wifi_series_seek(series[b], 0, &cursor); wifi_series_next(&cursor, &timestamp_ms, &signal_mbm) == 1; )
+			checksum += timestamp_ms + signal_mbm;
+	decode_ns = now_ns() - start;
+
+	//seek to random time and read the sample
+	start = now_ns();
+	for(i = 0; i < seeks; ++i)
+	{
+		b = xorshift32(&random) % bssids;
+		timestamp_ms = 1500000000000ULL + (uint64_t)(xorshift32(&random) % samples) * interval_ms;
+		wifi_series_seek(series[b], timestamp_ms, &cursor);
+		if(wifi_series_next(&cursor, &timestamp_ms, &signal_mbm) == 1)
+			checksum += timestamp_ms + signal_mbm;
+	}
+	seek_ns = now_ns() - start;
+
+	//verify
+	for(b = 0; b < bssids && !errors; ++b)
+	{
+		generate(b + 1, samples, interval_ms, timestamps_ms, signals_mbm);
+		wifi_series_seek(series[b], 0, &cursor);
+		for(i = 0; i < samples && !errors; ++i)
+			errors += wifi_series_next(&cursor, &timestamp_ms, &signal_mbm) != 1 || timestamp_ms != timestamps_ms[i] || signal_mbm != signals_mbm[i];
+		errors += !errors && wifi_series_next(&cursor, &timestamp_ms, &signal_mbm) != 0;
+	}
+
+	uint64_t encoded = chunks * sizeof(struct wifi_series_chunk);
+
+	printf("%d BSSIDs, %llu samples, %llu chunks, %s (checksum %llu)\n\n", bssids, (unsigned long long)total, (unsigned long long)chunks,
+		errors ? "DECODED DATA DIFFERS" : "decoded data matches", (unsigned long long)checksum);
+	printf("%-22s %12s %10s %8s\n", "format", "bytes", "per sample", "ratio");
+	printf("%-22s %12llu %10.2f %8.2f\n", "raw record (padded)", (unsigned long long)(total * sizeof(struct raw_record)), (double)sizeof(struct raw_record), 1.0);
+	printf("%-22s %12llu %10.2f %8.2f\n", "raw record (packed)", (unsigned long long)(total * 12), 12.0, 16.0 / 12);
+	printf("%-22s %12llu %10.2f %8.2f\n\n", "series chunks", (unsigned long long)encoded, (double)encoded / total, (double)total * sizeof(struct raw_record) / encoded);
+	printf("%-22s %10.2f ns/sample\n", "append", (double)append_ns / total);
+	printf("%-22s %10.2f ns/sample\n", "sequential decode", (double)decode_ns / total);
+	printf("%-22s %10.2f ns/seek\n", "seek and read", (double)seek_ns / seeks);
+
+	for(b = 0; b < bssids; ++b)
+		wifi_series_free(series[b]);
+	free(series);
+	free(signals_mbm);
+	free(timestamps_ms);
+
+	return errors ? 1 : 0;
+}
+
+void generate(uint32_t seed, int samples, int interval_ms, uint64_t *timestamps_ms, int32_t *signals_mbm)
+{
+	uint32_t random = seed * 2654435761u | 1;
+	uint64_t timestamp_ms = 1500000000000ULL;
+	int32_t signal_mbm = -4000 - (int32_t)(xorshift32(&random) % 5000) / 100 * 100;
+	int i;
+
+	for(i = 0; i < samples; ++i)
+	{
+		uint32_t r = xorshift32(&random);
+
+		//scans are scheduled regularly but results come with some jitter
+		timestamps_ms[i] = timestamp_ms + r % 64;
+		timestamp_ms += interval_ms;
+
+		//mostly small changes in whole dB, sometimes fractional value (e.g. averaged by driver)
+		signal_mbm += ((int32_t)(r >> 8) % 5 - 2) * 100;
+		if(signal_mbm > -3000 || signal_mbm < -9500)
+			signal_mbm = -6000;
+		signals_mbm[i] = (r >> 16) % 16 == 0 ? signal_mbm + 50 : signal_mbm;
+	}
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-n bssids] [-s samples_per_bssid] [-i interval_ms]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -n 1000 -s 10000 -i 5000\n", argv[0]);
+}
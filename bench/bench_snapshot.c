@@ -0,0 +1,237 @@
+/*
+ * bench-snapshot benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark archives synthetic scans (see synth.h) with snapshot writer (see wifi_snapshot.h)
+ *  and compares the size with CSV of the same data. Then it maps the archive and measures
+ *  column scan (average signal of all BSSes) and decoding back to bss_info.
+ *  Decoded data is checked against the original.
+ *
+ *  Each scan sees the population with some BSSes missing and signals varying.
+ *
+ *  Examples:
+ *  bench-snapshot
+ *  bench-snapshot -s 10000 -n 200 /tmp/scans.snapshot
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_scan.h"
+#include "../wifi_snapshot.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi
+#include <string.h>
+#include <unistd.h> //getopt
+
+void Usage(char **argv);
+// the scan of population as seen at time, returns the number of BSSes
+int observe(const struct bss_info *population, int length, int scan, struct bss_info *seen);
+// bytes of the scan written as CSV
+size_t csv_size(const struct bss_info *bss, int length, uint64_t timestamp_ns);
+
+int main(int argc, char **argv)
+{
+	int scans = 1000, bss_count = 100, opt, s, i, p;
+	const char *path = "bench-snapshot.snapshot";
+
+	while((opt = getopt(argc, argv, "s:n:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 's': scans = atoi(optarg); break;
+			case 'n': bss_count = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(optind < argc)
+		path = argv[optind];
+
+	if(scans <= 0 || bss_count <= 0)
+	{
+		Usage(argv);
+		return 1;
+	}
+
+	struct synth_population population;
+	struct synth_dump dump;
+	struct bss_info *bss = malloc(sizeof(struct bss_info) * bss_count);
+	struct bss_info *seen = malloc(sizeof(struct bss_info) * bss_count);
+	struct bss_info *decoded = malloc(sizeof(struct bss_info) * bss_count);
+	size_t offset = 0, csv = 0;
+	uint64_t total = 0, start, write_ns, scan_ns, read_ns;
+	int scanned = 0, length;
+
+	synth_population_default(&population, bss_count);
+	if(!synth_scan_dump(&population, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to generate population");
+		return 1;
+	}
+	for(p = 0; p < dump.parts && scanned >= 0; offset += dump.part_lengths[p++])
+		scanned = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[p], bss, bss_count, scanned);
+	synth_dump_free(&dump);
+
+	if(scanned < 0)
+	{
+		perror("Unable to parse population");
+		return 1;
+	}
+	bss_count = scanned < bss_count ? scanned : bss_count;
+
+	//write
+	struct wifi_snapshot_writer *writer = wifi_snapshot_create(path);
+
+	if(writer == NULL)
+	{
+		perror("Unable to create snapshot");
+		return 1;
+	}
+
+	start = now_ns();
+	for(s = 0; s < scans; ++s)
+	{
+		length = observe(bss, bss_count, s, seen);
+		total += length;
+		if(wifi_snapshot_append(writer, 1500000000000000000ULL + s * 10000000000ULL, s % 16, seen, length) == -1)
+		{
+			perror("Unable to append scan");
+			return 1;
+		}
+	}
+	if(wifi_snapshot_finish(writer) == -1)
+	{
+		perror("Unable to finish snapshot");
+		return 1;
+	}
+	write_ns = now_ns() - start;
+
+	for(s = 0; s < scans; ++s)
+	{
+		length = observe(bss, bss_count, s, seen);
+		csv += csv_size(seen, length, 1500000000000000000ULL + s * 10000000000ULL);
+	}
+
+	//read
+	struct wifi_snapshot *snapshot = wifi_snapshot_open(path);
+	struct wifi_snapshot_columns columns;
+	int64_t signal_sum = 0;
+	uint64_t bss_read = 0;
+	FILE *file = fopen(path, "rb");
+	long file_size = 0;
+
+	if(snapshot == NULL || file == NULL)
+	{
+		perror("Unable to open snapshot");
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	file_size = ftell(file);
+	fclose(file);
+
+	start = now_ns();
+	for(s = 0; s < wifi_snapshot_scans(snapshot); ++s)
+	{
+		wifi_snapshot_scan(snapshot, s, &columns);
+		for(i = 0; i < columns.bss_count; ++i)
+			signal_sum += columns.signal_mbm[i];
+		bss_read += columns.bss_count;
+	}
+	scan_ns = now_ns() - start;
+
+	start = now_ns();
+	for(s = 0; s < wifi_snapshot_scans(snapshot); ++s)
+		wifi_snapshot_read(snapshot, s, decoded, bss_count);
+	read_ns = now_ns() - start;
+
+	//verify
+	for(s = 0; s < scans; ++s)
+	{
+		length = observe(bss, bss_count, s, seen);
+		if(wifi_snapshot_read(snapshot, s, decoded, bss_count) != length)
+			break;
+		for(i = 0; i < length; ++i)
+			if(memcmp(seen[i].bssid, decoded[i].bssid, BSSID_LENGTH) || seen[i].frequency != decoded[i].frequency ||
+				strcmp(seen[i].ssid, decoded[i].ssid) || seen[i].signal_mbm != decoded[i].signal_mbm ||
+				seen[i].seen_ms_ago != decoded[i].seen_ms_ago || seen[i].status != decoded[i].status)
+				break;
+		if(i != length)
+			break;
+	}
+
+	printf("%d scans, %llu BSSes, %s\n\n", scans, (unsigned long long)total, s == scans ? "decoded data matches" : "DECODED DATA DIFFERS");
+	printf("%-22s %12s %10s\n", "format", "bytes", "per BSS");
+	printf("%-22s %12llu %10.1f\n", "bss_info", (unsigned long long)(total * sizeof(struct bss_info)), (double)sizeof(struct bss_info));
+	printf("%-22s %12zu %10.1f\n", "CSV", csv, (double)csv / total);
+	printf("%-22s %12ld %10.1f\n\n", "snapshot", file_size, (double)file_size / total);
+	printf("%-22s %10.2f ns/BSS\n", "write", (double)write_ns / total);
+	printf("%-22s %10.2f ns/BSS (average signal %.1f dBm)\n", "column scan (mmap)", (double)scan_ns / bss_read, signal_sum / 100.0 / bss_read);
+	printf("%-22s %10.2f ns/BSS\n", "decode to bss_info", (double)read_ns / bss_read);
+
+	wifi_snapshot_close(snapshot);
+	free(decoded);
+	free(seen);
+	free(bss);
+
+	return s == scans ? 0 : 1;
+}
+
+int observe(const struct bss_info *population, int length, int scan, struct bss_info *seen)
+{
+	int i, count = 0;
+	uint32_t random;
+
+	for(i = 0; i < length; ++i)
+	{
+		random = (uint32_t)(scan + 1) * 2654435761u ^ (uint32_t)(i + 1) * 2246822519u;
+		random ^= random >> 15;
+		random *= 2654435761u;
+
+		//roughly every 10th BSS is missed in the scan
+		if(random % 10 == 0)
+			continue;
+
+		seen[count] = population[i];
+		seen[count].signal_mbm += (int32_t)(random >> 8) % 600 - 300;
+		seen[count].seen_ms_ago = (random >> 16) % 5000;
+		++count;
+	}
+	return count;
+}
+
+size_t csv_size(const struct bss_info *bss, int length, uint64_t timestamp_ns)
+{
+	char line[256];
+	size_t size = 0;
+	int i;
+
+	for(i = 0; i < length; ++i)
+		size += snprintf(line, sizeof(line), "%llu,%02x:%02x:%02x:%02x:%02x:%02x,%u,%s,%d,%d,%d\n", (unsigned long long)timestamp_ns,
+			bss[i].bssid[0], bss[i].bssid[1], bss[i].bssid[2], bss[i].bssid[3], bss[i].bssid[4], bss[i].bssid[5],
+			bss[i].frequency, bss[i].ssid, bss[i].signal_mbm, bss[i].seen_ms_ago, bss[i].status);
+
+	return size;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-s scans] [-n bss_count] [snapshot_file]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -s 10000 -n 200 /tmp/scans.snapshot\n", argv[0]);
+}
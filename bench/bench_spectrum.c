@@ -0,0 +1,231 @@
+/*
+ * bench-spectrum benchmark for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This benchmark measures interference map (see wifi_spectrum.h) build and query speed
+ *  against brute force over all BSSes.
+ *
+ *  Synthetic population (see synth.h) is parsed, the occupied channels come from HT, VHT and HE
+ *  operation elements (20 MHz in 2.4 GHz, 40/80 MHz in 5 GHz, 160 MHz in 6 GHz).
+ *  Then every 20/40/80/160 MHz channel of 2.4, 5 and 6 GHz (and 320 MHz of 6 GHz) is queried,
+ *  results are compared with brute force, interference within 0.05 dB.
+ *
+ *  Examples:
+ *  bench-spectrum
+ *  bench-spectrum -b 50000 -r 20
+ *
+ */
+
+#include "common.h"
+#include "synth.h"
+#include "../wifi_spectrum.h"
+
+#include <libmnl/libmnl.h> //MNL_SOCKET_BUFFER_SIZE
+#include <math.h> //log10
+#include <stdio.h>  //printf
+#include <stdlib.h> //malloc, atoi, qsort
+#include <unistd.h> //getopt
+
+#define CHANNELS_MAX 512
+
+struct channel
+{
+	uint32_t center;
+	uint32_t width;
+};
+
+void Usage(char **argv);
+// all channels of given width between band edges (MHz)
+int band_channels(uint32_t low, uint32_t high, uint32_t step, uint32_t width, struct channel *channels, int count);
+// BSSes overlapping channel by checking all of them
+int brute_force(const struct bss_info *bss, int bss_count, const struct channel *channel, struct wifi_spectrum_overlap *overlaps);
+int compare_overlaps(const void *a, const void *b);
+
+int main(int argc, char **argv)
+{
+	static const uint32_t WIDTHS[] = {20, 40, 80, 160, 320};
+	int bss_count = 5000, repeats = 10, opt, i, c, r, count = 0, channels = 0, found, total = 0, widths[BSS_CHANNEL_WIDTH_320 + 1] = {0};
+	struct channel channel[CHANNELS_MAX];
+	struct synth_population synth;
+	struct synth_dump dump;
+	uint64_t start, build_ns, query_ns, brute_ns;
+	bool same = true;
+
+	while((opt = getopt(argc, argv, "b:r:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'b': bss_count = atoi(optarg); break;
+			case 'r': repeats = atoi(optarg); break;
+			default: Usage(argv); return 0;
+		}
+	}
+
+	if(bss_count <= 0 || repeats <= 0)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	wifi_scan_register_log_callback(silent_log);
+
+	struct bss_info *bss = malloc(bss_count * sizeof(struct bss_info));
+	struct wifi_spectrum_overlap *queried = malloc(bss_count * sizeof(struct wifi_spectrum_overlap));
+	struct wifi_spectrum_overlap *expected = malloc(bss_count * sizeof(struct wifi_spectrum_overlap));
+	struct wifi_spectrum *spectrum = wifi_spectrum_new();
+
+	synth_population_default(&synth, bss_count);
+	synth.malformed_percent = 0;
+
+	if(!bss || !queried || !expected || !spectrum || !synth_scan_dump(&synth, 0, 0, MNL_SOCKET_BUFFER_SIZE, &dump))
+	{
+		perror("Unable to allocate memory");
+		return 1;
+	}
+
+	size_t offset = 0;
+	for(i = 0; i < dump.parts && count >= 0; offset += dump.part_lengths[i++])
+		count = wifi_scan_parse_scan_results(dump.data + offset, dump.part_lengths[i], bss, bss_count, count);
+	synth_dump_free(&dump);
+
+	if(count > bss_count)
+		count = bss_count;
+
+	for(i = 0; i < count; ++i)
+		++widths[bss[i].channel_width];
+
+	//2.4 GHz channels 5 MHz apart, 5 GHz and 6 GHz aligned to the width
+	channels = band_channels(2402, 2482, 5, 20, channel, channels);
+	channels = band_channels(2402, 2482, 5, 40, channel, channels);
+	for(i = 0; i < 4; ++i)
+		channels = band_channels(5170, 5835, WIDTHS[i], WIDTHS[i], channel, channels);
+	for(i = 0; i < 5; ++i)
+		channels = band_channels(5945, 7125, WIDTHS[i], WIDTHS[i], channel, channels);
+
+	start = now_ns();
+	for(r = 0; r < repeats; ++r)
+		if(wifi_spectrum_build(spectrum, bss, count) == -1)
+		{
+			perror("wifi_spectrum_build failed");
+			return 1;
+		}
+	build_ns = (now_ns() - start) / repeats;
+
+	start = now_ns();
+	for(r = 0; r < repeats; ++r)
+		for(c = 0; c < channels; ++c)
+			total += wifi_spectrum_query(spectrum, channel[c].center, channel[c].width, queried, bss_count);
+	query_ns = now_ns() - start;
+
+	start = now_ns();
+	for(r = 0; r < repeats; ++r)
+		for(c = 0; c < channels; ++c)
+			brute_force(bss, count, &channel[c], expected);
+	brute_ns = now_ns() - start;
+
+	for(c = 0; c < channels; ++c)
+	{
+		found = wifi_spectrum_query(spectrum, channel[c].center, channel[c].width, queried, bss_count);
+
+		if(found != brute_force(bss, count, &channel[c], expected))
+		{
+			same = false;
+			continue;
+		}
+
+		qsort(queried, found, sizeof(struct wifi_spectrum_overlap), compare_overlaps);
+
+		for(i = 0; i < found; ++i)
+			if(queried[i].bss != expected[i].bss || queried[i].overlap_mhz != expected[i].overlap_mhz || queried[i].flags != expected[i].flags ||
+			   abs(queried[i].interference_mbm - expected[i].interference_mbm) > 5)
+				same = false;
+	}
+
+	printf("%d BSSes (20 MHz %d, 40 MHz %d, 80 MHz %d, 160 MHz %d, 80+80 MHz %d, 320 MHz %d), %d channels\n", count,
+		widths[0], widths[1], widths[2], widths[3], widths[4], widths[5], channels);
+	printf("build: %.1f us, %.1f ns/bss\n", build_ns / 1000.0, (double)build_ns / count);
+	printf("%-12s %12s %12s\n", "", "us/query", "overlaps");
+	printf("%-12s %12.2f %12.1f\n", "index", query_ns / 1000.0 / repeats / channels, (double)total / repeats / channels);
+	printf("%-12s %12.2f %12s\n", "brute force", brute_ns / 1000.0 / repeats / channels, same ? "same" : "DIFFERENT");
+
+	wifi_spectrum_free(spectrum);
+	free(bss);
+	free(queried);
+	free(expected);
+
+	return same ? 0 : 1;
+}
+
+int band_channels(uint32_t low, uint32_t high, uint32_t step, uint32_t width, struct channel *channels, int count)
+{
+	uint32_t center;
+
+	for(center = low + width / 2; center + width / 2 <= high && count < CHANNELS_MAX; center += step)
+	{
+		channels[count].center = center;
+		channels[count].width = width;
+		++count;
+	}
+
+	return count;
+}
+
+int brute_force(const struct bss_info *bss, int bss_count, const struct channel *channel, struct wifi_spectrum_overlap *overlaps)
+{
+	static const uint32_t SEGMENT_WIDTH_MHZ[] = {20, 40, 80, 160, 80, 320};
+	uint32_t low = channel->center - channel->width / 2, high = low + channel->width;
+	int i, s, found = 0;
+
+	for(i = 0; i < bss_count; ++i)
+	{
+		uint32_t width = SEGMENT_WIDTH_MHZ[bss[i].channel_width], overlap = 0;
+		uint32_t centers[2] = {bss[i].center_frequency, bss[i].center_frequency2};
+		int segments = bss[i].channel_width == BSS_CHANNEL_WIDTH_80P80 ? 2 : 1;
+
+		for(s = 0; s < segments; ++s)
+		{
+			uint32_t from = centers[s] - width / 2 > low ? centers[s] - width / 2 : low;
+			uint32_t to = centers[s] + width / 2 < high ? centers[s] + width / 2 : high;
+			overlap += to > from ? to - from : 0;
+		}
+
+		if(overlap == 0)
+			continue;
+
+		overlaps[found].bss = i;
+		overlaps[found].overlap_mhz = overlap;
+		overlaps[found].width_mhz = width * segments;
+		overlaps[found].signal_mbm = bss[i].signal_mbm;
+		overlaps[found].interference_mbm = bss[i].signal_mbm + (int32_t)lround(1000.0 * log10((double)overlap / (width * segments)));
+		overlaps[found].flags = bss[i].frequency - 10 >= low && bss[i].frequency + 10 <= high ? WIFI_SPECTRUM_PRIMARY : 0;
+		++found;
+	}
+
+	return found;
+}
+
+int compare_overlaps(const void *a, const void *b)
+{
+	const struct wifi_spectrum_overlap *x = a, *y = b;
+	return x->bss - y->bss;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s [-b bss_count] [-r repeats]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s\n", argv[0]);
+	printf("%s -b 50000 -r 20\n", argv[0]);
+}
@@ -0,0 +1,44 @@
+/*
+ * helpers shared by wifi-scan library benchmarks
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  Timing, deterministic random numbers and log sink used by all the benchmarks.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h> //clock_gettime
+
+// log callback (see wifi_scan_register_log_callback) that keeps the library quiet
+static inline void silent_log(const char *fmt, ...) {}
+
+// CLOCK_MONOTONIC in nanoseconds
+static inline uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// xorshift, deterministic and good enough for test data
+static inline uint32_t xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
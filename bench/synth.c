@@ -0,0 +1,616 @@
+/*
+ * synthetic nl80211 scan results for wifi-scan library benchmarks
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "synth.h"
+#include "common.h"
+#include "../wifi_scan.h"
+
+#include <libmnl/libmnl.h> //netlink libmnl
+#include <linux/nl80211.h> //nl80211 netlink
+#include <linux/genetlink.h> //generic netlink
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// what the synthetic kernel pretends to be
+enum synth_constants {SYNTH_NL80211_ID=0x1c, SYNTH_IFINDEX=3, SYNTH_PORTID=4242, SYNTH_MESSAGE_SIZE=8192, SYNTH_IES_SIZE=2048};
+
+// the ways a record may be broken
+enum synth_malformation {MALFORMED_SSID_LENGTH, MALFORMED_IE_OVERRUN, MALFORMED_BSSID_LENGTH, MALFORMED_FREQUENCY_LENGTH, MALFORMED_KINDS};
+
+static const char *COMMON_SSIDS[] = {"eduroam", "CorpNet", "guest", "Free WiFi", "xfinitywifi", "HomeNet", "Office", "Cafe"};
+static const int COMMON_SSIDS_LENGTH = sizeof(COMMON_SSIDS) / sizeof(COMMON_SSIDS[0]);
+
+static const uint8_t VENDOR_OUIS[][3] = { {0x00,0x50,0xf2}, {0x00,0x10,0x18}, {0x00,0x0c,0x43}, {0x00,0x17,0xf2}, {0x00,0x03,0x7f}, {0x8c,0xfd,0xf0}, {0x00,0x90,0x4c}, {0x50,0x6f,0x9a} };
+static const int VENDOR_OUIS_LENGTH = sizeof(VENDOR_OUIS) / sizeof(VENDOR_OUIS[0]);
+
+static bool synth_percent(uint32_t *state, int percent)
+{
+	return (int)(xorshift32(state) % 100) < percent;
+}
+
+void synth_population_default(struct synth_population *population, int bss_count)
+{
+	population->bss_count = bss_count;
+	population->seed = 1;
+	population->hidden_percent = 10;
+	population->multi_bssid_percent = 10;
+	population->multi_bssid_reported = false;
+	population->rnr_percent = 30;
+	population->ftm_percent = 20;
+	population->vendor_ies = 3;
+	population->malformed_percent = 0;
+	population->associated = 0;
+}
+
+// 45% 2.4 GHz (mostly channels 1/6/11), 45% 5 GHz, 10% 6 GHz PSC
+static uint32_t synth_frequency(uint32_t *rnd)
+{
+	uint32_t r = xorshift32(rnd) % 100;
+
+	if (r < 35)
+		return 2412 + 25 * (xorshift32(rnd) % 3);
+	if (r < 45)
+		return 2412 + 5 * (xorshift32(rnd) % 13);
+	if (r < 90)
+		return 5180 + 20 * (xorshift32(rnd) % 33);
+	return 5975 + 80 * (xorshift32(rnd) % 15);
+}
+
+static int synth_put_ie(uint8_t *ies, int len, uint8_t id, const void *data, uint8_t data_length)
+{
+	ies[len] = id;
+	ies[len + 1] = data_length;
+	memcpy(ies + len + 2, data, data_length);
+	return len + 2 + data_length;
+}
+
+static void synth_random_bytes(uint32_t *rnd, uint8_t *data, int length)
+{
+	int i;
+	for (i = 0; i < length; ++i)
+		data[i] = xorshift32(rnd);
+}
+
+static int synth_ssid(uint32_t *rnd, const struct synth_population *population, char ssid[SSID_MAX_LENGTH_WITH_NULL])
+{
+	if (synth_percent(rnd, population->hidden_percent))
+	{ //hidden SSIDs come either as zero length or as zeroed bytes of real length
+		int len = xorshift32(rnd) % 2 ? 0 : 4 + xorshift32(rnd) % 12;
+		memset(ssid, 0, SSID_MAX_LENGTH_WITH_NULL);
+		return len;
+	}
+	if (synth_percent(rnd, 50))
+	{ //a few networks with many BSSes, the most common ones most often
+		int a = xorshift32(rnd) % COMMON_SSIDS_LENGTH, b = xorshift32(rnd) % COMMON_SSIDS_LENGTH;
+		return snprintf(ssid, SSID_MAX_LENGTH_WITH_NULL, "%s", COMMON_SSIDS[a < b ? a : b]);
+	}
+	if (synth_percent(rnd, 50))
+		return snprintf(ssid, SSID_MAX_LENGTH_WITH_NULL, "HOME-%04X%s", xorshift32(rnd) & 0xffff, synth_percent(rnd, 30) ? "-5G" : "");
+	return snprintf(ssid, SSID_MAX_LENGTH_WITH_NULL, "AP-%06x", xorshift32(rnd) & 0xffffff);
+}
+
+// Multiple BSSID element with nontransmitted BSS profiles
+static int synth_multi_bssid(uint32_t *rnd, const struct synth_population *population, uint8_t *ies, int len)
+{
+	uint8_t element[255];
+	int profiles = 1 + xorshift32(rnd) % 7, i, element_length = 1;
+
+	element[0] = 3; //max BSSID indicator, up to 8 BSSes
+
+	//each profile takes at most 47 bytes, the element at most 255
+	for (i = 0; i < profiles && element_length + 47 <= 255; ++i)
+	{
+		uint8_t profile[64];
+		char ssid[SSID_MAX_LENGTH_WITH_NULL];
+		uint8_t capability[2] = {0x11, 0x04};
+		uint8_t index[3] = {i + 1, 1, 0};
+		int profile_length = 0, ssid_length = synth_ssid(rnd, population, ssid);
+
+		profile_length = synth_put_ie(profile, profile_length, 83, capability, sizeof(capability));
+		profile_length = synth_put_ie(profile, profile_length, 0, ssid, ssid_length);
+		profile_length = synth_put_ie(profile, profile_length, 85, index, sizeof(index));
+
+		element_length = synth_put_ie(element, element_length, 0, profile, profile_length);
+	}
+
+	return synth_put_ie(ies, len, 71, element, element_length);
+}
+
+// Reduced Neighbor Report element with colocated 6 GHz BSS on any of 59 channels
+// the BSS is one of bss_count / 10 so that some are reported by many BSSes (like radios of the same AP)
+static int synth_reduced_neighbor_report(uint32_t *rnd, const struct synth_population *population, uint8_t *ies, int len)
+{
+	uint32_t neighbor = xorshift32(rnd) % (population->bss_count / 10 + 1);
+	uint8_t element[4 + 13] = {0x00, 13, 131, 1 + 4 * (neighbor % 59)};
+	uint8_t *info = element + 4;
+
+	info[0] = 0xff; //TBTT offset unknown
+	info[1] = 0x02; //locally administered BSSID
+	info[4] = neighbor >> 16;
+	info[5] = neighbor >> 8;
+	info[6] = neighbor;
+	info[7] = neighbor; //short SSID
+	info[8] = neighbor >> 8;
+	info[11] = 0x40; //colocated AP
+	info[12] = 0x0a; //PSD 5 dBm/MHz
+
+	return synth_put_ie(ies, len, 201, element, sizeof(element));
+}
+
+// information elements the way typical AP sends them in beacons/probe responses
+static int synth_ies(uint32_t *rnd, const struct synth_population *population, uint32_t frequency, bool overrun, bool long_ssid, uint8_t *ies)
+{
+	static const uint8_t RATES_2GHZ[] = {0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24};
+	static const uint8_t RATES_5GHZ[] = {0x8c, 0x12, 0x98, 0x24, 0xb0, 0x48, 0x60, 0x6c};
+	static const uint8_t COUNTRY[] = {'U', 'S', ' ', 1, 11, 30};
+	static const uint8_t WMM[] = {0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x80, 0x00, 0x03, 0xa4, 0x00, 0x00, 0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00};
+	static const uint8_t AKMS[] = {1, 2, 8}; //802.1X, PSK, SAE
+
+	uint8_t data[255];
+	char ssid[SSID_MAX_LENGTH_WITH_NULL];
+	int len = 0, i, vendor_ies;
+	bool band_2ghz = frequency < 3000, band_6ghz = frequency > 5900;
+
+	if (long_ssid)
+	{
+		memset(data, 'X', 40);
+		len = synth_put_ie(ies, len, 0, data, 40);
+	}
+	else
+		len = synth_put_ie(ies, len, 0, ssid, synth_ssid(rnd, population, ssid));
+
+	len = synth_put_ie(ies, len, 1, band_2ghz ? RATES_2GHZ : RATES_5GHZ, 8);
+
+	if (band_2ghz)
+	{
+		data[0] = (frequency - 2407) / 5;
+		len = synth_put_ie(ies, len, 3, data, 1);
+	}
+
+	len = synth_put_ie(ies, len, 7, COUNTRY, sizeof(COUNTRY));
+
+	if (synth_percent(rnd, 85))
+	{
+		uint8_t rsn[] = {1, 0, 0x00, 0x0f, 0xac, 4, 1, 0, 0x00, 0x0f, 0xac, 4, 1, 0, 0x00, 0x0f, 0xac, 2, 0x0c, 0x00};
+		rsn[17] = AKMS[xorshift32(rnd) % 3];
+		len = synth_put_ie(ies, len, 48, rsn, sizeof(rsn));
+	}
+
+	if (synth_percent(rnd, 40))
+	{ //BSS Load of managed networks, station count, utilization and admission capacity
+		data[0] = xorshift32(rnd) % 40;
+		data[1] = 0;
+		data[2] = xorshift32(rnd) % 256;
+		data[3] = data[4] = 0;
+		len = synth_put_ie(ies, len, 11, data, 5);
+	}
+
+	if (!band_6ghz)
+	{
+		synth_random_bytes(rnd, data, 26);
+		len = synth_put_ie(ies, len, 45, data, 26); //HT capabilities
+		memset(data, 0, 22);
+		data[0] = band_2ghz ? (frequency - 2407) / 5 : (frequency - 5000) / 5;
+		if (!band_2ghz) //40 MHz, secondary channel above or below in the pair
+			data[1] = 0x04 | ((data[0] - 36) / 4 % 2 ? 3 : 1);
+		len = synth_put_ie(ies, len, 61, data, 22); //HT operation
+	}
+
+	memset(data, 0, 9);
+	data[2] = 0x08; //BSS transition
+	if (synth_percent(rnd, population->ftm_percent))
+		data[8] = 0x40; //FTM responder
+	len = synth_put_ie(ies, len, 127, data, 9);
+
+	if (!band_2ghz && !band_6ghz)
+	{
+		synth_random_bytes(rnd, data, 12);
+		len = synth_put_ie(ies, len, 191, data, 12); //VHT capabilities
+		memset(data, 0, 5);
+		data[0] = 1; //80 MHz around the center of channel block
+		data[1] = 36 + (frequency - 5180) / 80 * 16 + 6;
+		len = synth_put_ie(ies, len, 192, data, 5); //VHT operation
+	}
+
+	if (band_6ghz || synth_percent(rnd, 30))
+	{
+		data[0] = 35; //HE capabilities (element id extension)
+		synth_random_bytes(rnd, data + 1, 21);
+		len = synth_put_ie(ies, len, 255, data, 22);
+	}
+
+	if (band_6ghz)
+	{ //HE operation with 6 GHz operation information, 160 MHz
+		uint8_t channel = (frequency - 5950) / 5;
+		uint8_t he[] = {36, 0x00, 0x00, 0x02, 0x01, 0xfc, 0xff, channel, 0x03, 0, 0, 6};
+		he[9] = 1 + (channel - 1) / 16 * 16 + 6;
+		he[10] = 1 + (channel - 1) / 32 * 32 + 14;
+		len = synth_put_ie(ies, len, 255, he, sizeof(he));
+	}
+
+	if (synth_percent(rnd, population->multi_bssid_percent))
+		len = synth_multi_bssid(rnd, population, ies, len);
+
+	if (!band_6ghz && synth_percent(rnd, population->rnr_percent))
+		len = synth_reduced_neighbor_report(rnd, population, ies, len);
+
+	len = synth_put_ie(ies, len, 221, WMM, sizeof(WMM));
+
+	vendor_ies = population->vendor_ies > 0 ? xorshift32(rnd) % (population->vendor_ies + 1) : 0;
+
+	//leave space for the longest vendor IE and overrun
+	for (i = 0; i < vendor_ies && len + 2 + 200 + 5 <= SYNTH_IES_SIZE; ++i)
+	{
+		int length = 8 + xorshift32(rnd) % 193;
+		memcpy(data, VENDOR_OUIS[xorshift32(rnd) % VENDOR_OUIS_LENGTH], 3);
+		synth_random_bytes(rnd, data + 3, length - 3);
+		len = synth_put_ie(ies, len, 221, data, length);
+	}
+
+	if (overrun)
+	{ //claims more than there is
+		ies[len] = 221;
+		ies[len + 1] = 250;
+		memset(ies + len + 2, 0, 3);
+		len += 5;
+	}
+
+	return len;
+}
+
+static struct nlmsghdr *synth_genl_message(char *buf, uint16_t type, uint16_t flags, uint32_t seq, uint32_t portid, uint8_t cmd)
+{
+	struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+	struct genlmsghdr *genl;
+
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = flags;
+	nlh->nlmsg_seq = seq;
+	nlh->nlmsg_pid = portid;
+
+	genl = (struct genlmsghdr*)mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+	genl->cmd = cmd;
+	genl->version = 1;
+	return nlh;
+}
+
+// single BSS as NL80211_CMD_NEW_SCAN_RESULTS message
+static struct nlmsghdr *synth_bss_message(uint32_t *rnd, const struct synth_population *population, int index, uint32_t seq, uint32_t portid, char *buf)
+{
+	uint8_t ies[SYNTH_IES_SIZE], bssid[BSSID_LENGTH];
+	struct nlmsghdr *nlh = synth_genl_message(buf, SYNTH_NL80211_ID, NLM_F_MULTI, seq, portid, NL80211_CMD_NEW_SCAN_RESULTS);
+	int malformation = synth_percent(rnd, population->malformed_percent) ? (int)(xorshift32(rnd) % MALFORMED_KINDS) : -1;
+	uint32_t frequency = synth_frequency(rnd);
+	int32_t signal_mbm;
+	int ies_length;
+
+	memcpy(bssid, VENDOR_OUIS[xorshift32(rnd) % VENDOR_OUIS_LENGTH], 3);
+	//3 low bits are left for nontransmitted BSSIDs of Multiple BSSID set
+	bssid[3] = index >> 13;
+	bssid[4] = index >> 5;
+	bssid[5] = index << 3;
+
+	//more weak than strong signals, -95 to -30 dBm
+	uint32_t a = xorshift32(rnd) % 66, b = xorshift32(rnd) % 66;
+	signal_mbm = -9500 + 100 * (a < b ? a : b) + xorshift32(rnd) % 100;
+
+	ies_length = synth_ies(rnd, population, frequency, malformation == MALFORMED_IE_OVERRUN, malformation == MALFORMED_SSID_LENGTH, ies);
+
+	mnl_attr_put_u32(nlh, NL80211_ATTR_GENERATION, 42);
+	mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, SYNTH_IFINDEX);
+	mnl_attr_put_u64(nlh, NL80211_ATTR_WDEV, 1);
+
+	struct nlattr *nested = mnl_attr_nest_start(nlh, NL80211_ATTR_BSS);
+
+	mnl_attr_put(nlh, NL80211_BSS_BSSID, malformation == MALFORMED_BSSID_LENGTH ? BSSID_LENGTH - 1 : BSSID_LENGTH, bssid);
+
+	if (malformation == MALFORMED_FREQUENCY_LENGTH)
+		mnl_attr_put_u16(nlh, NL80211_BSS_FREQUENCY, frequency);
+	else
+		mnl_attr_put_u32(nlh, NL80211_BSS_FREQUENCY, frequency);
+
+	mnl_attr_put_u64(nlh, NL80211_BSS_TSF, ((uint64_t)xorshift32(rnd) << 20) | xorshift32(rnd));
+	mnl_attr_put_u16(nlh, NL80211_BSS_BEACON_INTERVAL, 100);
+	mnl_attr_put_u16(nlh, NL80211_BSS_CAPABILITY, 0x0411);
+	mnl_attr_put(nlh, NL80211_BSS_INFORMATION_ELEMENTS, ies_length, ies);
+
+	if (synth_percent(rnd, 80)) //beacon was received too, the kernel sends both
+		mnl_attr_put(nlh, NL80211_BSS_BEACON_IES, ies_length, ies);
+
+	mnl_attr_put_u32(nlh, NL80211_BSS_SIGNAL_MBM, signal_mbm);
+	mnl_attr_put_u32(nlh, NL80211_BSS_SEEN_MS_AGO, xorshift32(rnd) % 30000);
+	mnl_attr_put_u64(nlh, NL80211_BSS_LAST_SEEN_BOOTTIME, 1000000000ULL * (1000 + index));
+	mnl_attr_put_u32(nlh, NL80211_BSS_CHAN_WIDTH, NL80211_BSS_CHAN_WIDTH_20);
+
+	if (index == population->associated)
+		mnl_attr_put_u32(nlh, NL80211_BSS_STATUS, NL80211_BSS_STATUS_ASSOCIATED);
+
+	mnl_attr_nest_end(nlh, nested);
+
+	return nlh;
+}
+
+// append message to the dump, start new part if it doesn't fit in current one
+static bool synth_dump_append(struct synth_dump *dump, size_t *capacity, const struct nlmsghdr *nlh, size_t part_size);
+
+// records of nontransmitted BSSes from profiles in Multiple BSSID element of transmitted BSS record (the way newer kernels make them)
+// profile SSID and index with the elements of transmitted BSS, capability from the profile
+static bool synth_dump_nontransmitted(struct synth_dump *dump, size_t *capacity, const struct nlmsghdr *transmitter, size_t part_size)
+{
+	char buf[SYNTH_MESSAGE_SIZE];
+	const struct genlmsghdr *genl = mnl_nlmsg_get_payload(transmitter);
+	const struct nlattr *attr, *nested, *bss = NULL, *parent = NULL;
+	const uint8_t *ies, *element;
+	int ies_length, offset, sub;
+
+	mnl_attr_for_each(attr, transmitter, sizeof(struct genlmsghdr))
+		if (mnl_attr_get_type(attr) == NL80211_ATTR_BSS)
+			bss = attr;
+
+	if (bss == NULL)
+		return true;
+
+	mnl_attr_for_each_nested(nested, bss)
+		if (mnl_attr_get_type(nested) == NL80211_BSS_INFORMATION_ELEMENTS)
+			parent = nested;
+
+	if (parent == NULL)
+		return true;
+
+	ies = mnl_attr_get_payload(parent);
+	ies_length = mnl_attr_get_payload_len(parent);
+
+	for (offset = 0; offset + 2 <= ies_length && offset + 2 + ies[offset + 1] <= ies_length; offset += 2 + ies[offset + 1])
+	{
+		if (ies[offset] != 71)
+			continue;
+
+		element = ies + offset + 2;
+
+		for (sub = 1; sub + 2 <= element[-1] && sub + 2 + element[sub + 1] <= element[-1]; sub += 2 + element[sub + 1])
+		{
+			const uint8_t *profile = element + sub + 2;
+			uint8_t merged[SYNTH_IES_SIZE], mask = (1 << element[0]) - 1, index = 0;
+			uint16_t capability = 0;
+			int merged_length = 0, p, i;
+			struct nlmsghdr *nlh;
+			struct nlattr *nest;
+
+			for (p = 0; p + 2 <= element[sub + 1]; p += 2 + profile[p + 1])
+			{
+				if (profile[p] == 83)
+				{
+					capability = profile[p + 2] | profile[p + 3] << 8;
+					continue;
+				}
+				if (profile[p] == 85)
+					index = profile[p + 2];
+				merged_length = synth_put_ie(merged, merged_length, profile[p], profile + p + 2, profile[p + 1]);
+			}
+
+			for (i = 0; i + 2 <= ies_length && i + 2 + ies[i + 1] <= ies_length; i += 2 + ies[i + 1])
+				if (ies[i] != 0 && ies[i] != 71 && merged_length + 2 + ies[i + 1] <= SYNTH_IES_SIZE)
+					merged_length = synth_put_ie(merged, merged_length, ies[i], ies + i + 2, ies[i + 1]);
+
+			nlh = synth_genl_message(buf, transmitter->nlmsg_type, transmitter->nlmsg_flags, transmitter->nlmsg_seq, transmitter->nlmsg_pid, genl->cmd);
+
+			mnl_attr_for_each(attr, transmitter, sizeof(struct genlmsghdr))
+			{
+				if (mnl_attr_get_type(attr) != NL80211_ATTR_BSS)
+				{
+					mnl_attr_put(nlh, mnl_attr_get_type(attr), mnl_attr_get_payload_len(attr), mnl_attr_get_payload(attr));
+					continue;
+				}
+
+				nest = mnl_attr_nest_start(nlh, NL80211_ATTR_BSS);
+
+				mnl_attr_for_each_nested(nested, attr)
+					switch (mnl_attr_get_type(nested))
+					{
+						case NL80211_BSS_BSSID:
+						{
+							uint8_t bssid[BSSID_LENGTH];
+							int length = mnl_attr_get_payload_len(nested) < BSSID_LENGTH ? mnl_attr_get_payload_len(nested) : BSSID_LENGTH;
+							memcpy(bssid, mnl_attr_get_payload(nested), length);
+							bssid[length - 1] = (bssid[length - 1] & ~mask) | ((bssid[length - 1] + index) & mask);
+							mnl_attr_put(nlh, NL80211_BSS_BSSID, length, bssid);
+							break;
+						}
+						case NL80211_BSS_INFORMATION_ELEMENTS:
+						case NL80211_BSS_BEACON_IES:
+							mnl_attr_put(nlh, mnl_attr_get_type(nested), merged_length, merged);
+							break;
+						case NL80211_BSS_CAPABILITY:
+							mnl_attr_put_u16(nlh, NL80211_BSS_CAPABILITY, capability);
+							break;
+						case NL80211_BSS_STATUS:
+							break;
+						default:
+							mnl_attr_put(nlh, mnl_attr_get_type(nested), mnl_attr_get_payload_len(nested), mnl_attr_get_payload(nested));
+					}
+
+				mnl_attr_nest_end(nlh, nest);
+			}
+
+			if (!synth_dump_append(dump, capacity, nlh, part_size))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool synth_dump_append(struct synth_dump *dump, size_t *capacity, const struct nlmsghdr *nlh, size_t part_size)
+{
+	if (dump->parts == 0 || dump->part_lengths[dump->parts - 1] + nlh->nlmsg_len > part_size)
+	{
+		size_t *part_lengths = realloc(dump->part_lengths, (dump->parts + 1) * sizeof(size_t));
+		if (part_lengths == NULL)
+			return false;
+		dump->part_lengths = part_lengths;
+		dump->part_lengths[dump->parts++] = 0;
+	}
+
+	if (dump->length + nlh->nlmsg_len > *capacity)
+	{
+		size_t new_capacity = *capacity * 2 + nlh->nlmsg_len;
+		char *data = realloc(dump->data, new_capacity);
+		if (data == NULL)
+			return false;
+		dump->data = data;
+		*capacity = new_capacity;
+	}
+
+	memcpy(dump->data + dump->length, nlh, nlh->nlmsg_len);
+	dump->length += nlh->nlmsg_len;
+	dump->part_lengths[dump->parts - 1] += nlh->nlmsg_len;
+	return true;
+}
+
+bool synth_scan_dump(const struct synth_population *population, uint32_t seq, uint32_t portid, size_t part_size, struct synth_dump *dump)
+{
+	char buf[SYNTH_MESSAGE_SIZE];
+	uint32_t rnd = population->seed * 2654435761u + 1;
+	size_t capacity = 0;
+	struct nlmsghdr *nlh;
+	int i;
+
+	memset(dump, 0, sizeof(*dump));
+
+	for (i = 0; i < population->bss_count; ++i)
+	{
+		nlh = synth_bss_message(&rnd, population, i, seq, portid, buf);
+		if (!synth_dump_append(dump, &capacity, nlh, part_size) ||
+			(population->multi_bssid_reported && !synth_dump_nontransmitted(dump, &capacity, nlh, part_size)))
+		{
+			synth_dump_free(dump);
+			return false;
+		}
+	}
+
+	nlh = mnl_nlmsg_put_header(buf);
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_flags = NLM_F_MULTI;
+	nlh->nlmsg_seq = seq;
+	nlh->nlmsg_pid = portid;
+	*(int*)mnl_nlmsg_put_extra_header(nlh, sizeof(int)) = 0;
+
+	if (!synth_dump_append(dump, &capacity, nlh, part_size))
+	{
+		synth_dump_free(dump);
+		return false;
+	}
+
+	return true;
+}
+
+void synth_dump_free(struct synth_dump *dump)
+{
+	free(dump->data);
+	free(dump->part_lengths);
+	memset(dump, 0, sizeof(*dump));
+}
+
+static bool synth_write_record(FILE *file, uint64_t timestamp_ns, uint8_t channel, uint8_t direction, int32_t result, const void *data)
+{
+	struct wifi_scan_capture_record record = { timestamp_ns, channel, direction, 0, result };
+
+	return fwrite(&record, sizeof(record), 1, file) == 1
+	    && (result <= 0 || fwrite(data, result, 1, file) == 1);
+}
+
+// acknowledgement the kernel sends to NLM_F_ACK requests
+static struct nlmsghdr *synth_ack(char *buf, const struct nlmsghdr *request)
+{
+	struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+	struct nlmsgerr *err;
+
+	nlh->nlmsg_type = NLMSG_ERROR;
+	nlh->nlmsg_flags = NLM_F_CAPPED;
+	nlh->nlmsg_seq = request->nlmsg_seq;
+	nlh->nlmsg_pid = SYNTH_PORTID;
+
+	err = (struct nlmsgerr*)mnl_nlmsg_put_extra_header(nlh, sizeof(struct nlmsgerr));
+	err->error = 0;
+	memcpy(&err->msg, request, sizeof(struct nlmsghdr));
+	return nlh;
+}
+
+bool synth_write_capture(const char *capture_file, const struct synth_population *population, int scans)
+{
+	struct wifi_scan_capture_header header = { WIFI_SCAN_CAPTURE_MAGIC, WIFI_SCAN_CAPTURE_VERSION, SYNTH_IFINDEX, SYNTH_NL80211_ID, 0, {0, SYNTH_PORTID} };
+	char request[SYNTH_MESSAGE_SIZE], reply[SYNTH_MESSAGE_SIZE];
+	struct synth_dump dump;
+	struct nlmsghdr *nlh;
+	FILE *file = fopen(capture_file, "wb");
+	bool ok;
+	int scan, i;
+
+	if (file == NULL)
+		return false;
+
+	ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	for (scan = 0; ok && scan < scans; ++scan)
+	{
+		uint32_t seq = 2 * scan + 1;
+		uint64_t t = 1000000000ULL * (1500000000ULL + 5 * scan);
+		size_t offset = 0;
+
+		//no pending notifications, trigger the scan, kernel acknowledges and notifies
+		ok = ok && synth_write_record(file, t, WIFI_SCAN_CHANNEL_NOTIFICATIONS, WIFI_SCAN_CAPTURE_RECEIVE, -EAGAIN, NULL);
+
+		nlh = synth_genl_message(request, SYNTH_NL80211_ID, NLM_F_REQUEST | NLM_F_ACK, seq, 0, NL80211_CMD_TRIGGER_SCAN);
+		mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, SYNTH_IFINDEX);
+		ok = ok && synth_write_record(file, t + 10000, WIFI_SCAN_CHANNEL_COMMANDS, WIFI_SCAN_CAPTURE_SEND, nlh->nlmsg_len, nlh);
+
+		nlh = synth_ack(reply, nlh);
+		ok = ok && synth_write_record(file, t + 200000, WIFI_SCAN_CHANNEL_COMMANDS, WIFI_SCAN_CAPTURE_RECEIVE, nlh->nlmsg_len, nlh);
+
+		nlh = synth_genl_message(reply, SYNTH_NL80211_ID, 0, 0, 0, NL80211_CMD_TRIGGER_SCAN);
+		mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, SYNTH_IFINDEX);
+		ok = ok && synth_write_record(file, t + 300000, WIFI_SCAN_CHANNEL_NOTIFICATIONS, WIFI_SCAN_CAPTURE_RECEIVE, nlh->nlmsg_len, nlh);
+
+		nlh = synth_genl_message(reply, SYNTH_NL80211_ID, 0, 0, 0, NL80211_CMD_NEW_SCAN_RESULTS);
+		mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, SYNTH_IFINDEX);
+		ok = ok && synth_write_record(file, t + 3000000000ULL, WIFI_SCAN_CHANNEL_NOTIFICATIONS, WIFI_SCAN_CAPTURE_RECEIVE, nlh->nlmsg_len, nlh);
+
+		//dump the results
+		nlh = synth_genl_message(request, SYNTH_NL80211_ID, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, seq + 1, 0, NL80211_CMD_GET_SCAN);
+		mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, SYNTH_IFINDEX);
+		ok = ok && synth_write_record(file, t + 3000100000ULL, WIFI_SCAN_CHANNEL_COMMANDS, WIFI_SCAN_CAPTURE_SEND, nlh->nlmsg_len, nlh);
+
+		if (!ok || !synth_scan_dump(population, seq + 1, SYNTH_PORTID, MNL_SOCKET_BUFFER_SIZE, &dump))
+		{
+			ok = false;
+			break;
+		}
+
+		for (i = 0; ok && i < dump.parts; ++i)
+		{
+			ok = synth_write_record(file, t + 3000200000ULL + 10000 * i, WIFI_SCAN_CHANNEL_COMMANDS, WIFI_SCAN_CAPTURE_RECEIVE, dump.part_lengths[i], dump.data + offset);
+			offset += dump.part_lengths[i];
+		}
+
+		synth_dump_free(&dump);
+	}
+
+	if (fclose(file) != 0)
+		ok = false;
+
+	return ok;
+}
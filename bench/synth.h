@@ -0,0 +1,80 @@
+/*
+ * synthetic nl80211 scan results for wifi-scan library benchmarks
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  Generates well-formed (or deliberately malformed) NL80211_CMD_NEW_SCAN_RESULTS dumps
+ *  for configurable AP populations, the same as the kernel would send them.
+ * 
+ *  The same population with the same seed always gives the same bytes
+ *  so the output may serve as fixed benchmark fixture.
+ * 
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// what kind of environment to generate
+struct synth_population
+{
+	int bss_count; //the number of BSSes in the dump
+	unsigned int seed; //the same seed gives the same dump
+	int hidden_percent; //BSSes with hidden SSID (zero length or zeroed SSID)
+	int multi_bssid_percent; //BSSes advertising Multiple BSSID element with nontransmitted profiles
+	bool multi_bssid_reported; //nontransmitted BSSes reported as separate records too (like newer kernels)
+	int rnr_percent; //2.4/5 GHz BSSes advertising colocated 6 GHz BSS in Reduced Neighbor Report element
+	int ftm_percent; //BSSes advertising FTM responder role in Extended Capabilities element
+	int vendor_ies; //at most that many vendor specific IEs per BSS (besides WMM)
+	int malformed_percent; //records with broken attributes or IEs
+	int associated; //index of BSS we are associated with or -1
+};
+
+// dump split into parts as received with single recv, each part holds whole messages
+struct synth_dump
+{
+	char *data; //all the parts one after another
+	size_t length; //total length of data
+	size_t *part_lengths; //length of each part
+	int parts; //the number of parts, the last one holds NLMSG_DONE
+};
+
+// realistic defaults for bss_count BSSes
+void synth_population_default(struct synth_population *population, int bss_count);
+
+/* Generate scan results dump
+ *
+ * parameters:
+ * population - what to generate
+ * seq, portid - netlink sequence number and port id of the request being answered (0 for none)
+ * part_size - maximum size of single part (e.g. receive buffer size)
+ * dump - filled with data, free with synth_dump_free
+ *
+ * returns:
+ * false if memory could not be allocated
+ */
+bool synth_scan_dump(const struct synth_population *population, uint32_t seq, uint32_t portid, size_t part_size, struct synth_dump *dump);
+
+void synth_dump_free(struct synth_dump *dump);
+
+/* Write capture file (see wifi_scan_capture_start) with scans calls to wifi_scan_all
+ *
+ * Each call triggers the scan, receives notifications and dumps the population.
+ * Replay it with wifi_scan_init_replay.
+ *
+ * returns:
+ * false on error (errno is set)
+ */
+bool synth_write_capture(const char *capture_file, const struct synth_population *population, int scans);
@@ -23,6 +23,9 @@
  *  Program expects wireless interface as argument, e.g:
  *  wifi-scan-all wlan0
  * 
+ *  Optionally all the netlink traffic may be recorded for later replay (see wifi-scan-replay):
+ *  wifi-scan-all wlan0 capture.bin
+ * 
  */
  
 #include "../wifi_scan.h"
@@ -48,7 +51,7 @@ int main(int argc, char **argv)
 	char mac[BSSID_STRING_LENGTH];  //a placeholder where we convert BSSID to printable hardware mac address
 	int status, i;
 
-	if(argc != 2)
+	if(argc != 2 && argc != 3)
 	{
 		Usage(argv);
 		return 0;
@@ -70,6 +73,14 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	//record the traffic if capture file was passed
+	if(argc == 3 && wifi_scan_capture_start(wifi, argv[2]) == -1)
+	{
+		perror("Unable to start capture");
+		wifi_scan_close(wifi);
+		return 1;
+	}
+
 	while(1)
 	{
 		status=wifi_scan_all(wifi, bss, BSS_INFOS);
@@ -103,8 +114,9 @@ int main(int argc, char **argv)
 void Usage(char **argv)
 {
 	printf("Usage:\n");
-	printf("%s wireless_interface\n\n", argv[0]);
+	printf("%s wireless_interface [capture_file]\n\n", argv[0]);
 	printf("examples:\n");
 	printf("%s wlan0\n", argv[0]);
+	printf("%s wlan0 capture.bin\n", argv[0]);
 	
 }
@@ -0,0 +1,127 @@
+/*
+ * wifi-scan-replay example for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This example feeds netlink traffic recorded with wifi-scan-all (or wifi_scan_capture_start)
+ *  back to the library at full speed, prints the results and the time spent.
+ * 
+ *  No wireless hardware or permissions are needed. The output of two library versions
+ *  on the same capture file may be compared directly.
+ * 
+ *  Program expects capture file as argument and optionally what was recorded (all or station), e.g:
+ *  wifi-scan-replay capture.bin
+ *  wifi-scan-replay capture.bin station
+ * 
+ */
+
+#include "../wifi_scan.h"
+#include <stdio.h>  //printf
+#include <string.h> //strcmp
+#include <errno.h> //errno
+#include <time.h> //clock_gettime
+
+//convert bssid to printable hardware mac address
+const char *bssid_to_string(const uint8_t bssid[BSSID_LENGTH], char bssid_string[BSSID_STRING_LENGTH])
+{
+	snprintf(bssid_string, BSSID_STRING_LENGTH, "%02x:%02x:%02x:%02x:%02x:%02x",
+         bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+	return bssid_string;
+}
+
+const int BSS_INFOS=64; //the maximum amounts of APs (Access Points) we want to store
+
+void Usage(char **argv);
+double elapsed_ms(const struct timespec *start);
+
+int main(int argc, char **argv)
+{
+	struct wifi_scan *wifi=NULL;    //this stores all the library information
+	struct bss_info bss[BSS_INFOS]; //this is where we are going to keep informatoin about APs (Access Points)
+	struct station_info station;    //or information about associated AP if station traffic was recorded
+	char mac[BSSID_STRING_LENGTH];  //a placeholder where we convert BSSID to printable hardware mac address
+	struct timespec start;
+	int status, i, calls=0;
+	int station_mode = argc == 3 && strcmp(argv[2], "station") == 0;
+
+	if(argc != 2 && !(argc == 3 && (station_mode || strcmp(argv[2], "all") == 0)))
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	// initialize the library with recorded traffic instead of network interface
+	wifi=wifi_scan_init_replay(argv[1], false);
+
+	if(wifi == NULL)
+	{
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while(1)
+	{
+		if(station_mode)
+			status=wifi_scan_station(wifi, &station);
+		else
+			status=wifi_scan_all(wifi, bss, BSS_INFOS);
+
+		if(status<0 && errno==ENODATA) //the recording is exhausted
+			break;
+
+		++calls;
+
+		if(status<0)
+			perror("Unable to get scan data");
+		else if(station_mode && status>0)
+			printf("%s %s signal %d dBm %u rx %u tx\n",bssid_to_string(station.bssid, mac), station.ssid,  station.signal_dbm,station.rx_packets, station.tx_packets);
+		else if(station_mode)
+			break; //wifi_scan_station doesn't report errors, no station also when recording is exhausted
+		else
+			for(i=0;i<status && i<BSS_INFOS;++i)
+				printf("%s %s signal %d dBm on frequency %u MHz seen %d ms ago status %s\n",
+				   bssid_to_string(bss[i].bssid, mac),
+				   bss[i].ssid,
+				   bss[i].signal_mbm/100,
+				   bss[i].frequency,
+				   bss[i].seen_ms_ago,
+				   (bss[i].status==BSS_ASSOCIATED ? "associated" : "")
+				);
+
+		printf("\n");
+	}
+
+	fprintf(stderr, "replayed %d calls in %.3f ms\n", calls, elapsed_ms(&start));
+
+	//free the library resources
+	wifi_scan_close(wifi);
+
+	return 0;
+}
+
+double elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s capture_file [all|station]\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s capture.bin\n", argv[0]);
+	printf("%s capture.bin station\n", argv[0]);
+}
@@ -0,0 +1,115 @@
+/*
+ * wifi-scan-survey example for wifi-scan library
+ *
+ * Copyright (C) 2016 Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ * This program is distributed "as is" WITHOUT ANY WARRANTY of any
+ * kind, whether express or implied; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  This example retrieves channel survey (how busy the channels are) every few seconds.
+ *  The first survey reports counters since the driver started them, the following ones
+ *  utilization since the previous survey.
+ *
+ *  Most drivers update the channel in use all the time and other channels only while scanning.
+ *  Run wifi-scan-all in parallel to see utilization of other channels.
+ *
+ *  Program expects wireless interface as argument, e.g:
+ *  wifi-scan-survey wlan0
+ *
+ */
+
+#include "../wifi_scan.h"
+#include <stdio.h>  //printf
+#include <unistd.h> //sleep
+
+// this is the number of channels we will be able to report (the rest is counted but not returned)
+#define CHANNELS_MAX 128
+
+void Usage(char **argv);
+
+//print -1 (not reported) as dash
+void print_percent(int8_t percent)
+{
+	if(percent < 0)
+		printf(" %5s", "-");
+	else
+		printf(" %4d%%", percent);
+}
+
+int main(int argc, char **argv)
+{
+	struct wifi_scan *wifi=NULL;    //this stores all the library information
+	struct channel_survey surveys[CHANNELS_MAX]; //this is where we are going to keep the survey of channels
+	int status, i;
+
+	if(argc != 2)
+	{
+		Usage(argv);
+		return 0;
+	}
+
+	printf("This is just example, this is library - not utility!\n");
+	printf("### Close the program with ctrl+c when you're done ###\n\n");
+
+	// initialize the library with network interface argv[1] (e.g. wlan0)
+	wifi=wifi_scan_init(argv[1]);
+
+	if(wifi == NULL)
+	{
+		return 1;
+	}
+
+	while(1)
+	{
+		//single dump, no scan is triggered, no permissions needed
+		status=wifi_scan_survey(wifi, surveys, CHANNELS_MAX);
+
+		if(status<0)
+			perror("Unable to get channel survey");
+		else
+		{
+			printf("%6s %6s %10s %6s %6s %6s\n", "MHz", "noise", "time ms", "busy", "rx", "tx");
+
+			for(i=0;i<status && i<CHANNELS_MAX;++i)
+			{
+				//skip channels the radio didn't visit since the previous survey
+				if(surveys[i].delta_time_ms == 0 && !surveys[i].in_use)
+					continue;
+
+				printf("%6u", surveys[i].frequency);
+				if(surveys[i].fields & SURVEY_NOISE)
+					printf(" %6d", surveys[i].noise_dbm);
+				else
+					printf(" %6s", "-");
+				printf(" %10llu", (unsigned long long)surveys[i].delta_time_ms);
+				print_percent(surveys[i].busy_percent);
+				print_percent(surveys[i].rx_percent);
+				print_percent(surveys[i].tx_percent);
+				printf("%s\n", surveys[i].in_use ? " in use" : "");
+			}
+			printf("\n");
+		}
+
+		sleep(5);
+	}
+
+	//free the library resources
+	wifi_scan_close(wifi);
+
+	return 0;
+}
+
+void Usage(char **argv)
+{
+	printf("Usage:\n");
+	printf("%s wireless_interface\n\n", argv[0]);
+	printf("examples:\n");
+	printf("%s wlan0\n", argv[0]);
+}
@@ -0,0 +1,755 @@
+/*
+ * wifi-scan library Arrow export implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Arrow Overview
+  *
+  * Arrow IPC file is magic, stream of messages (schema, dictionary batches, record batches,
+  * end of stream marker), footer with schema and positions of all the batches, footer length and magic.
+  * Message is continuation marker, metadata length, Flatbuffers metadata and body with buffers of columns.
+  *
+  * Flatbuffers metadata is built here front to back - table (with its vtable just before it) first,
+  * then the strings, vectors and tables it points to, patching offsets as they are placed.
+  * All scalars are stored little endian as Flatbuffers require.
+  *
+  * Rows are gathered in columns of the writer until batch is full. Column arrays are written as body buffers
+  * as they are, SSID dictionary (wifi_ssid_map.h) keeps Arrow layout (offsets and data) to write its new part as delta.
+  *
+  */
+
+#include "wifi_arrow.h"
+#include "wifi_ssid_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define ARROW_MAGIC "ARROW1"
+
+// Arrow format constants (Schema.fbs, Message.fbs)
+enum arrow_format {ARROW_METADATA_V5=4, ARROW_HEADER_SCHEMA=1, ARROW_HEADER_DICTIONARY_BATCH=2, ARROW_HEADER_RECORD_BATCH=3,
+	ARROW_TYPE_INT=2, ARROW_TYPE_UTF8=5, ARROW_TYPE_TIMESTAMP=10, ARROW_TYPE_FIXED_SIZE_BINARY=15,
+	ARROW_TIME_UNIT_NANOSECOND=3, ARROW_CONTINUATION=-1, ARROW_SSID_DICTIONARY_ID=0};
+
+// exported columns in schema order
+enum arrow_columns {COLUMN_TIMESTAMP=0, COLUMN_DEVICE_ID, COLUMN_BSSID, COLUMN_SSID, COLUMN_FREQUENCY, COLUMN_SIGNAL_MBM,
+	COLUMN_SEEN_MS_AGO, COLUMN_STATUS, COLUMNS};
+
+// Flatbuffers under construction, positions instead of pointers as data may move
+struct flatbuffer
+{
+  uint8_t *data;
+  size_t length;
+  size_t capacity;
+  bool failed; //allocation failed, everything else is no-op then
+  size_t table; //position of the table being built
+  size_t vtable; //its vtable
+};
+
+// Block struct of the footer
+struct arrow_block
+{
+  int64_t offset;
+  int32_t metadata_length;
+  int64_t body_length;
+};
+
+// blocks of the written batches
+struct arrow_blocks
+{
+  struct arrow_block *blocks;
+  int count;
+  int capacity;
+};
+
+// internal writer data passed around by user
+struct wifi_arrow_writer
+{
+  FILE *file;
+  uint64_t offset; //where the next message goes
+  int batch_rows;
+  int rows; //in the batch being gathered
+  uint64_t *timestamps;
+  uint32_t *device_ids;
+  uint8_t (*bssids)[BSSID_LENGTH];
+  int32_t *ssids;
+  uint32_t *frequencies;
+  int32_t *signals_mbm;
+  int32_t *seen_ms_ago;
+  int8_t *statuses;
+  struct wifi_ssid_map *dictionary; //SSIDs in Arrow layout
+  int written; //SSIDs of dictionary written to the file so far
+  struct arrow_blocks dictionaries; //dictionary batches in the file
+  struct arrow_blocks batches; //record batches in the file
+  struct flatbuffer metadata; //reused for each message
+};
+
+// body buffer of message
+struct arrow_buffer
+{
+  const void *data;
+  size_t length;
+};
+
+// DECLARATIONS
+
+// public interface - create the file, write magic and schema
+struct wifi_arrow_writer *wifi_arrow_create(const char *path, int batch_rows);
+// public interface - gather rows, write full batches
+int wifi_arrow_append(struct wifi_arrow_writer *writer, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length);
+// public interface - write gathered rows
+int wifi_arrow_flush(struct wifi_arrow_writer *writer);
+// public interface - footer
+int wifi_arrow_finish(struct wifi_arrow_writer *writer);
+// frees the writer memory, closes the file
+static void free_writer(struct wifi_arrow_writer *writer);
+
+// MESSAGES
+
+// metadata of the writer is the message, write it with body buffers, block is filled if not NULL
+static bool write_message(struct wifi_arrow_writer *writer, const struct arrow_buffer *buffers, int buffers_count, struct arrow_block *block);
+// Schema table, returns its position
+static size_t build_schema(struct flatbuffer *fb);
+// Field table of column, returns its position
+static size_t build_field(struct flatbuffer *fb, int column);
+// RecordBatch table with nodes of length rows, buffers laid out one after another, returns its position
+static size_t build_record_batch(struct flatbuffer *fb, int64_t rows, int nodes, const struct arrow_buffer *buffers, int buffers_count);
+// Message table with header of type, returns position of header offset to patch
+static size_t build_message(struct flatbuffer *fb, uint8_t header_type, int64_t body_length);
+// Block vector of footer, returns its position
+static size_t build_blocks(struct flatbuffer *fb, const struct arrow_blocks *blocks);
+static bool blocks_add(struct arrow_blocks *blocks, const struct arrow_block *block);
+
+// DICTIONARY
+
+// copy SSID replacing invalid UTF-8 bytes with '?', returns the length
+static size_t sanitize_utf8(const char *ssid, char *out);
+
+// FLATBUFFERS
+
+// reset to empty buffer with space for root offset
+static void fb_reset(struct flatbuffer *fb);
+// zeroed space aligned to align (relative to buffer start), returns its position
+static size_t fb_reserve(struct flatbuffer *fb, size_t size, size_t align);
+// store little endian value of size bytes at position
+static void fb_put(struct flatbuffer *fb, size_t position, uint64_t value, size_t size);
+// start table with given number of vtable slots
+static void fb_table_begin(struct flatbuffer *fb, int slots);
+// scalar field of table
+static void fb_scalar(struct flatbuffer *fb, int slot, uint64_t value, size_t size);
+// offset field of table, returns its position to be patched
+static size_t fb_offset(struct flatbuffer *fb, int slot);
+// finish table, returns its position
+static size_t fb_table_end(struct flatbuffer *fb);
+// point offset field at position to target
+static void fb_patch(struct flatbuffer *fb, size_t offset, size_t target);
+// vector of count elements with elements aligned to align, returns position of its length (elements follow)
+static size_t fb_vector(struct flatbuffer *fb, uint32_t count, size_t element_size, size_t align);
+// null terminated string, returns its position
+static size_t fb_string(struct flatbuffer *fb, const char *string);
+
+// HELPERS
+
+// round up to multiple of 8
+static uint64_t align8(uint64_t value);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_arrow_writer *wifi_arrow_create(const char *path, int batch_rows)
+{
+  static const char magic[8] = ARROW_MAGIC;
+  struct wifi_arrow_writer *writer;
+  size_t rows, header;
+
+  if (batch_rows < 0)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if ((writer = calloc(sizeof(struct wifi_arrow_writer), 1)) == NULL)
+    return NULL;
+
+  writer->batch_rows = batch_rows ? batch_rows : WIFI_ARROW_DEFAULT_BATCH_ROWS;
+  rows = writer->batch_rows;
+
+  writer->timestamps = malloc(rows * sizeof(uint64_t));
+  writer->device_ids = malloc(rows * sizeof(uint32_t));
+  writer->bssids = malloc(rows * BSSID_LENGTH);
+  writer->ssids = malloc(rows * sizeof(int32_t));
+  writer->frequencies = malloc(rows * sizeof(uint32_t));
+  writer->signals_mbm = malloc(rows * sizeof(int32_t));
+  writer->seen_ms_ago = malloc(rows * sizeof(int32_t));
+  writer->statuses = malloc(rows * sizeof(int8_t));
+
+  writer->dictionary = wifi_ssid_map_new();
+
+  if (!writer->timestamps || !writer->device_ids || !writer->bssids || !writer->ssids || !writer->frequencies
+   || !writer->signals_mbm || !writer->seen_ms_ago || !writer->statuses || !writer->dictionary || (writer->file = fopen(path, "wb")) == NULL)
+  {
+    free_writer(writer);
+    return NULL;
+  }
+
+  //magic padded to 8 bytes, then the stream starts with schema
+  if (fwrite(magic, sizeof(magic), 1, writer->file) != 1)
+  {
+    free_writer(writer);
+    return NULL;
+  }
+  writer->offset = sizeof(magic);
+
+  fb_reset(&writer->metadata);
+  header = build_message(&writer->metadata, ARROW_HEADER_SCHEMA, 0);
+  fb_patch(&writer->metadata, header, build_schema(&writer->metadata));
+
+  if (!write_message(writer, NULL, 0, NULL))
+  {
+    free_writer(writer);
+    return NULL;
+  }
+
+  return writer;
+}
+
+// public interface
+//
+// prerequisities:
+// - writer initialized with wifi_arrow_create
+int wifi_arrow_append(struct wifi_arrow_writer *writer, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  char valid[SSID_MAX_LENGTH_WITH_NULL]; //each invalid byte is replaced with single '?'
+  int ssid, i;
+
+  if (bss_infos_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < bss_infos_length; ++i)
+  {
+    const struct bss_info *bss = &bss_infos[i];
+    int row = writer->rows;
+
+    if ((ssid = wifi_ssid_map_add(writer->dictionary, valid, sanitize_utf8(bss->ssid, valid))) == -1)
+      return -1;
+
+    writer->timestamps[row] = timestamp_ns;
+    writer->device_ids[row] = device_id;
+    memcpy(writer->bssids[row], bss->bssid, BSSID_LENGTH);
+    writer->ssids[row] = (int32_t)ssid;
+    writer->frequencies[row] = bss->frequency;
+    writer->signals_mbm[row] = bss->signal_mbm;
+    writer->seen_ms_ago[row] = bss->seen_ms_ago;
+    writer->statuses[row] = bss->status;
+
+    if (++writer->rows == writer->batch_rows && wifi_arrow_flush(writer) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - writer initialized with wifi_arrow_create
+int wifi_arrow_flush(struct wifi_arrow_writer *writer)
+{
+  const int32_t *ssid_offsets = wifi_ssid_map_offsets(writer->dictionary);
+  int ssids = wifi_ssid_map_size(writer->dictionary);
+  struct flatbuffer *fb = &writer->metadata;
+  struct arrow_block block;
+  int rows = writer->rows, i;
+
+  if (rows == 0)
+    return 0;
+
+  //SSIDs new since the previous batch, the first dictionary batch is not a delta
+  if (ssids > writer->written || writer->dictionaries.count == 0)
+  {
+    uint32_t count = ssids - writer->written;
+    int32_t base = ssid_offsets[writer->written];
+    int32_t *offsets = malloc((count + 1) * sizeof(int32_t));
+    struct arrow_buffer buffers[3];
+    size_t header, batch;
+    bool ok;
+
+    if (offsets == NULL)
+      return -1;
+
+    for (i = 0; i <= (int)count; ++i)
+      offsets[i] = ssid_offsets[writer->written + i] - base;
+
+    buffers[0] = (struct arrow_buffer){ NULL, 0 }; //validity, no nulls
+    buffers[1] = (struct arrow_buffer){ offsets, (count + 1) * sizeof(int32_t) };
+    buffers[2] = (struct arrow_buffer){ wifi_ssid_map_data(writer->dictionary) + base, ssid_offsets[ssids] - base };
+
+    fb_reset(fb);
+    header = build_message(fb, ARROW_HEADER_DICTIONARY_BATCH, align8(buffers[1].length) + align8(buffers[2].length));
+    fb_table_begin(fb, 3);
+    fb_scalar(fb, 0, ARROW_SSID_DICTIONARY_ID, 8);
+    batch = fb_offset(fb, 1);
+    fb_scalar(fb, 2, writer->dictionaries.count > 0, 1); //isDelta
+    fb_patch(fb, header, fb_table_end(fb));
+    fb_patch(fb, batch, build_record_batch(fb, count, 1, buffers, 3));
+
+    ok = write_message(writer, buffers, 3, &block) && blocks_add(&writer->dictionaries, &block);
+    free(offsets);
+
+    if (!ok)
+      return -1;
+
+    writer->written = ssids;
+  }
+
+  //validity (no nulls) and data of each column
+  struct arrow_buffer buffers[2 * COLUMNS] = {
+    {NULL, 0}, {writer->timestamps, rows * sizeof(uint64_t)},
+    {NULL, 0}, {writer->device_ids, rows * sizeof(uint32_t)},
+    {NULL, 0}, {writer->bssids, (size_t)rows * BSSID_LENGTH},
+    {NULL, 0}, {writer->ssids, rows * sizeof(int32_t)},
+    {NULL, 0}, {writer->frequencies, rows * sizeof(uint32_t)},
+    {NULL, 0}, {writer->signals_mbm, rows * sizeof(int32_t)},
+    {NULL, 0}, {writer->seen_ms_ago, rows * sizeof(int32_t)},
+    {NULL, 0}, {writer->statuses, rows * sizeof(int8_t)}
+  };
+  uint64_t body_length = 0;
+  size_t header;
+
+  for (i = 0; i < 2 * COLUMNS; ++i)
+    body_length += align8(buffers[i].length);
+
+  fb_reset(fb);
+  header = build_message(fb, ARROW_HEADER_RECORD_BATCH, body_length);
+  fb_patch(fb, header, build_record_batch(fb, rows, COLUMNS, buffers, 2 * COLUMNS));
+
+  if (!write_message(writer, buffers, 2 * COLUMNS, &block) || !blocks_add(&writer->batches, &block))
+    return -1;
+
+  writer->rows = 0;
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - writer initialized with wifi_arrow_create
+int wifi_arrow_finish(struct wifi_arrow_writer *writer)
+{
+  static const char magic[6] = ARROW_MAGIC;
+  static const int32_t END_OF_STREAM[2] = {ARROW_CONTINUATION, 0};
+  struct flatbuffer *fb = &writer->metadata;
+  size_t schema, dictionaries, batches;
+  int32_t footer_length;
+  bool ok;
+
+  ok = wifi_arrow_flush(writer) == 0 && fwrite(END_OF_STREAM, sizeof(END_OF_STREAM), 1, writer->file) == 1;
+
+  //Footer {version, schema, dictionaries, recordBatches}, not a message, written as it is
+  fb_reset(fb);
+  fb_table_begin(fb, 4);
+  fb_scalar(fb, 0, ARROW_METADATA_V5, 2);
+  schema = fb_offset(fb, 1);
+  dictionaries = fb_offset(fb, 2);
+  batches = fb_offset(fb, 3);
+  fb_patch(fb, 0, fb_table_end(fb));
+  fb_patch(fb, schema, build_schema(fb));
+  fb_patch(fb, dictionaries, build_blocks(fb, &writer->dictionaries));
+  fb_patch(fb, batches, build_blocks(fb, &writer->batches));
+
+  footer_length = (int32_t)fb->length;
+
+  ok = ok && !fb->failed && fwrite(fb->data, fb->length, 1, writer->file) == 1 &&
+    fwrite(&footer_length, sizeof(footer_length), 1, writer->file) == 1 &&
+    fwrite(magic, sizeof(magic), 1, writer->file) == 1;
+
+  ok = fclose(writer->file) == 0 && ok;
+  writer->file = NULL;
+
+  int error = fb->failed ? ENOMEM : errno;
+  free_writer(writer);
+  errno = error;
+
+  return ok ? 0 : -1;
+}
+
+static void free_writer(struct wifi_arrow_writer *writer)
+{
+  if (writer->file)
+    fclose(writer->file);
+  free(writer->timestamps);
+  free(writer->device_ids);
+  free(writer->bssids);
+  free(writer->ssids);
+  free(writer->frequencies);
+  free(writer->signals_mbm);
+  free(writer->seen_ms_ago);
+  free(writer->statuses);
+  wifi_ssid_map_free(writer->dictionary);
+  free(writer->dictionaries.blocks);
+  free(writer->batches.blocks);
+  free(writer->metadata.data);
+  free(writer);
+}
+
+// MESSAGES
+
+// continuation, metadata length (padded so that body is aligned to 8), metadata, padding, body
+static bool write_message(struct wifi_arrow_writer *writer, const struct arrow_buffer *buffers, int buffers_count, struct arrow_block *block)
+{
+  static const char padding[8];
+  struct flatbuffer *fb = &writer->metadata;
+  int32_t prefix[2] = {ARROW_CONTINUATION, (int32_t)align8(fb->length)};
+  uint64_t body_length = 0;
+  int i;
+
+  if (fb->failed)
+  {
+    errno = ENOMEM;
+    return false;
+  }
+
+  if (fwrite(prefix, sizeof(prefix), 1, writer->file) != 1 || fwrite(fb->data, fb->length, 1, writer->file) != 1 ||
+    fwrite(padding, prefix[1] - fb->length, 1, writer->file) != (prefix[1] - fb->length > 0))
+    return false;
+
+  for (i = 0; i < buffers_count; ++i)
+  {
+    size_t padded = align8(buffers[i].length);
+
+    if (buffers[i].length && fwrite(buffers[i].data, buffers[i].length, 1, writer->file) != 1)
+      return false;
+    if (padded > buffers[i].length && fwrite(padding, padded - buffers[i].length, 1, writer->file) != 1)
+      return false;
+    body_length += padded;
+  }
+
+  if (block)
+  {
+    block->offset = writer->offset;
+    block->metadata_length = sizeof(prefix) + prefix[1];
+    block->body_length = body_length;
+  }
+
+  writer->offset += sizeof(prefix) + prefix[1] + body_length;
+  return true;
+}
+
+// Schema {endianness, fields}
+static size_t build_schema(struct flatbuffer *fb)
+{
+  const uint16_t endian = 1;
+  size_t fields, vector, schema;
+  int column;
+
+  fb_table_begin(fb, 2);
+  fb_scalar(fb, 0, *(const uint8_t*)&endian == 0, 2); //Little=0, Big=1
+  fields = fb_offset(fb, 1);
+  schema = fb_table_end(fb);
+
+  vector = fb_vector(fb, COLUMNS, 4, 4);
+  fb_patch(fb, fields, vector);
+
+  for (column = 0; column < COLUMNS; ++column)
+    fb_patch(fb, vector + 4 + 4 * column, build_field(fb, column));
+
+  return schema;
+}
+
+// Field {name, nullable, type_type, type, dictionary, children}
+static size_t build_field(struct flatbuffer *fb, int column)
+{
+  static const char *NAMES[COLUMNS] = {"timestamp", "device_id", "bssid", "ssid", "frequency", "signal_mbm", "seen_ms_ago", "status"};
+  static const uint8_t TYPES[COLUMNS] = {ARROW_TYPE_TIMESTAMP, ARROW_TYPE_INT, ARROW_TYPE_FIXED_SIZE_BINARY, ARROW_TYPE_UTF8,
+    ARROW_TYPE_INT, ARROW_TYPE_INT, ARROW_TYPE_INT, ARROW_TYPE_INT};
+  static const int8_t INT_WIDTHS[COLUMNS] = {0, 32, 0, 0, 32, 32, 32, 8};
+  static const bool INT_SIGNED[COLUMNS] = {0, false, 0, 0, false, true, true, true};
+  size_t name, type, dictionary = 0, children, field, index_type;
+
+  fb_table_begin(fb, 6);
+  name = fb_offset(fb, 0);
+  fb_scalar(fb, 1, false, 1); //nullable
+  fb_scalar(fb, 2, TYPES[column], 1);
+  type = fb_offset(fb, 3);
+  if (column == COLUMN_SSID)
+    dictionary = fb_offset(fb, 4);
+  children = fb_offset(fb, 5);
+  field = fb_table_end(fb);
+
+  fb_patch(fb, name, fb_string(fb, NAMES[column]));
+
+  //Int {bitWidth, is_signed}, FixedSizeBinary {byteWidth}, Timestamp {unit, timezone}, Utf8 {}
+  switch (TYPES[column])
+  {
+    case ARROW_TYPE_INT:
+      fb_table_begin(fb, 2);
+      fb_scalar(fb, 0, INT_WIDTHS[column], 4);
+      fb_scalar(fb, 1, INT_SIGNED[column], 1);
+      break;
+    case ARROW_TYPE_FIXED_SIZE_BINARY:
+      fb_table_begin(fb, 1);
+      fb_scalar(fb, 0, BSSID_LENGTH, 4);
+      break;
+    case ARROW_TYPE_TIMESTAMP:
+      fb_table_begin(fb, 1);
+      fb_scalar(fb, 0, ARROW_TIME_UNIT_NANOSECOND, 2);
+      break;
+    default:
+      fb_table_begin(fb, 0);
+  }
+  fb_patch(fb, type, fb_table_end(fb));
+
+  //DictionaryEncoding {id, indexType: Int {32, signed}}
+  if (column == COLUMN_SSID)
+  {
+    fb_table_begin(fb, 2);
+    fb_scalar(fb, 0, ARROW_SSID_DICTIONARY_ID, 8);
+    index_type = fb_offset(fb, 1);
+    fb_patch(fb, dictionary, fb_table_end(fb));
+
+    fb_table_begin(fb, 2);
+    fb_scalar(fb, 0, 32, 4);
+    fb_scalar(fb, 1, true, 1);
+    fb_patch(fb, index_type, fb_table_end(fb));
+  }
+
+  //readers require children even if there are none
+  fb_patch(fb, children, fb_vector(fb, 0, 4, 4));
+
+  return field;
+}
+
+// RecordBatch {length, nodes: [FieldNode {length, null_count}], buffers: [Buffer {offset, length}]}
+static size_t build_record_batch(struct flatbuffer *fb, int64_t rows, int nodes, const struct arrow_buffer *buffers, int buffers_count)
+{
+  size_t batch, nodes_offset, buffers_offset, vector;
+  uint64_t body_offset = 0;
+  int i;
+
+  fb_table_begin(fb, 3);
+  fb_scalar(fb, 0, rows, 8);
+  nodes_offset = fb_offset(fb, 1);
+  buffers_offset = fb_offset(fb, 2);
+  batch = fb_table_end(fb);
+
+  vector = fb_vector(fb, nodes, 16, 8);
+  fb_patch(fb, nodes_offset, vector);
+  for (i = 0; i < nodes; ++i)
+    fb_put(fb, vector + 4 + 16 * i, rows, 8); //null_count stays 0
+
+  vector = fb_vector(fb, buffers_count, 16, 8);
+  fb_patch(fb, buffers_offset, vector);
+  for (i = 0; i < buffers_count; ++i)
+  {
+    fb_put(fb, vector + 4 + 16 * i, body_offset, 8);
+    fb_put(fb, vector + 4 + 16 * i + 8, buffers[i].length, 8);
+    body_offset += align8(buffers[i].length);
+  }
+
+  return batch;
+}
+
+// Message {version, header_type, header, bodyLength} as root
+static size_t build_message(struct flatbuffer *fb, uint8_t header_type, int64_t body_length)
+{
+  size_t header;
+
+  fb_table_begin(fb, 4);
+  fb_scalar(fb, 0, ARROW_METADATA_V5, 2);
+  fb_scalar(fb, 1, header_type, 1);
+  header = fb_offset(fb, 2);
+  fb_scalar(fb, 3, body_length, 8);
+  fb_patch(fb, 0, fb_table_end(fb));
+
+  return header;
+}
+
+// [Block {offset: long, metaDataLength: int, (padding), bodyLength: long}]
+static size_t build_blocks(struct flatbuffer *fb, const struct arrow_blocks *blocks)
+{
+  size_t vector = fb_vector(fb, blocks->count, 24, 8);
+  int i;
+
+  for (i = 0; i < blocks->count; ++i)
+  {
+    fb_put(fb, vector + 4 + 24 * i, blocks->blocks[i].offset, 8);
+    fb_put(fb, vector + 4 + 24 * i + 8, blocks->blocks[i].metadata_length, 4);
+    fb_put(fb, vector + 4 + 24 * i + 16, blocks->blocks[i].body_length, 8);
+  }
+
+  return vector;
+}
+
+static bool blocks_add(struct arrow_blocks *blocks, const struct arrow_block *block)
+{
+  if (blocks->count == blocks->capacity)
+  {
+    int capacity = blocks->capacity ? 2 * blocks->capacity : 64;
+    struct arrow_block *grown = realloc(blocks->blocks, capacity * sizeof(struct arrow_block));
+    if (grown == NULL)
+      return false;
+    blocks->blocks = grown;
+    blocks->capacity = capacity;
+  }
+
+  blocks->blocks[blocks->count++] = *block;
+  return true;
+}
+
+// DICTIONARY
+
+// strict UTF-8 - no overlong encodings, surrogates or code points over U+10FFFF
+static size_t sanitize_utf8(const char *ssid, char *out)
+{
+  const uint8_t *in = (const uint8_t*)ssid;
+  size_t length = strnlen(ssid, SSID_MAX_LENGTH_WITH_NULL - 1), i = 0, o = 0;
+
+  while (i < length)
+  {
+    uint8_t c = in[i];
+    int continuation = c < 0x80 ? 0 : c >= 0xC2 && c <= 0xDF ? 1 : c >= 0xE0 && c <= 0xEF ? 2 : c >= 0xF0 && c <= 0xF4 ? 3 : -1;
+    uint8_t low = 0x80, high = 0xBF; //allowed range of the first continuation byte
+    int k;
+
+    if (c == 0xE0) low = 0xA0;
+    else if (c == 0xED) high = 0x9F;
+    else if (c == 0xF0) low = 0x90;
+    else if (c == 0xF4) high = 0x8F;
+
+    for (k = 1; continuation > 0 && k <= continuation; ++k)
+      if (i + k >= length || in[i + k] < (k == 1 ? low : 0x80) || in[i + k] > (k == 1 ? high : 0xBF))
+        continuation = -1;
+
+    if (continuation < 0)
+    {
+      out[o++] = '?';
+      ++i;
+      continue;
+    }
+
+    memcpy(out + o, in + i, continuation + 1);
+    o += continuation + 1;
+    i += continuation + 1;
+  }
+
+  return o;
+}
+
+// FLATBUFFERS
+
+static void fb_reset(struct flatbuffer *fb)
+{
+  fb->length = 0;
+  fb->failed = false;
+  fb_reserve(fb, 4, 4); //root table offset
+}
+
+static size_t fb_reserve(struct flatbuffer *fb, size_t size, size_t align)
+{
+  size_t position = (fb->length + align - 1) / align * align;
+
+  if (position + size > fb->capacity)
+  {
+    size_t capacity = 2 * fb->capacity + position + size;
+    uint8_t *grown = fb->failed ? NULL : realloc(fb->data, capacity);
+    if (grown == NULL)
+    {
+      fb->failed = true;
+      return 0;
+    }
+    fb->data = grown;
+    fb->capacity = capacity;
+  }
+
+  memset(fb->data + fb->length, 0, position + size - fb->length);
+  fb->length = position + size;
+  return position;
+}
+
+static void fb_put(struct flatbuffer *fb, size_t position, uint64_t value, size_t size)
+{
+  size_t i;
+
+  if (fb->failed)
+    return;
+
+  for (i = 0; i < size; ++i, value >>= 8)
+    fb->data[position + i] = (uint8_t)value;
+}
+
+// vtable {vtable size, table size, field offsets...}, table starts with signed offset back to vtable
+static void fb_table_begin(struct flatbuffer *fb, int slots)
+{
+  fb->vtable = fb_reserve(fb, 4 + 2 * slots, 2);
+  fb->table = fb_reserve(fb, 4, 4);
+  fb_put(fb, fb->vtable, 4 + 2 * slots, 2);
+  fb_put(fb, fb->table, fb->table - fb->vtable, 4);
+}
+
+static void fb_scalar(struct flatbuffer *fb, int slot, uint64_t value, size_t size)
+{
+  size_t position = fb_reserve(fb, size, size);
+  fb_put(fb, position, value, size);
+  fb_put(fb, fb->vtable + 4 + 2 * slot, position - fb->table, 2);
+}
+
+static size_t fb_offset(struct flatbuffer *fb, int slot)
+{
+  size_t position = fb_reserve(fb, 4, 4);
+  fb_put(fb, fb->vtable + 4 + 2 * slot, position - fb->table, 2);
+  return position;
+}
+
+static size_t fb_table_end(struct flatbuffer *fb)
+{
+  fb_put(fb, fb->vtable + 2, fb->length - fb->table, 2);
+  return fb->table;
+}
+
+static void fb_patch(struct flatbuffer *fb, size_t offset, size_t target)
+{
+  fb_put(fb, offset, target - offset, 4);
+}
+
+static size_t fb_vector(struct flatbuffer *fb, uint32_t count, size_t element_size, size_t align)
+{
+  size_t position;
+
+  //the length is just before aligned elements
+  if (align > 4)
+    fb_reserve(fb, (fb->length + 4) % align ? align - (fb->length + 4) % align : 0, 1);
+
+  position = fb_reserve(fb, 4 + count * element_size, 4);
+  fb_put(fb, position, count, 4);
+  return position;
+}
+
+static size_t fb_string(struct flatbuffer *fb, const char *string)
+{
+  size_t length = strlen(string), position = fb_reserve(fb, 4 + length + 1, 4);
+
+  fb_put(fb, position, length, 4);
+  if (!fb->failed)
+    memcpy(fb->data + position + 4, string, length);
+  return position;
+}
+
+// HELPERS
+
+static uint64_t align8(uint64_t value)
+{
+  return (value + 7) & ~(uint64_t)7;
+}
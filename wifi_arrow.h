@@ -0,0 +1,96 @@
+/*
+ * wifi-scan library Arrow export header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Export of scan results to Apache Arrow IPC file format (Feather V2) without Arrow library
+ *
+ * Arrow based tools (pyarrow, polars, DuckDB, Spark...) memory map the file and use the columns
+ * without parsing or copying, e.g. in Python:
+ *
+ *   import pyarrow as pa
+ *   table = pa.ipc.open_file(pa.memory_map("scans.arrow")).read_all()
+ *
+ * Each row is single BSS of single scan, the schema is:
+ *   timestamp: timestamp[ns] - as passed to wifi_arrow_append (e.g. CLOCK_REALTIME)
+ *   device_id: uint32 - as passed to wifi_arrow_append
+ *   bssid: fixed_size_binary[6]
+ *   ssid: dictionary<values=string, indices=int32> - invalid UTF-8 bytes are replaced with '?'
+ *   frequency: uint32 - MHz
+ *   signal_mbm: int32
+ *   seen_ms_ago: int32
+ *   status: int8 - enum bss_status
+ *
+ * Rows are written in record batches of batch_rows rows. SSIDs are written as dictionary deltas
+ * before the batch which needs them, so the file past its 8 byte magic is also a valid Arrow IPC stream
+ * (readable while still being written).
+ * Columns are in host byte order, the schema tells which one.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_arrow_constants {WIFI_ARROW_DEFAULT_BATCH_ROWS=65536};
+
+// data used by the writer
+struct wifi_arrow_writer;
+
+/* Create Arrow IPC file
+ *
+ * parameters:
+ * path - the file to be created (or truncated)
+ * batch_rows - rows in record batch or 0 for WIFI_ARROW_DEFAULT_BATCH_ROWS
+ *
+ * returns:
+ * struct wifi_arrow_writer * - pass it to the writer functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_arrow_writer *wifi_arrow_create(const char *path, int batch_rows);
+
+/* Append scan results, full record batches are written as they fill up
+ *
+ * parameters:
+ * writer - initialized with wifi_arrow_create
+ * timestamp_ns - stored in every row of the scan (e.g. CLOCK_REALTIME)
+ * device_id - stored in every row of the scan (e.g. the device which scanned)
+ * bss_infos - results of wifi_scan_all
+ * bss_infos_length - the number of results
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_arrow_append(struct wifi_arrow_writer *writer, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Write rows appended so far as record batch (possibly shorter than batch_rows)
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_arrow_flush(struct wifi_arrow_writer *writer);
+
+/* Write the remaining rows and the file footer, close the file and free the writer
+ *
+ * The file can't be read with random access (as Arrow file) until it is finished.
+ *
+ * parameters:
+ * writer - initialized with wifi_arrow_create, it is freed even on error
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_arrow_finish(struct wifi_arrow_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
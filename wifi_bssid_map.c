@@ -0,0 +1,168 @@
+/*
+ * wifi-scan library BSSID map implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * BSSID Map Overview
+  *
+  * BSSIDs are stored densely in the order of ids. Open addressing hash table with linear probing
+  * holds id + 1 (0 for empty slot) and is kept at most half full.
+  *
+  */
+
+#include "wifi_bssid_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// internal data passed around by user
+struct wifi_bssid_map
+{
+  uint8_t (*bssids)[BSSID_LENGTH]; //in the order of ids
+  int count;
+  int capacity;
+  uint32_t *table; //id + 1, 0 for empty slot
+  uint32_t table_size; //power of 2, at least twice the count
+};
+
+// DECLARATIONS
+
+// public interface - empty map
+struct wifi_bssid_map *wifi_bssid_map_new(void);
+// public interface - free map memory
+void wifi_bssid_map_free(struct wifi_bssid_map *map);
+// public interface - find or insert
+int wifi_bssid_map_add(struct wifi_bssid_map *map, const uint8_t bssid[BSSID_LENGTH]);
+// public interface - find
+int wifi_bssid_map_find(const struct wifi_bssid_map *map, const uint8_t bssid[BSSID_LENGTH]);
+// public interface - accessors
+int wifi_bssid_map_size(const struct wifi_bssid_map *map);
+const uint8_t *wifi_bssid_map_bssid(const struct wifi_bssid_map *map, int id);
+// rebuild hash table with twice the size
+static bool map_grow(struct wifi_bssid_map *map);
+// hash table slot for BSSID
+static uint32_t hash_bssid(const uint8_t bssid[BSSID_LENGTH], uint32_t table_size);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_bssid_map *wifi_bssid_map_new(void)
+{
+  return calloc(sizeof(struct wifi_bssid_map), 1);
+}
+
+// public interface
+void wifi_bssid_map_free(struct wifi_bssid_map *map)
+{
+  if (map == NULL)
+    return;
+
+  free(map->bssids);
+  free(map->table);
+  free(map);
+}
+
+// public interface
+//
+// prerequisities:
+// - map created with wifi_bssid_map_new
+int wifi_bssid_map_add(struct wifi_bssid_map *map, const uint8_t bssid[BSSID_LENGTH])
+{
+  int id = wifi_bssid_map_find(map, bssid);
+  uint32_t slot;
+
+  if (id != -1)
+    return id;
+
+  //keep the table at most half full
+  if (2 * (map->count + 1) > (int)map->table_size && !map_grow(map))
+    return -1;
+
+  if (map->count == map->capacity)
+  {
+    int capacity = map->capacity ? 2 * map->capacity : 64;
+    uint8_t (*grown)[BSSID_LENGTH] = realloc(map->bssids, capacity * BSSID_LENGTH);
+    if (grown == NULL)
+      return -1;
+    map->bssids = grown;
+    map->capacity = capacity;
+  }
+
+  for (slot = hash_bssid(bssid, map->table_size); map->table[slot]; slot = (slot + 1) & (map->table_size - 1))
+    ;
+
+  memcpy(map->bssids[map->count], bssid, BSSID_LENGTH);
+  map->table[slot] = map->count + 1;
+
+  return map->count++;
+}
+
+// public interface
+int wifi_bssid_map_find(const struct wifi_bssid_map *map, const uint8_t bssid[BSSID_LENGTH])
+{
+  uint32_t slot;
+
+  if (map->table_size == 0)
+    return -1;
+
+  for (slot = hash_bssid(bssid, map->table_size); map->table[slot]; slot = (slot + 1) & (map->table_size - 1))
+    if (memcmp(map->bssids[map->table[slot] - 1], bssid, BSSID_LENGTH) == 0)
+      return map->table[slot] - 1;
+
+  return -1;
+}
+
+// public interface
+int wifi_bssid_map_size(const struct wifi_bssid_map *map)
+{
+  return map->count;
+}
+
+// public interface
+const uint8_t *wifi_bssid_map_bssid(const struct wifi_bssid_map *map, int id)
+{
+  if (id < 0 || id >= map->count)
+    return NULL;
+  return map->bssids[id];
+}
+
+static bool map_grow(struct wifi_bssid_map *map)
+{
+  uint32_t table_size = map->table_size ? 2 * map->table_size : 256;
+  uint32_t *table = calloc(table_size, sizeof(uint32_t));
+  uint32_t slot;
+  int i;
+
+  if (table == NULL)
+    return false;
+
+  for (i = 0; i < map->count; ++i)
+  {
+    for (slot = hash_bssid(map->bssids[i], table_size); table[slot]; slot = (slot + 1) & (table_size - 1))
+      ;
+    table[slot] = i + 1;
+  }
+
+  free(map->table);
+  map->table = table;
+  map->table_size = table_size;
+  return true;
+}
+
+static uint32_t hash_bssid(const uint8_t bssid[BSSID_LENGTH], uint32_t table_size)
+{
+  uint64_t key = 0;
+
+  memcpy(&key, bssid, BSSID_LENGTH);
+  //multiplicative hashing, the high bits are well mixed
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (table_size - 1);
+}
@@ -0,0 +1,66 @@
+/*
+ * wifi-scan library BSSID map header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Interning of BSSIDs to dense ids (0, 1, 2, ... in the order of first appearance)
+ *
+ * Ids may be used to index arrays (e.g. columns, per BSSID state) instead of hashing
+ * BSSIDs again and again. The lookup is a single probe of open addressing hash table typically.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+// internal data used by the functions
+struct wifi_bssid_map;
+
+/* Create empty map
+ *
+ * returns:
+ * struct wifi_bssid_map * - pass it to the map functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_bssid_map *wifi_bssid_map_new(void);
+
+/* Free the map */
+void wifi_bssid_map_free(struct wifi_bssid_map *map);
+
+/* Get id of BSSID, adding it if not present
+ *
+ * returns:
+ * -1 on error (errno is set) or id of BSSID
+ */
+int wifi_bssid_map_add(struct wifi_bssid_map *map, const uint8_t bssid[BSSID_LENGTH]);
+
+/* Get id of BSSID
+ *
+ * returns:
+ * -1 if BSSID is not in the map or id of BSSID
+ */
+int wifi_bssid_map_find(const struct wifi_bssid_map *map, const uint8_t bssid[BSSID_LENGTH]);
+
+/* Get the number of BSSIDs (ids are from 0 to size - 1) */
+int wifi_bssid_map_size(const struct wifi_bssid_map *map);
+
+/* Get BSSID of id
+ *
+ * returns:
+ * BSSID_LENGTH bytes valid until next wifi_bssid_map_add or NULL if id is out of range
+ */
+const uint8_t *wifi_bssid_map_bssid(const struct wifi_bssid_map *map, int id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,591 @@
+/*
+ * wifi-scan library channel selection implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Channel Selection Overview
+  *
+  * Spectrum is split into 5 MHz bins (2.4 GHz from 2402 MHz, 5 and 6 GHz from 4900 MHz so that
+  * channel edges are bin edges). Each neighbour BSS adds its power density (aW per bin, integer
+  * so that removal is exact) to the bins of its occupied channel and counts its primary channel.
+  * Both are kept in Fenwick trees - update of bin and sum of bin range take O(log bins).
+  *
+  * BSS contribution is remembered by BSSID, new scan only replaces contributions that changed
+  * and removes BSSes not seen for max_age_scans. Ranking sums the bins of each candidate
+  * (and of its 20 MHz channels for the primary) and sorts the candidates.
+  *
+  */
+
+#include "wifi_channel_select.h"
+#include "wifi_bssid_map.h"
+#include "wifi_mb.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+enum channel_select_constants {BIN_MHZ=5, FREQUENCY_2GHZ_MIN=2402, FREQUENCY_2GHZ_MAX=2497, FREQUENCY_MIN=4900, FREQUENCY_MAX=7125,
+	BINS_2GHZ=(FREQUENCY_2GHZ_MAX - FREQUENCY_2GHZ_MIN) / BIN_MHZ, BINS=BINS_2GHZ + (FREQUENCY_MAX - FREQUENCY_MIN) / BIN_MHZ,
+	MAX_SEGMENTS=2, FLOOR_MBM=-12000, ATTOWATT_MBM=-15000, BUSY_UNKNOWN=-1};
+
+// regulatory channel
+struct select_channel
+{
+  uint32_t frequency;
+  uint8_t flags;
+  int32_t max_power_mbm;
+  int8_t busy_percent; //from the last survey reporting it, -1 if unknown
+};
+
+struct select_candidate
+{
+  uint32_t center;
+  uint16_t width;
+  uint16_t low_bin; //[low_bin, high_bin)
+  uint16_t high_bin;
+  int first; //index of the lowest 20 MHz channel
+  int count; //of 20 MHz channels
+  int32_t max_power_mbm;
+};
+
+// contribution of BSS to spectrum
+struct select_bss
+{
+  uint64_t density; //aW per bin
+  uint16_t low[MAX_SEGMENTS]; //bins
+  uint16_t high[MAX_SEGMENTS];
+  uint8_t segments;
+  int16_t primary_bin; //-1 if outside of bins
+  uint32_t last_scan;
+  bool active;
+};
+
+// internal data passed around by user
+struct wifi_channel_select
+{
+  struct wifi_channel_select_config config;
+  struct select_channel *channels; //ascending frequency
+  int channels_count;
+  struct select_candidate *candidates;
+  struct wifi_channel_choice *ranked; //of all candidates
+  int candidates_count;
+  struct wifi_bssid_map *bssids;
+  struct select_bss *bss; //by BSSID id
+  int bss_capacity;
+  int *active; //ids of BSSes contributing
+  int active_count;
+  int active_capacity;
+  uint32_t scans;
+  uint64_t power[BINS + 1]; //Fenwick tree of aW per bin (modulo arithmetic, removal is exact)
+  uint32_t primaries[BINS + 1]; //Fenwick tree of BSS primary channels per bin
+};
+
+// DECLARATIONS
+
+// public interface - selection for regulatory domain
+struct wifi_channel_select *wifi_channel_select_new(const struct wifi_channel *channels, int channels_length, const struct wifi_channel_select_config *config);
+// public interface - free selection memory
+void wifi_channel_select_free(struct wifi_channel_select *select);
+// public interface - incremental updates
+int wifi_channel_select_add_scan(struct wifi_channel_select *select, const struct bss_info *bss_infos, int bss_infos_length);
+int wifi_channel_select_add_survey(struct wifi_channel_select *select, const struct channel_survey *surveys, int surveys_length);
+// public interface - ranking
+int wifi_channel_select_rank(struct wifi_channel_select *select, struct wifi_channel_choice *choices, int choices_length);
+
+// CANDIDATE HELPERS
+
+// candidates of configured width from allowed channels
+static bool candidates_build(struct wifi_channel_select *select);
+// index of channel with frequency or -1
+static int channel_index(const struct wifi_channel_select *select, uint32_t frequency);
+// qsort comparator of channels by frequency
+static int compare_channels(const void *a, const void *b);
+// cost of bin range with busy time, fills choice
+static void range_cost(const struct wifi_channel_select *select, int low_bin, int high_bin, int first, int count, struct wifi_channel_choice *choice);
+// qsort comparator of choices by cost
+static int compare_choices(const void *a, const void *b);
+
+// NEIGHBOUR HELPERS
+
+// contribution of BSS, false if outside of spectrum
+static bool bss_contribution(const struct bss_info *bss_info, struct select_bss *bss);
+// add (sign 1) or remove (sign -1) contribution of BSS
+static void bss_apply(struct wifi_channel_select *select, const struct select_bss *bss, int sign);
+// make room for BSS ids up to count
+static bool bss_grow(struct wifi_channel_select *select, int count);
+// bin of frequency in MHz, -1 outside of bins
+static int frequency_bin(uint32_t frequency);
+// signal in aW
+static uint64_t mbm_to_aw(int32_t signal_mbm);
+
+// FENWICK TREES
+
+static void fenwick_add64(uint64_t *tree, int bin, uint64_t delta);
+// sum of bins [0, end)
+static uint64_t fenwick_sum64(const uint64_t *tree, int end);
+static void fenwick_add32(uint32_t *tree, int bin, uint32_t delta);
+static uint32_t fenwick_sum32(const uint32_t *tree, int end);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_channel_select *wifi_channel_select_new(const struct wifi_channel *channels, int channels_length, const struct wifi_channel_select_config *config)
+{
+  struct wifi_channel_select_config defaults = {80, WIFI_CHANNEL_NO_IR | WIFI_CHANNEL_RADAR, 3, -9500, 1, 1, 10};
+  struct wifi_channel_select *select;
+  int i;
+
+  if (config == NULL)
+    config = &defaults;
+
+  if ((config->width_mhz != 20 && config->width_mhz != 40 && config->width_mhz != 80 && config->width_mhz != 160) ||
+      config->max_age_scans < 1 || channels_length < 0 || (channels_length > 0 && channels == NULL))
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if ((select = calloc(sizeof(struct wifi_channel_select), 1)) == NULL)
+    return NULL;
+
+  select->config = *config;
+
+  if ((select->bssids = wifi_bssid_map_new()) == NULL ||
+      (channels_length && (select->channels = malloc(channels_length * sizeof(struct select_channel))) == NULL))
+  {
+    wifi_channel_select_free(select);
+    return NULL;
+  }
+
+  for (i = 0; i < channels_length; ++i)
+  {
+    select->channels[i].frequency = channels[i].frequency;
+    select->channels[i].flags = channels[i].flags;
+    select->channels[i].max_power_mbm = channels[i].max_power_mbm;
+    select->channels[i].busy_percent = BUSY_UNKNOWN;
+  }
+
+  select->channels_count = channels_length;
+  qsort(select->channels, channels_length, sizeof(struct select_channel), compare_channels);
+
+  if (!candidates_build(select))
+  {
+    wifi_channel_select_free(select);
+    return NULL;
+  }
+
+  return select;
+}
+
+// public interface
+void wifi_channel_select_free(struct wifi_channel_select *select)
+{
+  if (select == NULL)
+    return;
+
+  wifi_bssid_map_free(select->bssids);
+  free(select->channels);
+  free(select->candidates);
+  free(select->ranked);
+  free(select->bss);
+  free(select->active);
+  free(select);
+}
+
+// public interface
+int wifi_channel_select_add_scan(struct wifi_channel_select *select, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  int i, id;
+
+  if (bss_infos_length < 0 || (bss_infos_length > 0 && bss_infos == NULL))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ++select->scans;
+
+  for (i = 0; i < bss_infos_length; ++i)
+  {
+    struct select_bss contribution;
+    struct select_bss *bss;
+
+    //nontransmitted BSS shares the radio (and airtime) of its transmitted BSS
+    if ((bss_infos[i].multiple_bssid & BSS_MULTIPLE_BSSID_NONTRANSMITTED) && memcmp(bss_infos[i].transmitter_bssid, bss_infos[i].bssid, BSSID_LENGTH))
+      continue;
+
+    if (!bss_contribution(&bss_infos[i], &contribution))
+      continue;
+
+    if ((id = wifi_bssid_map_add(select->bssids, bss_infos[i].bssid)) == -1 || !bss_grow(select, id + 1))
+      return -1;
+
+    bss = &select->bss[id];
+
+    if (!bss->active)
+    {
+      if (select->active_count == select->active_capacity)
+      {
+        int capacity = select->active_capacity ? 2 * select->active_capacity : 64;
+        int *active = realloc(select->active, capacity * sizeof(int));
+        if (active == NULL)
+          return -1;
+        select->active = active;
+        select->active_capacity = capacity;
+      }
+      select->active[select->active_count++] = id;
+    }
+    else if (bss->density != contribution.density || bss->segments != contribution.segments || bss->primary_bin != contribution.primary_bin ||
+             memcmp(bss->low, contribution.low, sizeof(bss->low)) || memcmp(bss->high, contribution.high, sizeof(bss->high)))
+      bss_apply(select, bss, -1);
+    else
+    { //the same as before, nothing to update
+      bss->last_scan = select->scans;
+      continue;
+    }
+
+    *bss = contribution;
+    bss->active = true;
+    bss->last_scan = select->scans;
+    bss_apply(select, bss, 1);
+  }
+
+  //forget BSSes not seen for max_age_scans
+  for (i = 0; i < select->active_count; )
+  {
+    struct select_bss *bss = &select->bss[select->active[i]];
+
+    if (select->scans - bss->last_scan < (uint32_t)select->config.max_age_scans)
+    {
+      ++i;
+      continue;
+    }
+
+    bss_apply(select, bss, -1);
+    bss->active = false;
+    select->active[i] = select->active[--select->active_count];
+  }
+
+  return 0;
+}
+
+// public interface
+int wifi_channel_select_add_survey(struct wifi_channel_select *select, const struct channel_survey *surveys, int surveys_length)
+{
+  int i, index;
+
+  if (surveys_length < 0 || (surveys_length > 0 && surveys == NULL))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < surveys_length; ++i)
+    if (surveys[i].busy_percent >= 0 && (index = channel_index(select, surveys[i].frequency)) != -1)
+      select->channels[index].busy_percent = surveys[i].busy_percent;
+
+  return 0;
+}
+
+// public interface
+int wifi_channel_select_rank(struct wifi_channel_select *select, struct wifi_channel_choice *choices, int choices_length)
+{
+  int c, k;
+
+  for (c = 0; c < select->candidates_count; ++c)
+  {
+    const struct select_candidate *candidate = &select->candidates[c];
+    struct wifi_channel_choice *choice = &select->ranked[c], primary;
+    int32_t best = 0;
+
+    range_cost(select, candidate->low_bin, candidate->high_bin, candidate->first, candidate->count, choice);
+    choice->center_frequency = candidate->center;
+    choice->width_mhz = candidate->width;
+    choice->max_power_mbm = candidate->max_power_mbm;
+    choice->primary_frequency = select->channels[candidate->first].frequency;
+
+    //primary is the least congested 20 MHz channel
+    for (k = 0; k < candidate->count && candidate->count > 1; ++k)
+    {
+      int low_bin = candidate->low_bin + k * 20 / BIN_MHZ;
+
+      range_cost(select, low_bin, low_bin + 20 / BIN_MHZ, candidate->first + k, 1, &primary);
+
+      if (k == 0 || primary.cost < best)
+      {
+        best = primary.cost;
+        choice->primary_frequency = select->channels[candidate->first + k].frequency;
+      }
+    }
+  }
+
+  qsort(select->ranked, select->candidates_count, sizeof(struct wifi_channel_choice), compare_choices);
+
+  if (choices_length > 0)
+    memcpy(choices, select->ranked, (choices_length < select->candidates_count ? choices_length : select->candidates_count) * sizeof(struct wifi_channel_choice));
+
+  return select->candidates_count;
+}
+
+// 2.4 GHz candidates are 20 MHz at each channel, 5 and 6 GHz are aligned blocks of allowed 20 MHz channels
+static bool candidates_build(struct wifi_channel_select *select)
+{
+  const uint8_t exclude = select->config.exclude_flags | WIFI_CHANNEL_DISABLED;
+  int i, k, count = 0;
+
+  if (select->channels_count == 0)
+    return true;
+
+  select->candidates = malloc(select->channels_count * sizeof(struct select_candidate));
+  select->ranked = malloc(select->channels_count * sizeof(struct wifi_channel_choice));
+
+  if (select->candidates == NULL || select->ranked == NULL)
+    return false;
+
+  for (i = 0; i < select->channels_count; ++i)
+  {
+    const struct select_channel *channel = &select->channels[i];
+    struct select_candidate *candidate = &select->candidates[count];
+    int width = channel->frequency < FREQUENCY_2GHZ_MAX ? 20 : select->config.width_mhz;
+    int low = (int)channel->frequency - 10, base = channel->frequency >= 5925 ? 5945 : channel->frequency >= 5735 ? 5735 : 5170;
+    int low_bin = frequency_bin(low), high_bin = frequency_bin(low + width);
+
+    if ((channel->flags & exclude) || low_bin == -1 || high_bin == -1 || (width > 20 && (low < base || (low - base) % width)))
+      continue;
+
+    candidate->center = low + width / 2;
+    candidate->width = width;
+    candidate->low_bin = low_bin;
+    candidate->high_bin = high_bin;
+    candidate->first = i;
+    candidate->count = width / 20;
+    candidate->max_power_mbm = channel->max_power_mbm;
+
+    for (k = 1; k < candidate->count && i + k < select->channels_count; ++k)
+    {
+      const struct select_channel *next = &select->channels[i + k];
+
+      if (next->frequency != channel->frequency + 20 * k || (next->flags & exclude))
+        break;
+      if (next->max_power_mbm < candidate->max_power_mbm)
+        candidate->max_power_mbm = next->max_power_mbm;
+    }
+
+    if (k == candidate->count)
+      ++count;
+  }
+
+  select->candidates_count = count;
+  return true;
+}
+
+static int channel_index(const struct wifi_channel_select *select, uint32_t frequency)
+{
+  int low = 0, high = select->channels_count - 1, middle;
+
+  while (low <= high)
+  {
+    middle = low + (high - low) / 2;
+
+    if (select->channels[middle].frequency == frequency)
+      return middle;
+    if (select->channels[middle].frequency < frequency)
+      low = middle + 1;
+    else
+      high = middle - 1;
+  }
+
+  return -1;
+}
+
+static int compare_channels(const void *a, const void *b)
+{
+  const struct select_channel *x = a, *y = b;
+  return (x->frequency > y->frequency) - (x->frequency < y->frequency);
+}
+
+// co-channel BSSes have primary 20 MHz inside, that is primary bin at least 10 MHz from the edges
+static void range_cost(const struct wifi_channel_select *select, int low_bin, int high_bin, int first, int count, struct wifi_channel_choice *choice)
+{
+  const struct wifi_channel_select_config *config = &select->config;
+  const int edge = 10 / BIN_MHZ;
+  uint64_t power = fenwick_sum64(select->power, high_bin) - fenwick_sum64(select->power, low_bin);
+  int k, busy_sum = 0, busy_count = 0;
+  int32_t above;
+
+  choice->interference_mbm = power ? wifi_log10_mb(power) + ATTOWATT_MBM : FLOOR_MBM;
+  if (choice->interference_mbm < FLOOR_MBM)
+    choice->interference_mbm = FLOOR_MBM;
+  choice->cochannel = fenwick_sum32(select->primaries, high_bin - edge + 1) - fenwick_sum32(select->primaries, low_bin + edge);
+
+  for (k = 0; k < count; ++k)
+    if (select->channels[first + k].busy_percent >= 0)
+    {
+      busy_sum += select->channels[first + k].busy_percent;
+      ++busy_count;
+    }
+
+  choice->busy_percent = busy_count ? busy_sum / busy_count : BUSY_UNKNOWN;
+
+  above = choice->interference_mbm > config->noise_floor_mbm ? choice->interference_mbm - config->noise_floor_mbm : 0;
+
+  choice->cost = config->interference_weight * above / 100 + config->cochannel_weight * (int32_t)choice->cochannel;
+  if (choice->busy_percent > 0)
+    choice->cost += config->busy_weight * choice->busy_percent;
+}
+
+// ties go to lower frequency
+static int compare_choices(const void *a, const void *b)
+{
+  const struct wifi_channel_choice *x = a, *y = b;
+
+  if (x->cost != y->cost)
+    return x->cost < y->cost ? -1 : 1;
+
+  return (x->center_frequency > y->center_frequency) - (x->center_frequency < y->center_frequency);
+}
+
+// the same occupied channel as spectrum interference map (see wifi_spectrum.h)
+static bool bss_contribution(const struct bss_info *bss_info, struct select_bss *bss)
+{
+  static const uint16_t SEGMENT_WIDTH_MHZ[] = {20, 40, 80, 160, 80, 320}; //by enum bss_channel_width
+  uint32_t centers[MAX_SEGMENTS] = {bss_info->center_frequency, bss_info->center_frequency2}, width;
+  uint8_t channel_width = bss_info->channel_width;
+  int s;
+
+  memset(bss, 0, sizeof(struct select_bss));
+
+  //older records without occupied channel
+  if (centers[0] == 0 || channel_width > BSS_CHANNEL_WIDTH_320)
+  {
+    centers[0] = bss_info->frequency;
+    channel_width = BSS_CHANNEL_WIDTH_20;
+  }
+
+  width = SEGMENT_WIDTH_MHZ[channel_width];
+
+  //the part of channel beyond the band edge is lost
+  for (s = 0; s < (channel_width == BSS_CHANNEL_WIDTH_80P80 ? MAX_SEGMENTS : 1); ++s)
+  {
+    uint32_t min = centers[s] < FREQUENCY_MIN ? FREQUENCY_2GHZ_MIN : FREQUENCY_MIN, max = centers[s] < FREQUENCY_MIN ? FREQUENCY_2GHZ_MAX : FREQUENCY_MAX;
+    uint32_t low = centers[s] > min + width / 2 ? centers[s] - width / 2 : min, high = centers[s] + width / 2 < max ? centers[s] + width / 2 : max;
+
+    if (low >= high)
+      continue;
+
+    bss->low[bss->segments] = frequency_bin(low);
+    bss->high[bss->segments] = frequency_bin(high);
+    ++bss->segments;
+  }
+
+  if (bss->segments == 0)
+    return false;
+
+  //power is spread evenly over the whole channel
+  bss->density = mbm_to_aw(bss_info->signal_mbm) * BIN_MHZ / (width * (channel_width == BSS_CHANNEL_WIDTH_80P80 ? 2 : 1));
+  bss->primary_bin = frequency_bin(bss_info->frequency);
+  return true;
+}
+
+static void bss_apply(struct wifi_channel_select *select, const struct select_bss *bss, int sign)
+{
+  uint64_t density = sign > 0 ? bss->density : 0 - bss->density;
+  int s, bin;
+
+  for (s = 0; s < bss->segments; ++s)
+    for (bin = bss->low[s]; bin < bss->high[s]; ++bin)
+      fenwick_add64(select->power, bin, density);
+
+  if (bss->primary_bin != -1)
+    fenwick_add32(select->primaries, bss->primary_bin, sign > 0 ? 1 : (uint32_t)-1);
+}
+
+static bool bss_grow(struct wifi_channel_select *select, int count)
+{
+  struct select_bss *bss;
+  int capacity = select->bss_capacity ? select->bss_capacity : 64;
+
+  if (count <= select->bss_capacity)
+    return true;
+
+  while (capacity < count)
+    capacity *= 2;
+
+  if ((bss = realloc(select->bss, capacity * sizeof(struct select_bss))) == NULL)
+    return false;
+
+  memset(bss + select->bss_capacity, 0, (capacity - select->bss_capacity) * sizeof(struct select_bss));
+  select->bss = bss;
+  select->bss_capacity = capacity;
+  return true;
+}
+
+// frequencies at the upper edge of band are the end of the last bin
+static int frequency_bin(uint32_t frequency)
+{
+  if (frequency >= FREQUENCY_2GHZ_MIN && frequency <= FREQUENCY_2GHZ_MAX)
+    return (frequency - FREQUENCY_2GHZ_MIN) / BIN_MHZ;
+  if (frequency >= FREQUENCY_MIN && frequency <= FREQUENCY_MAX)
+    return BINS_2GHZ + (frequency - FREQUENCY_MIN) / BIN_MHZ;
+  return -1;
+}
+
+// 1 dB resolution, signal clamped to [-120, 0] dBm, that is [10^3, 10^15] aW
+static uint64_t mbm_to_aw(int32_t signal_mbm)
+{
+  static const uint16_t TENTHS[] = {1000, 1259, 1585, 1995, 2512, 3162, 3981, 5012, 6310, 7943}; //1000 * 10^(i/10)
+  uint64_t aw = 1;
+  int db, i;
+
+  if (signal_mbm > 0)
+    signal_mbm = 0;
+  if (signal_mbm < FLOOR_MBM)
+    signal_mbm = FLOOR_MBM;
+
+  db = (signal_mbm - ATTOWATT_MBM + 50) / 100;
+
+  for (i = 0; i < db / 10; ++i)
+    aw *= 10;
+
+  return aw * TENTHS[db % 10] / 1000;
+}
+
+static void fenwick_add64(uint64_t *tree, int bin, uint64_t delta)
+{
+  for (++bin; bin <= BINS; bin += bin & -bin)
+    tree[bin] += delta;
+}
+
+static uint64_t fenwick_sum64(const uint64_t *tree, int end)
+{
+  uint64_t sum = 0;
+
+  for (; end > 0; end -= end & -end)
+    sum += tree[end];
+
+  return sum;
+}
+
+static void fenwick_add32(uint32_t *tree, int bin, uint32_t delta)
+{
+  for (++bin; bin <= BINS; bin += bin & -bin)
+    tree[bin] += delta;
+}
+
+static uint32_t fenwick_sum32(const uint32_t *tree, int end)
+{
+  uint32_t sum = 0;
+
+  for (; end > 0; end -= end & -end)
+    sum += tree[end];
+
+  return sum;
+}
@@ -0,0 +1,112 @@
+/*
+ * wifi-scan library channel selection header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Recommend the least congested channel for your own AP
+ *
+ * Candidates are channels of configured width allowed by regulatory domain (see wifi_scan_channels),
+ * aligned the 802.11 way (5 GHz blocks from channel 36 and 149, 6 GHz from channel 1).
+ * 2.4 GHz candidates are always 20 MHz wide.
+ *
+ * Cost of candidate (lower is better) combines:
+ * - interference - neighbour BSSes power received within the candidate, each BSS spreads its signal
+ *   evenly over its occupied channel (center_frequency and channel_width of struct bss_info)
+ * - busy time - mean survey busy_percent of candidate 20 MHz channels (see wifi_scan_survey)
+ * - co-channel BSSes - neighbours with primary channel inside the candidate contend for the medium
+ *
+ * cost = interference_weight * dB above noise floor + busy_weight * busy percent + cochannel_weight * co-channel BSSes
+ *
+ * Scans and surveys update the state incrementally (only BSSes that changed), ranking is computed
+ * from pre-aggregated spectrum in microseconds. Leave your own BSSes out of the scans.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+struct wifi_channel_select_config
+{
+	uint16_t width_mhz; //of candidates, 20, 40, 80 or 160
+	uint8_t exclude_flags; //enum wifi_channel_flags of channels never recommended, disabled channels are always excluded
+	int max_age_scans; //BSS not seen in that many scans stops counting
+	int32_t noise_floor_mbm; //interference below doesn't count
+	int interference_weight; //cost per dB of interference above noise floor
+	int busy_weight; //cost per percent of busy time
+	int cochannel_weight; //cost per co-channel BSS
+};
+
+struct wifi_channel_choice
+{
+	uint32_t center_frequency; //of the candidate in MHz
+	uint32_t primary_frequency; //the least congested 20 MHz channel of candidate in MHz
+	uint16_t width_mhz;
+	int32_t cost; //lower is better
+	int32_t interference_mbm; //neighbour power received within candidate, -12000 (-120 dBm) if none
+	int8_t busy_percent; //mean of candidate channels with survey, -1 if unknown
+	uint16_t cochannel; //BSSes with primary channel inside the candidate
+	int32_t max_power_mbm; //the lowest regulatory limit of candidate channels
+};
+
+// internal data used by the functions
+struct wifi_channel_select;
+
+/* Create channel selection for the regulatory domain
+ *
+ * parameters:
+ * channels - of the radio, e.g. from wifi_scan_channels
+ * channels_length - the number of channels
+ * config - or NULL for defaults (80 MHz, no NO_IR and RADAR channels, forget after 3 scans,
+ *  noise floor -95 dBm, weights 1 per dB, 1 per percent, 10 per co-channel BSS)
+ *
+ * returns:
+ * struct wifi_channel_select * - pass it to the selection functions or NULL if unsuccessfull (errno is set, EINVAL for wrong width)
+ */
+struct wifi_channel_select *wifi_channel_select_new(const struct wifi_channel *channels, int channels_length, const struct wifi_channel_select_config *config);
+
+/* Free the selection */
+void wifi_channel_select_free(struct wifi_channel_select *select);
+
+/* Update neighbours with scan results
+ *
+ * BSSes with the same signal and channel as before cost nothing, BSSes missing from
+ * max_age_scans consecutive scans are forgotten.
+ * Nontransmitted BSSes linked with their transmitted BSS (see MULTIPLE BSSID in wifi_scan.h)
+ * are the same radio and count once.
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_channel_select_add_scan(struct wifi_channel_select *select, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Update busy time with survey, channels without busy_percent keep the previous value
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_channel_select_add_survey(struct wifi_channel_select *select, const struct channel_survey *surveys, int surveys_length);
+
+/* Get candidates from the least congested
+ *
+ * parameters:
+ * choices - to be filled, choices_length at most
+ *
+ * returns:
+ * the number of candidates, may be greater than choices_length, 0 if the regulatory domain allows none
+ */
+int wifi_channel_select_rank(struct wifi_channel_select *select, struct wifi_channel_choice *choices, int choices_length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,409 @@
+/*
+ * wifi-scan library channel statistics implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Channel Statistics Overview
+  *
+  * Channels and bands are slots - bands are the first WIFI_BANDS slots, channels get the next slots
+  * in the order of appearance. Frequency is mapped to slot by direct lookup table over all the bands.
+  *
+  * Granularity keeps cells of all slots and buckets, cells of the slot are contiguous so that
+  * new slot is appended without moving anything. Bucket of time t is (t / period) % buckets,
+  * it is cleared when it is reused for newer period (epoch).
+  *
+  */
+
+#include "wifi_channel_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// frequencies of 2.4, 5 and 6 GHz bands in MHz, slot + 1 is stored in lookup table (0 for not seen)
+enum channel_stats_frequencies {FREQUENCY_MIN=2400, FREQUENCY_2GHZ_END=2500, FREQUENCY_5GHZ_MIN=4900, FREQUENCY_6GHZ_MIN=5925,
+	FREQUENCY_MAX=7125, FREQUENCY_LOOKUP=FREQUENCY_MAX - FREQUENCY_MIN + 1, MAX_SLOTS=255};
+
+// statistics of slot in single bucket
+struct channel_cell
+{
+  uint32_t bss;
+  int32_t max_signal_mbm; //valid if bss > 0
+  uint32_t signal[WIFI_CHANNEL_STATS_SIGNAL_BINS];
+  uint32_t utilization_samples;
+  uint32_t utilization_sum;
+  uint32_t utilization[WIFI_CHANNEL_STATS_UTILIZATION_BINS];
+  uint32_t stations;
+};
+
+// ring of buckets
+struct channel_granularity
+{
+  struct wifi_channel_granularity config;
+  struct channel_cell *cells; //slot * buckets + bucket
+  uint64_t *epochs; //timestamp / period of each bucket
+  uint32_t *scans; //of each bucket, 0 for unused
+  uint64_t newest; //the most recent epoch
+};
+
+// internal data passed around by user
+struct wifi_channel_stats
+{
+  struct channel_granularity granularities[WIFI_CHANNEL_STATS_MAX_GRANULARITIES];
+  int granularities_count;
+  uint8_t lookup[FREQUENCY_LOOKUP]; //slot + 1 by frequency - FREQUENCY_MIN
+  int slots;
+  int slots_capacity;
+};
+
+// DECLARATIONS
+
+// public interface - empty statistics
+struct wifi_channel_stats *wifi_channel_stats_new(const struct wifi_channel_granularity *granularities, int granularities_length);
+// public interface - free statistics memory
+void wifi_channel_stats_free(struct wifi_channel_stats *stats);
+// public interface - aggregate scan
+int wifi_channel_stats_add(struct wifi_channel_stats *stats, uint64_t timestamp_ms, const struct bss_info *bss_infos, int bss_infos_length);
+// public interface - queries
+int wifi_channel_stats_channels(const struct wifi_channel_stats *stats, uint32_t *frequencies, int frequencies_length);
+int wifi_channel_stats_query(const struct wifi_channel_stats *stats, int granularity, uint32_t frequency, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length);
+int wifi_channel_stats_query_band(const struct wifi_channel_stats *stats, int granularity, enum wifi_band band, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length);
+
+// SLOT HELPERS
+
+// band of frequency or -1 if outside of bands
+static int frequency_band(uint32_t frequency);
+// slot of frequency, added if not seen yet, -1 if outside of bands or no more slots (errno is set on allocation error)
+static int slot_of(struct wifi_channel_stats *stats, uint32_t frequency);
+// make room for slots cells in all granularities, new cells are zeroed
+static bool slots_grow(struct wifi_channel_stats *stats, int slots);
+
+// BUCKET HELPERS
+
+// bucket of timestamp in granularity, cleared if reused, -1 if timestamp is older than kept buckets
+static int bucket_of(struct wifi_channel_stats *stats, struct channel_granularity *granularity, uint64_t timestamp_ms);
+// add BSS to cell
+static void cell_add(struct channel_cell *cell, int32_t signal_mbm, int signal_bin, const struct bss_info *bss);
+// buckets of slot overlapping time range in time order
+static int query_slot(const struct wifi_channel_stats *stats, int granularity, int slot, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_channel_stats *wifi_channel_stats_new(const struct wifi_channel_granularity *granularities, int granularities_length)
+{
+  struct wifi_channel_stats *stats;
+  int g;
+
+  if (granularities_length < 1 || granularities_length > WIFI_CHANNEL_STATS_MAX_GRANULARITIES)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  for (g = 0; g < granularities_length; ++g)
+    if (granularities[g].period_ms == 0 || granularities[g].buckets < 1)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  if ((stats = calloc(sizeof(struct wifi_channel_stats), 1)) == NULL)
+    return NULL;
+
+  for (g = 0; g < granularities_length; ++g)
+  {
+    struct channel_granularity *granularity = &stats->granularities[g];
+    granularity->config = granularities[g];
+    granularity->epochs = calloc(granularities[g].buckets, sizeof(uint64_t));
+    granularity->scans = calloc(granularities[g].buckets, sizeof(uint32_t));
+    stats->granularities_count = g + 1;
+
+    if (granularity->epochs == NULL || granularity->scans == NULL)
+    {
+      wifi_channel_stats_free(stats);
+      return NULL;
+    }
+  }
+
+  //bands are always there
+  if (!slots_grow(stats, WIFI_BANDS))
+  {
+    wifi_channel_stats_free(stats);
+    return NULL;
+  }
+  stats->slots = WIFI_BANDS;
+
+  return stats;
+}
+
+// public interface
+void wifi_channel_stats_free(struct wifi_channel_stats *stats)
+{
+  int g;
+
+  if (stats == NULL)
+    return;
+
+  for (g = 0; g < stats->granularities_count; ++g)
+  {
+    free(stats->granularities[g].cells);
+    free(stats->granularities[g].epochs);
+    free(stats->granularities[g].scans);
+  }
+
+  free(stats);
+}
+
+// public interface
+//
+// prerequisities:
+// - stats created with wifi_channel_stats_new
+int wifi_channel_stats_add(struct wifi_channel_stats *stats, uint64_t timestamp_ms, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  int buckets[WIFI_CHANNEL_STATS_MAX_GRANULARITIES];
+  int g, i;
+
+  //slots first, growing cells must not fail in the middle of the scan
+  for (i = 0; i < bss_infos_length; ++i)
+    if (slot_of(stats, bss_infos[i].frequency) == -1 && errno == ENOMEM)
+      return -1;
+
+  for (g = 0; g < stats->granularities_count; ++g)
+    if ((buckets[g] = bucket_of(stats, &stats->granularities[g], timestamp_ms)) != -1)
+      ++stats->granularities[g].scans[buckets[g]];
+
+  for (i = 0; i < bss_infos_length; ++i)
+  {
+    const struct bss_info *bss = &bss_infos[i];
+    int band = frequency_band(bss->frequency), slot, bin;
+    int32_t dbm;
+
+    if (band == -1)
+      continue;
+
+    slot = stats->lookup[bss->frequency - FREQUENCY_MIN] - 1;
+
+    //floor division for negative signals
+    dbm = bss->signal_mbm >= 0 ? bss->signal_mbm / 100 : -((-bss->signal_mbm + 99) / 100);
+    bin = dbm < WIFI_CHANNEL_STATS_SIGNAL_FLOOR_DBM ? 0 : 1 + (dbm - WIFI_CHANNEL_STATS_SIGNAL_FLOOR_DBM) / WIFI_CHANNEL_STATS_SIGNAL_STEP_DB;
+    if (bin >= WIFI_CHANNEL_STATS_SIGNAL_BINS)
+      bin = WIFI_CHANNEL_STATS_SIGNAL_BINS - 1;
+
+    for (g = 0; g < stats->granularities_count; ++g)
+    {
+      struct channel_granularity *granularity = &stats->granularities[g];
+      int count = granularity->config.buckets;
+
+      if (buckets[g] == -1)
+        continue;
+
+      cell_add(&granularity->cells[band * count + buckets[g]], bss->signal_mbm, bin, bss);
+      if (slot != -1)
+        cell_add(&granularity->cells[slot * count + buckets[g]], bss->signal_mbm, bin, bss);
+    }
+  }
+
+  return 0;
+}
+
+// public interface
+int wifi_channel_stats_channels(const struct wifi_channel_stats *stats, uint32_t *frequencies, int frequencies_length)
+{
+  int i, count = 0;
+
+  //lookup table is ordered by frequency
+  for (i = 0; i < FREQUENCY_LOOKUP; ++i)
+    if (stats->lookup[i])
+    {
+      if (count < frequencies_length)
+        frequencies[count] = FREQUENCY_MIN + i;
+      ++count;
+    }
+
+  return count;
+}
+
+// public interface
+int wifi_channel_stats_query(const struct wifi_channel_stats *stats, int granularity, uint32_t frequency, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length)
+{
+  if (granularity < 0 || granularity >= stats->granularities_count)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (frequency_band(frequency) == -1 || stats->lookup[frequency - FREQUENCY_MIN] == 0)
+    return 0;
+
+  return query_slot(stats, granularity, stats->lookup[frequency - FREQUENCY_MIN] - 1, from_ms, to_ms, rollups, rollups_length);
+}
+
+// public interface
+int wifi_channel_stats_query_band(const struct wifi_channel_stats *stats, int granularity, enum wifi_band band, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length)
+{
+  if (granularity < 0 || granularity >= stats->granularities_count || band < WIFI_BAND_2GHZ || band >= WIFI_BANDS)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return query_slot(stats, granularity, band, from_ms, to_ms, rollups, rollups_length);
+}
+
+static int frequency_band(uint32_t frequency)
+{
+  if (frequency < FREQUENCY_MIN || frequency > FREQUENCY_MAX)
+    return -1;
+  if (frequency < FREQUENCY_2GHZ_END)
+    return WIFI_BAND_2GHZ;
+  if (frequency < FREQUENCY_5GHZ_MIN)
+    return -1;
+  return frequency < FREQUENCY_6GHZ_MIN ? WIFI_BAND_5GHZ : WIFI_BAND_6GHZ;
+}
+
+static int slot_of(struct wifi_channel_stats *stats, uint32_t frequency)
+{
+  uint8_t *entry;
+
+  errno = 0;
+
+  if (frequency_band(frequency) == -1)
+    return -1;
+
+  entry = &stats->lookup[frequency - FREQUENCY_MIN];
+
+  if (*entry)
+    return *entry - 1;
+
+  if (stats->slots == MAX_SLOTS)
+    return -1;
+
+  if (stats->slots == stats->slots_capacity && !slots_grow(stats, 2 * stats->slots_capacity))
+  {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  *entry = stats->slots + 1;
+  return stats->slots++;
+}
+
+static bool slots_grow(struct wifi_channel_stats *stats, int slots)
+{
+  int g;
+
+  if (slots > MAX_SLOTS)
+    slots = MAX_SLOTS;
+
+  for (g = 0; g < stats->granularities_count; ++g)
+  {
+    struct channel_granularity *granularity = &stats->granularities[g];
+    size_t buckets = granularity->config.buckets;
+    struct channel_cell *grown = realloc(granularity->cells, slots * buckets * sizeof(struct channel_cell));
+
+    if (grown == NULL)
+      return false;
+
+    memset(grown + stats->slots_capacity * buckets, 0, (slots - stats->slots_capacity) * buckets * sizeof(struct channel_cell));
+    granularity->cells = grown;
+  }
+
+  stats->slots_capacity = slots;
+  return true;
+}
+
+static int bucket_of(struct wifi_channel_stats *stats, struct channel_granularity *granularity, uint64_t timestamp_ms)
+{
+  uint64_t epoch = timestamp_ms / granularity->config.period_ms;
+  int buckets = granularity->config.buckets, bucket = epoch % buckets, slot;
+
+  if (epoch + buckets <= granularity->newest)
+    return -1;
+
+  if (epoch > granularity->newest)
+    granularity->newest = epoch;
+
+  if (granularity->scans[bucket] && granularity->epochs[bucket] == epoch)
+    return bucket;
+
+  for (slot = 0; slot < stats->slots; ++slot)
+    memset(&granularity->cells[slot * buckets + bucket], 0, sizeof(struct channel_cell));
+
+  granularity->epochs[bucket] = epoch;
+  granularity->scans[bucket] = 0;
+  return bucket;
+}
+
+static void cell_add(struct channel_cell *cell, int32_t signal_mbm, int signal_bin, const struct bss_info *bss)
+{
+  if (cell->bss == 0 || signal_mbm > cell->max_signal_mbm)
+    cell->max_signal_mbm = signal_mbm;
+
+  ++cell->bss;
+  ++cell->signal[signal_bin];
+
+  if (bss->channel_utilization >= 0)
+  {
+    ++cell->utilization_samples;
+    cell->utilization_sum += bss->channel_utilization;
+    ++cell->utilization[bss->channel_utilization * WIFI_CHANNEL_STATS_UTILIZATION_BINS / 256];
+    cell->stations += bss->station_count;
+  }
+}
+
+static int query_slot(const struct wifi_channel_stats *stats, int granularity, int slot, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length)
+{
+  const struct channel_granularity *g = &stats->granularities[granularity];
+  uint64_t period = g->config.period_ms, epoch;
+  int buckets = g->config.buckets, count = 0;
+
+  if (from_ms >= to_ms)
+    return 0;
+
+  //only epochs overlapping time range and kept in ring
+  epoch = from_ms / period;
+  if (epoch + buckets <= g->newest)
+    epoch = g->newest - buckets + 1;
+
+  for (; epoch <= g->newest && epoch * period < to_ms; ++epoch)
+  {
+    int bucket = epoch % buckets;
+    const struct channel_cell *cell = &g->cells[slot * buckets + bucket];
+
+    if (g->scans[bucket] == 0 || g->epochs[bucket] != epoch)
+      continue;
+
+    if (count < rollups_length)
+    {
+      struct wifi_channel_rollup *rollup = &rollups[count];
+
+      rollup->start_ms = epoch * period;
+      rollup->scans = g->scans[bucket];
+      rollup->bss = cell->bss;
+      rollup->max_signal_mbm = cell->bss ? cell->max_signal_mbm : 0;
+      memcpy(rollup->signal, cell->signal, sizeof(rollup->signal));
+      rollup->utilization_samples = cell->utilization_samples;
+      rollup->utilization_sum = cell->utilization_sum;
+      memcpy(rollup->utilization, cell->utilization, sizeof(rollup->utilization));
+      rollup->stations = cell->stations;
+    }
+    ++count;
+  }
+
+  return count;
+}
@@ -0,0 +1,118 @@
+/*
+ * wifi-scan library channel statistics header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Rolling per channel and per band rollups of scan results for RF planning and dashboards
+ *
+ * Each granularity (e.g. minute, hour, day) keeps a ring of buckets covering the most recent
+ * buckets * period_ms of time. Every scan is added to the current bucket of all granularities at once,
+ * so queries read pre-aggregated buckets instead of raw scans.
+ *
+ * Bucket of channel (or band) holds the number of BSSes summed over scans (divide by scans for mean AP count),
+ * histogram of BSS signals in WIFI_CHANNEL_STATS_SIGNAL_STEP_DB bins from WIFI_CHANNEL_STATS_SIGNAL_FLOOR_DBM
+ * and histogram of channel utilization advertised in BSS Load elements.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+// signal bin 0 takes anything below the floor, bin i > 0 signals from floor + (i - 1) * step dBm up (the last one anything above)
+// utilization bins are 10% wide (the last one is 90-100%)
+enum wifi_channel_stats_constants {WIFI_CHANNEL_STATS_SIGNAL_BINS=16, WIFI_CHANNEL_STATS_SIGNAL_FLOOR_DBM=-95, WIFI_CHANNEL_STATS_SIGNAL_STEP_DB=5,
+	WIFI_CHANNEL_STATS_UTILIZATION_BINS=10, WIFI_CHANNEL_STATS_MAX_GRANULARITIES=8};
+
+enum wifi_band {WIFI_BAND_2GHZ=0, WIFI_BAND_5GHZ=1, WIFI_BAND_6GHZ=2, WIFI_BANDS=3};
+
+// e.g. {60000, 60} for the last hour by minute
+struct wifi_channel_granularity
+{
+	uint64_t period_ms; //time covered by single bucket
+	int buckets; //the number of most recent buckets kept
+};
+
+struct wifi_channel_rollup
+{
+	uint64_t start_ms; //the bucket covers [start_ms, start_ms + period_ms)
+	uint32_t scans; //scans added to the bucket (of any channel)
+	uint32_t bss; //BSSes on channel summed over scans, bss / scans is mean AP count
+	int32_t max_signal_mbm; //the strongest BSS, 0 if there were none
+	uint32_t signal[WIFI_CHANNEL_STATS_SIGNAL_BINS]; //histogram of BSS signals
+	uint32_t utilization_samples; //BSSes advertising BSS Load
+	uint32_t utilization_sum; //of channel utilization (0-255), divide by samples for mean
+	uint32_t utilization[WIFI_CHANNEL_STATS_UTILIZATION_BINS]; //histogram of channel utilization
+	uint32_t stations; //associated stations from BSS Load summed over samples
+};
+
+// internal data used by the functions
+struct wifi_channel_stats;
+
+/* Create empty statistics
+ *
+ * parameters:
+ * granularities - at most WIFI_CHANNEL_STATS_MAX_GRANULARITIES of them
+ * granularities_length - the number of granularities
+ *
+ * returns:
+ * struct wifi_channel_stats * - pass it to the statistics functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_channel_stats *wifi_channel_stats_new(const struct wifi_channel_granularity *granularities, int granularities_length);
+
+/* Free the statistics */
+void wifi_channel_stats_free(struct wifi_channel_stats *stats);
+
+/* Add scan results to the current buckets
+ *
+ * Scans older than the oldest bucket kept by granularity are not added to that granularity.
+ * BSSes with frequency outside of 2.4, 5 and 6 GHz bands are ignored.
+ *
+ * parameters:
+ * timestamp_ms - of the scan (e.g. CLOCK_REALTIME)
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_channel_stats_add(struct wifi_channel_stats *stats, uint64_t timestamp_ms, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Get frequencies (MHz) of the channels seen so far in ascending order
+ *
+ * returns:
+ * the number of channels, may be greater than frequencies_length
+ */
+int wifi_channel_stats_channels(const struct wifi_channel_stats *stats, uint32_t *frequencies, int frequencies_length);
+
+/* Get buckets of channel in time order
+ *
+ * Buckets without scans are skipped.
+ *
+ * parameters:
+ * granularity - index in granularities passed to wifi_channel_stats_new
+ * frequency - primary channel frequency in MHz
+ * from_ms, to_ms - buckets overlapping [from_ms, to_ms) are returned
+ * rollups - to be filled, rollups_length at most
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for wrong granularity) or the number of buckets, may be greater than rollups_length
+ */
+int wifi_channel_stats_query(const struct wifi_channel_stats *stats, int granularity, uint32_t frequency, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length);
+
+/* Like wifi_channel_stats_query but for all the channels of the band together */
+int wifi_channel_stats_query_band(const struct wifi_channel_stats *stats, int granularity, enum wifi_band band, uint64_t from_ms, uint64_t to_ms,
+	struct wifi_channel_rollup *rollups, int rollups_length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,583 @@
+/*
+ * wifi-scan library fingerprint database implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Fingerprint Database Overview
+  *
+  * References are stored in blocks of WIFI_FINGERPRINT_BLOCK. Block keeps one byte array per column
+  * (allocated only if some reference of the block has seen the BSSID), labels and squared norms.
+  *
+  * Squared distance is computed as |r|^2 + |q|^2 - 2 r.q where the dot product needs
+  * only the columns seen in the query. Kernels accumulate up to 16 columns in 16 bit lanes
+  * (63 * 63 * 16 < 65536) and then widen to 32 bit dot products of the block.
+  *
+  * The k best references are kept in max heap (matches array) while the blocks are scanned.
+  */
+
+#include "wifi_fingerprint.h"
+#include "wifi_bssid_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FINGERPRINT_AVX2
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FINGERPRINT_NEON
+#endif
+
+// columns accumulated by kernel at once without 16 bit overflow
+#define KERNEL_COLUMNS 16
+// kernels process references in multiplies of this
+#define KERNEL_REFS 32
+
+// adds weighted columns to dot products of refs (multiple of KERNEL_REFS) references
+typedef void (*dot_kernel)(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot);
+
+// references from index * WIFI_FINGERPRINT_BLOCK
+struct fingerprint_block
+{
+  uint8_t **columns; //indexed by column id, NULL if no reference in block has seen the BSSID
+  int columns_capacity;
+  uint32_t norms[WIFI_FINGERPRINT_BLOCK]; //squared norm of each reference
+  uint32_t labels[WIFI_FINGERPRINT_BLOCK];
+};
+
+// internal data passed around by user
+struct wifi_fingerprint_db
+{
+  struct wifi_bssid_map *columns;
+  struct fingerprint_block **blocks;
+  int blocks_count;
+  int blocks_capacity;
+  int references;
+  enum wifi_fingerprint_kernel kernel;
+  dot_kernel dot;
+};
+
+// BSSID of fingerprint with its value
+struct fingerprint_value
+{
+  uint8_t bssid[BSSID_LENGTH];
+  uint8_t value;
+  int column; //-1 if not in the database
+};
+
+// DECLARATIONS
+
+// public interface - empty database
+struct wifi_fingerprint_db *wifi_fingerprint_db_new(void);
+// public interface - free database memory
+void wifi_fingerprint_db_free(struct wifi_fingerprint_db *db);
+// public interface - add reference
+int wifi_fingerprint_db_add(struct wifi_fingerprint_db *db, uint32_t label, const struct bss_info *bss, int bss_length);
+// public interface - accessors
+int wifi_fingerprint_db_references(const struct wifi_fingerprint_db *db);
+int wifi_fingerprint_db_columns(const struct wifi_fingerprint_db *db);
+// public interface - k nearest neighbours
+int wifi_fingerprint_db_knn(const struct wifi_fingerprint_db *db, const struct bss_info *bss, int bss_length, struct wifi_fingerprint_match *matches, int k);
+// public interface - kernel selection
+int wifi_fingerprint_db_set_kernel(struct wifi_fingerprint_db *db, enum wifi_fingerprint_kernel kernel);
+const char *wifi_fingerprint_db_kernel(const struct wifi_fingerprint_db *db);
+
+// FINGERPRINT HELPERS
+
+// signal in mBm to stored value
+static uint8_t signal_value(int32_t signal_mbm);
+// allocates values sorted by BSSID without duplicates and values at the floor, -1 on error or the count
+static int fingerprint_values(const struct bss_info *bss, int bss_length, struct fingerprint_value **values);
+// make sure the block for next reference exists and has room for all the columns, NULL on error
+static struct fingerprint_block *reference_block(struct wifi_fingerprint_db *db);
+static int compare_values_bssid(const void *a, const void *b);
+static int compare_values_column(const void *a, const void *b);
+
+// SEARCH HELPERS
+
+// push the match to max heap of matches if it is better than the worst one
+static void heap_offer(struct wifi_fingerprint_match *heap, int *size, int k, const struct wifi_fingerprint_match *match);
+static int compare_matches(const void *a, const void *b);
+
+// KERNELS
+
+static void dot_scalar(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot);
+#ifdef FINGERPRINT_AVX2
+static void dot_avx2(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot);
+#endif
+#ifdef FINGERPRINT_NEON
+static void dot_neon(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot);
+#endif
+// kernel function or NULL if not supported
+static dot_kernel kernel_function(enum wifi_fingerprint_kernel kernel);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_fingerprint_db *wifi_fingerprint_db_new(void)
+{
+  struct wifi_fingerprint_db *db = calloc(sizeof(struct wifi_fingerprint_db), 1);
+
+  if (db == NULL)
+    return NULL;
+
+  if ((db->columns = wifi_bssid_map_new()) == NULL)
+  {
+    free(db);
+    return NULL;
+  }
+
+  wifi_fingerprint_db_set_kernel(db, WIFI_FINGERPRINT_AUTO);
+  return db;
+}
+
+// public interface
+void wifi_fingerprint_db_free(struct wifi_fingerprint_db *db)
+{
+  int b, c;
+
+  if (db == NULL)
+    return;
+
+  for (b = 0; b < db->blocks_count; ++b)
+  {
+    for (c = 0; c < db->blocks[b]->columns_capacity; ++c)
+      free(db->blocks[b]->columns[c]);
+    free(db->blocks[b]->columns);
+    free(db->blocks[b]);
+  }
+
+  free(db->blocks);
+  wifi_bssid_map_free(db->columns);
+  free(db);
+}
+
+// public interface
+//
+// prerequisities:
+// - db created with wifi_fingerprint_db_new
+int wifi_fingerprint_db_add(struct wifi_fingerprint_db *db, uint32_t label, const struct bss_info *bss, int bss_length)
+{
+  struct fingerprint_value *values;
+  struct fingerprint_block *block;
+  int count, i, index = db->references % WIFI_FINGERPRINT_BLOCK;
+  uint32_t norm = 0;
+
+  if ((count = fingerprint_values(bss, bss_length, &values)) == -1)
+    return -1;
+
+  for (i = 0; i < count; ++i)
+    if ((values[i].column = wifi_bssid_map_add(db->columns, values[i].bssid)) == -1)
+      goto fail;
+
+  if ((block = reference_block(db)) == NULL)
+    goto fail;
+
+  //allocate everything first so that failure leaves no partial reference
+  for (i = 0; i < count; ++i)
+    if (block->columns[values[i].column] == NULL && (block->columns[values[i].column] = calloc(WIFI_FINGERPRINT_BLOCK, 1)) == NULL)
+      goto fail;
+
+  for (i = 0; i < count; ++i)
+  {
+    block->columns[values[i].column][index] = values[i].value;
+    norm += values[i].value * values[i].value;
+  }
+
+  block->norms[index] = norm;
+  block->labels[index] = label;
+
+  free(values);
+  return db->references++;
+
+fail:
+  free(values);
+  return -1;
+}
+
+// public interface
+int wifi_fingerprint_db_references(const struct wifi_fingerprint_db *db)
+{
+  return db->references;
+}
+
+// public interface
+int wifi_fingerprint_db_columns(const struct wifi_fingerprint_db *db)
+{
+  return wifi_bssid_map_size(db->columns);
+}
+
+// public interface
+//
+// prerequisities:
+// - db created with wifi_fingerprint_db_new
+// - matches of at least k elements
+int wifi_fingerprint_db_knn(const struct wifi_fingerprint_db *db, const struct bss_info *bss, int bss_length, struct wifi_fingerprint_match *matches, int k)
+{
+  uint32_t dot[WIFI_FINGERPRINT_BLOCK];
+  const uint8_t *columns[KERNEL_COLUMNS];
+  uint8_t weights[KERNEL_COLUMNS];
+  struct fingerprint_value *values;
+  struct wifi_fingerprint_match match;
+  int count, known = 0, found = 0, b, i, n;
+  uint32_t query_norm = 0;
+
+  if (k < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((count = fingerprint_values(bss, bss_length, &values)) == -1)
+    return -1;
+
+  //BSSIDs unknown to database add the same to all the distances
+  for (i = 0; i < count; ++i)
+  {
+    query_norm += values[i].value * values[i].value;
+    if ((values[i].column = wifi_bssid_map_find(db->columns, values[i].bssid)) != -1)
+      values[known++] = values[i];
+  }
+
+  //in the order of columns, closer in memory in the first blocks
+  qsort(values, known, sizeof(struct fingerprint_value), compare_values_column);
+
+  for (b = 0; b < db->blocks_count && k > 0; ++b)
+  {
+    const struct fingerprint_block *block = db->blocks[b];
+    int refs = db->references - b * WIFI_FINGERPRINT_BLOCK;
+
+    if (refs <= 0)
+      break;
+    if (refs > WIFI_FINGERPRINT_BLOCK)
+      refs = WIFI_FINGERPRINT_BLOCK;
+
+    int padded = (refs + KERNEL_REFS - 1) / KERNEL_REFS * KERNEL_REFS;
+
+    memset(dot, 0, padded * sizeof(uint32_t));
+
+    for (i = 0, n = 0; i < known; ++i)
+    {
+      if (values[i].column >= block->columns_capacity || block->columns[values[i].column] == NULL)
+        continue;
+
+      columns[n] = block->columns[values[i].column];
+      weights[n++] = values[i].value;
+
+      if (n == KERNEL_COLUMNS)
+      {
+        db->dot(columns, weights, n, padded, dot);
+        n = 0;
+      }
+    }
+
+    if (n)
+      db->dot(columns, weights, n, padded, dot);
+
+    for (i = 0; i < refs; ++i)
+    {
+      uint32_t distance = block->norms[i] + query_norm - 2 * dot[i];
+
+      //most references are farther than the k-th best, check before filling the match
+      if (found == k && distance >= matches[0].distance)
+        continue;
+
+      match.label = block->labels[i];
+      match.reference = b * WIFI_FINGERPRINT_BLOCK + i;
+      match.distance = distance;
+      heap_offer(matches, &found, k, &match);
+    }
+  }
+
+  free(values);
+
+  qsort(matches, found, sizeof(struct wifi_fingerprint_match), compare_matches);
+  return found;
+}
+
+// public interface
+int wifi_fingerprint_db_set_kernel(struct wifi_fingerprint_db *db, enum wifi_fingerprint_kernel kernel)
+{
+  dot_kernel dot;
+
+  if (kernel == WIFI_FINGERPRINT_AUTO)
+  {
+    if (kernel_function(WIFI_FINGERPRINT_AVX2) != NULL)
+      kernel = WIFI_FINGERPRINT_AVX2;
+    else if (kernel_function(WIFI_FINGERPRINT_NEON) != NULL)
+      kernel = WIFI_FINGERPRINT_NEON;
+    else
+      kernel = WIFI_FINGERPRINT_SCALAR;
+  }
+
+  if ((dot = kernel_function(kernel)) == NULL)
+  {
+    errno = ENOTSUP;
+    return -1;
+  }
+
+  db->kernel = kernel;
+  db->dot = dot;
+  return 0;
+}
+
+// public interface
+const char *wifi_fingerprint_db_kernel(const struct wifi_fingerprint_db *db)
+{
+  switch (db->kernel)
+  {
+    case WIFI_FINGERPRINT_AVX2: return "avx2";
+    case WIFI_FINGERPRINT_NEON: return "neon";
+    default: return "scalar";
+  }
+}
+
+// FINGERPRINT HELPERS
+
+static uint8_t signal_value(int32_t signal_mbm)
+{
+  int32_t value = signal_mbm / 100 - WIFI_FINGERPRINT_FLOOR_DBM;
+
+  if (value < 0)
+    return 0;
+  if (value > WIFI_FINGERPRINT_MAX_VALUE)
+    return WIFI_FINGERPRINT_MAX_VALUE;
+  return value;
+}
+
+static int fingerprint_values(const struct bss_info *bss, int bss_length, struct fingerprint_value **values)
+{
+  struct fingerprint_value *v;
+  int count = 0, i;
+
+  if (bss_length < 0 || (bss_length > 0 && bss == NULL))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  //at least one element so that NULL means error
+  if ((v = malloc((bss_length + 1) * sizeof(struct fingerprint_value))) == NULL)
+    return -1;
+
+  for (i = 0; i < bss_length; ++i)
+  {
+    memcpy(v[count].bssid, bss[i].bssid, BSSID_LENGTH);
+    v[count].value = signal_value(bss[i].signal_mbm);
+    v[count].column = -1;
+    count += v[count].value != 0;
+  }
+
+  qsort(v, count, sizeof(struct fingerprint_value), compare_values_bssid);
+
+  //keep the strongest of the same BSSIDs
+  for (i = 1, bss_length = count, count = count ? 1 : 0; i < bss_length; ++i)
+    if (memcmp(v[count - 1].bssid, v[i].bssid, BSSID_LENGTH) != 0)
+      v[count++] = v[i];
+    else if (v[i].value > v[count - 1].value)
+      v[count - 1].value = v[i].value;
+
+  *values = v;
+  return count;
+}
+
+static struct fingerprint_block *reference_block(struct wifi_fingerprint_db *db)
+{
+  struct fingerprint_block *block;
+  int b = db->references / WIFI_FINGERPRINT_BLOCK, columns = wifi_bssid_map_size(db->columns);
+
+  if (b == db->blocks_count)
+  {
+    if (db->blocks_count == db->blocks_capacity)
+    {
+      int capacity = db->blocks_capacity ? 2 * db->blocks_capacity : 16;
+      struct fingerprint_block **grown = realloc(db->blocks, capacity * sizeof(struct fingerprint_block *));
+      if (grown == NULL)
+        return NULL;
+      db->blocks = grown;
+      db->blocks_capacity = capacity;
+    }
+
+    if ((db->blocks[b] = calloc(sizeof(struct fingerprint_block), 1)) == NULL)
+      return NULL;
+    ++db->blocks_count;
+  }
+
+  block = db->blocks[b];
+
+  if (columns > block->columns_capacity)
+  {
+    int capacity = block->columns_capacity ? block->columns_capacity : 64;
+    uint8_t **grown;
+
+    while (capacity < columns)
+      capacity *= 2;
+
+    if ((grown = realloc(block->columns, capacity * sizeof(uint8_t *))) == NULL)
+      return NULL;
+
+    memset(grown + block->columns_capacity, 0, (capacity - block->columns_capacity) * sizeof(uint8_t *));
+    block->columns = grown;
+    block->columns_capacity = capacity;
+  }
+
+  return block;
+}
+
+static int compare_values_bssid(const void *a, const void *b)
+{
+  return memcmp(((const struct fingerprint_value *)a)->bssid, ((const struct fingerprint_value *)b)->bssid, BSSID_LENGTH);
+}
+
+static int compare_values_column(const void *a, const void *b)
+{
+  return ((const struct fingerprint_value *)a)->column - ((const struct fingerprint_value *)b)->column;
+}
+
+// SEARCH HELPERS
+
+static void heap_offer(struct wifi_fingerprint_match *heap, int *size, int k, const struct wifi_fingerprint_match *match)
+{
+  int i, child;
+
+  //references come in growing order so the equal distance never replaces
+  if (*size == k)
+  {
+    if (match->distance >= heap[0].distance)
+      return;
+
+    for (i = 0; (child = 2 * i + 1) < k; i = child)
+    {
+      if (child + 1 < k && compare_matches(&heap[child + 1], &heap[child]) > 0)
+        ++child;
+      if (compare_matches(&heap[child], match) <= 0)
+        break;
+      heap[i] = heap[child];
+    }
+    heap[i] = *match;
+    return;
+  }
+
+  for (i = (*size)++; i > 0 && compare_matches(&heap[(i - 1) / 2], match) < 0; i = (i - 1) / 2)
+    heap[i] = heap[(i - 1) / 2];
+  heap[i] = *match;
+}
+
+static int compare_matches(const void *a, const void *b)
+{
+  const struct wifi_fingerprint_match *x = a, *y = b;
+
+  if (x->distance != y->distance)
+    return x->distance < y->distance ? -1 : 1;
+  return x->reference - y->reference;
+}
+
+// KERNELS
+
+static void dot_scalar(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot)
+{
+  int c, r;
+
+  for (c = 0; c < n; ++c)
+    for (r = 0; r < refs; ++r)
+      dot[r] += columns[c][r] * weights[c];
+}
+
+#ifdef FINGERPRINT_AVX2
+__attribute__((target("avx2")))
+static void dot_avx2(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot)
+{
+  const uint8_t *a[KERNEL_COLUMNS / 2], *b[KERNEL_COLUMNS / 2];
+  __m256i w[KERNEL_COLUMNS / 2];
+  int c, p, pairs = (n + 1) / 2, r;
+
+  //pairs of columns with interleaved weights (values up to 63 fit signed byte of maddubs),
+  //odd column paired with itself at zero weight
+  for (p = 0, c = 0; p < pairs; ++p, c += 2)
+  {
+    a[p] = columns[c];
+    b[p] = c + 1 < n ? columns[c + 1] : columns[c];
+    w[p] = _mm256_set1_epi16(weights[c] | (c + 1 < n ? weights[c + 1] : 0) << 8);
+  }
+
+  //pair of bytes multiplied and summed into 16 bit lane, interleave within 128 bit halves
+  //so lo accumulates references 0-7 and 16-23, hi 8-15 and 24-31
+  for (r = 0; r < refs; r += 32)
+  {
+    __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+    __m256i *out = (__m256i *)(dot + r);
+
+    for (p = 0; p < pairs; ++p)
+    {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(a[p] + r));
+      __m256i y = _mm256_loadu_si256((const __m256i *)(b[p] + r));
+      //each column is separate 4 KiB array, hardware prefetcher alone lags behind
+      _mm_prefetch((const char *)(a[p] + r + 512), _MM_HINT_T0);
+      _mm_prefetch((const char *)(b[p] + r + 512), _MM_HINT_T0);
+      lo = _mm256_add_epi16(lo, _mm256_maddubs_epi16(_mm256_unpacklo_epi8(x, y), w[p]));
+      hi = _mm256_add_epi16(hi, _mm256_maddubs_epi16(_mm256_unpackhi_epi8(x, y), w[p]));
+    }
+
+    _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(lo))));
+    _mm256_storeu_si256(out + 1, _mm256_add_epi32(_mm256_loadu_si256(out + 1), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(hi))));
+    _mm256_storeu_si256(out + 2, _mm256_add_epi32(_mm256_loadu_si256(out + 2), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(lo, 1))));
+    _mm256_storeu_si256(out + 3, _mm256_add_epi32(_mm256_loadu_si256(out + 3), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(hi, 1))));
+  }
+}
+#endif
+
+#ifdef FINGERPRINT_NEON
+static void dot_neon(const uint8_t * const *columns, const uint8_t *weights, int n, int refs, uint32_t *dot)
+{
+  int c, r;
+
+  //16 bit lanes, two accumulators of 8 references
+  for (r = 0; r < refs; r += 16)
+  {
+    uint16x8_t lo = vdupq_n_u16(0), hi = vdupq_n_u16(0);
+
+    for (c = 0; c < n; ++c)
+    {
+      uint8x16_t v = vld1q_u8(columns[c] + r);
+      lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(v)), weights[c]);
+      hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(v)), weights[c]);
+    }
+
+    vst1q_u32(dot + r, vaddw_u16(vld1q_u32(dot + r), vget_low_u16(lo)));
+    vst1q_u32(dot + r + 4, vaddw_u16(vld1q_u32(dot + r + 4), vget_high_u16(lo)));
+    vst1q_u32(dot + r + 8, vaddw_u16(vld1q_u32(dot + r + 8), vget_low_u16(hi)));
+    vst1q_u32(dot + r + 12, vaddw_u16(vld1q_u32(dot + r + 12), vget_high_u16(hi)));
+  }
+}
+#endif
+
+static dot_kernel kernel_function(enum wifi_fingerprint_kernel kernel)
+{
+  switch (kernel)
+  {
+    case WIFI_FINGERPRINT_SCALAR:
+      return dot_scalar;
+#ifdef FINGERPRINT_AVX2
+    case WIFI_FINGERPRINT_AVX2:
+      return __builtin_cpu_supports("avx2") ? dot_avx2 : NULL;
+#endif
+#ifdef FINGERPRINT_NEON
+    case WIFI_FINGERPRINT_NEON:
+      return dot_neon;
+#endif
+    default:
+      return NULL;
+  }
+}
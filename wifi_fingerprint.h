@@ -0,0 +1,109 @@
+/*
+ * wifi-scan library fingerprint database header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Nearest neighbour search of Wi-Fi fingerprints for localisation
+ *
+ * Fingerprint is the sparse vector of (BSSID, signal) from wifi_scan_all.
+ * Reference fingerprints are added with user label (e.g. id of the surveyed location),
+ * queries return the k references with the smallest euclidean distance.
+ *
+ * Signal is stored as the dB above WIFI_FINGERPRINT_FLOOR_DBM (clamped to 0-63),
+ * BSSID which is not seen is the same as signal at the floor.
+ * BSSIDs are mapped to dense column ids (see wifi_bssid_map.h), references are stored
+ * in blocks of WIFI_FINGERPRINT_BLOCK, column by column, and scored with vectorised
+ * kernels (AVX2, NEON) over the columns seen in the query only.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_fingerprint_constants {WIFI_FINGERPRINT_FLOOR_DBM=-95, WIFI_FINGERPRINT_MAX_VALUE=63, WIFI_FINGERPRINT_BLOCK=4096};
+
+// distance kernels, AUTO picks the fastest supported by CPU
+enum wifi_fingerprint_kernel {WIFI_FINGERPRINT_AUTO=0, WIFI_FINGERPRINT_SCALAR, WIFI_FINGERPRINT_AVX2, WIFI_FINGERPRINT_NEON};
+
+// internal data used by the functions
+struct wifi_fingerprint_db;
+
+// single result of the query
+struct wifi_fingerprint_match
+{
+	uint32_t label; //as passed to wifi_fingerprint_db_add
+	int reference; //index of the reference
+	uint32_t distance; //squared euclidean distance in dB^2
+};
+
+/* Create empty database
+ *
+ * returns:
+ * struct wifi_fingerprint_db * - pass it to the database functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_fingerprint_db *wifi_fingerprint_db_new(void);
+
+/* Free the database */
+void wifi_fingerprint_db_free(struct wifi_fingerprint_db *db);
+
+/* Add reference fingerprint
+ *
+ * BSSID present more than once counts with the strongest signal.
+ *
+ * parameters:
+ * db - database
+ * label - user data returned with matches (e.g. location id)
+ * bss - fingerprint (e.g. from wifi_scan_all)
+ * bss_length - the number of bss elements
+ *
+ * returns:
+ * -1 on error (errno is set) or index of the reference (0, 1, 2, ...)
+ */
+int wifi_fingerprint_db_add(struct wifi_fingerprint_db *db, uint32_t label, const struct bss_info *bss, int bss_length);
+
+/* Get the number of references */
+int wifi_fingerprint_db_references(const struct wifi_fingerprint_db *db);
+
+/* Get the number of columns (distinct BSSIDs in the references) */
+int wifi_fingerprint_db_columns(const struct wifi_fingerprint_db *db);
+
+/* Find k nearest references
+ *
+ * BSSIDs not in the database are accounted for in the distance but don't change the order.
+ *
+ * parameters:
+ * db - database
+ * bss - query fingerprint
+ * bss_length - the number of bss elements
+ * matches - array of at least k elements, filled in the order of growing distance (ties by reference index)
+ * k - the number of neighbours
+ *
+ * returns:
+ * -1 on error (errno is set), the number of matches otherwise (smaller than k if there are fewer references)
+ */
+int wifi_fingerprint_db_knn(const struct wifi_fingerprint_db *db, const struct bss_info *bss, int bss_length, struct wifi_fingerprint_match *matches, int k);
+
+/* Choose distance kernel
+ *
+ * returns:
+ * -1 on error (errno is set, ENOTSUP if kernel is not supported by the build or CPU), 0 on success
+ */
+int wifi_fingerprint_db_set_kernel(struct wifi_fingerprint_db *db, enum wifi_fingerprint_kernel kernel);
+
+/* Get the name of the kernel in use ("scalar", "avx2" or "neon") */
+const char *wifi_fingerprint_db_kernel(const struct wifi_fingerprint_db *db);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,819 @@
+/*
+ * wifi-scan library history store implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * History Overview
+  *
+  * Appends go to snapshot writer of the current segment. When the segment is finished
+  * the archive is mapped back and its index is built from the columns and written next to it.
+  *
+  * Index file layout (host byte order, all sections 8 bytes aligned):
+  * - struct history_index_header
+  * - BSSID keys (struct history_bssid_key) sorted by BSSID
+  * - frequency keys (struct history_frequency_key) sorted by frequency
+  * - BSSID postings (struct history_posting), those of each key sorted by scan and row
+  * - frequency postings (struct history_posting), those of each key sorted by scan and row
+  *
+  * Scans of the archive are in time order so postings of each key are in time order too,
+  * the query binary searches scans by time and then postings by scan.
+  *
+  */
+
+#include "wifi_history.h"
+#include "wifi_snapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h> //va_list
+#include <errno.h>
+#include <limits.h> //PATH_MAX
+#include <fcntl.h> //open
+#include <unistd.h> //close, access
+#include <dirent.h> //opendir
+#include <sys/mman.h> //mmap
+#include <sys/stat.h> //fstat, mkdir
+
+#define HISTORY_INDEX_MAGIC "WSHINDEX"
+
+struct history_index_header
+{
+  char magic[8]; //HISTORY_INDEX_MAGIC without null character
+  uint32_t version; //WIFI_HISTORY_INDEX_VERSION
+  uint32_t scan_count; //of the archive
+  uint64_t postings; //in each of BSSID and frequency postings (BSSes in the archive)
+  uint32_t bssid_keys;
+  uint32_t frequency_keys;
+  uint64_t first_ns; //timestamp of the first scan in archive
+  uint64_t last_ns; //timestamp of the last scan in archive
+  uint8_t reserved[16];
+};
+
+struct history_bssid_key
+{
+  uint8_t bssid[BSSID_LENGTH];
+  uint16_t reserved;
+  uint32_t first; //posting
+  uint32_t count; //of postings
+};
+
+struct history_frequency_key
+{
+  uint32_t frequency;
+  uint32_t first; //posting
+  uint32_t count; //of postings
+  uint32_t reserved;
+};
+
+struct history_posting
+{
+  uint32_t scan;
+  uint32_t row;
+};
+
+// BSS of the archive while building index
+struct history_entry
+{
+  uint8_t bssid[BSSID_LENGTH];
+  uint32_t frequency;
+  uint32_t scan;
+  uint32_t row;
+};
+
+// finished segment, archive and index mapped
+struct history_segment
+{
+  struct wifi_snapshot *snapshot;
+  const char *index; //the whole mapped index file
+  size_t index_length;
+  const struct history_index_header *header;
+  const struct history_bssid_key *bssid_keys;
+  const struct history_frequency_key *frequency_keys;
+  const struct history_posting *bssid_postings;
+  const struct history_posting *frequency_postings;
+};
+
+// internal data passed around by user
+struct wifi_history
+{
+  char directory[PATH_MAX];
+  uint64_t segment_ns;
+  struct history_segment *segments; //finished, in time order
+  int count;
+  int capacity;
+  struct wifi_snapshot_writer *writer; //of the current segment or NULL
+  char writer_path[PATH_MAX]; //of the current segment without extension
+  uint64_t writer_end_ns; //when the current segment time is over
+  uint64_t last_ns; //timestamp of the last stored scan
+};
+
+// DECLARATIONS
+
+// STORE
+
+// public interface - map existing segments, rebuild missing indexes
+struct wifi_history *wifi_history_open(const char *directory, uint64_t segment_ns);
+// public interface - finish current segment, unmap all
+int wifi_history_close(struct wifi_history *history);
+// public interface - append to current segment, start new one if needed
+int wifi_history_append(struct wifi_history *history, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length);
+// public interface - finish current segment
+int wifi_history_flush(struct wifi_history *history);
+// public interface
+int wifi_history_segments(const struct wifi_history *history);
+// create snapshot writer for the segment starting at timestamp
+static int start_segment(struct wifi_history *history, uint64_t timestamp_ns);
+// map the archive and index (building index if needed) and add to segments
+static int add_segment(struct wifi_history *history, const char *path);
+// unmap the segment
+static void close_segment(struct history_segment *segment);
+// order segments by time of the first scan
+static int compare_segments(const void *a, const void *b);
+
+// INDEX
+
+// build index of archive and write it to path
+static int build_index(const struct wifi_snapshot *snapshot, const char *path);
+// map and validate index of archive
+static int map_index(struct history_segment *segment, const char *path);
+// order entries by BSSID, then by position in the archive
+static int compare_bssid_entries(const void *a, const void *b);
+// order entries by frequency, then by position in the archive
+static int compare_frequency_entries(const void *a, const void *b);
+
+// QUERIES
+
+// public interface - query finished segments overlapping the time range
+int wifi_history_query(const struct wifi_history *history, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length);
+// add matching rows of the segment to records
+static int query_segment(const struct history_segment *segment, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length, int *matched);
+// add the row of the scan to records if it matches the query
+static int match_row(const struct history_segment *segment, const struct wifi_snapshot_columns *columns, uint32_t row, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length, int *matched);
+// the first scan not earlier than timestamp or -1 on error
+static int lower_bound_scan(const struct wifi_snapshot *snapshot, uint64_t timestamp_ns);
+// the first posting of scan not smaller than scan
+static uint32_t lower_bound_posting(const struct history_posting *postings, uint32_t count, uint32_t scan);
+
+// HELPERS
+
+// map the whole file, NULL on error
+static const char *map_file(const char *path, size_t *length);
+// printf to PATH_MAX buffer, -1 with ENAMETOOLONG if it doesn't fit
+static int make_path(char *path, const char *format, ...);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// STORE
+
+// public interface
+struct wifi_history *wifi_history_open(const char *directory, uint64_t segment_ns)
+{
+  struct wifi_history *history;
+  struct dirent *entry;
+  char path[PATH_MAX];
+  DIR *dir;
+
+  if (segment_ns == 0)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (mkdir(directory, 0755) == -1 && errno != EEXIST)
+    return NULL;
+
+  if ((history = calloc(sizeof(struct wifi_history), 1)) == NULL)
+    return NULL;
+
+  history->segment_ns = segment_ns;
+
+  if (make_path(history->directory, "%s", directory) == -1 || (dir = opendir(directory)) == NULL)
+  {
+    free(history);
+    return NULL;
+  }
+
+  while ((entry = readdir(dir)) != NULL)
+  {
+    size_t length = strlen(entry->d_name);
+
+    if (length <= strlen(".snapshot") || strcmp(entry->d_name + length - strlen(".snapshot"), ".snapshot") != 0)
+      continue;
+
+    //segment path without extension
+    if (make_path(path, "%s/%.*s", history->directory, (int)(length - strlen(".snapshot")), entry->d_name) == -1)
+      continue;
+
+    //unfinished or corrupted segment, left for manual recovery
+    if (add_segment(history, path) == -1 && errno != EINVAL)
+    {
+      closedir(dir);
+      wifi_history_close(history);
+      return NULL;
+    }
+  }
+
+  closedir(dir);
+
+  if (history->count)
+  {
+    qsort(history->segments, history->count, sizeof(struct history_segment), compare_segments);
+    history->last_ns = history->segments[history->count - 1].header->last_ns;
+  }
+
+  return history;
+}
+
+// public interface
+//
+// prerequisities:
+// - history initialized with wifi_history_open
+int wifi_history_close(struct wifi_history *history)
+{
+  int ret = wifi_history_flush(history), i;
+
+  for (i = 0; i < history->count; ++i)
+    close_segment(&history->segments[i]);
+
+  free(history->segments);
+  free(history);
+
+  return ret;
+}
+
+// public interface
+//
+// prerequisities:
+// - history initialized with wifi_history_open
+// - bss_info table of sized bss_info_length passed
+int wifi_history_append(struct wifi_history *history, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  if (timestamp_ns < history->last_ns)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (history->writer && timestamp_ns >= history->writer_end_ns && wifi_history_flush(history) == -1)
+    return -1;
+
+  if (history->writer == NULL && start_segment(history, timestamp_ns) == -1)
+    return -1;
+
+  if (wifi_snapshot_append(history->writer, timestamp_ns, device_id, bss_infos, bss_infos_length) == -1)
+    return -1;
+
+  history->last_ns = timestamp_ns;
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - history initialized with wifi_history_open
+int wifi_history_flush(struct wifi_history *history)
+{
+  struct wifi_snapshot_writer *writer = history->writer;
+
+  if (writer == NULL)
+    return 0;
+
+  history->writer = NULL;
+
+  if (wifi_snapshot_finish(writer) == -1)
+    return -1;
+
+  return add_segment(history, history->writer_path);
+}
+
+// public interface
+int wifi_history_segments(const struct wifi_history *history)
+{
+  return history->count;
+}
+
+static int start_segment(struct wifi_history *history, uint64_t timestamp_ns)
+{
+  char path[PATH_MAX];
+  int suffix;
+
+  if (make_path(history->writer_path, "%s/%016llx", history->directory, (unsigned long long)timestamp_ns) == -1)
+    return -1;
+
+  //the name is taken if the last segment was flushed with the same timestamp
+  for (suffix = 1; ; ++suffix)
+  {
+    if (make_path(path, "%s.snapshot", history->writer_path) == -1)
+      return -1;
+
+    if (access(path, F_OK) == -1)
+      break;
+
+    if (make_path(history->writer_path, "%s/%016llx-%d", history->directory, (unsigned long long)timestamp_ns, suffix) == -1)
+      return -1;
+  }
+
+  if ((history->writer = wifi_snapshot_create(path)) == NULL)
+    return -1;
+
+  history->writer_end_ns = (timestamp_ns / history->segment_ns + 1) * history->segment_ns;
+  return 0;
+}
+
+static int add_segment(struct wifi_history *history, const char *path)
+{
+  struct history_segment segment;
+  char snapshot_path[PATH_MAX], index_path[PATH_MAX];
+
+  if (make_path(snapshot_path, "%s.snapshot", path) == -1 || make_path(index_path, "%s.index", path) == -1)
+    return -1;
+
+  if (history->count == history->capacity)
+  {
+    int capacity = history->capacity ? 2 * history->capacity : 64;
+    struct history_segment *grown = realloc(history->segments, capacity * sizeof(struct history_segment));
+    if (grown == NULL)
+      return -1;
+    history->segments = grown;
+    history->capacity = capacity;
+  }
+
+  memset(&segment, 0, sizeof(segment));
+
+  if ((segment.snapshot = wifi_snapshot_open(snapshot_path)) == NULL)
+    return -1;
+
+  if (wifi_snapshot_scans(segment.snapshot) == 0)
+  {
+    wifi_snapshot_close(segment.snapshot);
+    errno = EINVAL;
+    return -1;
+  }
+
+  //missing index (e.g. crash after finishing archive) or not matching the archive
+  if (map_index(&segment, index_path) == -1)
+    if (build_index(segment.snapshot, index_path) == -1 || map_index(&segment, index_path) == -1)
+    {
+      wifi_snapshot_close(segment.snapshot);
+      return -1;
+    }
+
+  history->segments[history->count++] = segment;
+  return 0;
+}
+
+static void close_segment(struct history_segment *segment)
+{
+  munmap((void*)segment->index, segment->index_length);
+  wifi_snapshot_close(segment->snapshot);
+}
+
+static int compare_segments(const void *a, const void *b)
+{
+  const struct history_segment *sa = a, *sb = b;
+
+  if (sa->header->first_ns != sb->header->first_ns)
+    return sa->header->first_ns < sb->header->first_ns ? -1 : 1;
+
+  return sa->header->last_ns < sb->header->last_ns ? -1 : sa->header->last_ns > sb->header->last_ns;
+}
+
+// INDEX
+
+static int build_index(const struct wifi_snapshot *snapshot, const char *path)
+{
+  struct history_index_header header;
+  struct wifi_snapshot_columns columns;
+  struct history_entry *entries = NULL;
+  struct history_bssid_key *bssid_keys = NULL;
+  struct history_frequency_key *frequency_keys = NULL;
+  struct history_posting *bssid_postings = NULL, *frequency_postings = NULL;
+  char temporary_path[PATH_MAX];
+  uint64_t total = 0, i, n = 0;
+  int scan, row, ret = -1;
+  FILE *file;
+
+  for (scan = 0; scan < wifi_snapshot_scans(snapshot); ++scan)
+  {
+    if (wifi_snapshot_scan(snapshot, scan, &columns) == -1)
+      return -1;
+    total += columns.bss_count;
+  }
+
+  if (total > UINT32_MAX)
+  {
+    errno = EFBIG;
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, HISTORY_INDEX_MAGIC, sizeof(header.magic));
+  header.version = WIFI_HISTORY_INDEX_VERSION;
+  header.scan_count = wifi_snapshot_scans(snapshot);
+  header.postings = total;
+
+  entries = malloc(total * sizeof(struct history_entry) + 1);
+  bssid_keys = malloc(total * sizeof(struct history_bssid_key) + 1);
+  frequency_keys = malloc(total * sizeof(struct history_frequency_key) + 1);
+  bssid_postings = malloc(total * sizeof(struct history_posting) + 1);
+  frequency_postings = malloc(total * sizeof(struct history_posting) + 1);
+
+  if (!entries || !bssid_keys || !frequency_keys || !bssid_postings || !frequency_postings)
+    goto cleanup;
+
+  for (scan = 0; scan < wifi_snapshot_scans(snapshot); ++scan)
+  {
+    wifi_snapshot_scan(snapshot, scan, &columns);
+
+    if (scan == 0)
+      header.first_ns = columns.timestamp_ns;
+    header.last_ns = columns.timestamp_ns;
+
+    for (row = 0; row < columns.bss_count; ++row, ++n)
+    {
+      memcpy(entries[n].bssid, columns.bssid[row], BSSID_LENGTH);
+      entries[n].frequency = columns.frequency[row];
+      entries[n].scan = scan;
+      entries[n].row = row;
+    }
+  }
+
+  qsort(entries, total, sizeof(struct history_entry), compare_bssid_entries);
+
+  for (i = 0; i < total; ++i)
+  {
+    if (i == 0 || memcmp(entries[i].bssid, entries[i - 1].bssid, BSSID_LENGTH))
+    {
+      struct history_bssid_key *key = &bssid_keys[header.bssid_keys++];
+      memcpy(key->bssid, entries[i].bssid, BSSID_LENGTH);
+      key->reserved = 0;
+      key->first = i;
+      key->count = 0;
+    }
+    ++bssid_keys[header.bssid_keys - 1].count;
+    bssid_postings[i].scan = entries[i].scan;
+    bssid_postings[i].row = entries[i].row;
+  }
+
+  qsort(entries, total, sizeof(struct history_entry), compare_frequency_entries);
+
+  for (i = 0; i < total; ++i)
+  {
+    if (i == 0 || entries[i].frequency != entries[i - 1].frequency)
+    {
+      struct history_frequency_key *key = &frequency_keys[header.frequency_keys++];
+      key->frequency = entries[i].frequency;
+      key->first = i;
+      key->count = 0;
+      key->reserved = 0;
+    }
+    ++frequency_keys[header.frequency_keys - 1].count;
+    frequency_postings[i].scan = entries[i].scan;
+    frequency_postings[i].row = entries[i].row;
+  }
+
+  //write aside and rename so that the index is never seen half written
+  if (make_path(temporary_path, "%s.tmp", path) == -1 || (file = fopen(temporary_path, "wb")) == NULL)
+    goto cleanup;
+
+  if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+    fwrite(bssid_keys, sizeof(struct history_bssid_key), header.bssid_keys, file) != header.bssid_keys ||
+    fwrite(frequency_keys, sizeof(struct history_frequency_key), header.frequency_keys, file) != header.frequency_keys ||
+    fwrite(bssid_postings, sizeof(struct history_posting), total, file) != total ||
+    fwrite(frequency_postings, sizeof(struct history_posting), total, file) != total)
+  {
+    fclose(file);
+    unlink(temporary_path);
+    goto cleanup;
+  }
+
+  if (fclose(file) != 0 || rename(temporary_path, path) == -1)
+  {
+    unlink(temporary_path);
+    goto cleanup;
+  }
+
+  ret = 0;
+
+cleanup:
+  free(frequency_postings);
+  free(bssid_postings);
+  free(frequency_keys);
+  free(bssid_keys);
+  free(entries);
+  return ret;
+}
+
+// prerequisities:
+// - segment snapshot mapped
+static int map_index(struct history_segment *segment, const char *path)
+{
+  const struct history_index_header *header;
+  struct wifi_snapshot_columns first, last;
+  uint64_t expected;
+  size_t length;
+  uint32_t i;
+  const char *data;
+
+  if ((data = map_file(path, &length)) == NULL)
+    return -1;
+
+  header = (const struct history_index_header*)data;
+
+  if (length < sizeof(struct history_index_header) || memcmp(header->magic, HISTORY_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+    header->version != WIFI_HISTORY_INDEX_VERSION || header->postings > UINT32_MAX)
+    goto invalid;
+
+  expected = sizeof(struct history_index_header) + (uint64_t)header->bssid_keys * sizeof(struct history_bssid_key) +
+    (uint64_t)header->frequency_keys * sizeof(struct history_frequency_key) + 2 * header->postings * sizeof(struct history_posting);
+
+  if (length != expected || header->bssid_keys > header->postings || header->frequency_keys > header->postings)
+    goto invalid;
+
+  //the index of this archive (and not of one overwritten later)
+  if ((int)header->scan_count != wifi_snapshot_scans(segment->snapshot) ||
+    wifi_snapshot_scan(segment->snapshot, 0, &first) == -1 || first.timestamp_ns != header->first_ns ||
+    wifi_snapshot_scan(segment->snapshot, header->scan_count - 1, &last) == -1 || last.timestamp_ns != header->last_ns)
+    goto invalid;
+
+  segment->index = data;
+  segment->index_length = length;
+  segment->header = header;
+  segment->bssid_keys = (const struct history_bssid_key*)(header + 1);
+  segment->frequency_keys = (const struct history_frequency_key*)(segment->bssid_keys + header->bssid_keys);
+  segment->bssid_postings = (const struct history_posting*)(segment->frequency_keys + header->frequency_keys);
+  segment->frequency_postings = segment->bssid_postings + header->postings;
+
+  //postings themselves are checked when used
+  for (i = 0; i < header->bssid_keys; ++i)
+    if (segment->bssid_keys[i].first > header->postings || segment->bssid_keys[i].count > header->postings - segment->bssid_keys[i].first)
+      goto invalid;
+
+  for (i = 0; i < header->frequency_keys; ++i)
+    if (segment->frequency_keys[i].first > header->postings || segment->frequency_keys[i].count > header->postings - segment->frequency_keys[i].first)
+      goto invalid;
+
+  return 0;
+
+invalid:
+  munmap((void*)data, length);
+  segment->index = NULL;
+  errno = EINVAL;
+  return -1;
+}
+
+static int compare_bssid_entries(const void *a, const void *b)
+{
+  const struct history_entry *ea = a, *eb = b;
+  int result = memcmp(ea->bssid, eb->bssid, BSSID_LENGTH);
+
+  if (result)
+    return result;
+  if (ea->scan != eb->scan)
+    return ea->scan < eb->scan ? -1 : 1;
+  return ea->row < eb->row ? -1 : ea->row > eb->row;
+}
+
+static int compare_frequency_entries(const void *a, const void *b)
+{
+  const struct history_entry *ea = a, *eb = b;
+
+  if (ea->frequency != eb->frequency)
+    return ea->frequency < eb->frequency ? -1 : 1;
+  if (ea->scan != eb->scan)
+    return ea->scan < eb->scan ? -1 : 1;
+  return ea->row < eb->row ? -1 : ea->row > eb->row;
+}
+
+// QUERIES
+
+// public interface
+//
+// prerequisities:
+// - history initialized with wifi_history_open
+// - records table of sized records_length passed
+int wifi_history_query(const struct wifi_history *history, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length)
+{
+  int matched = 0, i;
+
+  for (i = 0; i < history->count; ++i)
+  {
+    const struct history_segment *segment = &history->segments[i];
+
+    if (segment->header->first_ns >= query->to_ns || segment->header->last_ns < query->from_ns)
+      continue;
+
+    if (query_segment(segment, query, records, records_length, &matched) == -1)
+      return -1;
+  }
+
+  return matched;
+}
+
+static int query_segment(const struct history_segment *segment, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length, int *matched)
+{
+  const struct history_posting *postings = NULL;
+  struct wifi_snapshot_columns columns;
+  uint32_t count = 0, p, row, first, last, key, keys;
+  int first_scan, last_scan, scan = -1;
+
+  if ((first_scan = lower_bound_scan(segment->snapshot, query->from_ns)) == -1 || (last_scan = lower_bound_scan(segment->snapshot, query->to_ns)) == -1)
+    return -1;
+
+  if (query->bssid)
+  {
+    for (first = 0, last = keys = segment->header->bssid_keys; first < last; )
+    {
+      key = first + (last - first) / 2;
+      if (memcmp(segment->bssid_keys[key].bssid, query->bssid, BSSID_LENGTH) < 0)
+        first = key + 1;
+      else
+        last = key;
+    }
+    if (first == keys || memcmp(segment->bssid_keys[first].bssid, query->bssid, BSSID_LENGTH))
+      return 0;
+    postings = segment->bssid_postings + segment->bssid_keys[first].first;
+    count = segment->bssid_keys[first].count;
+  }
+  else if (query->frequency)
+  {
+    for (first = 0, last = keys = segment->header->frequency_keys; first < last; )
+    {
+      key = first + (last - first) / 2;
+      if (segment->frequency_keys[key].frequency < query->frequency)
+        first = key + 1;
+      else
+        last = key;
+    }
+    if (first == keys || segment->frequency_keys[first].frequency != query->frequency)
+      return 0;
+    postings = segment->frequency_postings + segment->frequency_keys[first].first;
+    count = segment->frequency_keys[first].count;
+  }
+  else
+  {
+    //no index to use, read the whole time range
+    for (scan = first_scan; scan < last_scan; ++scan)
+    {
+      if (wifi_snapshot_scan(segment->snapshot, scan, &columns) == -1)
+        return -1;
+      for (row = 0; row < (uint32_t)columns.bss_count; ++row)
+        if (match_row(segment, &columns, row, query, records, records_length, matched) == -1)
+          return -1;
+    }
+    return 0;
+  }
+
+  for (p = lower_bound_posting(postings, count, first_scan); p < count && postings[p].scan < (uint32_t)last_scan; ++p)
+  {
+    //postings of the same scan are next to each other
+    if ((int)postings[p].scan != scan && wifi_snapshot_scan(segment->snapshot, scan = postings[p].scan, &columns) == -1)
+      return -1;
+
+    if (postings[p].row >= (uint32_t)columns.bss_count)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    if (match_row(segment, &columns, postings[p].row, query, records, records_length, matched) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+static int match_row(const struct history_segment *segment, const struct wifi_snapshot_columns *columns, uint32_t row, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length, int *matched)
+{
+  struct wifi_history_record *record;
+  const char *ssid;
+
+  if ((query->device_id && columns->device_id != *query->device_id) ||
+    (query->bssid && memcmp(columns->bssid[row], query->bssid, BSSID_LENGTH)) ||
+    (query->frequency && columns->frequency[row] != query->frequency))
+    return 0;
+
+  if (*matched >= records_length)
+  {
+    ++*matched;
+    return 0;
+  }
+
+  record = &records[(*matched)++];
+  record->timestamp_ns = columns->timestamp_ns;
+  record->device_id = columns->device_id;
+  memcpy(record->bss.bssid, columns->bssid[row], BSSID_LENGTH);
+  record->bss.frequency = columns->frequency[row];
+  record->bss.status = columns->status[row];
+  record->bss.signal_mbm = columns->signal_mbm[row];
+  record->bss.seen_ms_ago = columns->seen_ms_ago[row];
+
+  if ((ssid = wifi_snapshot_ssid(segment->snapshot, columns->ssid[row])) == NULL)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  strncpy(record->bss.ssid, ssid, SSID_MAX_LENGTH_WITH_NULL - 1);
+  record->bss.ssid[SSID_MAX_LENGTH_WITH_NULL - 1] = '\0';
+
+  return 0;
+}
+
+static int lower_bound_scan(const struct wifi_snapshot *snapshot, uint64_t timestamp_ns)
+{
+  struct wifi_snapshot_columns columns;
+  int first = 0, last = wifi_snapshot_scans(snapshot);
+
+  while (first < last)
+  {
+    int middle = first + (last - first) / 2;
+
+    if (wifi_snapshot_scan(snapshot, middle, &columns) == -1)
+      return -1;
+
+    if (columns.timestamp_ns < timestamp_ns)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+
+  return first;
+}
+
+static uint32_t lower_bound_posting(const struct history_posting *postings, uint32_t count, uint32_t scan)
+{
+  uint32_t first = 0, last = count;
+
+  while (first < last)
+  {
+    uint32_t middle = first + (last - first) / 2;
+
+    if (postings[middle].scan < scan)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+
+  return first;
+}
+
+// HELPERS
+
+static const char *map_file(const char *path, size_t *length)
+{
+  struct stat file_stat;
+  void *data;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) == -1)
+    return NULL;
+
+  if (fstat(fd, &file_stat) == -1)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  if (file_stat.st_size == 0)
+  {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); //the mapping stays
+
+  if (data == MAP_FAILED)
+    return NULL;
+
+  *length = file_stat.st_size;
+  return data;
+}
+
+static int make_path(char *path, const char *format, ...)
+{
+  va_list args;
+  int length;
+
+  va_start(args, format);
+  length = vsnprintf(path, PATH_MAX, format, args);
+  va_end(args);
+
+  if (length < 0 || length >= PATH_MAX)
+  {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * wifi-scan library history store header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Append-only store of scan results with time, BSSID and frequency queries
+ *
+ * The store is a directory of time partitioned segments. Each segment is a snapshot archive
+ * (see wifi_snapshot.h) covering segment_ns of time and a sidecar index file with sorted BSSID and
+ * frequency keys pointing to rows of the archive. Queries skip segments outside of time range,
+ * binary search scans by time and follow the index, so they don't read data that can't match.
+ *
+ * Files in the directory:
+ * - <first timestamp hex>.snapshot - the archive, named after the timestamp of the first scan
+ * - <first timestamp hex>.index - the index, rebuilt on open if missing or invalid
+ *
+ * Scans become visible to queries when their segment is finished (segment time is over,
+ * wifi_history_flush or wifi_history_close).
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_history_constants {WIFI_HISTORY_INDEX_VERSION=1};
+
+// single BSS of stored scan
+struct wifi_history_record
+{
+	uint64_t timestamp_ns; //of the scan, as passed to wifi_history_append
+	uint32_t device_id; //of the scan, as passed to wifi_history_append
+	struct bss_info bss;
+};
+
+// query filters, records have to match all of them
+struct wifi_history_query
+{
+	uint64_t from_ns; //the first timestamp to match
+	uint64_t to_ns; //the first timestamp not to match
+	const uint8_t *bssid; //BSSID_LENGTH bytes or NULL for any BSSID
+	const uint32_t *device_id; //NULL for any device
+	uint32_t frequency; //in MHz or 0 for any frequency
+};
+
+// internal data used by the functions
+struct wifi_history;
+
+/* Open (or create) the store
+ *
+ * The existing segments are mapped, missing or invalid indexes are rebuilt.
+ * Unfinished segments (e.g. after crash) are not readable and are left as they are.
+ *
+ * parameters:
+ * directory - created if it doesn't exist
+ * segment_ns - time covered by single segment, e.g. 3600000000000 for an hour
+ *
+ * returns:
+ * struct wifi_history * - pass it to the history functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_history *wifi_history_open(const char *directory, uint64_t segment_ns);
+
+/* Finish the current segment and free the store
+ *
+ * parameters:
+ * history - initialized with wifi_history_open, it is freed even on error
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_history_close(struct wifi_history *history);
+
+/* Append scan results
+ *
+ * The segment is finished and the next one started when timestamp crosses segment time.
+ *
+ * parameters:
+ * history - initialized with wifi_history_open
+ * timestamp_ns - of the scan (e.g. CLOCK_REALTIME), not smaller than of any stored scan
+ * device_id - the device which scanned
+ * bss_infos - results of wifi_scan_all
+ * bss_infos_length - the number of results
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for timestamp going back), 0 on success
+ */
+int wifi_history_append(struct wifi_history *history, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Finish the current segment so that its scans are visible to queries
+ *
+ * The next append starts a new segment.
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_history_flush(struct wifi_history *history);
+
+/* Get the number of finished segments */
+int wifi_history_segments(const struct wifi_history *history);
+
+/* Find records matching the query in time order
+ *
+ * BSSID index is used if BSSID is set, frequency index if frequency is set,
+ * otherwise all the scans of time range are read.
+ *
+ * parameters:
+ * history - initialized with wifi_history_open
+ * query - filters
+ * records - array of records of size records_length
+ * records_length - the length of passed array
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for corrupted files) or the number of matching records,
+ * the number may be greater than records_length
+ */
+int wifi_history_query(const struct wifi_history *history, const struct wifi_history_query *query, struct wifi_history_record *records, int records_length);
+
+#ifdef __cplusplus
+}
+#endif
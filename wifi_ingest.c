@@ -0,0 +1,861 @@
+/*
+ * wifi-scan library offline ingest implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Ingest Overview
+  *
+  * The calling thread splits the files into chunks (only walking record and message headers),
+  * deals them round-robin to the queues of parsing threads and hands the results to the callback
+  * in order. At most window chunks are in flight, their slots are reused after delivery.
+  *
+  * Parsing threads pop the oldest chunk from their own queue or steal the newest chunk
+  * from the queue of other thread. The dumps are parsed with wifi_scan_parse_scan_results
+  * to thread scratch buffers and copied to arena blocks owned by the chunk. Delivered chunk
+  * gives its blocks back to the thread which parsed it.
+  *
+  * Both splitting and parsing see the input as parts:
+  * - capture file - data of each received record of commands channel
+  * - raw stream - messages of a dump up to NLMSG_DONE/NLMSG_ERROR or a single other message
+  * A dump starts with NL80211_CMD_NEW_SCAN_RESULTS multipart message and ends with the part
+  * holding NLMSG_DONE or NLMSG_ERROR. Chunks end right after a dump.
+  *
+  */
+
+#include "wifi_ingest.h"
+
+#include <linux/netlink.h> //nlmsghdr
+#include <linux/genetlink.h> //genlmsghdr
+#include <linux/nl80211.h> //NL80211_CMD_NEW_SCAN_RESULTS
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h> //open
+#include <unistd.h> //close, sysconf
+#include <sys/mman.h> //mmap
+#include <sys/stat.h> //fstat
+
+enum ingest_constants {INGEST_BLOCK_SIZE=1<<18, INGEST_CHUNKS_PER_THREAD=4, INGEST_INITIAL_BSS=256};
+
+enum ingest_format {INGEST_CAPTURE=0, INGEST_RAW=1};
+
+enum ingest_chunk_state {CHUNK_QUEUED=0, CHUNK_DONE=1};
+
+// piece of arena memory, belongs to chunk or to free list of thread
+struct ingest_block
+{
+  struct ingest_block *next;
+  size_t used;
+  size_t size;
+  char data[];
+};
+
+// input file as seen by the splitter
+struct ingest_file
+{
+  const char *data; //the whole mapped file or NULL if not mapped (yet)
+  size_t length;
+  enum ingest_format format;
+  uint16_t nl80211_id; //from capture header
+  size_t offset; //where the next chunk starts
+  uint64_t dumps; //found by splitter so far
+  int pending; //chunks not delivered yet
+  bool split; //the whole file split to chunks
+};
+
+// received data or messages, see overview
+struct ingest_part
+{
+  const char *data;
+  size_t length;
+  uint64_t timestamp_ns;
+  bool scan_results; //starts with multipart NL80211_CMD_NEW_SCAN_RESULTS
+  bool end; //holds NLMSG_DONE or NLMSG_ERROR
+};
+
+// unit of work
+struct ingest_chunk
+{
+  int file;
+  size_t begin; //offset in file
+  size_t end;
+  uint64_t first_dump; //index of the first dump in file
+  int state; //enum ingest_chunk_state, under pipeline lock
+  int worker; //which parsed the chunk (owns the blocks)
+  struct wifi_ingest_scan *scans; //in arena
+  int scan_count;
+  struct ingest_block *blocks;
+  uint64_t dumps;
+  uint64_t failed_dumps;
+  uint64_t bss;
+  int error; //errno if chunk couldn't be parsed (e.g. no memory)
+};
+
+struct ingest_pipeline;
+
+// parsing thread
+struct ingest_worker
+{
+  struct ingest_pipeline *pipeline;
+  int id;
+  pthread_t thread;
+  pthread_mutex_t lock; //for queue and free blocks
+  int *queue; //ring of chunk slots, capacity of window
+  int head; //the oldest chunk
+  int tail; //after the newest chunk
+  struct ingest_block *free_blocks;
+  struct bss_info *bss; //scratch for parsed dump
+  int bss_capacity;
+  struct wifi_ingest_scan *scans; //scratch for scans of chunk
+  int scans_capacity;
+  uint64_t steals;
+};
+
+struct ingest_pipeline
+{
+  const char * const *paths;
+  struct ingest_file *files;
+  int file_count;
+  int split_file; //being split
+  struct ingest_chunk *chunks; //ring of window slots
+  int window;
+  struct ingest_worker *workers;
+  int threads;
+  pthread_mutex_t lock;
+  pthread_cond_t work; //queued chunk or finished
+  pthread_cond_t done; //chunk parsed
+  int queued; //chunks in queues
+  bool finished; //no more chunks will be queued
+  bool aborted; //queued chunks are to be skipped
+};
+
+// DECLARATIONS
+
+// PIPELINE
+
+// public interface - split, parse in thread pool, deliver in order
+int wifi_ingest(const char * const *paths, int paths_length, int threads, wifi_ingest_callback callback, void *user, struct wifi_ingest_stats *stats);
+// allocate pipeline and start threads, false on error
+static bool init_pipeline(struct ingest_pipeline *pipeline, const char * const *paths, int paths_length, int threads);
+// stop threads, free everything (delivered or not)
+static void close_pipeline(struct ingest_pipeline *pipeline);
+// hand scans of parsed chunk to callback, give blocks back, -1 if callback stopped
+static int deliver_chunk(struct ingest_pipeline *pipeline, struct ingest_chunk *chunk, wifi_ingest_callback callback, void *user, struct wifi_ingest_stats *stats);
+// give chunk blocks back to the thread which parsed it
+static void release_chunk(struct ingest_pipeline *pipeline, struct ingest_chunk *chunk);
+
+// SPLITTING
+
+// the next chunk of input, 1 if split, 0 at the end of input, -1 on error
+static int split_chunk(struct ingest_pipeline *pipeline, struct ingest_chunk *chunk);
+// map the file and detect its format
+static int open_file(struct ingest_file *file, const char *path);
+// unmap the file if it was split and all chunks delivered
+static void release_file(struct ingest_file *file);
+// the next part starting from offset up to end, false if there are no more
+static bool next_part(const struct ingest_file *file, size_t *offset, size_t end, struct ingest_part *part);
+// set scan_results and end of part
+static void classify_part(struct ingest_part *part, uint16_t nl80211_id);
+
+// PARSING
+
+// thread main loop
+static void *worker_main(void *arg);
+// push chunk slot to the thread queue
+static void queue_push(struct ingest_worker *worker, int slot);
+// pop the oldest chunk slot of own queue, -1 if empty
+static int queue_pop(struct ingest_worker *worker);
+// take the newest chunk slot from other thread queue, -1 if all empty
+static int queue_steal(struct ingest_worker *worker);
+// parse all the dumps of chunk to arena
+static int parse_chunk(struct ingest_worker *worker, struct ingest_chunk *chunk);
+// parse dump parts from offset up to end (which ends the dump), -1 if dump is broken
+static int parse_dump(struct ingest_worker *worker, const struct ingest_file *file, size_t offset, size_t end);
+// memory for chunk results from thread arena, NULL on error
+static void *arena_alloc(struct ingest_worker *worker, struct ingest_chunk *chunk, size_t size);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// PIPELINE
+
+// public interface
+int wifi_ingest(const char * const *paths, int paths_length, int threads, wifi_ingest_callback callback, void *user, struct wifi_ingest_stats *stats)
+{
+  struct ingest_pipeline pipeline;
+  struct wifi_ingest_stats local_stats;
+  int created = 0, delivered = 0, split = 1, error = 0, i;
+
+  if (stats == NULL)
+    stats = &local_stats;
+
+  memset(stats, 0, sizeof(struct wifi_ingest_stats));
+
+  if (paths_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (threads <= 0 && (threads = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+    threads = 1;
+
+  if (!init_pipeline(&pipeline, paths, paths_length, threads))
+    return -1;
+
+  while (!error)
+  {
+    //keep the window full
+    while (created - delivered < pipeline.window && (split = split_chunk(&pipeline, &pipeline.chunks[created % pipeline.window])) == 1)
+    {
+      int slot = created % pipeline.window;
+
+      pipeline.chunks[slot].state = CHUNK_QUEUED;
+      queue_push(&pipeline.workers[created % pipeline.threads], slot);
+
+      pthread_mutex_lock(&pipeline.lock);
+      ++pipeline.queued;
+      pthread_cond_broadcast(&pipeline.work);
+      pthread_mutex_unlock(&pipeline.lock);
+
+      ++created;
+    }
+
+    if (split == -1)
+    {
+      error = errno;
+      break;
+    }
+
+    if (created == delivered)
+      break;
+
+    struct ingest_chunk *chunk = &pipeline.chunks[delivered % pipeline.window];
+
+    pthread_mutex_lock(&pipeline.lock);
+    while (chunk->state != CHUNK_DONE)
+      pthread_cond_wait(&pipeline.done, &pipeline.lock);
+    pthread_mutex_unlock(&pipeline.lock);
+
+    if (deliver_chunk(&pipeline, chunk, callback, user, stats) == -1)
+      error = errno;
+
+    ++delivered;
+  }
+
+  //stop the threads, skipping what is still queued after error
+  pthread_mutex_lock(&pipeline.lock);
+  pipeline.finished = true;
+  pipeline.aborted = error != 0;
+  pthread_cond_broadcast(&pipeline.work);
+  pthread_mutex_unlock(&pipeline.lock);
+
+  for (i = 0; i < pipeline.threads; ++i)
+  {
+    pthread_join(pipeline.workers[i].thread, NULL);
+    stats->steals += pipeline.workers[i].steals;
+  }
+
+  for (; delivered < created; ++delivered)
+    release_chunk(&pipeline, &pipeline.chunks[delivered % pipeline.window]);
+
+  stats->threads = pipeline.threads;
+  stats->chunks = created;
+  for (i = 0; i < pipeline.file_count; ++i)
+    stats->bytes += pipeline.files[i].length;
+
+  close_pipeline(&pipeline);
+
+  if (error)
+  {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+static bool init_pipeline(struct ingest_pipeline *pipeline, const char * const *paths, int paths_length, int threads)
+{
+  int i, error;
+
+  memset(pipeline, 0, sizeof(struct ingest_pipeline));
+  pipeline->paths = paths;
+  pipeline->file_count = paths_length;
+  pipeline->window = INGEST_CHUNKS_PER_THREAD * threads;
+
+  pthread_mutex_init(&pipeline->lock, NULL);
+  pthread_cond_init(&pipeline->work, NULL);
+  pthread_cond_init(&pipeline->done, NULL);
+
+  pipeline->files = calloc(paths_length + 1, sizeof(struct ingest_file));
+  pipeline->chunks = calloc(pipeline->window, sizeof(struct ingest_chunk));
+  pipeline->workers = calloc(threads, sizeof(struct ingest_worker));
+
+  if (pipeline->files == NULL || pipeline->chunks == NULL || pipeline->workers == NULL)
+  {
+    close_pipeline(pipeline);
+    return false;
+  }
+
+  for (i = 0; i < threads; ++i)
+  {
+    struct ingest_worker *worker = &pipeline->workers[i];
+
+    worker->pipeline = pipeline;
+    worker->id = i;
+    pthread_mutex_init(&worker->lock, NULL);
+    pipeline->threads = i + 1;
+
+    if ((worker->queue = malloc(pipeline->window * sizeof(int))) == NULL)
+    {
+      close_pipeline(pipeline);
+      return false;
+    }
+  }
+
+  for (i = 0; i < threads; ++i)
+    if ((error = pthread_create(&pipeline->workers[i].thread, NULL, worker_main, &pipeline->workers[i])) != 0)
+    {
+      //stop those already running
+      pthread_mutex_lock(&pipeline->lock);
+      pipeline->finished = true;
+      pthread_cond_broadcast(&pipeline->work);
+      pthread_mutex_unlock(&pipeline->lock);
+
+      while (i-- > 0)
+        pthread_join(pipeline->workers[i].thread, NULL);
+
+      close_pipeline(pipeline);
+      errno = error;
+      return false;
+    }
+
+  return true;
+}
+
+static void close_pipeline(struct ingest_pipeline *pipeline)
+{
+  struct ingest_block *block;
+  int i;
+
+  for (i = 0; pipeline->workers && i < pipeline->threads; ++i)
+  {
+    struct ingest_worker *worker = &pipeline->workers[i];
+
+    while ((block = worker->free_blocks) != NULL)
+    {
+      worker->free_blocks = block->next;
+      free(block);
+    }
+    free(worker->bss);
+    free(worker->scans);
+    free(worker->queue);
+    pthread_mutex_destroy(&worker->lock);
+  }
+
+  for (i = 0; pipeline->files && i < pipeline->file_count; ++i)
+    if (pipeline->files[i].data)
+      munmap((void*)pipeline->files[i].data, pipeline->files[i].length);
+
+  pthread_mutex_destroy(&pipeline->lock);
+  pthread_cond_destroy(&pipeline->work);
+  pthread_cond_destroy(&pipeline->done);
+
+  free(pipeline->workers);
+  free(pipeline->chunks);
+  free(pipeline->files);
+}
+
+static int deliver_chunk(struct ingest_pipeline *pipeline, struct ingest_chunk *chunk, wifi_ingest_callback callback, void *user, struct wifi_ingest_stats *stats)
+{
+  struct ingest_file *file = &pipeline->files[chunk->file];
+  int error = chunk->error, i;
+
+  stats->dumps += chunk->dumps;
+  stats->failed_dumps += chunk->failed_dumps;
+  stats->bss += chunk->bss;
+
+  for (i = 0; i < chunk->scan_count && !error; ++i)
+    if (callback(&chunk->scans[i], user) != 0)
+      error = ECANCELED;
+
+  release_chunk(pipeline, chunk);
+
+  --file->pending;
+  release_file(file);
+
+  if (error)
+  {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void release_chunk(struct ingest_pipeline *pipeline, struct ingest_chunk *chunk)
+{
+  struct ingest_worker *worker = &pipeline->workers[chunk->worker];
+  struct ingest_block *last = chunk->blocks;
+
+  if (last)
+  {
+    while (last->next)
+      last = last->next;
+
+    pthread_mutex_lock(&worker->lock);
+    last->next = worker->free_blocks;
+    worker->free_blocks = chunk->blocks;
+    pthread_mutex_unlock(&worker->lock);
+  }
+
+  chunk->blocks = NULL;
+  chunk->scans = NULL;
+  chunk->scan_count = 0;
+}
+
+// SPLITTING
+
+static int split_chunk(struct ingest_pipeline *pipeline, struct ingest_chunk *chunk)
+{
+  struct ingest_file *file;
+  struct ingest_part part;
+  size_t offset;
+  bool in_dump = false;
+
+  for (; pipeline->split_file < pipeline->file_count; ++pipeline->split_file)
+  {
+    file = &pipeline->files[pipeline->split_file];
+
+    if (file->data == NULL && !file->split && open_file(file, pipeline->paths[pipeline->split_file]) == -1)
+      return -1;
+
+    if (file->offset < file->length)
+      break;
+
+    file->split = true;
+    release_file(file);
+  }
+
+  if (pipeline->split_file == pipeline->file_count)
+    return 0;
+
+  file = &pipeline->files[pipeline->split_file];
+
+  memset(chunk, 0, sizeof(struct ingest_chunk));
+  chunk->file = pipeline->split_file;
+  chunk->begin = file->offset;
+  chunk->first_dump = file->dumps;
+
+  //the chunk ends after the dump which makes it big enough or with the file
+  for (offset = file->offset, chunk->end = file->length; next_part(file, &offset, file->length, &part); )
+  {
+    if (!in_dump && !part.scan_results)
+      continue;
+
+    in_dump = !part.end;
+
+    if (part.end)
+    {
+      ++file->dumps;
+      if (offset - chunk->begin >= WIFI_INGEST_CHUNK_BYTES)
+      {
+        chunk->end = offset;
+        break;
+      }
+    }
+  }
+
+  file->offset = chunk->end;
+  ++file->pending;
+
+  return 1;
+}
+
+static int open_file(struct ingest_file *file, const char *path)
+{
+  struct wifi_scan_capture_header header;
+  struct stat file_stat;
+  void *data;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) == -1)
+    return -1;
+
+  if (fstat(fd, &file_stat) == -1)
+  {
+    close(fd);
+    return -1;
+  }
+
+  //nothing to split
+  if (file_stat.st_size == 0)
+  {
+    close(fd);
+    file->split = true;
+    return 0;
+  }
+
+  data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); //the mapping stays
+
+  if (data == MAP_FAILED)
+    return -1;
+
+  //files are read once from the beginning to the end
+  madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+
+  file->data = data;
+  file->length = file_stat.st_size;
+  file->format = INGEST_RAW;
+
+  if (file->length >= sizeof(header) && memcmp(file->data, WIFI_SCAN_CAPTURE_MAGIC, sizeof(header.magic)) == 0)
+  {
+    memcpy(&header, file->data, sizeof(header));
+
+    if (header.version != WIFI_SCAN_CAPTURE_VERSION)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    file->format = INGEST_CAPTURE;
+    file->nl80211_id = header.nl80211_id;
+    file->offset = sizeof(header);
+  }
+
+  return 0;
+}
+
+static void release_file(struct ingest_file *file)
+{
+  if (!file->split || file->pending || file->data == NULL)
+    return;
+
+  munmap((void*)file->data, file->length);
+  file->data = NULL;
+}
+
+static bool next_part(const struct ingest_file *file, size_t *offset, size_t end, struct ingest_part *part)
+{
+  if (file->format == INGEST_CAPTURE)
+  {
+    struct wifi_scan_capture_record record;
+
+    while (*offset + sizeof(record) <= end)
+    {
+      size_t length;
+
+      memcpy(&record, file->data + *offset, sizeof(record));
+      length = record.result > 0 ? record.result : 0;
+
+      //the capture may have been cut short, like for replay ignore incomplete record
+      if (*offset + sizeof(record) + length > end)
+        break;
+
+      part->data = file->data + *offset + sizeof(record);
+      part->length = length;
+      part->timestamp_ns = record.timestamp_ns;
+      *offset += sizeof(record) + length;
+
+      if (record.channel != WIFI_SCAN_CHANNEL_COMMANDS || record.direction != WIFI_SCAN_CAPTURE_RECEIVE || length == 0)
+        continue;
+
+      classify_part(part, file->nl80211_id);
+      return true;
+    }
+
+    *offset = end;
+    return false;
+  }
+
+  //raw stream, dump as single part or single other message
+  const struct nlmsghdr *nlh;
+  size_t begin = *offset;
+
+  part->data = file->data + begin;
+  part->timestamp_ns = 0;
+
+  while (*offset + NLMSG_HDRLEN <= end)
+  {
+    nlh = (const struct nlmsghdr*)(file->data + *offset);
+
+    if (nlh->nlmsg_len < NLMSG_HDRLEN || nlh->nlmsg_len > end - *offset)
+      break;
+
+    if (*offset == begin)
+    {
+      part->length = nlh->nlmsg_len;
+      classify_part(part, 0);
+    }
+    else
+      part->end = nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR;
+
+    *offset += NLMSG_ALIGN(nlh->nlmsg_len) < end - *offset ? NLMSG_ALIGN(nlh->nlmsg_len) : end - *offset;
+
+    if (part->end || !part->scan_results)
+      break;
+  }
+
+  part->length = *offset - begin;
+
+  //the rest is not netlink data
+  if (*offset > begin)
+    return true;
+
+  *offset = end;
+  return false;
+}
+
+static void classify_part(struct ingest_part *part, uint16_t nl80211_id)
+{
+  const struct nlmsghdr *nlh = (const struct nlmsghdr*)part->data;
+  const struct genlmsghdr *genl = (const struct genlmsghdr*)NLMSG_DATA(nlh);
+  size_t offset = 0;
+
+  part->scan_results = part->length >= NLMSG_HDRLEN + GENL_HDRLEN && nlh->nlmsg_len >= NLMSG_HDRLEN + GENL_HDRLEN &&
+    (nl80211_id ? nlh->nlmsg_type == nl80211_id : nlh->nlmsg_type >= NLMSG_MIN_TYPE) &&
+    (nlh->nlmsg_flags & NLM_F_MULTI) && genl->cmd == NL80211_CMD_NEW_SCAN_RESULTS;
+  part->end = false;
+
+  while (offset + NLMSG_HDRLEN <= part->length)
+  {
+    nlh = (const struct nlmsghdr*)(part->data + offset);
+
+    if (nlh->nlmsg_len < NLMSG_HDRLEN)
+      break;
+
+    if (nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR)
+    {
+      part->end = true;
+      break;
+    }
+
+    offset += NLMSG_ALIGN(nlh->nlmsg_len);
+  }
+}
+
+// PARSING
+
+static void *worker_main(void *arg)
+{
+  struct ingest_worker *worker = arg;
+  struct ingest_pipeline *pipeline = worker->pipeline;
+  int slot;
+  bool skip;
+
+  for (;;)
+  {
+    if ((slot = queue_pop(worker)) == -1 && (slot = queue_steal(worker)) == -1)
+    {
+      pthread_mutex_lock(&pipeline->lock);
+      while (pipeline->queued == 0 && !pipeline->finished)
+        pthread_cond_wait(&pipeline->work, &pipeline->lock);
+      skip = pipeline->queued == 0 && pipeline->finished;
+      pthread_mutex_unlock(&pipeline->lock);
+
+      if (skip)
+        break;
+      continue;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    --pipeline->queued;
+    skip = pipeline->aborted;
+    pthread_mutex_unlock(&pipeline->lock);
+
+    struct ingest_chunk *chunk = &pipeline->chunks[slot];
+    chunk->worker = worker->id;
+
+    if (!skip && parse_chunk(worker, chunk) == -1)
+      chunk->error = errno;
+
+    pthread_mutex_lock(&pipeline->lock);
+    chunk->state = CHUNK_DONE;
+    pthread_cond_broadcast(&pipeline->done);
+    pthread_mutex_unlock(&pipeline->lock);
+  }
+
+  return NULL;
+}
+
+static void queue_push(struct ingest_worker *worker, int slot)
+{
+  pthread_mutex_lock(&worker->lock);
+  worker->queue[worker->tail++ % worker->pipeline->window] = slot;
+  pthread_mutex_unlock(&worker->lock);
+}
+
+static int queue_pop(struct ingest_worker *worker)
+{
+  int slot = -1;
+
+  pthread_mutex_lock(&worker->lock);
+  if (worker->head < worker->tail)
+    slot = worker->queue[worker->head++ % worker->pipeline->window];
+  pthread_mutex_unlock(&worker->lock);
+
+  return slot;
+}
+
+static int queue_steal(struct ingest_worker *worker)
+{
+  struct ingest_pipeline *pipeline = worker->pipeline;
+  int i, slot = -1;
+
+  for (i = 1; i < pipeline->threads && slot == -1; ++i)
+  {
+    struct ingest_worker *victim = &pipeline->workers[(worker->id + i) % pipeline->threads];
+
+    //the newest chunk, the owner works on the oldest ones
+    pthread_mutex_lock(&victim->lock);
+    if (victim->head < victim->tail)
+      slot = victim->queue[--victim->tail % pipeline->window];
+    pthread_mutex_unlock(&victim->lock);
+  }
+
+  if (slot != -1)
+    ++worker->steals;
+
+  return slot;
+}
+
+static int parse_chunk(struct ingest_worker *worker, struct ingest_chunk *chunk)
+{
+  const struct ingest_file *file = &worker->pipeline->files[chunk->file];
+  struct ingest_part part;
+  size_t offset = chunk->begin, dump_begin = 0, part_begin;
+  int scanned;
+  bool in_dump = false;
+
+  for (part_begin = offset; next_part(file, &offset, chunk->end, &part); part_begin = offset)
+  {
+    if (!in_dump && !part.scan_results)
+      continue;
+
+    if (!in_dump)
+      dump_begin = part_begin;
+
+    if (!(in_dump = !part.end))
+    {
+      //the whole dump is parsed at once, only complete dumps count
+      if ((scanned = parse_dump(worker, file, dump_begin, offset)) == -1)
+      {
+        if (errno == ENOMEM)
+          return -1;
+        ++chunk->failed_dumps;
+        ++chunk->dumps;
+        continue;
+      }
+
+      if (chunk->scan_count == worker->scans_capacity)
+      {
+        int capacity = worker->scans_capacity ? 2 * worker->scans_capacity : 64;
+        struct wifi_ingest_scan *grown = realloc(worker->scans, capacity * sizeof(struct wifi_ingest_scan));
+        if (grown == NULL)
+          return -1;
+        worker->scans = grown;
+        worker->scans_capacity = capacity;
+      }
+
+      struct wifi_ingest_scan *scan = &worker->scans[chunk->scan_count++];
+      scan->file = chunk->file;
+      scan->dump = chunk->first_dump + chunk->dumps++;
+      scan->timestamp_ns = part.timestamp_ns;
+      scan->bss_count = scanned;
+      scan->bss = NULL;
+
+      if (scanned && (scan->bss = arena_alloc(worker, chunk, scanned * sizeof(struct bss_info))) == NULL)
+        return -1;
+      memcpy((void*)scan->bss, worker->bss, scanned * sizeof(struct bss_info));
+      chunk->bss += scanned;
+    }
+  }
+
+  if (chunk->scan_count && (chunk->scans = arena_alloc(worker, chunk, chunk->scan_count * sizeof(struct wifi_ingest_scan))) == NULL)
+    return -1;
+
+  memcpy(chunk->scans, worker->scans, chunk->scan_count * sizeof(struct wifi_ingest_scan));
+  return 0;
+}
+
+static int parse_dump(struct ingest_worker *worker, const struct ingest_file *file, size_t offset, size_t end)
+{
+  struct ingest_part part;
+  size_t begin = offset;
+  int scanned = 0;
+
+  for (;;)
+  {
+    //the same parser as wifi_scan_all, the parts are fed as they were received
+    for (offset = begin, scanned = 0; scanned != -1 && next_part(file, &offset, end, &part); )
+      scanned = wifi_scan_parse_scan_results(part.data, part.length, worker->bss, worker->bss_capacity, scanned);
+
+    if (scanned == -1)
+    {
+      errno = EBADMSG;
+      return -1;
+    }
+
+    if (scanned <= worker->bss_capacity)
+      return scanned;
+
+    //more BSSes than ever before, grow and parse again
+    int capacity = worker->bss_capacity ? worker->bss_capacity : INGEST_INITIAL_BSS;
+    while (capacity < scanned)
+      capacity *= 2;
+
+    struct bss_info *grown = realloc(worker->bss, capacity * sizeof(struct bss_info));
+    if (grown == NULL)
+      return -1;
+    worker->bss = grown;
+    worker->bss_capacity = capacity;
+  }
+}
+
+static void *arena_alloc(struct ingest_worker *worker, struct ingest_chunk *chunk, size_t size)
+{
+  struct ingest_block *block = chunk->blocks;
+  void *memory;
+
+  size = (size + 7) & ~(size_t)7;
+
+  if (block == NULL || block->used + size > block->size)
+  {
+    size_t block_size = size > INGEST_BLOCK_SIZE ? size : INGEST_BLOCK_SIZE;
+
+    pthread_mutex_lock(&worker->lock);
+    if ((block = worker->free_blocks) != NULL && block->size >= block_size)
+      worker->free_blocks = block->next;
+    else
+      block = NULL;
+    pthread_mutex_unlock(&worker->lock);
+
+    if (block == NULL)
+    {
+      if ((block = malloc(sizeof(struct ingest_block) + block_size)) == NULL)
+      {
+        errno = ENOMEM;
+        return NULL;
+      }
+      block->size = block_size;
+    }
+
+    block->used = 0;
+    block->next = chunk->blocks;
+    chunk->blocks = block;
+  }
+
+  memory = block->data + block->used;
+  block->used += size;
+  return memory;
+}
@@ -0,0 +1,80 @@
+/*
+ * wifi-scan library offline ingest header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Parallel parsing of recorded scan results
+ *
+ * Input files are either capture files (see wifi_scan_capture_start) or raw netlink streams
+ * of NL80211_CMD_NEW_SCAN_RESULTS dumps (e.g. as passed to wifi_scan_init_fake).
+ * Each complete dump (ending with NLMSG_DONE) is a scan.
+ *
+ * The files are split into chunks of whole dumps which are parsed by a pool of threads
+ * with work stealing (each thread has its own queue and steals from others when it runs out).
+ * Parsed scans are stored in per thread arenas and handed to the callback in input order,
+ * in the calling thread. Memory is bounded by the number of chunks in flight.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_ingest_constants {WIFI_INGEST_CHUNK_BYTES=1<<20};
+
+// single parsed scan handed to the callback
+struct wifi_ingest_scan
+{
+	int file; //index of the input file
+	uint64_t dump; //index of the dump within file
+	uint64_t timestamp_ns; //of the last dump part in capture file or 0 for raw stream
+	int bss_count;
+	const struct bss_info *bss; //valid only during the callback
+};
+
+struct wifi_ingest_stats
+{
+	int threads; //the number of parsing threads used
+	int chunks; //the number of work units
+	uint64_t steals; //chunks taken from other threads queue
+	uint64_t bytes; //of input files
+	uint64_t dumps; //complete dumps found
+	uint64_t failed_dumps; //dumps not parsed (e.g. interrupted or with error message), not handed to callback
+	uint64_t bss; //in all the scans
+};
+
+/* Called for each scan in the order of input files and dumps
+ *
+ * returns:
+ * 0 to continue, -1 to stop ingest
+ */
+typedef int (*wifi_ingest_callback)(const struct wifi_ingest_scan *scan, void *user);
+
+/* Parse the files with thread pool and hand the scans to callback in order
+ *
+ * parameters:
+ * paths - capture files and/or raw netlink streams
+ * paths_length - the number of files
+ * threads - parsing threads or 0 for the number of online CPUs
+ * callback - called in the calling thread for each scan
+ * user - passed to callback
+ * stats - filled with statistics, may be NULL
+ *
+ * returns:
+ * -1 on error (errno is set, ECANCELED if callback stopped ingest), 0 on success
+ */
+int wifi_ingest(const char * const *paths, int paths_length, int threads, wifi_ingest_callback callback, void *user, struct wifi_ingest_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
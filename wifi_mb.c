@@ -0,0 +1,38 @@
+/*
+ * wifi-scan library decibel helpers implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+#include "wifi_mb.h"
+
+// binary logarithm in 16.16 fixed point by repeated squaring, times log10(2)
+int32_t wifi_log10_mb(uint64_t x)
+{
+  uint32_t integer = 0, fraction = 0;
+  uint64_t y;
+  int bit;
+
+  while (x >> (integer + 1))
+    ++integer;
+
+  //mantissa in [1, 2) as 16.16
+  y = integer >= 16 ? x >> (integer - 16) : x << (16 - integer);
+
+  for (bit = 15; bit >= 0; --bit)
+  {
+    y = (y * y) >> 16;
+    if (y >= 2 << 16)
+    {
+      y >>= 1;
+      fraction |= 1u << bit;
+    }
+  }
+
+  return (int32_t)((((uint64_t)integer << 16 | fraction) * 30103 + (100u << 16) / 2) / (100u << 16));
+}
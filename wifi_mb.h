@@ -0,0 +1,37 @@
+/*
+ * wifi-scan library decibel helpers header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Fixed point decibel arithmetic shared by the library modules (not installed)
+ *
+ * Power in mB (1/100 of dB) is kept in integers, conversions don't need libm.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Get 1000 * log10(x) for x >= 1, that is dB in mB
+ *
+ * Accurate to 1 mB over the whole range.
+ *
+ * returns:
+ * 1000 * log10(x) rounded to nearest, 0 for x = 0
+ */
+int32_t wifi_log10_mb(uint64_t x);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,383 @@
+/*
+ * wifi-scan library MinHash sketches implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * MinHash Overview
+  *
+  * BSSID is hashed once to 64 bits, the hash functions are (a_i * x + b_i) >> 32 with odd a_i.
+  * Minimums are computed over full 32 bits and then truncated to 16 bits (b-bit MinHash),
+  * false equality of 1/65536 is negligible next to sketch estimation error.
+  *
+  * Index keeps all the sketches and labels in arrays by id. Each band of the sketch is hashed
+  * to 64 bit bucket key (band number included) in single open addressing hash table holding the newest scan
+  * of the bucket. Older scans of the same bucket are linked through next array (one link per scan and band).
+  *
+  */
+
+#include "wifi_minhash.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// internal data passed around by user
+struct wifi_minhash_index
+{
+  struct wifi_minhash *sketches; //by id
+  uint64_t *labels; //by id
+  uint32_t *next; //[id * WIFI_MINHASH_BANDS + band], id + 1 of older scan in the same bucket, 0 at the end
+  int count;
+  int capacity;
+  uint64_t *keys; //bucket keys
+  uint32_t *heads; //id + 1 of the newest scan in bucket, 0 for empty slot
+  uint32_t table_size; //power of 2, at least twice the buckets
+  uint32_t buckets;
+};
+
+// DECLARATIONS
+
+// public interface - sketches
+void wifi_minhash_sketch(const struct bss_info *bss, int bss_length, struct wifi_minhash *sketch);
+float wifi_minhash_similarity(const struct wifi_minhash *a, const struct wifi_minhash *b);
+// public interface - empty index
+struct wifi_minhash_index *wifi_minhash_index_new(void);
+// public interface - free index memory
+void wifi_minhash_index_free(struct wifi_minhash_index *index);
+// public interface - add sketch
+int wifi_minhash_index_add(struct wifi_minhash_index *index, const struct wifi_minhash *sketch, uint64_t label);
+// public interface - accessors
+int wifi_minhash_index_size(const struct wifi_minhash_index *index);
+// public interface - similar scans
+int wifi_minhash_index_query(const struct wifi_minhash_index *index, const struct wifi_minhash *sketch, float min_similarity, struct wifi_minhash_match *matches, int matches_length);
+
+// HASHING HELPERS
+
+static uint64_t mix64(uint64_t x);
+// bucket key of band of the sketch
+static uint64_t band_key(const struct wifi_minhash *sketch, int band);
+// true for sketch of empty scan
+static bool sketch_empty(const struct wifi_minhash *sketch);
+
+// INDEX HELPERS
+
+// slot with the key or empty slot where it belongs
+static uint32_t find_slot(const struct wifi_minhash_index *index, uint64_t key);
+// rebuild hash table with twice the size
+static bool table_grow(struct wifi_minhash_index *index);
+// make room for one more scan
+static bool arrays_grow(struct wifi_minhash_index *index);
+static int compare_ids(const void *a, const void *b);
+static int compare_matches(const void *a, const void *b);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+void wifi_minhash_sketch(const struct bss_info *bss, int bss_length, struct wifi_minhash *sketch)
+{
+  uint64_t a[WIFI_MINHASH_HASHES], b[WIFI_MINHASH_HASHES], x;
+  uint32_t mins[WIFI_MINHASH_HASHES], h;
+  int i, j;
+
+  for (j = 0; j < WIFI_MINHASH_HASHES; ++j)
+  {
+    a[j] = mix64(2 * j + 1) | 1;
+    b[j] = mix64(2 * j + 2);
+    mins[j] = UINT32_MAX;
+  }
+
+  for (i = 0; i < bss_length; ++i)
+  {
+    x = 0;
+    memcpy(&x, bss[i].bssid, BSSID_LENGTH);
+    x = mix64(x);
+
+    for (j = 0; j < WIFI_MINHASH_HASHES; ++j)
+    {
+      h = (uint32_t)((a[j] * x + b[j]) >> 32);
+      if (h < mins[j])
+        mins[j] = h;
+    }
+  }
+
+  for (j = 0; j < WIFI_MINHASH_HASHES; ++j)
+    sketch->mins[j] = bss_length > 0 ? (uint16_t)mins[j] : UINT16_MAX;
+}
+
+// public interface
+float wifi_minhash_similarity(const struct wifi_minhash *a, const struct wifi_minhash *b)
+{
+  int j, equal = 0;
+
+  for (j = 0; j < WIFI_MINHASH_HASHES; ++j)
+    equal += a->mins[j] == b->mins[j];
+
+  return (float)equal / WIFI_MINHASH_HASHES;
+}
+
+// public interface
+struct wifi_minhash_index *wifi_minhash_index_new(void)
+{
+  return calloc(sizeof(struct wifi_minhash_index), 1);
+}
+
+// public interface
+void wifi_minhash_index_free(struct wifi_minhash_index *index)
+{
+  if (index == NULL)
+    return;
+
+  free(index->sketches);
+  free(index->labels);
+  free(index->next);
+  free(index->keys);
+  free(index->heads);
+  free(index);
+}
+
+// public interface
+//
+// prerequisities:
+// - index created with wifi_minhash_index_new
+int wifi_minhash_index_add(struct wifi_minhash_index *index, const struct wifi_minhash *sketch, uint64_t label)
+{
+  uint32_t *next;
+  uint64_t key;
+  uint32_t slot;
+  int band;
+
+  if (index->count == index->capacity && !arrays_grow(index))
+    return -1;
+
+  //at most one new bucket per band
+  if (2 * (index->buckets + WIFI_MINHASH_BANDS) > index->table_size && !table_grow(index))
+    return -1;
+
+  next = index->next + (size_t)index->count * WIFI_MINHASH_BANDS;
+  memset(next, 0, WIFI_MINHASH_BANDS * sizeof(uint32_t));
+
+  for (band = 0; band < WIFI_MINHASH_BANDS && !sketch_empty(sketch); ++band)
+  {
+    key = band_key(sketch, band);
+    slot = find_slot(index, key);
+
+    if (index->heads[slot] == 0)
+    {
+      index->keys[slot] = key;
+      ++index->buckets;
+    }
+
+    next[band] = index->heads[slot];
+    index->heads[slot] = index->count + 1;
+  }
+
+  index->sketches[index->count] = *sketch;
+  index->labels[index->count] = label;
+
+  return index->count++;
+}
+
+// public interface
+int wifi_minhash_index_size(const struct wifi_minhash_index *index)
+{
+  return index->count;
+}
+
+// public interface
+//
+// prerequisities:
+// - index created with wifi_minhash_index_new
+// - matches of at least matches_length elements
+int wifi_minhash_index_query(const struct wifi_minhash_index *index, const struct wifi_minhash *sketch, float min_similarity, struct wifi_minhash_match *matches, int matches_length)
+{
+  struct wifi_minhash_match *found;
+  uint32_t *candidates = NULL, id;
+  int count = 0, capacity = 0, unique = 0, kept = 0, band, i;
+
+  if (matches_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (index->count == 0 || sketch_empty(sketch))
+    return 0;
+
+  for (band = 0; band < WIFI_MINHASH_BANDS && count < WIFI_MINHASH_MAX_CANDIDATES; ++band)
+  {
+    uint32_t slot = find_slot(index, band_key(sketch, band));
+
+    for (id = index->heads[slot]; id && count < WIFI_MINHASH_MAX_CANDIDATES; id = index->next[(size_t)(id - 1) * WIFI_MINHASH_BANDS + band])
+    {
+      if (count == capacity)
+      {
+        uint32_t *grown = realloc(candidates, (capacity = capacity ? 2 * capacity : 256) * sizeof(uint32_t));
+        if (grown == NULL)
+        {
+          free(candidates);
+          return -1;
+        }
+        candidates = grown;
+      }
+      candidates[count++] = id - 1;
+    }
+  }
+
+  //the same scan is usually hit by many bands
+  qsort(candidates, count, sizeof(uint32_t), compare_ids);
+  for (i = 0; i < count; ++i)
+    if (unique == 0 || candidates[unique - 1] != candidates[i])
+      candidates[unique++] = candidates[i];
+
+  if ((found = malloc((unique + 1) * sizeof(struct wifi_minhash_match))) == NULL)
+  {
+    free(candidates);
+    return -1;
+  }
+
+  for (i = 0; i < unique; ++i)
+  {
+    float similarity = wifi_minhash_similarity(sketch, &index->sketches[candidates[i]]);
+
+    if (similarity < min_similarity)
+      continue;
+
+    found[kept].label = index->labels[candidates[i]];
+    found[kept].id = candidates[i];
+    found[kept++].similarity = similarity;
+  }
+
+  qsort(found, kept, sizeof(struct wifi_minhash_match), compare_matches);
+
+  if (kept > matches_length)
+    kept = matches_length;
+
+  memcpy(matches, found, kept * sizeof(struct wifi_minhash_match));
+
+  free(found);
+  free(candidates);
+  return kept;
+}
+
+// HASHING HELPERS
+
+// splitmix64 finalizer
+static uint64_t mix64(uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static uint64_t band_key(const struct wifi_minhash *sketch, int band)
+{
+  const uint16_t *rows = sketch->mins + band * WIFI_MINHASH_ROWS;
+  uint64_t key = band;
+  int r;
+
+  for (r = 0; r < WIFI_MINHASH_ROWS; ++r)
+    key = mix64(key ^ rows[r]);
+
+  return key;
+}
+
+static bool sketch_empty(const struct wifi_minhash *sketch)
+{
+  int j;
+
+  for (j = 0; j < WIFI_MINHASH_HASHES; ++j)
+    if (sketch->mins[j] != UINT16_MAX)
+      return false;
+
+  return true;
+}
+
+// INDEX HELPERS
+
+static uint32_t find_slot(const struct wifi_minhash_index *index, uint64_t key)
+{
+  uint32_t slot = (uint32_t)(key >> 32) & (index->table_size - 1);
+
+  while (index->heads[slot] && index->keys[slot] != key)
+    slot = (slot + 1) & (index->table_size - 1);
+
+  return slot;
+}
+
+static bool table_grow(struct wifi_minhash_index *index)
+{
+  struct wifi_minhash_index grown = *index;
+  uint32_t slot, i;
+
+  grown.table_size = index->table_size ? 2 * index->table_size : 1024;
+  grown.keys = malloc(grown.table_size * sizeof(uint64_t));
+  grown.heads = calloc(grown.table_size, sizeof(uint32_t));
+
+  if (grown.keys == NULL || grown.heads == NULL)
+  {
+    free(grown.keys);
+    free(grown.heads);
+    return false;
+  }
+
+  for (i = 0; i < index->table_size; ++i)
+  {
+    if (index->heads[i] == 0)
+      continue;
+    slot = find_slot(&grown, index->keys[i]);
+    grown.keys[slot] = index->keys[i];
+    grown.heads[slot] = index->heads[i];
+  }
+
+  free(index->keys);
+  free(index->heads);
+  index->keys = grown.keys;
+  index->heads = grown.heads;
+  index->table_size = grown.table_size;
+  return true;
+}
+
+static bool arrays_grow(struct wifi_minhash_index *index)
+{
+  int capacity = index->capacity ? 2 * index->capacity : 1024;
+  void *grown;
+
+  if ((grown = realloc(index->sketches, capacity * sizeof(struct wifi_minhash))) == NULL)
+    return false;
+  index->sketches = grown;
+
+  if ((grown = realloc(index->labels, capacity * sizeof(uint64_t))) == NULL)
+    return false;
+  index->labels = grown;
+
+  if ((grown = realloc(index->next, (size_t)capacity * WIFI_MINHASH_BANDS * sizeof(uint32_t))) == NULL)
+    return false;
+  index->next = grown;
+
+  index->capacity = capacity;
+  return true;
+}
+
+static int compare_ids(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static int compare_matches(const void *a, const void *b)
+{
+  const struct wifi_minhash_match *x = a, *y = b;
+
+  if (x->similarity != y->similarity)
+    return x->similarity > y->similarity ? -1 : 1;
+  return x->id - y->id;
+}
@@ -0,0 +1,109 @@
+/*
+ * wifi-scan library MinHash sketches header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Compact sketches of scans BSSID sets and locality sensitive hashing index
+ *
+ * Sketch keeps WIFI_MINHASH_HASHES minimums of independent hashes of the BSSIDs
+ * (lower 16 bits of each) so that the fraction of equal minimums estimates
+ * Jaccard similarity of two sets. Signal is not used.
+ *
+ * Index splits sketch into WIFI_MINHASH_BANDS bands of WIFI_MINHASH_ROWS minimums.
+ * Scans with any band equal to the query are candidates (likely for similarity above ~0.5)
+ * and only candidates are compared, so the query time depends on the number of similar scans
+ * and not on the size of the index.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_minhash_constants {WIFI_MINHASH_HASHES=64, WIFI_MINHASH_BANDS=16, WIFI_MINHASH_ROWS=4, WIFI_MINHASH_MAX_CANDIDATES=65536};
+
+// sketch of BSSID set
+struct wifi_minhash
+{
+	uint16_t mins[WIFI_MINHASH_HASHES];
+};
+
+// single result of the query
+struct wifi_minhash_match
+{
+	uint64_t label; //as passed to wifi_minhash_index_add
+	int id; //index of the scan in the index
+	float similarity; //estimated Jaccard similarity
+};
+
+// internal data used by the index functions
+struct wifi_minhash_index;
+
+/* Compute sketch of BSSIDs (e.g. from wifi_scan_all)
+ *
+ * parameters:
+ * bss - scan results
+ * bss_length - the number of bss elements
+ * sketch - filled with the sketch
+ */
+void wifi_minhash_sketch(const struct bss_info *bss, int bss_length, struct wifi_minhash *sketch);
+
+/* Estimate Jaccard similarity of BSSID sets (0.0 to 1.0) */
+float wifi_minhash_similarity(const struct wifi_minhash *a, const struct wifi_minhash *b);
+
+/* Create empty index
+ *
+ * returns:
+ * struct wifi_minhash_index * - pass it to the index functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_minhash_index *wifi_minhash_index_new(void);
+
+/* Free the index */
+void wifi_minhash_index_free(struct wifi_minhash_index *index);
+
+/* Add sketch to the index
+ *
+ * Sketch of empty scan is stored but never matched.
+ *
+ * parameters:
+ * index - index
+ * sketch - sketch of the scan
+ * label - user data returned with matches (e.g. device and time)
+ *
+ * returns:
+ * -1 on error (errno is set) or id of the scan (0, 1, 2, ...)
+ */
+int wifi_minhash_index_add(struct wifi_minhash_index *index, const struct wifi_minhash *sketch, uint64_t label);
+
+/* Get the number of scans in the index */
+int wifi_minhash_index_size(const struct wifi_minhash_index *index);
+
+/* Find the scans similar to the sketch
+ *
+ * At most WIFI_MINHASH_MAX_CANDIDATES band hits are considered (the most recent scans first).
+ *
+ * parameters:
+ * index - index
+ * sketch - sketch of the query scan
+ * min_similarity - skip candidates with lower estimated similarity
+ * matches - filled in the order of decreasing similarity (ties by id)
+ * matches_length - the size of matches array
+ *
+ * returns:
+ * -1 on error (errno is set), the number of matches otherwise
+ */
+int wifi_minhash_index_query(const struct wifi_minhash_index *index, const struct wifi_minhash *sketch, float min_similarity, struct wifi_minhash_match *matches, int matches_length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,556 @@
+/*
+ * wifi-scan library presence detector implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Presence Overview
+  *
+  * BSSIDs of places are interned in dictionary (see wifi_bssid_map.h). Place keeps membership bitset over
+  * dictionary ids, number of set bits before each word (rank) and levels in the order of set bits,
+  * so the level of BSSID in place is a bit test and popcount.
+  *
+  * Detector remembers levels of the last scan by dictionary id. Each place keeps sum of its levels (mass)
+  * and sum of minimums with the last scan (overlap), weighted Jaccard is overlap / (scan mass + place mass - overlap).
+  * New scan changes overlap only through BSSIDs with different level than in the previous scan.
+  * BSSIDs which are not in any place count only in the scan mass and are not interned.
+  *
+  */
+
+#include "wifi_presence.h"
+#include "wifi_bssid_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// reference BSSIDs of the place
+struct presence_place
+{
+  uint64_t *words; //membership bitset over dictionary ids
+  uint32_t *ranks; //set bits before each word
+  uint8_t *levels; //in the order of set bits
+  int words_count;
+  int32_t mass; //sum of levels
+  int32_t overlap; //sum of minimum levels with the last scan
+  float similarity; //with the last scan
+  bool inside;
+  int streak; //consecutive scans voting for state change
+};
+
+// dictionary id with level
+struct presence_level
+{
+  int id;
+  uint8_t level;
+};
+
+// internal data passed around by user
+struct wifi_presence
+{
+  struct wifi_presence_config config;
+  struct wifi_bssid_map *dictionary;
+  uint8_t *levels; //by dictionary id in the last scan, 0 if not seen
+  uint8_t *incoming; //by dictionary id in the scan being processed, all 0 between updates
+  int levels_capacity;
+  int *present; //dictionary ids seen in the last scan
+  int *arrived; //dictionary ids seen in the scan being processed
+  int ids_capacity; //of present and arrived
+  int present_count;
+  int32_t scan_mass; //sum of levels of the last scan (including BSSIDs not in dictionary)
+  struct presence_place *places;
+  int places_count;
+  int places_capacity;
+};
+
+// DECLARATIONS
+
+// public interface - detector without places
+struct wifi_presence *wifi_presence_new(const struct wifi_presence_config *config);
+// public interface - free detector memory
+void wifi_presence_free(struct wifi_presence *presence);
+// public interface - places
+int wifi_presence_add_place(struct wifi_presence *presence, const struct bss_info *bss, int bss_length);
+int wifi_presence_extend_place(struct wifi_presence *presence, int place, const struct bss_info *bss, int bss_length);
+int wifi_presence_places(const struct wifi_presence *presence);
+// public interface - process scan
+int wifi_presence_update(struct wifi_presence *presence, const struct bss_info *bss, int bss_length, struct wifi_presence_event *events, int events_length);
+// public interface - state
+float wifi_presence_similarity(const struct wifi_presence *presence, int place);
+bool wifi_presence_inside(const struct wifi_presence *presence, int place);
+
+// PLACE HELPERS
+
+// signal in mBm to level, 0 under the floor
+static uint8_t signal_level(int32_t signal_mbm);
+// level of dictionary id in the place, 0 if not member
+static uint8_t place_level(const struct presence_place *place, int id);
+// build place from levels sorted by id without duplicates, false on error
+static bool place_build(struct presence_place *place, const struct presence_level *levels, int count);
+static void place_free(struct presence_place *place);
+// interns bss and appends the levels of place (may be NULL) to allocated array, sorted and merged, -1 on error or the count
+static int place_levels(struct wifi_presence *presence, const struct presence_place *place, const struct bss_info *bss, int bss_length, struct presence_level **levels);
+// overlap of place with the last scan
+static int32_t place_overlap(const struct wifi_presence *presence, const struct presence_place *place);
+static int compare_levels(const void *a, const void *b);
+
+// DETECTOR HELPERS
+
+// make room for levels of all dictionary ids
+static bool levels_grow(struct wifi_presence *presence);
+// apply level change of dictionary id to overlap of all places
+static void apply_change(struct wifi_presence *presence, int id, uint8_t old_level, uint8_t new_level);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_presence *wifi_presence_new(const struct wifi_presence_config *config)
+{
+  struct wifi_presence_config defaults = {0.5f, 0.3f, 2};
+  struct wifi_presence *presence;
+
+  if (config == NULL)
+    config = &defaults;
+
+  if (config->leave > config->enter || config->confirm_scans < 1)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if ((presence = calloc(sizeof(struct wifi_presence), 1)) == NULL)
+    return NULL;
+
+  if ((presence->dictionary = wifi_bssid_map_new()) == NULL)
+  {
+    free(presence);
+    return NULL;
+  }
+
+  presence->config = *config;
+  return presence;
+}
+
+// public interface
+void wifi_presence_free(struct wifi_presence *presence)
+{
+  int p;
+
+  if (presence == NULL)
+    return;
+
+  for (p = 0; p < presence->places_count; ++p)
+    place_free(&presence->places[p]);
+
+  free(presence->places);
+  free(presence->present);
+  free(presence->arrived);
+  free(presence->levels);
+  free(presence->incoming);
+  wifi_bssid_map_free(presence->dictionary);
+  free(presence);
+}
+
+// public interface
+//
+// prerequisities:
+// - presence created with wifi_presence_new
+int wifi_presence_add_place(struct wifi_presence *presence, const struct bss_info *bss, int bss_length)
+{
+  struct presence_place *place;
+  struct presence_level *levels;
+  int count;
+
+  if (presence->places_count == presence->places_capacity)
+  {
+    int capacity = presence->places_capacity ? 2 * presence->places_capacity : 16;
+    struct presence_place *grown = realloc(presence->places, capacity * sizeof(struct presence_place));
+    if (grown == NULL)
+      return -1;
+    presence->places = grown;
+    presence->places_capacity = capacity;
+  }
+
+  if ((count = place_levels(presence, NULL, bss, bss_length, &levels)) == -1)
+    return -1;
+
+  place = &presence->places[presence->places_count];
+  memset(place, 0, sizeof(struct presence_place));
+
+  if (!place_build(place, levels, count))
+  {
+    free(levels);
+    return -1;
+  }
+
+  free(levels);
+  place->overlap = place_overlap(presence, place);
+  return presence->places_count++;
+}
+
+// public interface
+//
+// prerequisities:
+// - presence created with wifi_presence_new
+int wifi_presence_extend_place(struct wifi_presence *presence, int place, const struct bss_info *bss, int bss_length)
+{
+  struct presence_place extended = {0};
+  struct presence_level *levels;
+  int count;
+
+  if (place < 0 || place >= presence->places_count)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((count = place_levels(presence, &presence->places[place], bss, bss_length, &levels)) == -1)
+    return -1;
+
+  if (!place_build(&extended, levels, count))
+  {
+    free(levels);
+    return -1;
+  }
+
+  free(levels);
+
+  //keep the state, similarity is refreshed with the next scan
+  extended.similarity = presence->places[place].similarity;
+  extended.inside = presence->places[place].inside;
+  extended.streak = presence->places[place].streak;
+  extended.overlap = place_overlap(presence, &extended);
+
+  place_free(&presence->places[place]);
+  presence->places[place] = extended;
+  return 0;
+}
+
+// public interface
+int wifi_presence_places(const struct wifi_presence *presence)
+{
+  return presence->places_count;
+}
+
+// public interface
+//
+// prerequisities:
+// - presence created with wifi_presence_new
+int wifi_presence_update(struct wifi_presence *presence, const struct bss_info *bss, int bss_length, struct wifi_presence_event *events, int events_length)
+{
+  const struct wifi_presence_config *config = &presence->config;
+  int arrived = 0, found = 0, i, p, id, *swap;
+  int32_t scan_mass = 0;
+  uint8_t level;
+
+  if (bss_length < 0 || (bss_length > 0 && bss == NULL) || events_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  //dictionary may have grown without levels if adding place failed
+  if (!levels_grow(presence))
+    return -1;
+
+  if (bss_length > presence->ids_capacity)
+  {
+    int *present = realloc(presence->present, bss_length * sizeof(int));
+    if (present == NULL)
+      return -1;
+    presence->present = present;
+
+    int *grown = realloc(presence->arrived, bss_length * sizeof(int));
+    if (grown == NULL)
+      return -1;
+    presence->arrived = grown;
+    presence->ids_capacity = bss_length;
+  }
+
+  for (i = 0; i < bss_length; ++i)
+  {
+    if ((level = signal_level(bss[i].signal_mbm)) == 0)
+      continue;
+
+    //not in any place, changes only the scan mass
+    if ((id = wifi_bssid_map_find(presence->dictionary, bss[i].bssid)) == -1)
+    {
+      scan_mass += level;
+      continue;
+    }
+
+    if (presence->incoming[id] == 0)
+      presence->arrived[arrived++] = id;
+    if (level > presence->incoming[id])
+      presence->incoming[id] = level;
+  }
+
+  //changed and gone BSSIDs of the last scan, then the new ones
+  for (i = 0; i < presence->present_count; ++i)
+  {
+    id = presence->present[i];
+    if (presence->levels[id] != presence->incoming[id])
+      apply_change(presence, id, presence->levels[id], presence->incoming[id]);
+  }
+
+  for (i = 0; i < arrived; ++i)
+  {
+    id = presence->arrived[i];
+    if (presence->levels[id] == 0)
+      apply_change(presence, id, 0, presence->incoming[id]);
+  }
+
+  for (i = 0; i < presence->present_count; ++i)
+    presence->levels[presence->present[i]] = 0;
+
+  for (i = 0; i < arrived; ++i)
+  {
+    id = presence->arrived[i];
+    presence->levels[id] = presence->incoming[id];
+    presence->incoming[id] = 0;
+    scan_mass += presence->levels[id];
+  }
+
+  swap = presence->present;
+  presence->present = presence->arrived;
+  presence->arrived = swap;
+  presence->present_count = arrived;
+  presence->scan_mass = scan_mass;
+
+  for (p = 0; p < presence->places_count; ++p)
+  {
+    struct presence_place *place = &presence->places[p];
+    int32_t union_mass = scan_mass + place->mass - place->overlap;
+    bool vote;
+
+    place->similarity = union_mass > 0 ? (float)place->overlap / union_mass : 0.0f;
+
+    vote = place->inside ? place->similarity < config->leave : place->similarity >= config->enter;
+    place->streak = vote ? place->streak + 1 : 0;
+
+    if (place->streak < config->confirm_scans)
+      continue;
+
+    place->inside = !place->inside;
+    place->streak = 0;
+
+    if (found < events_length)
+    {
+      events[found].place = p;
+      events[found].type = place->inside ? WIFI_PRESENCE_ENTER : WIFI_PRESENCE_LEAVE;
+      events[found++].similarity = place->similarity;
+    }
+  }
+
+  return found;
+}
+
+// public interface
+float wifi_presence_similarity(const struct wifi_presence *presence, int place)
+{
+  if (place < 0 || place >= presence->places_count)
+    return 0.0f;
+  return presence->places[place].similarity;
+}
+
+// public interface
+bool wifi_presence_inside(const struct wifi_presence *presence, int place)
+{
+  if (place < 0 || place >= presence->places_count)
+    return false;
+  return presence->places[place].inside;
+}
+
+// PLACE HELPERS
+
+static uint8_t signal_level(int32_t signal_mbm)
+{
+  int32_t dbm = signal_mbm / 100, level;
+
+  if (dbm < WIFI_PRESENCE_FLOOR_DBM)
+    return 0;
+
+  level = (dbm - WIFI_PRESENCE_FLOOR_DBM) / WIFI_PRESENCE_LEVEL_DB + 1;
+  return level > WIFI_PRESENCE_MAX_LEVEL ? WIFI_PRESENCE_MAX_LEVEL : level;
+}
+
+static uint8_t place_level(const struct presence_place *place, int id)
+{
+  int word = id >> 6;
+  uint64_t bits, below;
+
+  if (word >= place->words_count)
+    return 0;
+
+  bits = place->words[word];
+  below = ((uint64_t)1 << (id & 63)) - 1;
+
+  if (!(bits >> (id & 63) & 1))
+    return 0;
+
+  return place->levels[place->ranks[word] + __builtin_popcountll(bits & below)];
+}
+
+static bool place_build(struct presence_place *place, const struct presence_level *levels, int count)
+{
+  int i, w;
+
+  place->words_count = count ? levels[count - 1].id / 64 + 1 : 0;
+  place->words = calloc(place->words_count + 1, sizeof(uint64_t));
+  place->ranks = calloc(place->words_count + 1, sizeof(uint32_t));
+  place->levels = malloc(count + 1);
+  place->mass = 0;
+
+  if (place->words == NULL || place->ranks == NULL || place->levels == NULL)
+  {
+    place_free(place);
+    return false;
+  }
+
+  for (i = 0; i < count; ++i)
+  {
+    place->words[levels[i].id >> 6] |= (uint64_t)1 << (levels[i].id & 63);
+    place->levels[i] = levels[i].level;
+    place->mass += levels[i].level;
+  }
+
+  for (w = 1; w < place->words_count; ++w)
+    place->ranks[w] = place->ranks[w - 1] + __builtin_popcountll(place->words[w - 1]);
+
+  return true;
+}
+
+static void place_free(struct presence_place *place)
+{
+  free(place->words);
+  free(place->ranks);
+  free(place->levels);
+  place->words = NULL;
+  place->ranks = NULL;
+  place->levels = NULL;
+}
+
+static int place_levels(struct wifi_presence *presence, const struct presence_place *place, const struct bss_info *bss, int bss_length, struct presence_level **levels)
+{
+  struct presence_level *l;
+  int existing = place && place->words_count ? place->ranks[place->words_count - 1] + __builtin_popcountll(place->words[place->words_count - 1]) : 0;
+  int count = 0, merged, i, w;
+  uint64_t bits;
+
+  if (bss_length < 0 || (bss_length > 0 && bss == NULL))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  //at least one element so that NULL means error
+  if ((l = malloc((existing + bss_length + 1) * sizeof(struct presence_level))) == NULL)
+    return -1;
+
+  for (w = 0; place && w < place->words_count; ++w)
+    for (bits = place->words[w]; bits; bits &= bits - 1)
+    {
+      l[count].id = w * 64 + __builtin_ctzll(bits);
+      l[count].level = place->levels[count];
+      ++count;
+    }
+
+  for (i = 0; i < bss_length; ++i)
+  {
+    if ((l[count].level = signal_level(bss[i].signal_mbm)) == 0)
+      continue;
+
+    if ((l[count++].id = wifi_bssid_map_add(presence->dictionary, bss[i].bssid)) == -1)
+    {
+      free(l);
+      return -1;
+    }
+  }
+
+  if (!levels_grow(presence))
+  {
+    free(l);
+    return -1;
+  }
+
+  qsort(l, count, sizeof(struct presence_level), compare_levels);
+
+  //keep the strongest level of the same id
+  for (i = 1, merged = count ? 1 : 0; i < count; ++i)
+    if (l[merged - 1].id != l[i].id)
+      l[merged++] = l[i];
+    else if (l[i].level > l[merged - 1].level)
+      l[merged - 1].level = l[i].level;
+
+  *levels = l;
+  return merged;
+}
+
+static int32_t place_overlap(const struct wifi_presence *presence, const struct presence_place *place)
+{
+  int32_t overlap = 0;
+  int i, id;
+
+  for (i = 0; i < presence->present_count; ++i)
+  {
+    uint8_t level = place_level(place, id = presence->present[i]);
+    overlap += level < presence->levels[id] ? level : presence->levels[id];
+  }
+
+  return overlap;
+}
+
+static int compare_levels(const void *a, const void *b)
+{
+  return ((const struct presence_level *)a)->id - ((const struct presence_level *)b)->id;
+}
+
+// DETECTOR HELPERS
+
+static bool levels_grow(struct wifi_presence *presence)
+{
+  int size = wifi_bssid_map_size(presence->dictionary), capacity = presence->levels_capacity ? presence->levels_capacity : 256;
+  uint8_t *levels, *incoming;
+
+  if (size <= presence->levels_capacity)
+    return true;
+
+  while (capacity < size)
+    capacity *= 2;
+
+  if ((levels = realloc(presence->levels, capacity)) == NULL)
+    return false;
+  presence->levels = levels;
+
+  if ((incoming = realloc(presence->incoming, capacity)) == NULL)
+    return false;
+  presence->incoming = incoming;
+
+  memset(levels + presence->levels_capacity, 0, capacity - presence->levels_capacity);
+  memset(incoming + presence->levels_capacity, 0, capacity - presence->levels_capacity);
+  presence->levels_capacity = capacity;
+  return true;
+}
+
+static void apply_change(struct wifi_presence *presence, int id, uint8_t old_level, uint8_t new_level)
+{
+  int p;
+
+  for (p = 0; p < presence->places_count; ++p)
+  {
+    struct presence_place *place = &presence->places[p];
+    uint8_t level = place_level(place, id);
+
+    if (level == 0)
+      continue;
+
+    place->overlap += (new_level < level ? new_level : level) - (old_level < level ? old_level : level);
+  }
+}
@@ -0,0 +1,108 @@
+/*
+ * wifi-scan library presence detector header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * "Am I at place A?" from consecutive scans
+ *
+ * Place is the set of BSSIDs (from one or more reference scans) with signal levels
+ * of WIFI_PRESENCE_LEVEL_DB steps above WIFI_PRESENCE_FLOOR_DBM. Each scan is compared with all the places
+ * by weighted Jaccard similarity (sum of minimum levels / sum of maximum levels).
+ *
+ * The similarity is updated incrementally, only BSSIDs which changed level since the previous scan
+ * are looked up in the places. Entering the place needs similarity of at least enter threshold and leaving
+ * similarity under leave threshold, both for confirm_scans consecutive scans.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_presence_constants {WIFI_PRESENCE_FLOOR_DBM=-95, WIFI_PRESENCE_LEVEL_DB=5, WIFI_PRESENCE_MAX_LEVEL=13};
+
+enum wifi_presence_event_type {WIFI_PRESENCE_ENTER=0, WIFI_PRESENCE_LEAVE};
+
+struct wifi_presence_config
+{
+	float enter; //similarity to enter the place
+	float leave; //similarity under which the place is left, not greater than enter
+	int confirm_scans; //consecutive scans needed to change the state
+};
+
+struct wifi_presence_event
+{
+	int place; //as returned from wifi_presence_add_place
+	enum wifi_presence_event_type type;
+	float similarity; //in the scan that triggered the event
+};
+
+// internal data used by the functions
+struct wifi_presence;
+
+/* Create presence detector without places
+ *
+ * parameters:
+ * config - thresholds or NULL for defaults (enter 0.5, leave 0.3, confirm 2 scans)
+ *
+ * returns:
+ * struct wifi_presence * - pass it to the presence functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_presence *wifi_presence_new(const struct wifi_presence_config *config);
+
+/* Free the detector */
+void wifi_presence_free(struct wifi_presence *presence);
+
+/* Add place from reference scan
+ *
+ * returns:
+ * -1 on error (errno is set) or place id (0, 1, 2, ...)
+ */
+int wifi_presence_add_place(struct wifi_presence *presence, const struct bss_info *bss, int bss_length);
+
+/* Add another reference scan to the place (the stronger level counts)
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_presence_extend_place(struct wifi_presence *presence, int place, const struct bss_info *bss, int bss_length);
+
+/* Get the number of places */
+int wifi_presence_places(const struct wifi_presence *presence);
+
+/* Update the detector with new scan
+ *
+ * There is at most one event per place, events array of wifi_presence_places size gets all of them.
+ * Events that don't fit are not reported but the state changes anyway.
+ *
+ * parameters:
+ * presence - detector
+ * bss - scan results (e.g. from wifi_scan_all)
+ * bss_length - the number of bss elements
+ * events - filled with enter/leave events
+ * events_length - the size of events array
+ *
+ * returns:
+ * -1 on error (errno is set), the number of events otherwise
+ */
+int wifi_presence_update(struct wifi_presence *presence, const struct bss_info *bss, int bss_length, struct wifi_presence_event *events, int events_length);
+
+/* Get similarity of the last scan to the place */
+float wifi_presence_similarity(const struct wifi_presence *presence, int place);
+
+/* Get the state of the place (true if inside) */
+bool wifi_presence_inside(const struct wifi_presence *presence, int place);
+
+#ifdef __cplusplus
+}
+#endif
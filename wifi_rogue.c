@@ -0,0 +1,403 @@
+/*
+ * wifi-scan library rogue AP detector implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Rogue Detector Overview
+  *
+  * Profiles are stored in array indexed from open addressing hash table of SSIDs (profile index + 1).
+  * Trusted BSSIDs are interned (see wifi_bssid_map.h) with ids indexing array of their parameters.
+  * Alerted BSSIDs are interned in another map with the reasons already reported.
+  *
+  * Security is compared by protocols, group and pairwise ciphers, AKMs and management frame protection bits
+  * (other RSN capabilities like replay counters may legitimately differ).
+  *
+  */
+
+#include "wifi_rogue.h"
+#include "wifi_bssid_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// management frame protection required and capable
+#define RSN_CAPABILITIES_MFP 0xC0
+
+// what is legitimate for SSID
+struct rogue_profile
+{
+  char ssid[SSID_MAX_LENGTH_WITH_NULL];
+  struct bss_security securities[WIFI_ROGUE_MAX_SECURITIES];
+  int securities_count;
+  uint32_t frequencies[WIFI_ROGUE_MAX_FREQUENCIES];
+  int frequencies_count;
+};
+
+// trusted BSSID
+struct rogue_bssid
+{
+  int profile;
+  struct bss_security security;
+  uint8_t channel_width;
+};
+
+// internal data passed around by user
+struct wifi_rogue
+{
+  struct rogue_profile *profiles;
+  int profiles_count;
+  int profiles_capacity;
+  uint32_t *ssid_table; //profile index + 1, 0 for empty slot
+  uint32_t ssid_table_size; //power of 2, at least twice the profiles
+  struct wifi_bssid_map *trusted_ids;
+  struct rogue_bssid *trusted; //by trusted id
+  int trusted_capacity;
+  struct wifi_bssid_map *alerted_ids;
+  uint32_t *alerted; //reported reasons by alerted id
+  int alerted_capacity;
+};
+
+// DECLARATIONS
+
+// public interface - detector without profiles
+struct wifi_rogue *wifi_rogue_new(void);
+// public interface - free detector memory
+void wifi_rogue_free(struct wifi_rogue *rogue);
+// public interface - learn legitimate BSSes
+int wifi_rogue_trust(struct wifi_rogue *rogue, const struct bss_info *bss, int bss_length);
+// public interface - check scan
+int wifi_rogue_check(struct wifi_rogue *rogue, const struct bss_info *bss, int bss_length, struct wifi_rogue_alert *alerts, int alerts_length);
+// public interface - accessors
+int wifi_rogue_profiles(const struct wifi_rogue *rogue);
+
+// PROFILE HELPERS
+
+// trust single BSS, -1 on error, 0 on success
+static int trust_bss(struct wifi_rogue *rogue, const struct bss_info *bss);
+// profile index of SSID or -1
+static int profile_find(const struct wifi_rogue *rogue, const char *ssid);
+// profile index of SSID, created if needed, -1 on error
+static int profile_add(struct wifi_rogue *rogue, const char *ssid);
+// rebuild SSID hash table with twice the size
+static bool ssid_table_grow(struct wifi_rogue *rogue);
+static uint32_t hash_ssid(const char *ssid, uint32_t table_size);
+static bool security_equal(const struct bss_security *a, const struct bss_security *b);
+static bool profile_has_security(const struct rogue_profile *profile, const struct bss_security *security);
+static bool profile_has_frequency(const struct rogue_profile *profile, uint32_t frequency);
+
+// CHECK HELPERS
+
+// reasons why BSS is suspicious (0 if it is not or SSID is unknown)
+static uint32_t check_bss(const struct wifi_rogue *rogue, const struct bss_info *bss);
+// make room for parameters of all the ids of the map, false on error
+static bool array_grow(void **array, int *capacity, int size, size_t element_size);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_rogue *wifi_rogue_new(void)
+{
+  struct wifi_rogue *rogue = calloc(sizeof(struct wifi_rogue), 1);
+
+  if (rogue == NULL)
+    return NULL;
+
+  if ((rogue->trusted_ids = wifi_bssid_map_new()) == NULL || (rogue->alerted_ids = wifi_bssid_map_new()) == NULL)
+  {
+    wifi_rogue_free(rogue);
+    return NULL;
+  }
+
+  return rogue;
+}
+
+// public interface
+void wifi_rogue_free(struct wifi_rogue *rogue)
+{
+  if (rogue == NULL)
+    return;
+
+  free(rogue->profiles);
+  free(rogue->ssid_table);
+  free(rogue->trusted);
+  free(rogue->alerted);
+  wifi_bssid_map_free(rogue->trusted_ids);
+  wifi_bssid_map_free(rogue->alerted_ids);
+  free(rogue);
+}
+
+// public interface
+//
+// prerequisities:
+// - rogue created with wifi_rogue_new
+int wifi_rogue_trust(struct wifi_rogue *rogue, const struct bss_info *bss, int bss_length)
+{
+  int i;
+
+  for (i = 0; i < bss_length; ++i)
+    if (trust_bss(rogue, &bss[i]) == -1)
+      return -1;
+
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - rogue created with wifi_rogue_new
+int wifi_rogue_check(struct wifi_rogue *rogue, const struct bss_info *bss, int bss_length, struct wifi_rogue_alert *alerts, int alerts_length)
+{
+  uint32_t reasons;
+  int found = 0, i, id;
+
+  for (i = 0; i < bss_length; ++i)
+  {
+    if ((reasons = check_bss(rogue, &bss[i])) == 0)
+      continue;
+
+    if ((id = wifi_bssid_map_add(rogue->alerted_ids, bss[i].bssid)) == -1)
+      return -1;
+
+    if (!array_grow((void **)&rogue->alerted, &rogue->alerted_capacity, wifi_bssid_map_size(rogue->alerted_ids), sizeof(uint32_t)))
+      return -1;
+
+    //only the reasons not reported before
+    if ((reasons &= ~rogue->alerted[id]) == 0)
+      continue;
+
+    rogue->alerted[id] |= reasons;
+
+    if (found < alerts_length)
+    {
+      alerts[found].bss = bss[i];
+      alerts[found].reasons = reasons;
+    }
+    ++found;
+  }
+
+  return found;
+}
+
+// public interface
+int wifi_rogue_profiles(const struct wifi_rogue *rogue)
+{
+  return rogue->profiles_count;
+}
+
+// PROFILE HELPERS
+
+static int trust_bss(struct wifi_rogue *rogue, const struct bss_info *bss)
+{
+  struct rogue_profile *profile;
+  int p, id;
+
+  if (bss->ssid[0] == '\0')
+    return 0;
+
+  if ((p = profile_add(rogue, bss->ssid)) == -1)
+    return -1;
+
+  profile = &rogue->profiles[p];
+
+  if (!profile_has_security(profile, &bss->security))
+  {
+    if (profile->securities_count == WIFI_ROGUE_MAX_SECURITIES)
+    {
+      errno = ENOSPC;
+      return -1;
+    }
+    profile->securities[profile->securities_count++] = bss->security;
+  }
+
+  if (!profile_has_frequency(profile, bss->frequency))
+  {
+    if (profile->frequencies_count == WIFI_ROGUE_MAX_FREQUENCIES)
+    {
+      errno = ENOSPC;
+      return -1;
+    }
+    profile->frequencies[profile->frequencies_count++] = bss->frequency;
+  }
+
+  if ((id = wifi_bssid_map_add(rogue->trusted_ids, bss->bssid)) == -1)
+    return -1;
+
+  if (!array_grow((void **)&rogue->trusted, &rogue->trusted_capacity, wifi_bssid_map_size(rogue->trusted_ids), sizeof(struct rogue_bssid)))
+    return -1;
+
+  rogue->trusted[id].profile = p;
+  rogue->trusted[id].security = bss->security;
+  rogue->trusted[id].channel_width = bss->channel_width;
+
+  //may alert again
+  if ((id = wifi_bssid_map_find(rogue->alerted_ids, bss->bssid)) != -1)
+    rogue->alerted[id] = 0;
+
+  return 0;
+}
+
+static int profile_find(const struct wifi_rogue *rogue, const char *ssid)
+{
+  uint32_t slot;
+
+  if (rogue->ssid_table_size == 0)
+    return -1;
+
+  for (slot = hash_ssid(ssid, rogue->ssid_table_size); rogue->ssid_table[slot]; slot = (slot + 1) & (rogue->ssid_table_size - 1))
+    if (strcmp(rogue->profiles[rogue->ssid_table[slot] - 1].ssid, ssid) == 0)
+      return rogue->ssid_table[slot] - 1;
+
+  return -1;
+}
+
+static int profile_add(struct wifi_rogue *rogue, const char *ssid)
+{
+  int p = profile_find(rogue, ssid);
+  uint32_t slot;
+
+  if (p != -1)
+    return p;
+
+  if (2 * (rogue->profiles_count + 1) > (int)rogue->ssid_table_size && !ssid_table_grow(rogue))
+    return -1;
+
+  if (rogue->profiles_count == rogue->profiles_capacity)
+  {
+    int capacity = rogue->profiles_capacity ? 2 * rogue->profiles_capacity : 64;
+    struct rogue_profile *grown = realloc(rogue->profiles, capacity * sizeof(struct rogue_profile));
+    if (grown == NULL)
+      return -1;
+    rogue->profiles = grown;
+    rogue->profiles_capacity = capacity;
+  }
+
+  p = rogue->profiles_count++;
+  memset(&rogue->profiles[p], 0, sizeof(struct rogue_profile));
+  strncpy(rogue->profiles[p].ssid, ssid, SSID_MAX_LENGTH_WITH_NULL - 1);
+
+  for (slot = hash_ssid(ssid, rogue->ssid_table_size); rogue->ssid_table[slot]; slot = (slot + 1) & (rogue->ssid_table_size - 1))
+    ;
+  rogue->ssid_table[slot] = p + 1;
+
+  return p;
+}
+
+static bool ssid_table_grow(struct wifi_rogue *rogue)
+{
+  uint32_t table_size = rogue->ssid_table_size ? 2 * rogue->ssid_table_size : 128;
+  uint32_t *table = calloc(table_size, sizeof(uint32_t));
+  uint32_t slot;
+  int p;
+
+  if (table == NULL)
+    return false;
+
+  for (p = 0; p < rogue->profiles_count; ++p)
+  {
+    for (slot = hash_ssid(rogue->profiles[p].ssid, table_size); table[slot]; slot = (slot + 1) & (table_size - 1))
+      ;
+    table[slot] = p + 1;
+  }
+
+  free(rogue->ssid_table);
+  rogue->ssid_table = table;
+  rogue->ssid_table_size = table_size;
+  return true;
+}
+
+// FNV-1a
+static uint32_t hash_ssid(const char *ssid, uint32_t table_size)
+{
+  uint32_t hash = 2166136261u;
+
+  for (; *ssid; ++ssid)
+    hash = (hash ^ (uint8_t)*ssid) * 16777619u;
+
+  return hash & (table_size - 1);
+}
+
+static bool security_equal(const struct bss_security *a, const struct bss_security *b)
+{
+  return a->protocols == b->protocols && a->group_cipher == b->group_cipher && a->pairwise_ciphers == b->pairwise_ciphers
+    && a->akm_suites == b->akm_suites && (a->rsn_capabilities & RSN_CAPABILITIES_MFP) == (b->rsn_capabilities & RSN_CAPABILITIES_MFP);
+}
+
+static bool profile_has_security(const struct rogue_profile *profile, const struct bss_security *security)
+{
+  int i;
+
+  for (i = 0; i < profile->securities_count; ++i)
+    if (security_equal(&profile->securities[i], security))
+      return true;
+
+  return false;
+}
+
+static bool profile_has_frequency(const struct rogue_profile *profile, uint32_t frequency)
+{
+  int i;
+
+  for (i = 0; i < profile->frequencies_count; ++i)
+    if (profile->frequencies[i] == frequency)
+      return true;
+
+  return false;
+}
+
+// CHECK HELPERS
+
+static uint32_t check_bss(const struct wifi_rogue *rogue, const struct bss_info *bss)
+{
+  const struct rogue_profile *profile;
+  const struct rogue_bssid *trusted = NULL;
+  uint32_t reasons = 0;
+  int p, id;
+
+  if (bss->ssid[0] == '\0' || (p = profile_find(rogue, bss->ssid)) == -1)
+    return 0;
+
+  profile = &rogue->profiles[p];
+
+  if ((id = wifi_bssid_map_find(rogue->trusted_ids, bss->bssid)) != -1 && rogue->trusted[id].profile == p)
+    trusted = &rogue->trusted[id];
+
+  if (trusted == NULL)
+    reasons |= WIFI_ROGUE_UNKNOWN_BSSID;
+
+  if (trusted ? !security_equal(&trusted->security, &bss->security) : !profile_has_security(profile, &bss->security))
+    reasons |= WIFI_ROGUE_SECURITY;
+
+  if (!profile_has_frequency(profile, bss->frequency) || (trusted && trusted->channel_width != bss->channel_width))
+    reasons |= WIFI_ROGUE_CHANNEL;
+
+  return reasons;
+}
+
+static bool array_grow(void **array, int *capacity, int size, size_t element_size)
+{
+  int grown_capacity = *capacity ? *capacity : 64;
+  char *grown;
+
+  if (size <= *capacity)
+    return true;
+
+  while (grown_capacity < size)
+    grown_capacity *= 2;
+
+  if ((grown = realloc(*array, grown_capacity * element_size)) == NULL)
+    return false;
+
+  memset(grown + *capacity * element_size, 0, (grown_capacity - *capacity) * element_size);
+  *array = grown;
+  *capacity = grown_capacity;
+  return true;
+}
@@ -0,0 +1,86 @@
+/*
+ * wifi-scan library rogue AP detector header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Rogue AP and evil twin detection
+ *
+ * Legitimate BSSes (e.g. from site survey) are trusted first. Each known SSID gets profile
+ * of its BSSIDs, security parameters (protocols, ciphers, AKMs, management frame protection)
+ * and frequencies. Then each scan is checked record by record:
+ * - known SSID from BSSID not trusted for the SSID (evil twin)
+ * - security different from the trusted BSSID (or from all of the SSID if BSSID is unknown)
+ * - frequency not used by the SSID or channel width different from the trusted BSSID
+ *
+ * Each check is constant time (hash table lookups of SSID and BSSID), alerts for the same
+ * BSSID are raised once per reason. Hidden SSIDs are not checked.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_rogue_constants {WIFI_ROGUE_MAX_SECURITIES=4, WIFI_ROGUE_MAX_FREQUENCIES=32};
+
+// why BSS is suspicious (flags)
+enum wifi_rogue_reason {WIFI_ROGUE_UNKNOWN_BSSID=1, WIFI_ROGUE_SECURITY=2, WIFI_ROGUE_CHANNEL=4};
+
+struct wifi_rogue_alert
+{
+	struct bss_info bss; //the suspicious record
+	uint32_t reasons; //new WIFI_ROGUE_* flags of this BSSID
+};
+
+// internal data used by the functions
+struct wifi_rogue;
+
+/* Create detector without profiles
+ *
+ * returns:
+ * struct wifi_rogue * - pass it to the detector functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_rogue *wifi_rogue_new(void);
+
+/* Free the detector */
+void wifi_rogue_free(struct wifi_rogue *rogue);
+
+/* Add legitimate BSSes to the profiles of their SSIDs
+ *
+ * Trusted BSSID may alert again for any reason.
+ *
+ * returns:
+ * -1 on error (errno is set, ENOSPC if SSID has more than WIFI_ROGUE_MAX_SECURITIES or WIFI_ROGUE_MAX_FREQUENCIES), 0 on success
+ */
+int wifi_rogue_trust(struct wifi_rogue *rogue, const struct bss_info *bss, int bss_length);
+
+/* Check scan results against the profiles
+ *
+ * parameters:
+ * rogue - detector
+ * bss - scan results (e.g. from wifi_scan_all)
+ * bss_length - the number of bss elements
+ * alerts - filled with alerts
+ * alerts_length - the size of alerts array
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of alerts, the number may be greater than alerts_length
+ */
+int wifi_rogue_check(struct wifi_rogue *rogue, const struct bss_info *bss, int bss_length, struct wifi_rogue_alert *alerts, int alerts_length);
+
+/* Get the number of SSID profiles */
+int wifi_rogue_profiles(const struct wifi_rogue *rogue);
+
+#ifdef __cplusplus
+}
+#endif
@@ -52,6 +52,8 @@
 #include <fcntl.h> //fntnl (set descriptor options)
 #include <errno.h> //errno
 #include <stdarg.h>
+#include <time.h> //clock_gettime for capture timestamps
+#include <poll.h> //poll for frames with timeout
 
 //Fix needed for compilation on Debian Wheezy
 #ifndef NL80211_GENL_NAME
@@ -59,6 +61,99 @@
 #endif
 
 
+struct netlink_channel;
+
+// the way raw netlink messages are moved between library and kernel (or recording)
+struct netlink_transport
+{
+  ssize_t (*send)(struct netlink_channel *channel, const void *buf, size_t len);
+  ssize_t (*recv)(struct netlink_channel *channel, void *buf, size_t len);
+  bool (*set_blocking)(struct netlink_channel *channel, bool blocking);
+  bool (*subscribe)(struct netlink_channel *channel, uint32_t group);
+  unsigned int (*get_portid)(struct netlink_channel *channel);
+  bool (*wait)(struct netlink_channel *channel, uint32_t timeout_ms); //something to receive within timeout
+};
+
+// recording of raw netlink traffic, see wifi_scan_capture_start
+struct netlink_capture
+{
+  FILE *file;
+};
+
+// recording loaded to memory and fed back to the library, see wifi_scan_init_replay
+struct netlink_replay
+{
+  char *data; //the whole capture file
+  size_t length; //length of data truncated to the last complete record
+  size_t cursor[2]; //offset of the next record to consider for each channel
+  unsigned int portid[2]; //port ids of channels at the time of capture
+  bool loop; //start over when recording is exhausted
+};
+
+// pending receives of single fake channel, each stored as size_t length followed by data
+struct fake_queue
+{
+  char *data;
+  size_t length; //bytes used in data
+  size_t capacity; //bytes allocated for data
+  size_t head; //offset of the next receive
+};
+
+// what the fake pretends to be, full scan takes that many channels (2.4 GHz, 5 GHz and 15 of 6 GHz preferred scanning channels)
+// the radio has one more 2.4 GHz channel (disabled) and all 59 channels of 6 GHz
+// the AP answers neighbor report request with that many BSSes of its SSID at most, the radio ranges that many peers at once
+enum fake_constants {FAKE_NL80211_ID=0x1c, FAKE_IFINDEX=1, FAKE_PORTID=0x4000, FAKE_FULL_SCAN_CHANNELS=53, FAKE_CHANNELS=98, FAKE_6GHZ_CHANNEL=39,
+	FAKE_WIPHY=0, FAKE_NEIGHBORS=32, FAKE_NEIGHBOR_SCAN=1024, FAKE_FRAME_SIZE=1024, FAKE_FTM_PEERS=16};
+// locally administered address of the fake interface
+static const uint8_t FAKE_ADDRESS[BSSID_LENGTH] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+// peer of fake ranging as found in scan results
+struct fake_ftm_peer
+{
+  uint8_t bssid[BSSID_LENGTH];
+  int32_t signal_mbm; //0 if not in scan results
+  bool responder; //advertises FTM responder role
+};
+
+// local nl80211 imitation answering requests, see wifi_scan_init_fake
+struct netlink_fake
+{
+  char *scan_results; //NL80211_CMD_NEW_SCAN_RESULTS messages served for dumps
+  size_t scan_results_length;
+  uint32_t channel_time_ms; //simulated time spent on single channel when scanning
+  struct fake_queue queue[2]; //pending receives for each channel
+  bool blocking[2]; //blocking mode of each channel
+  bool scanning; //scan in progress
+  struct timespec scan_done; //CLOCK_MONOTONIC when scan in progress finishes
+  uint32_t station_packets; //simulated traffic with associated station
+  struct timespec started; //CLOCK_MONOTONIC at init, survey counters run from here
+  int8_t frames_channel; //registered for action frames, -1 if none
+  uint64_t cookie; //of the last transmitted frame
+  char frame[FAKE_FRAME_SIZE]; //NL80211_CMD_FRAME with the AP answer waiting to be received
+  size_t frame_length; //0 if there is no answer waiting
+  struct timespec frame_due; //CLOCK_MONOTONIC when the AP answers
+  bool ranging; //FTM ranging in progress
+  int8_t ranging_channel; //started ranging and receives the results
+  uint64_t ranging_cookie;
+  struct fake_ftm_peer ranging_peers[FAKE_FTM_PEERS];
+  int ranging_peers_length;
+  int ranging_reported; //peers with results already sent
+  struct timespec ranging_due; //CLOCK_MONOTONIC of the next result
+};
+
+// what is injected between library and transport, see wifi_scan_set_faults
+struct netlink_faults
+{
+  struct scan_fault_rule *script; //copy of the user script
+  int script_length;
+  uint16_t permille[SCAN_FAULT_TYPES];
+  uint32_t random; //xorshift state for the above
+  uint32_t opportunities[SCAN_FAULT_TYPES]; //seen so far for each fault
+  uint32_t injected[SCAN_FAULT_TYPES]; //injected so far for each fault
+  char reply[64]; //answer for the swallowed request, received instead of transport data
+  size_t reply_length; //0 if there is no answer waiting
+};
+
 // everything needed for sending/receiving with netlink
 struct netlink_channel
 {
@@ -68,6 +163,19 @@ struct netlink_channel
   uint32_t ifindex; //the wireless interface number (e.g. interface number for wlan0)
   uint32_t sequence; //the sequence number of netlink message
   void *context; //additional data to be stored/used when processing concrete message
+  const struct netlink_transport *transport; //socket or replay
+  struct netlink_replay *replay; //replay data if transport is replay
+  struct netlink_fake *fake; //fake backend data if transport is fake
+  struct netlink_capture *capture; //if not NULL all the traffic is recorded here
+  struct netlink_faults *faults; //if not NULL faults are injected here
+  uint8_t id; //WIFI_SCAN_CHANNEL_NOTIFICATIONS or WIFI_SCAN_CHANNEL_COMMANDS
+};
+
+// the data needed from notifications
+struct context_NL80211_MULTICAST_GROUP_SCAN
+{
+  int new_scan_results; //are new scan results waiting for us?
+  int scan_triggered; //was scan was already triggered by somebody else?
 };
 
 // internal library data passed around by user
@@ -75,6 +183,19 @@ struct wifi_scan
 {
   struct netlink_channel notification_channel;
   struct netlink_channel command_channel;
+  struct netlink_capture *capture;
+  struct netlink_replay *replay;
+  struct netlink_fake *fake;
+  struct netlink_faults *faults;
+  struct flood_guard *flood; //if not NULL scan results are bounded here
+  struct survey_history *survey; //counters of the previous survey, NULL before the first one
+  struct wiphy_cache *wiphy; //radio capabilities queried at init, NULL if unknown
+  struct colocated_list *colocated; //6 GHz BSSes from Reduced Neighbor Reports, NULL before the first scan
+  struct multiple_bssid_list *multiple_bssid; //nontransmitted BSSes of the last dump, NULL before the first scan
+  struct neighbor_report *neighbor; //NULL before the first neighbor report request
+  struct ftm_ranging *ftm; //NULL before the first ranging
+  struct scan_timings timings; //of the last wifi_scan_all_params/wifi_scan_station call
+  struct context_NL80211_MULTICAST_GROUP_SCAN scan_seen; //scan notifications received while waiting for something else
 };
 
 // DECLARATIONS AND TOP-DOWN LIBRARY OVERVIEW
@@ -89,7 +210,7 @@ struct context_CTRL_CMD_GETFAMILY
 
 struct wifi_scan *wifi_scan_init(const char *interface);
 // allocate memory, set initial values, etc.
-static bool init_netlink_channel(struct netlink_channel *channel, const char *interface, char* buffer);
+static bool init_netlink_channel(struct netlink_channel *channel, const char *interface, char* buffer, uint8_t id);
 // create netlink sockets for generic netlink
 static bool init_netlink_socket(struct netlink_channel *channel);
 
@@ -103,6 +224,65 @@ static bool parse_CTRL_ATTR_MCAST_GROUPS(struct nlattr *nested, struct netlink_c
 // subscribes channel to multicast group scan using scan group id
 static bool subscribe_NL80211_MULTICAST_GROUP_SCAN(struct netlink_channel *channel, uint32_t scan_group_id);
 
+// INITIALIZATION - replay
+
+// public interface - library fed with recorded traffic instead of kernel
+struct wifi_scan* wifi_scan_init_replay(const char *capture_file, bool loop);
+// load capture file and set both channels for replay
+static bool init_replay(struct wifi_scan *wifi, const char *capture_file, bool loop);
+// set channel for transport other than netlink socket
+static void init_transport_channel(struct netlink_channel *channel, const struct netlink_transport *transport, uint16_t nl80211_id, uint32_t ifindex, uint8_t id);
+
+// INITIALIZATION - fake
+
+// public interface - library talking to local nl80211 imitation instead of kernel
+struct wifi_scan* wifi_scan_init_fake(const void *scan_results, size_t length, uint32_t channel_time_ms);
+
+// INITIALIZATION - radio capabilities
+
+// capabilities of the radio with its channels, context of the wiphy queries
+struct wiphy_cache
+{
+  struct wifi_capabilities capabilities; //capabilities.channels is the number of channels
+  struct wifi_channel *channels;
+  int channels_capacity;
+  uint8_t address[BSSID_LENGTH]; //of the interface, zeroed if unknown
+  uint32_t ftm_preambles; //bitmap of enum nl80211_preamble the radio ranges with, 0 if unknown
+  uint32_t ftm_bandwidths; //bitmap of enum nl80211_chan_width the radio ranges with, 0 if unknown
+  bool ftm_asap; //the radio ranges as soon as possible (without negotiated start time)
+  bool found; //the reply carried what was asked for
+};
+
+// query the radio behind the interface and its regulatory domain, not fatal if it fails
+static void init_wiphy(struct wifi_scan *wifi);
+// get the radio index of the interface
+static int get_interface(struct netlink_channel *channel);
+static int handle_NL80211_CMD_NEW_INTERFACE(const struct nlmsghdr *nlh, void *data);
+// split dump of the radio
+static int get_wiphy(struct netlink_channel *channel, uint32_t wiphy);
+static int handle_NL80211_CMD_NEW_WIPHY(const struct nlmsghdr *nlh, void *data);
+// get the channels of all bands (nested attribute), possibly part of them in split dump
+static bool parse_NL80211_ATTR_WIPHY_BANDS(struct nlattr *nested, struct wiphy_cache *wiphy);
+// get the channel (nested attribute), add it if not known yet
+static bool parse_NL80211_BAND_ATTR_FREQS(struct nlattr *nested, struct wiphy_cache *wiphy);
+// get FTM ranging capabilities (nested attribute)
+static void parse_NL80211_ATTR_PEER_MEASUREMENTS(struct nlattr *nested, struct wiphy_cache *wiphy);
+// regulatory domain applied to the radio
+static int get_regulatory(struct netlink_channel *channel, uint32_t wiphy);
+static int handle_NL80211_CMD_GET_REG(const struct nlmsghdr *nlh, void *data);
+// the channel of frequency or NULL
+static const struct wifi_channel *wiphy_channel(const struct wiphy_cache *wiphy, uint32_t frequency);
+// frequencies the radio scans are supported and not disabled
+static bool wiphy_frequency_valid(const struct wiphy_cache *wiphy, uint32_t frequency);
+// false with errno EINVAL for params the trigger would fail with
+static bool wiphy_check_params(const struct wiphy_cache *wiphy, const struct scan_params *params);
+// public interface - cached capabilities
+void wifi_scan_capabilities(const struct wifi_scan *wifi, struct wifi_capabilities *capabilities);
+// public interface - cached channels
+int wifi_scan_channels(const struct wifi_scan *wifi, struct wifi_channel *channels, int channels_length);
+// public interface - frequencies for scan params
+int wifi_scan_frequencies(const struct wifi_scan *wifi, uint8_t exclude_flags, uint32_t *frequencies, int frequencies_length);
+
 // CLEANUP
 
 // public interface - cleans up after library
@@ -114,16 +294,15 @@ static void close_netlink_channel(struct netlink_channel *channel);
 
 // public interface - trigger scan if necessary, retrieve information about all known BSSes
 int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length);
+// public interface - as above with mode, frequencies and SSIDs
+int wifi_scan_all_params(struct wifi_scan *wifi, const struct scan_params *params, struct bss_info *bss_infos, int bss_infos_length);
+// public interface - phase timings of the last call
+void wifi_scan_last_timings(const struct wifi_scan *wifi, struct scan_timings *timings);
+// nanoseconds elapsed since, since is updated to now
+static uint64_t elapsed_ns(struct timespec *since);
 
 // SCANNING - notification related
 
-// the data needed from notifications
-struct context_NL80211_MULTICAST_GROUP_SCAN
-{
-  int new_scan_results; //are new scan results waiting for us?
-  int scan_triggered; //was scan was already triggered by somebody else?
-};
-
 // read but do not block
 static bool read_past_notifications(struct netlink_channel *notifications);
 // go non-blocking
@@ -132,10 +311,12 @@ static bool set_channel_non_blocking(struct netlink_channel *channel);
 static bool set_channel_blocking(struct netlink_channel *channel);
 // this handles notifications
 static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void *data);
+// update scanning with scan notification, false if it is something else
+static bool record_scan_notification(const struct nlmsghdr *nlh, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning);
 // triggers scan if no results are waiting yet and if it was not already triggered
-static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning);
-// triggers the scan
-static int trigger_scan(struct netlink_channel *channel);
+static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning, const struct scan_params *params, const struct wiphy_cache *wiphy);
+// triggers the scan, limited to frequencies (valid for wiphy if known) and probing SSIDs from params
+static int trigger_scan(struct netlink_channel *channel, const struct scan_params *params, const struct wiphy_cache *wiphy);
 // wait for the notification that scan finished
 static bool wait_for_new_scan_results(struct netlink_channel *notifications);
 
@@ -168,18 +349,147 @@ struct context_NL80211_CMD_NEW_SCAN_RESULTS
   struct bss_info *bss_infos;
   int bss_infos_length;
   int scanned;
+  int interrupted; //dumps repeated because BSS list changed while dumping
+  struct flood_guard *flood; //NULL if not guarded
+  struct colocated_list *colocated; //NULL if not collected
+  struct multiple_bssid_list *multiple_bssid; //NULL if nontransmitted BSSes are not linked
 };
 
-// get scan results cached by the driver
+// interrupted dump is repeated at most that many times
+enum get_scan_constants {GET_SCAN_INTERRUPTED_RETRIES=3};
+
+// get scan results cached by the driver, repeat if dump is interrupted
 static int get_scan(struct netlink_channel *channel);
+// single dump of scan results
+static int get_scan_dump(struct netlink_channel *channel);
 // process the new scan results
 static int handle_NL80211_CMD_NEW_SCAN_RESULTS(const struct nlmsghdr *nlh, void *data);
 // get the information about bss (nested attribute)
 static void parse_NL80211_ATTR_BSS(struct nlattr *nested, struct netlink_channel *channel);
-// get the information from IE (non-netlink binary data here!)
-static void parse_NL80211_BSS_INFORMATION_ELEMENTS(struct nlattr *attr, char SSID_OUT[33]);
+// decode already parsed attributes of bss
+static void parse_bss(struct nlattr **tb, enum nl80211_bss_status status, struct bss_info *bss);
+// information elements decoded by the library, extension elements are identified by the first byte of data
+enum information_element_ids {IE_SSID=0, IE_DS_PARAMETER_SET=3, IE_BSS_LOAD=11, IE_RSN=48, IE_HT_OPERATION=61, IE_MULTIPLE_BSSID=71,
+	IE_NONTRANSMITTED_BSSID_CAPABILITY=83, IE_MULTIPLE_BSSID_INDEX=85, IE_EXTENDED_CAPABILITIES=127, IE_VHT_OPERATION=192, IE_REDUCED_NEIGHBOR_REPORT=201, IE_VENDOR_SPECIFIC=221,
+	IE_EXTENSION=255, IE_EXT_HE_OPERATION=36, IE_EXT_NON_INHERITANCE=56, IE_EXT_EHT_OPERATION=106};
+// occupied channel of BSS, frequencies in MHz
+struct operating_channel
+{
+  uint8_t width; //enum bss_channel_width
+  uint16_t center;
+  uint16_t center2; //80+80 only
+};
+// get the information from IE (non-netlink binary data here!) - SSID, channel, width, load and security
+static void parse_NL80211_BSS_INFORMATION_ELEMENTS(struct nlattr *attr, struct bss_info *bss);
+// as above from elements one after another (e.g. nontransmitted BSS profile with inherited elements)
+static void parse_information_elements(const uint8_t *payload, int len, struct bss_info *bss);
+// get cipher and AKM suites of RSN element or WPA vendor element (after OUI and type)
+static void parse_security_element(const uint8_t *data, int len, const uint8_t oui[3], struct bss_security *security);
+// get 40 MHz channel from HT operation element, false if not advertised
+static bool parse_ht_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel);
+// get 80/160/80+80 MHz channel from VHT operation element, false if not advertised (HT operation tells)
+static bool parse_vht_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel);
+// get 6 GHz channel from HE operation element (after extension id), false if not advertised
+static bool parse_he_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel);
+// get channel from EHT operation element (after extension id), false if not advertised
+static bool parse_eht_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel);
+// 80 MHz at center segment 0 or 160/80+80 if segment 1 is set (VHT width 1 and later HE/EHT convention)
+static void wide_channel(uint32_t primary, uint8_t segment0, uint8_t segment1, struct operating_channel *channel);
+// take candidate if wider than channel and primary 20 MHz is inside
+static void operating_channel_update(struct operating_channel *channel, const struct operating_channel *candidate, uint32_t primary);
+// frequency in MHz of channel number in the band of primary frequency
+static uint32_t channel_frequency(uint32_t primary, uint8_t channel);
 // get BSSID (mac address)
 static void parse_NL80211_BSS_BSSID(struct nlattr *attr, uint8_t bssid_out[BSSID_LENGTH]);
+// public interface - process raw scan results (e.g. from capture) without any channel
+int wifi_scan_parse_scan_results(const void *buf, size_t len, struct bss_info *bss_infos, int bss_infos_length, int scanned);
+
+// SCANNING - flood guard
+
+// count-min sketch is FLOOD_SKETCH_DEPTH rows of 2^FLOOD_SKETCH_WIDTH_BITS saturating counters
+enum flood_constants {FLOOD_SKETCH_DEPTH=4, FLOOD_SKETCH_WIDTH_BITS=10, FLOOD_SKETCH_WIDTH=1 << FLOOD_SKETCH_WIDTH_BITS};
+
+// guard configuration and state of the current dump
+struct flood_guard
+{
+  struct scan_flood_guard config;
+  struct scan_flood_status status;
+  uint16_t ssids[FLOOD_SKETCH_DEPTH][FLOOD_SKETCH_WIDTH]; //SSID hash counts
+  uint16_t ouis[FLOOD_SKETCH_DEPTH][FLOOD_SKETCH_WIDTH]; //BSSID OUI counts
+};
+
+// public interface - bound scan results
+int wifi_scan_set_flood_guard(struct wifi_scan *wifi, const struct scan_flood_guard *guard);
+// public interface - what the guard has seen
+void wifi_scan_last_flood_status(const struct wifi_scan *wifi, struct scan_flood_status *status);
+// forget the dump (new scan or dump retry)
+static void flood_reset(struct flood_guard *flood);
+// count SSID and OUI of bss in sketches
+static void flood_count(struct flood_guard *flood, struct nlattr **tb);
+// add key to sketch, returns estimated count of key
+static int flood_sketch_add(uint16_t sketch[FLOOD_SKETCH_DEPTH][FLOOD_SKETCH_WIDTH], uint64_t key);
+// keep bss over the limit if it is better than the worst one, bss_infos are min-heap of keys then
+static void flood_evict(struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results, struct nlattr **tb, enum nl80211_bss_status status);
+// the higher the key the less likely the bss is evicted
+static int64_t flood_key(enum scan_eviction eviction, enum nl80211_bss_status status, int32_t signal_mbm, uint32_t seen_ms_ago);
+static int64_t flood_bss_key(enum scan_eviction eviction, const struct bss_info *bss);
+static void flood_sift_down(struct bss_info *heap, int length, int i, enum scan_eviction eviction);
+// associated bss first again, flood verdict, returns the number of bss to report
+static int flood_finish(struct flood_guard *flood, struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results);
+
+// SCANNING - multiple BSSID
+
+// profile elements with inherited elements of transmitted BSS fit in that many bytes, profile subelement id
+enum multiple_bssid_constants {MULTIPLE_BSSID_IES_MAX=4096, MULTIPLE_BSSID_SUBELEMENT_PROFILE=0};
+
+// nontransmitted BSSes made from profiles of transmitted BSSes in the dump
+struct multiple_bssid_list
+{
+  struct bss_info bss[WIFI_SCAN_MULTIPLE_BSSID_MAX]; //sorted by BSSID when linking
+  bool reported[WIFI_SCAN_MULTIPLE_BSSID_MAX]; //by the kernel as well
+  int length;
+  uint8_t ies[MULTIPLE_BSSID_IES_MAX]; //profile being decoded with inherited elements
+};
+
+// make records of nontransmitted BSSes from Multiple BSSID elements of transmitted BSS
+static void multiple_bssid_collect(struct multiple_bssid_list *list, struct nlattr *attr, const struct bss_info *transmitter);
+// make record from Nontransmitted BSSID Profile subelement, false if the profile is incomplete (e.g. continued in the next element)
+static bool multiple_bssid_profile(struct multiple_bssid_list *list, const uint8_t *profile, int profile_len, const uint8_t *ies, int ies_len,
+	uint8_t max_bssid_indicator, const struct bss_info *transmitter, struct bss_info *bss);
+// profile elements followed by inherited elements of transmitted BSS, returns length or -1 if it doesn't fit
+static int multiple_bssid_inherit(const uint8_t *profile, int profile_len, const uint8_t *ies, int ies_len, uint8_t *out, int out_size);
+// element of transmitted BSS is not inherited - overridden by the profile, listed in its Non-Inheritance element or Multiple BSSID itself
+static bool multiple_bssid_not_inherited(const uint8_t *profile, int profile_len, const uint8_t *non_inheritance, const uint8_t *element);
+// link reported nontransmitted BSSes with transmitted ones, append the rest while there is space
+static void multiple_bssid_link(struct multiple_bssid_list *list, struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results);
+// qsort/bsearch comparator of bss_info by BSSID
+static int bssid_compare(const void *a, const void *b);
+
+// SCANNING - 6 GHz discovery
+
+// 6 GHz BSSes reported by scanned BSSes in order of discovery
+struct colocated_list
+{
+  struct wifi_colocated_bss bss[WIFI_SCAN_COLOCATED_MAX];
+  int length;
+};
+
+// TBTT information field type of neighbour AP information, parameters of 6 GHz operating classes
+enum colocated_constants {RNR_TBTT_INFO_TYPE_NEIGHBOR=0, RNR_6GHZ_CLASS_FIRST=131, RNR_6GHZ_CLASS_LAST=137, RNR_6GHZ_CLASS_CHANNEL_2=136,
+	RNR_PSD_UNKNOWN=127};
+
+// public interface - 6 GHz BSSes reported in the last scan results
+int wifi_scan_colocated(const struct wifi_scan *wifi, struct wifi_colocated_bss *colocated, int colocated_length);
+// params of colocated mode scan with distinct frequencies of colocated BSSes, false with errno ENODATA if there are none
+static bool colocated_params(const struct colocated_list *colocated, const struct scan_params *params, struct scan_params *targeted, uint32_t *frequencies);
+// search IEs of bss for Reduced Neighbor Report elements
+static void colocated_collect(struct colocated_list *colocated, struct nlattr **tb);
+// get 6 GHz neighbours from Reduced Neighbor Report element
+static void parse_reduced_neighbor_report(const uint8_t *data, int len, const struct wifi_colocated_bss *reporter, struct colocated_list *colocated);
+// add neighbour unless it is known already (the same BSSID or short SSID on the same channel)
+static void colocated_add(struct colocated_list *colocated, const struct wifi_colocated_bss *bss);
+// frequency in MHz of channel in 6 GHz operating class, 0 for other classes
+static uint32_t colocated_frequency(uint8_t operating_class, uint8_t channel);
 
 // STATION
 
@@ -198,6 +508,122 @@ static int handle_NL80211_CMD_NEW_STATION(const struct nlmsghdr *nlh, void *data
 // process station info (nested attribute)
 static void parse_NL80211_ATTR_STA_INFO(struct nlattr *nested, struct netlink_channel *channel);
 
+// NEIGHBOR REPORT
+
+// radio measurement action frame codes, Neighbor Report element, management frame header and its action type (frame control)
+enum neighbor_report_constants {ACTION_CATEGORY_RADIO_MEASUREMENT=5, ACTION_NEIGHBOR_REPORT_REQUEST=4, ACTION_NEIGHBOR_REPORT_RESPONSE=5,
+	IE_NEIGHBOR_REPORT=52, NEIGHBOR_REPORT_MIN_LENGTH=13, FRAME_HEADER_LENGTH=24, FRAME_CONTROL_ACTION=0xd0};
+
+// what is remembered between requests
+struct neighbor_report
+{
+  bool registered; //notification channel receives the responses
+  uint8_t dialog_token; //of the last request
+};
+
+// the data needed from frames received while waiting for the response
+struct context_NL80211_CMD_FRAME
+{
+  struct wifi_neighbor *neighbors;
+  int neighbors_length;
+  int found; //-1 until the response comes
+  uint8_t bssid[BSSID_LENGTH]; //of the AP asked
+  uint8_t dialog_token; //of the request
+  struct context_NL80211_MULTICAST_GROUP_SCAN *scanning; //scan notifications received meanwhile
+};
+
+// public interface - ask the associated AP for neighbours
+int wifi_scan_neighbor_report(struct wifi_scan *wifi, struct wifi_neighbor *neighbors, int neighbors_length, uint32_t timeout_ms);
+// public interface - distinct frequencies of neighbours for scan params
+int wifi_scan_neighbor_frequencies(const struct wifi_scan *wifi, const struct wifi_neighbor *neighbors, int neighbors_length,
+	uint32_t *frequencies, int frequencies_length);
+// register channel for Neighbor Report Response frames
+static int register_neighbor_report(struct netlink_channel *channel);
+// send Neighbor Report Request to the AP with bssid from interface address
+static int send_neighbor_report_request(struct netlink_channel *channel, const uint8_t bssid[BSSID_LENGTH], const uint8_t address[BSSID_LENGTH], uint8_t dialog_token);
+// receive frames until the response comes or timeout passes (errno ETIMEDOUT)
+static bool wait_for_neighbor_report(struct netlink_channel *notifications, uint32_t timeout_ms);
+// process received frames and replies to frame requests
+static int handle_NL80211_CMD_FRAME(const struct nlmsghdr *nlh, void *data);
+// get neighbours from Neighbor Report Response action frame, false if it is not the response waited for
+static bool parse_neighbor_report_response(const uint8_t *frame, int len, struct context_NL80211_CMD_FRAME *context);
+// frequency in MHz of channel in operating class (global or country one guessed by channel number), 0 if unknown
+static uint32_t operating_class_frequency(uint8_t operating_class, uint8_t channel);
+
+// FTM RANGING
+
+// results kept until collected, the speed of light for round trip time to distance
+enum ftm_constants {FTM_PENDING_MAX=128, LIGHT_SPEED_M_PER_S=299792458};
+
+// ranging in progress, context of notifications while ranging
+struct ftm_ranging
+{
+  bool active; //started and not all the results collected
+  bool complete; //the kernel is done with all the peers
+  struct wifi_ftm_result pending[FTM_PENDING_MAX]; //received, not collected yet
+  int pending_length;
+  struct context_NL80211_MULTICAST_GROUP_SCAN *scanning; //scan notifications received meanwhile
+};
+
+// public interface - range against FTM responders of scan results
+int wifi_scan_ftm_start(struct wifi_scan *wifi, const struct bss_info *bss_infos, int bss_infos_length, const struct wifi_ftm_params *params);
+// public interface - batch of results received so far
+int wifi_scan_ftm_results(struct wifi_scan *wifi, struct wifi_ftm_result *results, int results_length, uint32_t timeout_ms);
+// request ranging of peers, the results come to the channel
+static int start_peer_measurement(struct netlink_channel *channel, const struct wiphy_cache *wiphy, const struct bss_info **peers, int peers_length, const struct wifi_ftm_params *params);
+// channel of the peer (as wide as BSS and the radio allow) and FTM request
+static void put_ftm_peer(struct nlmsghdr *nlh, const struct wiphy_cache *wiphy, const struct bss_info *bss, const struct wifi_ftm_params *params);
+// receive results until something is pending or timeout passes, then the rest that came already
+static bool wait_for_ftm_results(struct netlink_channel *notifications, uint32_t timeout_ms);
+// process peer measurement results and completion
+static int handle_NL80211_CMD_PEER_MEASUREMENT_RESULT(const struct nlmsghdr *nlh, void *data);
+// get the result of the peer (nested attribute) into pending results
+static void parse_NL80211_PMSR_ATTR_PEERS(struct nlattr *nested, struct ftm_ranging *ftm);
+// get FTM data of the response (nested attribute)
+static void parse_NL80211_PMSR_TYPE_FTM(struct nlattr *nested, struct wifi_ftm_result *result);
+
+// SURVEY
+
+// counters of single channel remembered for deltas
+struct survey_counters
+{
+  uint32_t frequency;
+  uint64_t time_ms;
+  uint64_t busy_ms;
+  uint64_t rx_ms;
+  uint64_t tx_ms;
+};
+
+// all the channels surveyed so far, in driver order
+struct survey_history
+{
+  struct survey_counters *channels;
+  int length;
+  int capacity;
+};
+
+// data needed from new survey results
+struct context_NL80211_CMD_NEW_SURVEY_RESULTS
+{
+  struct channel_survey *surveys;
+  int surveys_length;
+  int surveyed;
+  struct survey_history *history;
+};
+
+// public interface - get channel survey with deltas since the previous one
+int wifi_scan_survey(struct wifi_scan *wifi, struct channel_survey *surveys, int surveys_length);
+// dump survey of the interface
+static int get_survey(struct netlink_channel *channel);
+// process the new survey results
+static int handle_NL80211_CMD_NEW_SURVEY_RESULTS(const struct nlmsghdr *nlh, void *data);
+// get the information about channel (nested attribute), false if there is no frequency
+static bool parse_NL80211_ATTR_SURVEY_INFO(struct nlattr *nested, struct channel_survey *survey);
+// fill deltas from remembered counters and remember the new ones, hint is where the channel was the last time
+static bool survey_delta(struct survey_history *history, int hint, struct channel_survey *survey);
+// part of whole in percent, -1 if unknown
+static int8_t survey_percent(bool reported, uint64_t part, uint64_t whole);
+
 // NETLINK HELPERS
 
 // NETLINK HELPERS - message construction/sending/receiving
@@ -210,6 +636,98 @@ static struct nlmsghdr *prepare_nl_message(uint32_t type, uint16_t flags, uint8_
 static bool send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel);
 // receive the results and process them using callback function
 static int receive_nl_message(struct netlink_channel *channel, mnl_cb_t callback);
+// 0 if there are only complete messages of consistent dump in the buffer, errno to fail with otherwise
+static int check_nl_messages(const void *buf, size_t len);
+// after failure read the rest of the reply (e.g. multipart dump) so that it doesn't confuse next request
+static void drain_nl_message(struct netlink_channel *channel);
+
+// NETLINK HELPERS - transport
+
+// send through channel transport, record if capturing
+static ssize_t channel_send(struct netlink_channel *channel, const void *buf, size_t len);
+// receive to channel buffer through channel transport, record if capturing
+static ssize_t channel_receive(struct netlink_channel *channel);
+// append single send/receive to capture file
+static void capture_record(struct netlink_capture *capture, uint8_t channel, uint8_t direction, ssize_t result, int error, const void *data);
+
+// kernel netlink socket (default)
+static ssize_t socket_send(struct netlink_channel *channel, const void *buf, size_t len);
+static ssize_t socket_recv(struct netlink_channel *channel, void *buf, size_t len);
+static bool socket_set_blocking(struct netlink_channel *channel, bool blocking);
+static bool socket_subscribe(struct netlink_channel *channel, uint32_t group);
+static unsigned int socket_get_portid(struct netlink_channel *channel);
+static bool socket_wait(struct netlink_channel *channel, uint32_t timeout_ms);
+
+// recorded traffic fed back at full speed
+static ssize_t replay_send(struct netlink_channel *channel, const void *buf, size_t len);
+static ssize_t replay_recv(struct netlink_channel *channel, void *buf, size_t len);
+static bool replay_set_blocking(struct netlink_channel *channel, bool blocking);
+static bool replay_subscribe(struct netlink_channel *channel, uint32_t group);
+static unsigned int replay_get_portid(struct netlink_channel *channel);
+static bool replay_wait(struct netlink_channel *channel, uint32_t timeout_ms);
+// find next record of the channel starting from cursor, 0 if there is none
+static size_t replay_next_record(const struct netlink_replay *replay, uint8_t channel, size_t cursor, struct wifi_scan_capture_record *record);
+
+// local nl80211 imitation
+static ssize_t fake_send(struct netlink_channel *channel, const void *buf, size_t len);
+static ssize_t fake_recv(struct netlink_channel *channel, void *buf, size_t len);
+static bool fake_set_blocking(struct netlink_channel *channel, bool blocking);
+static bool fake_subscribe(struct netlink_channel *channel, uint32_t group);
+static unsigned int fake_get_portid(struct netlink_channel *channel);
+static bool fake_wait(struct netlink_channel *channel, uint32_t timeout_ms);
+// complete the scan in progress and deliver the AP answer if their time has come
+static void fake_update(struct netlink_fake *fake);
+// the time has come
+static bool fake_due(const struct timespec *now, const struct timespec *due);
+// start the scan of that many channels, notify about the trigger
+static void fake_start_scan(struct netlink_fake *fake, int channels);
+// answers to requests
+static void fake_trigger_scan(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_get_scan(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_get_station(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_get_survey(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_get_interface(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_get_wiphy(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_get_regulatory(struct netlink_fake *fake, const struct nlmsghdr *request);
+static void fake_register_frame(struct netlink_fake *fake, const struct nlmsghdr *request, uint8_t channel);
+static void fake_frame(struct netlink_fake *fake, const struct nlmsghdr *request);
+// the associated AP answer to Neighbor Report Request action frame
+static void fake_neighbor_report(struct netlink_fake *fake, const uint8_t *request);
+// acknowledge ranging started by the channel, results come later
+static void fake_peer_measurement_start(struct netlink_fake *fake, const struct nlmsghdr *request, uint8_t channel);
+// result of the next peer or completion after the last one
+static void fake_peer_measurement_result(struct netlink_fake *fake);
+// distance at which the AP is received with the signal
+static int64_t fake_distance_mm(int32_t signal_mbm);
+// frequency of i-th channel of the radio and its regulatory flags
+static uint32_t fake_channel(int i, uint8_t *flags);
+// reply message of nl80211 command at buf, add nlmsg_len to the length when attributes are in
+static struct nlmsghdr *fake_put_header(char *buf, const struct nlmsghdr *request, uint8_t cmd, uint16_t flags);
+// NLMSG_DONE terminating dump to be appended to message being built
+static void fake_put_done(char *buf, size_t *length, const struct nlmsghdr *request);
+// NLMSG_ERROR with error code (0 for acknowledgement) to be appended to message being built
+static void fake_put_error(char *buf, size_t *length, const struct nlmsghdr *request, int error);
+// queue single receive for the channel
+static void fake_queue_push(struct fake_queue *queue, const void *data, size_t length);
+
+// NETLINK HELPERS - fault injection
+
+// public interface - inject faults between library and transport
+int wifi_scan_set_faults(struct wifi_scan *wifi, const struct scan_faults *faults);
+// public interface - how many faults were injected
+void wifi_scan_fault_counts(const struct wifi_scan *wifi, uint32_t injected[SCAN_FAULT_TYPES]);
+// should the fault be injected at this opportunity, counts the opportunity
+static bool fault_fires(struct netlink_faults *faults, enum scan_fault fault);
+// swallow the request and prepare answer instead of transport, true if swallowed
+static bool fault_send(struct netlink_channel *channel, const void *buf, size_t len);
+// alter what was received from transport (len bytes in channel buffer)
+static ssize_t fault_receive(struct netlink_channel *channel, ssize_t len);
+// NLMSG_ERROR with error code answering request, returns its length
+static size_t fault_error_message(void *buf, const struct nlmsghdr *request, uint32_t portid, int error);
+
+static const struct netlink_transport SOCKET_TRANSPORT = { socket_send, socket_recv, socket_set_blocking, socket_subscribe, socket_get_portid, socket_wait };
+static const struct netlink_transport REPLAY_TRANSPORT = { replay_send, replay_recv, replay_set_blocking, replay_subscribe, replay_get_portid, replay_wait };
+static const struct netlink_transport FAKE_TRANSPORT = { fake_send, fake_recv, fake_set_blocking, fake_subscribe, fake_get_portid, fake_wait };
 
 // NETLINK HELPERS - validation
 
@@ -251,6 +769,7 @@ const struct attribute_validation NL80211_BSS_VALIDATION[] = {
  {NL80211_BSS_BSSID, MNL_TYPE_BINARY, 6},
  {NL80211_BSS_FREQUENCY, MNL_TYPE_U32},
  {NL80211_BSS_INFORMATION_ELEMENTS, MNL_TYPE_BINARY},
+ {NL80211_BSS_CAPABILITY, MNL_TYPE_U16},
  {NL80211_BSS_STATUS, MNL_TYPE_U32},
  {NL80211_BSS_SIGNAL_MBM, MNL_TYPE_U32},
  {NL80211_BSS_SEEN_MS_AGO, MNL_TYPE_U32} };
@@ -270,12 +789,109 @@ const struct attribute_validation NL80211_STA_INFO_VALIDATION[] = {
  {NL80211_STA_INFO_TX_PACKETS, MNL_TYPE_U32}
 };
 
+const struct attribute_validation NL80211_CMD_NEW_SURVEY_RESULTS_VALIDATION[] = {
+ {NL80211_ATTR_SURVEY_INFO, MNL_TYPE_NESTED},
+};
+
+const struct attribute_validation NL80211_SURVEY_INFO_VALIDATION[] = {
+ {NL80211_SURVEY_INFO_FREQUENCY, MNL_TYPE_U32},
+ {NL80211_SURVEY_INFO_NOISE, MNL_TYPE_U8},
+ {NL80211_SURVEY_INFO_IN_USE, MNL_TYPE_FLAG},
+ {NL80211_SURVEY_INFO_TIME, MNL_TYPE_U64},
+ {NL80211_SURVEY_INFO_TIME_BUSY, MNL_TYPE_U64},
+ {NL80211_SURVEY_INFO_TIME_RX, MNL_TYPE_U64},
+ {NL80211_SURVEY_INFO_TIME_TX, MNL_TYPE_U64}
+};
+
+const struct attribute_validation NL80211_CMD_NEW_WIPHY_VALIDATION[] = {
+ {NL80211_ATTR_WIPHY, MNL_TYPE_U32},
+ {NL80211_ATTR_WIPHY_BANDS, MNL_TYPE_NESTED},
+ {NL80211_ATTR_MAX_NUM_SCAN_SSIDS, MNL_TYPE_U8},
+ {NL80211_ATTR_MAX_SCAN_IE_LEN, MNL_TYPE_U16},
+ {NL80211_ATTR_FEATURE_FLAGS, MNL_TYPE_U32},
+ {NL80211_ATTR_EXT_FEATURES, MNL_TYPE_BINARY},
+ {NL80211_ATTR_REG_ALPHA2, MNL_TYPE_STRING},
+ {NL80211_ATTR_DFS_REGION, MNL_TYPE_U8},
+ {NL80211_ATTR_MAC, MNL_TYPE_BINARY, 6},
+ {NL80211_ATTR_PEER_MEASUREMENTS, MNL_TYPE_NESTED}
+};
+
+const struct attribute_validation NL80211_CMD_FRAME_VALIDATION[] = {
+ {NL80211_ATTR_FRAME, MNL_TYPE_BINARY},
+ {NL80211_ATTR_COOKIE, MNL_TYPE_U64}
+};
+
+const struct attribute_validation NL80211_BAND_VALIDATION[] = {
+ {NL80211_BAND_ATTR_FREQS, MNL_TYPE_NESTED}
+};
+
+const struct attribute_validation NL80211_FREQUENCY_VALIDATION[] = {
+ {NL80211_FREQUENCY_ATTR_FREQ, MNL_TYPE_U32},
+ {NL80211_FREQUENCY_ATTR_DISABLED, MNL_TYPE_FLAG},
+ {NL80211_FREQUENCY_ATTR_NO_IR, MNL_TYPE_FLAG},
+ {NL80211_FREQUENCY_ATTR_RADAR, MNL_TYPE_FLAG},
+ {NL80211_FREQUENCY_ATTR_MAX_TX_POWER, MNL_TYPE_U32},
+ {NL80211_FREQUENCY_ATTR_INDOOR_ONLY, MNL_TYPE_FLAG}
+};
+
+const struct attribute_validation NL80211_CMD_PEER_MEASUREMENT_VALIDATION[] = {
+ {NL80211_ATTR_COOKIE, MNL_TYPE_U64},
+ {NL80211_ATTR_PEER_MEASUREMENTS, MNL_TYPE_NESTED}
+};
+
+const struct attribute_validation NL80211_PMSR_VALIDATION[] = {
+ {NL80211_PMSR_ATTR_MAX_PEERS, MNL_TYPE_U32},
+ {NL80211_PMSR_ATTR_TYPE_CAPA, MNL_TYPE_NESTED},
+ {NL80211_PMSR_ATTR_PEERS, MNL_TYPE_NESTED}
+};
+
+const struct attribute_validation NL80211_PMSR_FTM_CAPA_VALIDATION[] = {
+ {NL80211_PMSR_FTM_CAPA_ATTR_ASAP, MNL_TYPE_FLAG},
+ {NL80211_PMSR_FTM_CAPA_ATTR_PREAMBLES, MNL_TYPE_U32},
+ {NL80211_PMSR_FTM_CAPA_ATTR_BANDWIDTHS, MNL_TYPE_U32}
+};
+
+const struct attribute_validation NL80211_PMSR_PEER_VALIDATION[] = {
+ {NL80211_PMSR_PEER_ATTR_ADDR, MNL_TYPE_BINARY, 6},
+ {NL80211_PMSR_PEER_ATTR_RESP, MNL_TYPE_NESTED}
+};
+
+const struct attribute_validation NL80211_PMSR_RESP_VALIDATION[] = {
+ {NL80211_PMSR_RESP_ATTR_DATA, MNL_TYPE_NESTED},
+ {NL80211_PMSR_RESP_ATTR_STATUS, MNL_TYPE_U32},
+ {NL80211_PMSR_RESP_ATTR_HOST_TIME, MNL_TYPE_U64},
+ {NL80211_PMSR_RESP_ATTR_FINAL, MNL_TYPE_FLAG}
+};
+
+const struct attribute_validation NL80211_PMSR_FTM_RESP_VALIDATION[] = {
+ {NL80211_PMSR_FTM_RESP_ATTR_FAIL_REASON, MNL_TYPE_U32},
+ {NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_ATTEMPTS, MNL_TYPE_U32},
+ {NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_SUCCESSES, MNL_TYPE_U32},
+ {NL80211_PMSR_FTM_RESP_ATTR_RSSI_AVG, MNL_TYPE_U32},
+ {NL80211_PMSR_FTM_RESP_ATTR_RTT_AVG, MNL_TYPE_U64},
+ {NL80211_PMSR_FTM_RESP_ATTR_RTT_VARIANCE, MNL_TYPE_U64},
+ {NL80211_PMSR_FTM_RESP_ATTR_DIST_AVG, MNL_TYPE_U64},
+ {NL80211_PMSR_FTM_RESP_ATTR_DIST_VARIANCE, MNL_TYPE_U64}
+};
+
 const int NL80211_VALIDATION_LENGTH = sizeof(NL80211_VALIDATION) / sizeof(struct attribute_validation);
 const int NL80211_MCAST_GROUPS_VALIDATION_LENGTH = sizeof(NL80211_MCAST_GROUPS_VALIDATION) / sizeof(struct attribute_validation);
 const int NL80211_BSS_VALIDATION_LENGTH = sizeof(NL80211_BSS_VALIDATION) / sizeof(struct attribute_validation);
 const int NL80211_NEW_SCAN_RESULTS_VALIDATION_LENGTH = sizeof(NL80211_NEW_SCAN_RESULTS_VALIDATION) / sizeof(struct attribute_validation);
 const int NL80211_CMD_NEW_STATION_VALIDATION_LENGTH = sizeof(NL80211_CMD_NEW_STATION_VALIDATION) / sizeof(struct attribute_validation);
 const int NL80211_STA_INFO_VALIDATION_LENGTH = sizeof(NL80211_STA_INFO_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_CMD_NEW_SURVEY_RESULTS_VALIDATION_LENGTH = sizeof(NL80211_CMD_NEW_SURVEY_RESULTS_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_SURVEY_INFO_VALIDATION_LENGTH = sizeof(NL80211_SURVEY_INFO_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_CMD_NEW_WIPHY_VALIDATION_LENGTH = sizeof(NL80211_CMD_NEW_WIPHY_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_CMD_FRAME_VALIDATION_LENGTH = sizeof(NL80211_CMD_FRAME_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_BAND_VALIDATION_LENGTH = sizeof(NL80211_BAND_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_FREQUENCY_VALIDATION_LENGTH = sizeof(NL80211_FREQUENCY_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_CMD_PEER_MEASUREMENT_VALIDATION_LENGTH = sizeof(NL80211_CMD_PEER_MEASUREMENT_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_PMSR_VALIDATION_LENGTH = sizeof(NL80211_PMSR_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_PMSR_FTM_CAPA_VALIDATION_LENGTH = sizeof(NL80211_PMSR_FTM_CAPA_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_PMSR_PEER_VALIDATION_LENGTH = sizeof(NL80211_PMSR_PEER_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_PMSR_RESP_VALIDATION_LENGTH = sizeof(NL80211_PMSR_RESP_VALIDATION) / sizeof(struct attribute_validation);
+const int NL80211_PMSR_FTM_RESP_VALIDATION_LENGTH = sizeof(NL80211_PMSR_FTM_RESP_VALIDATION) / sizeof(struct attribute_validation);
 
 
 bool wifi_interface_exists(const char *interface)
@@ -288,7 +904,7 @@ bool wifi_interface_exists(const char *interface)
 static bool wifi_scan_init_internal(struct wifi_scan* wifi, char* buffer1, char* buffer2, const char *interface)
 {
 
-  if (!init_netlink_channel(&wifi->notification_channel, interface, buffer1))
+  if (!init_netlink_channel(&wifi->notification_channel, interface, buffer1, WIFI_SCAN_CHANNEL_NOTIFICATIONS))
   {
     return false;
   }
@@ -308,7 +924,7 @@ static bool wifi_scan_init_internal(struct wifi_scan* wifi, char* buffer1, char*
     return false;
   }
 
-  if (!init_netlink_channel(&wifi->command_channel, interface, buffer2))
+  if (!init_netlink_channel(&wifi->command_channel, interface, buffer2, WIFI_SCAN_CHANNEL_COMMANDS))
   {
     return false;
   }
@@ -342,16 +958,182 @@ struct wifi_scan* wifi_scan_init(const char *interface)
     return NULL;
   }
 
+  init_wiphy(wifi);
+
+  return wifi;
+}
+
+// public interface - pass file recorded with wifi_scan_capture_start
+struct wifi_scan* wifi_scan_init_replay(const char *capture_file, bool loop)
+{
+  struct wifi_scan* wifi = calloc(sizeof(struct wifi_scan), 1);
+  char* buffer1 = (char*)malloc(MNL_SOCKET_BUFFER_SIZE);
+  char* buffer2 = (char*)malloc(MNL_SOCKET_BUFFER_SIZE);
+
+  if (wifi == NULL)
+  {
+    to_log("Can not allocate memory for wifi");
+    return NULL;
+  }
+
+  wifi->notification_channel.buf = buffer1;
+  wifi->command_channel.buf = buffer2;
+
+  if (!init_replay(wifi, capture_file, loop))
+  {
+    wifi_scan_close(wifi);
+    return NULL;
+  }
+
+  return wifi;
+}
+
+// prerequisities:
+// - channel buffers allocated
+static bool init_replay(struct wifi_scan *wifi, const char *capture_file, bool loop)
+{
+  struct wifi_scan_capture_header header;
+  struct netlink_replay *replay = calloc(sizeof(struct netlink_replay), 1);
+  FILE *file = fopen(capture_file, "rb");
+  long length;
+
+  wifi->replay = replay;
+
+  if (replay == NULL || file == NULL)
+  {
+    log_error("Can not open capture file");
+    if (file)
+      fclose(file);
+    return false;
+  }
+
+  if (fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0
+      || (replay->data = malloc(length)) == NULL || fread(replay->data, 1, length, file) != (size_t)length)
+  {
+    log_error("Can not read capture file");
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+
+  if (length < (long)sizeof(header))
+  {
+    to_log("Capture file too short");
+    return false;
+  }
+
+  memcpy(&header, replay->data, sizeof(header));
+
+  if (memcmp(header.magic, WIFI_SCAN_CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != WIFI_SCAN_CAPTURE_VERSION)
+  {
+    to_log("Not a wifi-scan capture file or unsupported version");
+    return false;
+  }
+
+  //the capture may have been cut short (e.g. program killed), ignore incomplete record at the end
+  size_t offset = sizeof(header);
+  struct wifi_scan_capture_record record;
+
+  while (offset + sizeof(record) <= (size_t)length)
+  {
+    memcpy(&record, replay->data + offset, sizeof(record));
+    size_t data_length = record.result > 0 ? record.result : 0;
+    if (offset + sizeof(record) + data_length > (size_t)length)
+      break;
+    offset += sizeof(record) + data_length;
+  }
+
+  replay->length = offset;
+  replay->cursor[WIFI_SCAN_CHANNEL_NOTIFICATIONS] = replay->cursor[WIFI_SCAN_CHANNEL_COMMANDS] = sizeof(header);
+  replay->portid[WIFI_SCAN_CHANNEL_NOTIFICATIONS] = header.portid[WIFI_SCAN_CHANNEL_NOTIFICATIONS];
+  replay->portid[WIFI_SCAN_CHANNEL_COMMANDS] = header.portid[WIFI_SCAN_CHANNEL_COMMANDS];
+  replay->loop = loop;
+
+  init_transport_channel(&wifi->notification_channel, &REPLAY_TRANSPORT, header.nl80211_id, header.ifindex, WIFI_SCAN_CHANNEL_NOTIFICATIONS);
+  init_transport_channel(&wifi->command_channel, &REPLAY_TRANSPORT, header.nl80211_id, header.ifindex, WIFI_SCAN_CHANNEL_COMMANDS);
+  wifi->notification_channel.replay = wifi->command_channel.replay = replay;
+
+  return true;
+}
+
+// prerequisities:
+// - channel buffer allocated
+static void init_transport_channel(struct netlink_channel *channel, const struct netlink_transport *transport, uint16_t nl80211_id, uint32_t ifindex, uint8_t id)
+{
+  channel->sequence = 1;
+  channel->nl = 0;
+  channel->id = id;
+  channel->transport = transport;
+  channel->replay = NULL;
+  channel->fake = NULL;
+  channel->capture = NULL;
+  channel->context = NULL;
+  channel->nl80211_id = nl80211_id;
+  channel->ifindex = ifindex;
+}
+
+// public interface - pass NL80211_CMD_NEW_SCAN_RESULTS messages to be served as scan results
+struct wifi_scan* wifi_scan_init_fake(const void *scan_results, size_t length, uint32_t channel_time_ms)
+{
+  struct wifi_scan* wifi = calloc(sizeof(struct wifi_scan), 1);
+  char* buffer1 = (char*)malloc(MNL_SOCKET_BUFFER_SIZE);
+  char* buffer2 = (char*)malloc(MNL_SOCKET_BUFFER_SIZE);
+
+  if (wifi == NULL)
+  {
+    to_log("Can not allocate memory for wifi");
+    return NULL;
+  }
+
+  wifi->notification_channel.buf = buffer1;
+  wifi->command_channel.buf = buffer2;
+
+  struct netlink_fake *fake = wifi->fake = calloc(sizeof(struct netlink_fake), 1);
+
+  if (fake == NULL || (fake->scan_results = malloc(length)) == NULL)
+  {
+    to_log("Can not allocate memory for fake backend");
+    wifi_scan_close(wifi);
+    return NULL;
+  }
+
+  //keep only the scan results, control messages (e.g. NLMSG_DONE) are generated as needed
+  const struct nlmsghdr *nlh = scan_results;
+  int remaining = length;
+
+  for (; mnl_nlmsg_ok(nlh, remaining); nlh = mnl_nlmsg_next(nlh, &remaining))
+    if (nlh->nlmsg_type >= NLMSG_MIN_TYPE)
+    {
+      memcpy(fake->scan_results + fake->scan_results_length, nlh, nlh->nlmsg_len);
+      fake->scan_results_length += nlh->nlmsg_len;
+    }
+
+  fake->channel_time_ms = channel_time_ms;
+  fake->frames_channel = -1;
+  clock_gettime(CLOCK_MONOTONIC, &fake->started);
+  fake->blocking[WIFI_SCAN_CHANNEL_NOTIFICATIONS] = fake->blocking[WIFI_SCAN_CHANNEL_COMMANDS] = true;
+
+  init_transport_channel(&wifi->notification_channel, &FAKE_TRANSPORT, FAKE_NL80211_ID, FAKE_IFINDEX, WIFI_SCAN_CHANNEL_NOTIFICATIONS);
+  init_transport_channel(&wifi->command_channel, &FAKE_TRANSPORT, FAKE_NL80211_ID, FAKE_IFINDEX, WIFI_SCAN_CHANNEL_COMMANDS);
+  wifi->notification_channel.fake = wifi->command_channel.fake = fake;
+
+  init_wiphy(wifi);
+
   return wifi;
 }
 
 // prerequisities:
 // - proper interface, e.g. wlan0, wlan1
-static bool init_netlink_channel(struct netlink_channel *channel, const char *interface, char* buffer)
+static bool init_netlink_channel(struct netlink_channel *channel, const char *interface, char* buffer, uint8_t id)
 {
   channel->sequence = 1;
   channel->buf = buffer;
   channel->nl = 0;
+  channel->id = id;
+  channel->transport = &SOCKET_TRANSPORT;
+  channel->replay = NULL;
+  channel->fake = NULL;
+  channel->capture = NULL;
   channel->ifindex = if_nametoindex(interface);
 
   if (channel->ifindex == 0)
@@ -469,262 +1251,302 @@ static bool parse_CTRL_ATTR_MCAST_GROUPS(struct nlattr *nested, struct netlink_c
 // - channel initialized with init_netlink_channel
 static bool subscribe_NL80211_MULTICAST_GROUP_SCAN(struct netlink_channel *channel, uint32_t scan_group_id)
 {
-  if (mnl_socket_setsockopt(channel->nl, NETLINK_ADD_MEMBERSHIP, &scan_group_id, sizeof(int)) < 0)
-  {
-    log_error("mnl_socket_set_sockopt");
-    return false;
-  }
-  return true;
+  return channel->transport->subscribe(channel, scan_group_id);
 }
 
-// CLEANUP
+// INITIALIZATION - radio capabilities
 
 // prerequisities:
-// - wifi initialized with wifi_scan_init
-void wifi_scan_close(struct wifi_scan *wifi)
+// - command channel initialized (socket or fake)
+static void init_wiphy(struct wifi_scan *wifi)
 {
-  close_netlink_channel(&wifi->notification_channel);
-  close_netlink_channel(&wifi->command_channel);
+  struct netlink_channel *commands = &wifi->command_channel;
+  struct wiphy_cache *wiphy = calloc(sizeof(struct wiphy_cache), 1);
+
+  if (wiphy == NULL)
+  {
+    to_log("Can not allocate memory for radio capabilities");
+    return;
+  }
+
+  commands->context = wiphy;
+
+  if (get_interface(commands) == MNL_CB_ERROR || !wiphy->found)
+  {
+    to_log("Unable to get radio of the interface, radio capabilities unknown");
+    free(wiphy);
+    return;
+  }
+
+  wiphy->found = false;
+
+  if (get_wiphy(commands, wiphy->capabilities.wiphy) == MNL_CB_ERROR || !wiphy->found || wiphy->capabilities.channels == 0)
+  {
+    to_log("Unable to get radio information, radio capabilities unknown");
+    free(wiphy->channels);
+    free(wiphy);
+    return;
+  }
+
+  //channel flags already reflect regulatory domain, country is informative
+  if (get_regulatory(commands, wiphy->capabilities.wiphy) == MNL_CB_ERROR)
+    to_log("Unable to get regulatory domain");
+
+  wiphy->capabilities.known = true;
+  wifi->wiphy = wiphy;
 }
 
 // prerequisities:
-// - channel initalized with init_netlink-channel
-static void close_netlink_channel(struct netlink_channel *channel)
+// - channel context of type struct wiphy_cache
+static int get_interface(struct netlink_channel *channel)
 {
-  free(channel->buf);
-  if (channel->nl != 0)
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_GET_INTERFACE, channel);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+
+  if (!send_nl_message(nlh, channel))
   {
-    mnl_socket_close(channel->nl);
+    return MNL_CB_ERROR;
   }
+  return receive_nl_message(channel, handle_NL80211_CMD_NEW_INTERFACE);
 }
 
-
-// SCANNING
-
-// handle also trigger abort
-// public interface
-//
 // prerequisities:
-// - wifi initialized with wifi_scan_init
-// - bss_info table of sized bss_info_length passed
-int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length)
+// - netlink_channel passed as data
+// - data->context of type struct wiphy_cache
+static int handle_NL80211_CMD_NEW_INTERFACE(const struct nlmsghdr *nlh, void *data)
 {
-  struct netlink_channel *notifications = &wifi->notification_channel;
-  struct context_NL80211_MULTICAST_GROUP_SCAN scanning = { 0,0 };
-  notifications->context = &scanning;
-
-  struct netlink_channel *commands = &wifi->command_channel;
-  struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { bss_infos, bss_infos_length, 0 };
-  commands->context = &scan_results;
+  struct netlink_channel *channel = data;
+  struct wiphy_cache *wiphy = channel->context;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_NEW_WIPHY_VALIDATION, NL80211_CMD_NEW_WIPHY_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
 
-  //somebody else might have triggered scanning or even the results can be already waiting
-  if (!read_past_notifications(notifications))
+  if (genl->cmd != NL80211_CMD_NEW_INTERFACE)
   {
-    return -1;
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
   }
 
-  //if no results yet or scan not triggered then trigger it.
-  //the device can be busy - we have to take it into account
-  if (trigger_scan_if_necessary(commands, &scanning) == -1)
-    return -1; //most likely with errno set to EBUSY
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
 
-//now just wait for trigger/new_scan_results
-  if (!wait_for_new_scan_results(notifications))
+  if (tb[NL80211_ATTR_WIPHY])
   {
-    return -1;
+    wiphy->capabilities.wiphy = mnl_attr_get_u32(tb[NL80211_ATTR_WIPHY]);
+    wiphy->found = true;
   }
 
-  //finally read the scan
-  get_scan(commands);
+  if (tb[NL80211_ATTR_MAC] && mnl_attr_get_payload_len(tb[NL80211_ATTR_MAC]) == BSSID_LENGTH)
+    memcpy(wiphy->address, mnl_attr_get_payload(tb[NL80211_ATTR_MAC]), BSSID_LENGTH);
 
-  return scan_results.scanned;
+  return MNL_CB_OK;
 }
 
-// SCANNING - notification related
-
-// prerequisities
-// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
-// - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
-static bool read_past_notifications(struct netlink_channel *notifications)
+// prerequisities:
+// - channel context of type struct wiphy_cache
+static int get_wiphy(struct netlink_channel *channel, uint32_t wiphy)
 {
-  if (!set_channel_non_blocking(notifications))
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_WIPHY, channel);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY, wiphy);
+  //single message of modern radio doesn't fit into the buffer, the kernel splits it into many
+  mnl_attr_put(nlh, NL80211_ATTR_SPLIT_WIPHY_DUMP, 0, NULL);
+
+  if (!send_nl_message(nlh, channel))
   {
-    return false;
+    return MNL_CB_ERROR;
   }
+  return receive_nl_message(channel, handle_NL80211_CMD_NEW_WIPHY);
+}
 
-  int ret, run_ret;
+// each message of split dump carries part of the information
+//
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type struct wiphy_cache
+static int handle_NL80211_CMD_NEW_WIPHY(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct wiphy_cache *wiphy = channel->context;
+  struct wifi_capabilities *capabilities = &wiphy->capabilities;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_NEW_WIPHY_VALIDATION, NL80211_CMD_NEW_WIPHY_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
 
-  while ((ret = mnl_socket_recvfrom(notifications->nl, notifications->buf, MNL_SOCKET_BUFFER_SIZE)) >= 0)
+  if (genl->cmd != NL80211_CMD_NEW_WIPHY)
   {
-    //the line below fills context about past scans/triggers
-    run_ret = mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_MULTICAST_GROUP_SCAN, notifications);
-    if (run_ret <= 0)
-    {
-      to_log("ReadPastNotificationsNonBlocking mnl_cb_run failed");
-      return false;
-    }
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
   }
 
-  if (ret == -1)
-  {
-    if (!(errno == EINPROGRESS || errno == EWOULDBLOCK))
-    {
-      to_log("ReadPastNotificationsNonBlocking mnl_socket_recv failed");
-      return false;
-    }
-  }
-  //no more notifications waiting
-  return set_channel_blocking(notifications);
-}
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
 
-// prerequisities
-// - channel initialized with init_netlink_channel
-static bool set_channel_non_blocking(struct netlink_channel *channel)
-{
-  int fd = mnl_socket_get_fd(channel->nl);
-  int flags = fcntl(fd, F_GETFL, 0);
-  if (flags == -1)
+  //kernels without dump filter send all the radios
+  if (!tb[NL80211_ATTR_WIPHY] || mnl_attr_get_u32(tb[NL80211_ATTR_WIPHY]) != capabilities->wiphy)
+    return MNL_CB_OK;
+
+  wiphy->found = true;
+
+  if (tb[NL80211_ATTR_MAX_NUM_SCAN_SSIDS])
+    capabilities->max_scan_ssids = mnl_attr_get_u8(tb[NL80211_ATTR_MAX_NUM_SCAN_SSIDS]);
+  if (tb[NL80211_ATTR_MAX_SCAN_IE_LEN])
+    capabilities->max_scan_ie_len = mnl_attr_get_u16(tb[NL80211_ATTR_MAX_SCAN_IE_LEN]);
+
+  if (tb[NL80211_ATTR_FEATURE_FLAGS])
   {
-    log_error("SetChannelNonBlocking F_GETFL");
-    return false;
+    uint32_t features = mnl_attr_get_u32(tb[NL80211_ATTR_FEATURE_FLAGS]);
+
+    if (features & NL80211_FEATURE_LOW_PRIORITY_SCAN)
+      capabilities->scan_features |= WIFI_SCAN_FEATURE_LOW_PRIORITY;
+    if (features & NL80211_FEATURE_SCAN_FLUSH)
+      capabilities->scan_features |= WIFI_SCAN_FEATURE_FLUSH;
+    if (features & NL80211_FEATURE_SCAN_RANDOM_MAC_ADDR)
+      capabilities->scan_features |= WIFI_SCAN_FEATURE_RANDOM_MAC;
   }
-  if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+
+  //bitmap of enum nl80211_ext_feature_index
+  if (tb[NL80211_ATTR_EXT_FEATURES])
   {
-    log_error("SetChannelNonBlocking F_SETFL");
-    return false;
+    const uint8_t *bits = mnl_attr_get_payload(tb[NL80211_ATTR_EXT_FEATURES]);
+    uint16_t len = mnl_attr_get_payload_len(tb[NL80211_ATTR_EXT_FEATURES]);
+
+    if (NL80211_EXT_FEATURE_SET_SCAN_DWELL / 8 < len && bits[NL80211_EXT_FEATURE_SET_SCAN_DWELL / 8] & 1 << NL80211_EXT_FEATURE_SET_SCAN_DWELL % 8)
+      capabilities->scan_features |= WIFI_SCAN_FEATURE_DWELL;
+    if (NL80211_EXT_FEATURE_SCAN_START_TIME / 8 < len && bits[NL80211_EXT_FEATURE_SCAN_START_TIME / 8] & 1 << NL80211_EXT_FEATURE_SCAN_START_TIME % 8)
+      capabilities->scan_features |= WIFI_SCAN_FEATURE_START_TIME;
   }
-  return true;
+
+  if (tb[NL80211_ATTR_WIPHY_BANDS] && !parse_NL80211_ATTR_WIPHY_BANDS(tb[NL80211_ATTR_WIPHY_BANDS], wiphy))
+    return MNL_CB_ERROR;
+
+  if (tb[NL80211_ATTR_PEER_MEASUREMENTS])
+    parse_NL80211_ATTR_PEER_MEASUREMENTS(tb[NL80211_ATTR_PEER_MEASUREMENTS], wiphy);
+
+  return MNL_CB_OK;
 }
 
-// prerequisities
-// - channel initialized with init_netlink_channel
-static bool set_channel_blocking(struct netlink_channel *channel)
+// bands are nested attributes of band index type, so are the channels inside
+static bool parse_NL80211_ATTR_WIPHY_BANDS(struct nlattr *nested, struct wiphy_cache *wiphy)
 {
-  int fd = mnl_socket_get_fd(channel->nl);
-  int flags = fcntl(fd, F_GETFL, 0);
-  if (flags == -1)
-  {
-    log_error("SetChannelNonBlocking F_GETFL");
-    return false;
-  }
-  if (fcntl(fd, F_SETFL, flags &  ~O_NONBLOCK) == -1)
+  struct nlattr *band, *frequency;
+
+  mnl_attr_for_each_nested(band, nested)
   {
-    log_error("SetChannelNonBlocking F_SETFL");
-    return false;
+    struct nlattr *tb[NL80211_BAND_ATTR_MAX + 1] = {};
+    struct validation_data vd = { tb, NL80211_BAND_ATTR_MAX, NL80211_BAND_VALIDATION, NL80211_BAND_VALIDATION_LENGTH };
+
+    mnl_attr_parse_nested(band, validate, &vd);
+
+    if (!tb[NL80211_BAND_ATTR_FREQS])
+      continue;
+
+    mnl_attr_for_each_nested(frequency, tb[NL80211_BAND_ATTR_FREQS])
+      if (!parse_NL80211_BAND_ATTR_FREQS(frequency, wiphy))
+        return false;
   }
+
   return true;
 }
 
-// prerequisities:
-// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
-// - netlink_channel passed as data
-// - data->context of type struct context_NL80211_MULTICAST_GROUP_SCAN
-static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void *data)
+static bool parse_NL80211_BAND_ATTR_FREQS(struct nlattr *nested, struct wiphy_cache *wiphy)
 {
-  struct netlink_channel *channel = data;
-  struct context_NL80211_MULTICAST_GROUP_SCAN *context = channel->context;
+  struct nlattr *tb[NL80211_FREQUENCY_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_FREQUENCY_ATTR_MAX, NL80211_FREQUENCY_VALIDATION, NL80211_FREQUENCY_VALIDATION_LENGTH };
+  struct wifi_channel channel = {0};
 
-  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+  mnl_attr_parse_nested(nested, validate, &vd);
 
-  if (genl->cmd == NL80211_CMD_TRIGGER_SCAN)
-  {
-    context->scan_triggered = 1;
-    return MNL_CB_OK; //do nothing for now
-  }
-  else if (genl->cmd == NL80211_CMD_NEW_SCAN_RESULTS)
-  {
-    if (nlh->nlmsg_pid == 0 && nlh->nlmsg_seq == 0)
-      context->new_scan_results = 1;
-    return MNL_CB_OK; //do nothing for now
-  }
-  else
-  {
-    to_log2("Ignoring generic netlink command type %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
-    return MNL_CB_OK;
-  }
-}
+  if (!tb[NL80211_FREQUENCY_ATTR_FREQ])
+    return true;
 
+  channel.frequency = mnl_attr_get_u32(tb[NL80211_FREQUENCY_ATTR_FREQ]);
 
-// prerequisities:
-// - commands initialized with init_netlink_channel
-// - scanning updated with read_past_notifications
-static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning)
-{
-  if (!scanning->new_scan_results && !scanning->scan_triggered)
-    if (trigger_scan(commands) == -1)
-      return -1; //most likely errno set to EBUSY which means hardware is doing something else, try again later
-  return 0;
-}
+  //split dump may repeat band with the channels sent so far
+  if (wiphy_channel(wiphy, channel.frequency))
+    return true;
 
-// prerequisities:
-// - channel initialized with init_netlink_channel
-static int trigger_scan(struct netlink_channel *channel)
-{
-  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_TRIGGER_SCAN, channel);
-  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
-  if (!send_nl_message(nlh, channel))
+  if (tb[NL80211_FREQUENCY_ATTR_DISABLED])
+    channel.flags |= WIFI_CHANNEL_DISABLED;
+  if (tb[NL80211_FREQUENCY_ATTR_NO_IR])
+    channel.flags |= WIFI_CHANNEL_NO_IR;
+  if (tb[NL80211_FREQUENCY_ATTR_RADAR])
+    channel.flags |= WIFI_CHANNEL_RADAR;
+  if (tb[NL80211_FREQUENCY_ATTR_INDOOR_ONLY])
+    channel.flags |= WIFI_CHANNEL_INDOOR_ONLY;
+  if (tb[NL80211_FREQUENCY_ATTR_MAX_TX_POWER])
+    channel.max_power_mbm = mnl_attr_get_u32(tb[NL80211_FREQUENCY_ATTR_MAX_TX_POWER]);
+
+  if (wiphy->capabilities.channels == wiphy->channels_capacity)
   {
-    return MNL_CB_ERROR;
+    int capacity = wiphy->channels_capacity ? 2 * wiphy->channels_capacity : 64;
+    struct wifi_channel *grown = realloc(wiphy->channels, capacity * sizeof(struct wifi_channel));
+    if (grown == NULL)
+      return false;
+    wiphy->channels = grown;
+    wiphy->channels_capacity = capacity;
   }
-  return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+
+  wiphy->channels[wiphy->capabilities.channels++] = channel;
+  return true;
 }
 
-// prerequisities
-// - channel initalized with init_netlink_channel
-// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
-// - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
-static bool wait_for_new_scan_results(struct netlink_channel *notifications)
+// capabilities are nested by measurement type, FTM is the only one we know
+static void parse_NL80211_ATTR_PEER_MEASUREMENTS(struct nlattr *nested, struct wiphy_cache *wiphy)
 {
-  struct context_NL80211_MULTICAST_GROUP_SCAN *scanning = notifications->context;
-  int ret;
+  struct nlattr *tb[NL80211_PMSR_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_PMSR_ATTR_MAX, NL80211_PMSR_VALIDATION, NL80211_PMSR_VALIDATION_LENGTH };
+  struct nlattr *type;
 
-  while (!scanning->new_scan_results)
+  mnl_attr_parse_nested(nested, validate, &vd);
+
+  if (!tb[NL80211_PMSR_ATTR_MAX_PEERS] || !tb[NL80211_PMSR_ATTR_TYPE_CAPA])
+    return;
+
+  mnl_attr_for_each_nested(type, tb[NL80211_PMSR_ATTR_TYPE_CAPA])
   {
-    if ((ret = mnl_socket_recvfrom(notifications->nl, notifications->buf, MNL_SOCKET_BUFFER_SIZE)) <= 0)
-    {
-      to_log("Waiting for new scan results failed - mnl_socket_recvfrom");
-      return false;
-    }
+    struct nlattr *ftm[NL80211_PMSR_FTM_CAPA_ATTR_MAX + 1] = {};
+    struct validation_data ftm_vd = { ftm, NL80211_PMSR_FTM_CAPA_ATTR_MAX, NL80211_PMSR_FTM_CAPA_VALIDATION, NL80211_PMSR_FTM_CAPA_VALIDATION_LENGTH };
 
-    if ((ret = mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_MULTICAST_GROUP_SCAN, notifications)) <= 0)
-    {
-      to_log("Processing notificatoins failed - mnl_cb_run");
-      return false;
-    }
-  }
+    if (mnl_attr_get_type(type) != NL80211_PMSR_TYPE_FTM)
+      continue;
 
-  return true;
-}
+    mnl_attr_parse_nested(type, validate, &ftm_vd);
 
-// SCANNING - scan related
+    wiphy->capabilities.ftm_max_peers = mnl_attr_get_u32(tb[NL80211_PMSR_ATTR_MAX_PEERS]);
+    wiphy->ftm_asap = ftm[NL80211_PMSR_FTM_CAPA_ATTR_ASAP] != NULL;
+
+    if (ftm[NL80211_PMSR_FTM_CAPA_ATTR_PREAMBLES])
+      wiphy->ftm_preambles = mnl_attr_get_u32(ftm[NL80211_PMSR_FTM_CAPA_ATTR_PREAMBLES]);
+    if (ftm[NL80211_PMSR_FTM_CAPA_ATTR_BANDWIDTHS])
+      wiphy->ftm_bandwidths = mnl_attr_get_u32(ftm[NL80211_PMSR_FTM_CAPA_ATTR_BANDWIDTHS]);
+  }
+}
 
 // prerequisities:
-// - channel initalized with init_netlink_channel
-// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
-static int get_scan(struct netlink_channel *channel)
+// - channel context of type struct wiphy_cache
+static int get_regulatory(struct netlink_channel *channel, uint32_t wiphy)
 {
-  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_SCAN, channel);
-  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_GET_REG, channel);
+  //self managed radio answers with its own domain, other with the global one
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY, wiphy);
 
   if (!send_nl_message(nlh, channel))
   {
     return MNL_CB_ERROR;
   }
-  return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+  return receive_nl_message(channel, handle_NL80211_CMD_GET_REG);
 }
 
 // prerequisities:
 // - netlink_channel passed as data
-// - data->context of type context_NL80211_CMD_NEW_SCAN_RESULTS
-static int handle_NL80211_CMD_NEW_SCAN_RESULTS(const struct nlmsghdr *nlh, void *data)
+// - data->context of type struct wiphy_cache
+static int handle_NL80211_CMD_GET_REG(const struct nlmsghdr *nlh, void *data)
 {
   struct netlink_channel *channel = data;
+  struct wifi_capabilities *capabilities = &((struct wiphy_cache*)channel->context)->capabilities;
   struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
-  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_NEW_SCAN_RESULTS_VALIDATION, NL80211_NEW_SCAN_RESULTS_VALIDATION_LENGTH };
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_NEW_WIPHY_VALIDATION, NL80211_CMD_NEW_WIPHY_VALIDATION_LENGTH };
   struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
 
-
-  if (genl->cmd != NL80211_CMD_NEW_SCAN_RESULTS)
+  if (genl->cmd != NL80211_CMD_GET_REG)
   {
     to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
     return MNL_CB_OK;
@@ -732,255 +1554,3970 @@ static int handle_NL80211_CMD_NEW_SCAN_RESULTS(const struct nlmsghdr *nlh, void
 
   mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
 
-  if (!tb[NL80211_ATTR_BSS])
-    return MNL_CB_OK;
-
-  parse_NL80211_ATTR_BSS(tb[NL80211_ATTR_BSS], channel);
+  if (tb[NL80211_ATTR_REG_ALPHA2])
+    strncpy(capabilities->country, mnl_attr_get_str(tb[NL80211_ATTR_REG_ALPHA2]), sizeof(capabilities->country) - 1);
+  if (tb[NL80211_ATTR_DFS_REGION])
+    capabilities->dfs_region = mnl_attr_get_u8(tb[NL80211_ATTR_DFS_REGION]);
 
   return MNL_CB_OK;
 }
 
-// prerequisities:
-// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
-static void parse_NL80211_ATTR_BSS(struct nlattr *nested, struct netlink_channel *channel)
+static const struct wifi_channel *wiphy_channel(const struct wiphy_cache *wiphy, uint32_t frequency)
 {
-  struct nlattr *tb[NL80211_BSS_MAX + 1] = {};
-  struct validation_data vd = { tb, NL80211_BSS_MAX, NL80211_BSS_VALIDATION, NL80211_BSS_VALIDATION_LENGTH };
-  struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results = channel->context;
-  struct bss_info *bss = scan_results->bss_infos + scan_results->scanned;
+  int i;
 
-  mnl_attr_parse_nested(nested, validate, &vd);
+  for (i = 0; i < wiphy->capabilities.channels; ++i)
+    if (wiphy->channels[i].frequency == frequency)
+      return &wiphy->channels[i];
 
-  enum nl80211_bss_status status = BSS_NONE;
+  return NULL;
+}
 
-  if (tb[NL80211_BSS_STATUS])
-    status = mnl_attr_get_u32(tb[NL80211_BSS_STATUS]);
+// unknown radio takes anything
+static bool wiphy_frequency_valid(const struct wiphy_cache *wiphy, uint32_t frequency)
+{
+  const struct wifi_channel *channel;
 
-  //if we have found associated station store first as last and associated as first
-  if (status == NL80211_BSS_STATUS_ASSOCIATED
-   //|| status == NL80211_BSS_STATUS_AUTHENTICATED
-   || status == NL80211_BSS_STATUS_IBSS_JOINED)
-  {
-    if (scan_results->scanned > 0 && scan_results->scanned < scan_results->bss_infos_length)
-      memcpy(bss, scan_results->bss_infos, sizeof(struct bss_info));
-    bss = scan_results->bss_infos;
-  }
+  if (wiphy == NULL)
+    return true;
 
-  //check bounds, make exception if we have found associated station and replace previous data
-  if (scan_results->bss_infos_length == 0 || (scan_results->scanned >= scan_results->bss_infos_length && bss != scan_results->bss_infos))
-  {
-    ++scan_results->scanned;
-    return;
-  }
+  channel = wiphy_channel(wiphy, frequency);
+  return channel && !(channel->flags & WIFI_CHANNEL_DISABLED);
+}
 
-  if (tb[NL80211_BSS_BSSID])
-    parse_NL80211_BSS_BSSID(tb[NL80211_BSS_BSSID], bss->bssid);
+static bool wiphy_check_params(const struct wiphy_cache *wiphy, const struct scan_params *params)
+{
+  int i;
 
-  if (tb[NL80211_BSS_FREQUENCY])
-    bss->frequency = mnl_attr_get_u32(tb[NL80211_BSS_FREQUENCY]);
+  if (wiphy == NULL)
+    return true;
 
-  if (tb[NL80211_BSS_INFORMATION_ELEMENTS])
-    parse_NL80211_BSS_INFORMATION_ELEMENTS(tb[NL80211_BSS_INFORMATION_ELEMENTS], bss->ssid);
+  if (params->ssids_length > wiphy->capabilities.max_scan_ssids)
+  {
+    to_log2("%d SSIDs to probe but the radio probes at most %d", params->ssids_length, wiphy->capabilities.max_scan_ssids);
+    errno = EINVAL;
+    return false;
+  }
 
-  if (tb[NL80211_BSS_SIGNAL_MBM])
-    bss->signal_mbm = mnl_attr_get_u32(tb[NL80211_BSS_SIGNAL_MBM]);
+  //no frequencies means all of them
+  for (i = 0; i < params->frequencies_length; ++i)
+    if (wiphy_frequency_valid(wiphy, params->frequencies[i]))
+      return true;
 
-  if (tb[NL80211_BSS_SEEN_MS_AGO])
-    bss->seen_ms_ago = mnl_attr_get_u32(tb[NL80211_BSS_SEEN_MS_AGO]);
+  if (params->frequencies_length > 0)
+  {
+    to_log("None of the frequencies can be scanned by the radio");
+    errno = EINVAL;
+    return false;
+  }
 
-  bss->status = (enum bss_status)status; //TODO: Better conversion
+  return true;
+}
 
-  ++scan_results->scanned;
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+void wifi_scan_capabilities(const struct wifi_scan *wifi, struct wifi_capabilities *capabilities)
+{
+  if (wifi->wiphy)
+    *capabilities = wifi->wiphy->capabilities;
+  else
+    memset(capabilities, 0, sizeof(struct wifi_capabilities));
 }
 
-//This is guesswork! Read up on that!!! I don't think it's netlink in this attribute, some lower beacon layer
-static void parse_NL80211_BSS_INFORMATION_ELEMENTS(struct nlattr *attr, char SSID_OUT[SSID_MAX_LENGTH_WITH_NULL])
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+int wifi_scan_channels(const struct wifi_scan *wifi, struct wifi_channel *channels, int channels_length)
 {
-  const char *payload = mnl_attr_get_payload(attr);
-  int len = mnl_attr_get_payload_len(attr);
-  if (len == 0 || payload[0] != 0 || payload[1] >= SSID_MAX_LENGTH_WITH_NULL || payload[1] > len - 2)
-  {
-    to_log("SSID len 0 or payload not starting from 0 or payload length > 32 or payload length > length-2!");
-    SSID_OUT[0] = '\0';
-    return;
-  }
-  int ssid_len = payload[1];
-  strncpy(SSID_OUT, payload + 2, ssid_len);
-  SSID_OUT[ssid_len] = '\0';
+  int count;
+
+  if (wifi->wiphy == NULL)
+    return 0;
+
+  count = wifi->wiphy->capabilities.channels;
+  if (channels_length > 0)
+    memcpy(channels, wifi->wiphy->channels, (count < channels_length ? count : channels_length) * sizeof(struct wifi_channel));
+
+  return count;
 }
 
-static void parse_NL80211_BSS_BSSID(struct nlattr *attr, uint8_t bssid_out[BSSID_LENGTH])
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+int wifi_scan_frequencies(const struct wifi_scan *wifi, uint8_t exclude_flags, uint32_t *frequencies, int frequencies_length)
 {
-  const char *payload = mnl_attr_get_payload(attr);
-  int len = mnl_attr_get_payload_len(attr);
+  const struct wiphy_cache *wiphy = wifi->wiphy;
+  int i, count = 0;
 
-  if (len != BSSID_LENGTH)
+  if (wiphy == NULL)
   {
-    to_log2("BSSID length != %d, ignoring", BSSID_LENGTH);
-    memset(bssid_out, 0, BSSID_LENGTH);
-    return;
+    errno = ENODATA;
+    return -1;
   }
 
-  memcpy(bssid_out, payload, BSSID_LENGTH);
+  for (i = 0; i < wiphy->capabilities.channels; ++i)
+    if (!(wiphy->channels[i].flags & (exclude_flags | WIFI_CHANNEL_DISABLED)))
+    {
+      if (count < frequencies_length)
+        frequencies[count] = wiphy->channels[i].frequency;
+      ++count;
+    }
+
+  return count;
 }
 
-// STATION
+// CLEANUP
 
-// public interface
-//
 // prerequisities:
 // - wifi initialized with wifi_scan_init
-int wifi_scan_station(struct wifi_scan *wifi, struct station_info *station)
+void wifi_scan_close(struct wifi_scan *wifi)
 {
-  struct netlink_channel *commands = &wifi->command_channel;
-  struct bss_info bss;
-
-  struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { &bss, 1, 0 };
-  commands->context = &scan_results;
+  wifi_scan_capture_stop(wifi);
+  wifi_scan_set_faults(wifi, NULL);
+  wifi_scan_set_flood_guard(wifi, NULL);
 
-  if (get_scan(commands) == MNL_CB_ERROR)
+  if (wifi->survey)
   {
-    to_log("get_scan returned an error");
-    return 0;
+    free(wifi->survey->channels);
+    free(wifi->survey);
   }
 
+  if (wifi->wiphy)
+  {
+    free(wifi->wiphy->channels);
+    free(wifi->wiphy);
+  }
+
+  free(wifi->colocated);
+  free(wifi->multiple_bssid);
+  free(wifi->neighbor);
+  free(wifi->ftm);
+
+  close_netlink_channel(&wifi->notification_channel);
+  close_netlink_channel(&wifi->command_channel);
+
+  if (wifi->replay)
+  {
+    free(wifi->replay->data);
+    free(wifi->replay);
+  }
+
+  if (wifi->fake)
+  {
+    free(wifi->fake->scan_results);
+    free(wifi->fake->queue[WIFI_SCAN_CHANNEL_NOTIFICATIONS].data);
+    free(wifi->fake->queue[WIFI_SCAN_CHANNEL_COMMANDS].data);
+    free(wifi->fake);
+  }
+}
+
+// prerequisities:
+// - channel initalized with init_netlink-channel
+static void close_netlink_channel(struct netlink_channel *channel)
+{
+  free(channel->buf);
+  if (channel->nl != 0)
+  {
+    mnl_socket_close(channel->nl);
+  }
+}
+
+
+// SCANNING
+
+// handle also trigger abort
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+// - bss_info table of sized bss_info_length passed
+int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length)
+{
+  struct scan_params params = { SCAN_MODE_TRIGGERED };
+  return wifi_scan_all_params(wifi, &params, bss_infos, bss_infos_length);
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init (or replay/fake)
+// - bss_info table of sized bss_info_length passed
+int wifi_scan_all_params(struct wifi_scan *wifi, const struct scan_params *params, struct bss_info *bss_infos, int bss_infos_length)
+{
+  struct netlink_channel *notifications = &wifi->notification_channel;
+  struct context_NL80211_MULTICAST_GROUP_SCAN scanning = { 0,0 };
+  notifications->context = &scanning;
+
+  struct netlink_channel *commands = &wifi->command_channel;
+  struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { bss_infos, bss_infos_length, 0 };
+  commands->context = &scan_results;
+
+  if (wifi->flood)
+  {
+    flood_reset(wifi->flood);
+    scan_results.flood = wifi->flood;
+    if (wifi->flood->config.max_bss > 0 && wifi->flood->config.max_bss < bss_infos_length)
+      scan_results.bss_infos_length = wifi->flood->config.max_bss;
+  }
+
+  struct scan_timings *timings = &wifi->timings;
+  struct timespec start, phase;
+  struct scan_params targeted;
+  uint32_t frequencies[WIFI_SCAN_COLOCATED_MAX];
+  bool trigger = params->mode == SCAN_MODE_TRIGGERED || params->mode == SCAN_MODE_COLOCATED;
+  int ret;
+
+  memset(timings, 0, sizeof(struct scan_timings));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  phase = start;
+
+  if (wifi->colocated == NULL && (wifi->colocated = calloc(sizeof(struct colocated_list), 1)) == NULL)
+    return -1;
+  if (wifi->multiple_bssid == NULL && (wifi->multiple_bssid = calloc(sizeof(struct multiple_bssid_list), 1)) == NULL)
+    return -1;
+
+  if (params->mode == SCAN_MODE_COLOCATED)
+  {
+    if (!colocated_params(wifi->colocated, params, &targeted, frequencies))
+      return -1;
+    params = &targeted;
+  }
+
+  if (trigger && !wiphy_check_params(wifi->wiphy, params))
+    return -1;
+
+  if (params->mode != SCAN_MODE_CACHED)
+  {
+    //notifications received while waiting for frames or FTM results are past notifications as well
+    scanning = wifi->scan_seen;
+    memset(&wifi->scan_seen, 0, sizeof(wifi->scan_seen));
+
+    //somebody else might have triggered scanning or even the results can be already waiting
+    if (!read_past_notifications(notifications))
+    {
+      return -1;
+    }
+    timings->notifications_ns = elapsed_ns(&phase);
+
+    //if no results yet or scan not triggered then trigger it (observer never triggers)
+    //the device can be busy - we have to take it into account
+    if (trigger)
+    {
+      timings->triggered = !scanning.new_scan_results && !scanning.scan_triggered;
+      if (trigger_scan_if_necessary(commands, &scanning, params, wifi->wiphy) == -1)
+        return -1; //most likely with errno set to EBUSY
+      timings->trigger_ns = elapsed_ns(&phase);
+    }
+
+    //now just wait for trigger/new_scan_results
+    if (!wait_for_new_scan_results(notifications))
+    {
+      return -1;
+    }
+    timings->wait_ns = elapsed_ns(&phase);
+  }
+
+  //colocated scan adds to what was learned before, any other starts over
+  if (params->mode != SCAN_MODE_COLOCATED)
+    wifi->colocated->length = 0;
+  scan_results.colocated = wifi->colocated;
+  wifi->multiple_bssid->length = 0;
+  scan_results.multiple_bssid = wifi->multiple_bssid;
+
+  //finally read the scan
+  ret = get_scan(commands);
+  timings->dump_retries = scan_results.interrupted;
+
+  if (ret == -1)
+  {
+    log_error("get_scan failed");
+    return -1;
+  }
+
+  multiple_bssid_link(wifi->multiple_bssid, &scan_results);
+
+  timings->dump_ns = elapsed_ns(&phase);
+  timings->total_ns = elapsed_ns(&start);
+
+  if (wifi->flood)
+    return flood_finish(wifi->flood, &scan_results);
+
+  return scan_results.scanned;
+}
+
+// public interface
+void wifi_scan_last_timings(const struct wifi_scan *wifi, struct scan_timings *timings)
+{
+  *timings = wifi->timings;
+}
+
+static uint64_t elapsed_ns(struct timespec *since)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t elapsed = (now.tv_sec - since->tv_sec) * 1000000000ULL + now.tv_nsec - since->tv_nsec;
+  *since = now;
+  return elapsed;
+}
+
+// SCANNING - notification related
+
+// prerequisities
+// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
+// - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
+static bool read_past_notifications(struct netlink_channel *notifications)
+{
+  if (!set_channel_non_blocking(notifications))
+  {
+    return false;
+  }
+
+  int ret, run_ret, error;
+
+  while ((ret = channel_receive(notifications)) != 0)
+  {
+    if (ret == -1)
+    {
+      if (errno != ENOBUFS)
+        break;
+      //socket overrun, some notifications were lost, we can only carry on with what we have
+      to_log("ReadPastNotificationsNonBlocking notifications lost");
+      continue;
+    }
+    //the line below fills context about past scans/triggers
+    run_ret = mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_MULTICAST_GROUP_SCAN, notifications);
+    if (run_ret <= 0)
+    {
+      log_error("ReadPastNotificationsNonBlocking mnl_cb_run failed");
+      error = errno;
+      set_channel_blocking(notifications);
+      errno = error;
+      return false;
+    }
+  }
+
+  if (ret == -1)
+  {
+    if (!(errno == EINPROGRESS || errno == EWOULDBLOCK))
+    {
+      log_error("ReadPastNotificationsNonBlocking mnl_socket_recv failed");
+      error = errno;
+      set_channel_blocking(notifications);
+      errno = error;
+      return false;
+    }
+  }
+  //no more notifications waiting
+  return set_channel_blocking(notifications);
+}
+
+// prerequisities
+// - channel initialized with init_netlink_channel
+static bool set_channel_non_blocking(struct netlink_channel *channel)
+{
+  return channel->transport->set_blocking(channel, false);
+}
+
+// prerequisities
+// - channel initialized with init_netlink_channel
+static bool set_channel_blocking(struct netlink_channel *channel)
+{
+  return channel->transport->set_blocking(channel, true);
+}
+
+// prerequisities:
+// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
+// - netlink_channel passed as data
+// - data->context of type struct context_NL80211_MULTICAST_GROUP_SCAN
+static int handle_NL80211_MULTICAST_GROUP_SCAN(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct context_NL80211_MULTICAST_GROUP_SCAN *context = channel->context;
+
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+
+  if (!record_scan_notification(nlh, context))
+    to_log2("Ignoring generic netlink command type %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+
+  return MNL_CB_OK;
+}
+
+static bool record_scan_notification(const struct nlmsghdr *nlh, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning)
+{
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+
+  if (genl->cmd == NL80211_CMD_TRIGGER_SCAN)
+    scanning->scan_triggered = 1;
+  else if (genl->cmd == NL80211_CMD_NEW_SCAN_RESULTS)
+  {
+    if (nlh->nlmsg_pid == 0 && nlh->nlmsg_seq == 0)
+      scanning->new_scan_results = 1;
+  }
+  else if (genl->cmd == NL80211_CMD_SCAN_ABORTED)
+    scanning->scan_triggered = 0; //no results are coming, somebody has to trigger again
+  else
+    return false;
+
+  return true;
+}
+
+
+// prerequisities:
+// - commands initialized with init_netlink_channel
+// - scanning updated with read_past_notifications
+static int trigger_scan_if_necessary(struct netlink_channel *commands, struct context_NL80211_MULTICAST_GROUP_SCAN *scanning, const struct scan_params *params, const struct wiphy_cache *wiphy)
+{
+  if (!scanning->new_scan_results && !scanning->scan_triggered)
+    if (trigger_scan(commands, params, wiphy) == -1)
+      return -1; //most likely errno set to EBUSY which means hardware is doing something else, try again later
+  return 0;
+}
+
+// prerequisities:
+// - channel initialized with init_netlink_channel
+static int trigger_scan(struct netlink_channel *channel, const struct scan_params *params, const struct wiphy_cache *wiphy)
+{
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_TRIGGER_SCAN, channel);
+  struct nlattr *nested;
+  int i, j;
+
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+
+  //without frequencies the driver scans all the channels
+  if (params->frequencies_length > 0)
+  {
+    nested = mnl_attr_nest_start(nlh, NL80211_ATTR_SCAN_FREQUENCIES);
+    for (i = 0, j = 0; i < params->frequencies_length; ++i)
+      if (wiphy_frequency_valid(wiphy, params->frequencies[i]))
+        mnl_attr_put_u32(nlh, j++, params->frequencies[i]);
+    mnl_attr_nest_end(nlh, nested);
+  }
+
+  //probe requests for those SSIDs (active scan, finds hidden networks)
+  if (params->ssids_length > 0)
+  {
+    nested = mnl_attr_nest_start(nlh, NL80211_ATTR_SCAN_SSIDS);
+    for (i = 0; i < params->ssids_length; ++i)
+      mnl_attr_put(nlh, i, strnlen(params->ssids[i], SSID_MAX_LENGTH_WITH_NULL - 1), params->ssids[i]);
+    mnl_attr_nest_end(nlh, nested);
+  }
+
+  //the driver probes BSSes it learned from Reduced Neighbor Reports on those channels
+  if (params->mode == SCAN_MODE_COLOCATED)
+    mnl_attr_put_u32(nlh, NL80211_ATTR_SCAN_FLAGS, NL80211_SCAN_FLAG_COLOCATED_6GHZ);
+
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+  return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+}
+
+// prerequisities
+// - channel initalized with init_netlink_channel
+// - subscribed to scan group with subscribe_NL80211_MULTICAST_GROUP_SCAN
+// - context_NL80211_MULTICAST_GROUP_SCAN set for notifications
+static bool wait_for_new_scan_results(struct netlink_channel *notifications)
+{
+  struct context_NL80211_MULTICAST_GROUP_SCAN *scanning = notifications->context;
+  int ret;
+
+  while (!scanning->new_scan_results)
+  {
+    if ((ret = channel_receive(notifications)) == -1 && errno == ENOBUFS)
+    {
+      //socket overrun, the notification we wait for might have been lost, waiting could take forever
+      to_log("Notifications lost while waiting for new scan results, reading available results");
+      return true;
+    }
+
+    if (ret <= 0)
+    {
+      log_error("Waiting for new scan results failed - mnl_socket_recvfrom");
+      return false;
+    }
+
+    if ((ret = mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_MULTICAST_GROUP_SCAN, notifications)) <= 0)
+    {
+      log_error("Processing notificatoins failed - mnl_cb_run");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// SCANNING - scan related
+
+// prerequisities:
+// - channel initalized with init_netlink_channel
+// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
+static int get_scan(struct netlink_channel *channel)
+{
+  struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results = channel->context;
+  int ret;
+
+  //the kernel flags the dump if BSS list changed in the meantime, we could have duplicates or miss BSSes
+  while ((ret = get_scan_dump(channel)) == -1 && errno == EINTR && scan_results->interrupted < GET_SCAN_INTERRUPTED_RETRIES)
+  {
+    to_log("Scan results dump interrupted, retrying");
+    ++scan_results->interrupted;
+    scan_results->scanned = 0;
+    if (scan_results->flood)
+      flood_reset(scan_results->flood);
+    if (scan_results->multiple_bssid)
+      scan_results->multiple_bssid->length = 0;
+  }
+
+  return ret;
+}
+
+// prerequisities:
+// - channel initalized with init_netlink_channel
+// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
+static int get_scan_dump(struct netlink_channel *channel)
+{
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_SCAN, channel);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+  return receive_nl_message(channel, handle_NL80211_CMD_NEW_SCAN_RESULTS);
+}
+
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type context_NL80211_CMD_NEW_SCAN_RESULTS
+static int handle_NL80211_CMD_NEW_SCAN_RESULTS(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_NEW_SCAN_RESULTS_VALIDATION, NL80211_NEW_SCAN_RESULTS_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+
+
+  if (genl->cmd != NL80211_CMD_NEW_SCAN_RESULTS)
+  {
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
+  }
+
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+
+  if (!tb[NL80211_ATTR_BSS])
+    return MNL_CB_OK;
+
+  parse_NL80211_ATTR_BSS(tb[NL80211_ATTR_BSS], channel);
+
+  return MNL_CB_OK;
+}
+
+// prerequisities:
+// - channel context of type context_NL80211_CMD_NEW_SCAN_RESULTS
+static void parse_NL80211_ATTR_BSS(struct nlattr *nested, struct netlink_channel *channel)
+{
+  struct nlattr *tb[NL80211_BSS_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_BSS_MAX, NL80211_BSS_VALIDATION, NL80211_BSS_VALIDATION_LENGTH };
+  struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results = channel->context;
+  struct bss_info *bss = scan_results->bss_infos + scan_results->scanned;
+
+  mnl_attr_parse_nested(nested, validate, &vd);
+
+  enum nl80211_bss_status status = BSS_NONE;
+
+  if (tb[NL80211_BSS_STATUS])
+    status = mnl_attr_get_u32(tb[NL80211_BSS_STATUS]);
+
+  //neighbours of all the BSSes count, also of those not kept
+  if (scan_results->colocated)
+    colocated_collect(scan_results->colocated, tb);
+
+  if (scan_results->flood)
+  {
+    flood_count(scan_results->flood, tb);
+
+    //over the limit the guard decides what to keep, associated bss included
+    if (scan_results->flood->config.eviction != SCAN_EVICT_NONE && scan_results->scanned >= scan_results->bss_infos_length)
+    {
+      flood_evict(scan_results, tb, status);
+      ++scan_results->scanned;
+      return;
+    }
+  }
+
+  //if we have found associated station store first as last and associated as first
+  if (status == NL80211_BSS_STATUS_ASSOCIATED
+   //|| status == NL80211_BSS_STATUS_AUTHENTICATED
+   || status == NL80211_BSS_STATUS_IBSS_JOINED)
+  {
+    if (scan_results->scanned > 0 && scan_results->scanned < scan_results->bss_infos_length)
+      memcpy(bss, scan_results->bss_infos, sizeof(struct bss_info));
+    bss = scan_results->bss_infos;
+  }
+
+  //check bounds, make exception if we have found associated station and replace previous data
+  if (scan_results->bss_infos_length == 0 || (scan_results->scanned >= scan_results->bss_infos_length && bss != scan_results->bss_infos))
+  {
+    ++scan_results->scanned;
+    return;
+  }
+
+  parse_bss(tb, status, bss);
+
+  if (scan_results->multiple_bssid && (bss->multiple_bssid & BSS_MULTIPLE_BSSID_TRANSMITTED))
+    multiple_bssid_collect(scan_results->multiple_bssid, tb[NL80211_BSS_INFORMATION_ELEMENTS], bss);
+
+  ++scan_results->scanned;
+}
+
+static void parse_bss(struct nlattr **tb, enum nl80211_bss_status status, struct bss_info *bss)
+{
+  if (tb[NL80211_BSS_BSSID])
+    parse_NL80211_BSS_BSSID(tb[NL80211_BSS_BSSID], bss->bssid);
+
+  //until linked with transmitted BSS (see multiple_bssid_link)
+  memcpy(bss->transmitter_bssid, bss->bssid, BSSID_LENGTH);
+
+  if (tb[NL80211_BSS_FREQUENCY])
+    bss->frequency = mnl_attr_get_u32(tb[NL80211_BSS_FREQUENCY]);
+
+  if (tb[NL80211_BSS_INFORMATION_ELEMENTS])
+    parse_NL80211_BSS_INFORMATION_ELEMENTS(tb[NL80211_BSS_INFORMATION_ELEMENTS], bss);
+  else
+  {
+    bss->channel = 0;
+    bss->channel_width = BSS_CHANNEL_WIDTH_20;
+    bss->center_frequency = bss->frequency;
+    bss->center_frequency2 = 0;
+    bss->station_count = bss->channel_utilization = -1;
+    memset(&bss->security, 0, sizeof(struct bss_security));
+    bss->multiple_bssid = bss->multiple_bssid_index = 0;
+    bss->ftm = 0;
+  }
+
+  bss->capability = tb[NL80211_BSS_CAPABILITY] ? mnl_attr_get_u16(tb[NL80211_BSS_CAPABILITY]) : 0;
+
+  //privacy without RSN or WPA element
+  if ((bss->capability & 0x10) && bss->security.protocols == 0)
+    bss->security.protocols = BSS_SECURITY_WEP;
+
+  if (tb[NL80211_BSS_SIGNAL_MBM])
+    bss->signal_mbm = mnl_attr_get_u32(tb[NL80211_BSS_SIGNAL_MBM]);
+
+  if (tb[NL80211_BSS_SEEN_MS_AGO])
+    bss->seen_ms_ago = mnl_attr_get_u32(tb[NL80211_BSS_SEEN_MS_AGO]);
+
+  bss->status = (enum bss_status)status; //TODO: Better conversion
+}
+
+// IEs are not netlink attributes but 802.11 elements (id, length, data) from beacon or probe response
+// prerequisities:
+// - bss->frequency is already set (channel numbers are relative to band)
+static void parse_NL80211_BSS_INFORMATION_ELEMENTS(struct nlattr *attr, struct bss_info *bss)
+{
+  parse_information_elements(mnl_attr_get_payload(attr), mnl_attr_get_payload_len(attr), bss);
+}
+
+static void parse_information_elements(const uint8_t *payload, int len, struct bss_info *bss)
+{
+  static const uint8_t RSN_OUI[] = {0x00, 0x0f, 0xac}, WPA_OUI[] = {0x00, 0x50, 0xf2};
+  int offset, length;
+  struct bss_security wpa = {0};
+  struct operating_channel channel = {BSS_CHANNEL_WIDTH_20, bss->frequency, 0}, candidate;
+  bool ssid = false, transmitted = false;
+
+  bss->ssid[0] = '\0';
+  bss->channel = 0;
+  bss->station_count = bss->channel_utilization = -1;
+  bss->multiple_bssid_index = 0;
+  bss->ftm = 0;
+  memset(&bss->security, 0, sizeof(struct bss_security));
+
+  for (offset = 0; offset + 2 <= len; offset += 2 + length)
+  {
+    const uint8_t *data = payload + offset + 2;
+    length = payload[offset + 1];
+
+    if (length > len - offset - 2)
+    {
+      to_log("IE length > remaining payload length, ignoring the rest");
+      break;
+    }
+
+    switch (payload[offset])
+    {
+      case IE_SSID:
+        //the first one, others may be nested in e.g. multiple BSSID element
+        if (ssid)
+          break;
+        ssid = true;
+        if (length >= SSID_MAX_LENGTH_WITH_NULL)
+        {
+          to_log("SSID payload length > 32!");
+          break;
+        }
+        strncpy(bss->ssid, (const char*)data, length);
+        bss->ssid[length] = '\0';
+        break;
+      case IE_DS_PARAMETER_SET:
+        if (length >= 1)
+          bss->channel = data[0];
+        break;
+      case IE_BSS_LOAD:
+        //station count, channel utilization, available admission capacity
+        if (length < 3 || bss->channel_utilization != -1)
+          break;
+        bss->station_count = data[0] | data[1] << 8;
+        bss->channel_utilization = data[2];
+        break;
+      case IE_RSN:
+        if (length >= 2 && !(bss->security.protocols & BSS_SECURITY_RSN))
+        {
+          bss->security.protocols |= BSS_SECURITY_RSN;
+          parse_security_element(data, length, RSN_OUI, &bss->security);
+        }
+        break;
+      case IE_HT_OPERATION:
+        if (length >= 1 && bss->channel == 0)
+          bss->channel = data[0];
+        if (parse_ht_operation(data, length, bss->frequency, &candidate))
+          operating_channel_update(&channel, &candidate, bss->frequency);
+        break;
+      case IE_VHT_OPERATION:
+        if (parse_vht_operation(data, length, bss->frequency, &candidate))
+          operating_channel_update(&channel, &candidate, bss->frequency);
+        break;
+      case IE_MULTIPLE_BSSID:
+        transmitted = transmitted || length >= 1;
+        break;
+      case IE_MULTIPLE_BSSID_INDEX:
+        //nontransmitted BSS reported by the kernel has the index of its profile
+        if (length >= 1 && bss->multiple_bssid_index == 0)
+          bss->multiple_bssid_index = data[0];
+        break;
+      case IE_EXTENDED_CAPABILITIES:
+        //bit 70 FTM responder, bit 71 FTM initiator
+        if (length >= 9)
+          bss->ftm = (data[8] & 0x40 ? BSS_FTM_RESPONDER : 0) | (data[8] & 0x80 ? BSS_FTM_INITIATOR : 0);
+        break;
+      case IE_EXTENSION:
+        if (length >= 1 && data[0] == IE_EXT_HE_OPERATION && parse_he_operation(data + 1, length - 1, bss->frequency, &candidate))
+          operating_channel_update(&channel, &candidate, bss->frequency);
+        else if (length >= 1 && data[0] == IE_EXT_EHT_OPERATION && parse_eht_operation(data + 1, length - 1, bss->frequency, &candidate))
+          operating_channel_update(&channel, &candidate, bss->frequency);
+        break;
+      case IE_VENDOR_SPECIFIC:
+        if (length >= 6 && memcmp(data, WPA_OUI, 3) == 0 && data[3] == 1 && !(wpa.protocols & BSS_SECURITY_WPA))
+        {
+          wpa.protocols = BSS_SECURITY_WPA;
+          parse_security_element(data + 4, length - 4, WPA_OUI, &wpa);
+        }
+        break;
+    }
+  }
+
+  bss->channel_width = channel.width;
+  bss->center_frequency = channel.center;
+  bss->center_frequency2 = channel.center2;
+  bss->multiple_bssid = bss->multiple_bssid_index ? BSS_MULTIPLE_BSSID_NONTRANSMITTED : transmitted ? BSS_MULTIPLE_BSSID_TRANSMITTED : 0;
+
+  //suites of RSN take precedence
+  if (wpa.protocols && bss->security.protocols)
+    bss->security.protocols |= BSS_SECURITY_WPA;
+  else if (wpa.protocols)
+    bss->security = wpa;
+}
+
+// version, group cipher, pairwise ciphers, AKMs, capabilities, the fields missing at the end are left 0
+static void parse_security_element(const uint8_t *data, int len, const uint8_t oui[3], struct bss_security *security)
+{
+  int offset = 2, count, i;
+
+  if (offset + 4 > len)
+    return;
+
+  if (memcmp(data + offset, oui, 3) == 0)
+    security->group_cipher = data[offset + 3];
+  offset += 4;
+
+  if (offset + 2 > len)
+    return;
+  count = data[offset] | data[offset + 1] << 8;
+
+  for (i = 0, offset += 2; i < count && offset + 4 <= len; ++i, offset += 4)
+    if (memcmp(data + offset, oui, 3) == 0 && data[offset + 3] < 16)
+      security->pairwise_ciphers |= 1 << data[offset + 3];
+
+  if (i < count || offset + 2 > len)
+    return;
+  count = data[offset] | data[offset + 1] << 8;
+
+  for (i = 0, offset += 2; i < count && offset + 4 <= len; ++i, offset += 4)
+    if (memcmp(data + offset, oui, 3) == 0 && data[offset + 3] < 32)
+      security->akm_suites |= (uint32_t)1 << data[offset + 3];
+
+  if (i == count && offset + 2 <= len)
+    security->rsn_capabilities = data[offset] | data[offset + 1] << 8;
+}
+
+// primary channel, secondary channel offset (1 above, 3 below) and any channel width allowed
+static bool parse_ht_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel)
+{
+  uint8_t offset;
+
+  if (len < 2 || !(data[1] & 0x04))
+    return false;
+
+  offset = data[1] & 0x03;
+
+  if (offset != 1 && offset != 3)
+    return false;
+
+  channel->width = BSS_CHANNEL_WIDTH_40;
+  channel->center = offset == 1 ? primary + 10 : primary - 10;
+  channel->center2 = 0;
+  return true;
+}
+
+// channel width, center frequency segment 0 and 1
+static bool parse_vht_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel)
+{
+  if (len < 3 || data[0] == 0)
+    return false; //HT operation tells 20 or 40
+
+  //width 2 and 3 are deprecated 160 and 80+80 with segment 0 as the center
+  if (data[0] == 1)
+    wide_channel(primary, data[1], data[2], channel);
+  else if (data[0] == 2)
+  {
+    channel->width = BSS_CHANNEL_WIDTH_160;
+    channel->center = channel_frequency(primary, data[1]);
+    channel->center2 = 0;
+  }
+  else if (data[0] == 3)
+  {
+    channel->width = BSS_CHANNEL_WIDTH_80P80;
+    channel->center = channel_frequency(primary, data[1]);
+    channel->center2 = channel_frequency(primary, data[2]);
+  }
+  else
+    return false;
+
+  return true;
+}
+
+// HE operation parameters (3), BSS color (1), basic HE-MCS (2), optional VHT operation information (3),
+// co-hosted BSS indicator (1) and 6 GHz operation information (primary, control, segment 0 and 1, minimum rate)
+static bool parse_he_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel)
+{
+  int offset = 6;
+  uint8_t width;
+
+  if (len < offset || !(data[2] & 0x02))
+    return false; //no 6 GHz operation information, HT and VHT operation tell
+
+  if (data[1] & 0x40)
+    offset += 3;
+  if (data[1] & 0x80)
+    offset += 1;
+
+  if (offset + 5 > len)
+    return false;
+
+  data += offset;
+  width = data[1] & 0x03;
+
+  if (width == 3 && data[3] == 0)
+  { //160 with segment 0 as the center
+    channel->width = BSS_CHANNEL_WIDTH_160;
+    channel->center = channel_frequency(primary, data[2]);
+    channel->center2 = 0;
+  }
+  else if (width >= 2)
+    wide_channel(primary, data[2], width == 3 ? data[3] : 0, channel);
+  else
+  {
+    channel->width = width;
+    channel->center = channel_frequency(primary, data[2]);
+    channel->center2 = 0;
+  }
+
+  return true;
+}
+
+// EHT operation parameters (1), basic EHT-MCS (4) and optional EHT operation information (control, segment 0 and 1)
+static bool parse_eht_operation(const uint8_t *data, int len, uint32_t primary, struct operating_channel *channel)
+{
+  uint8_t width;
+
+  if (len < 8 || !(data[0] & 0x01))
+    return false;
+
+  data += 5;
+  width = data[0] & 0x07;
+
+  //segment 0 is the center of 20/40/80, segment 1 of 160 and 320
+  if (width == 4)
+  {
+    channel->width = BSS_CHANNEL_WIDTH_320;
+    channel->center = channel_frequency(primary, data[2]);
+    channel->center2 = 0;
+  }
+  else if (width == 2 || width == 3)
+    wide_channel(primary, data[1], width == 3 ? data[2] : 0, channel);
+  else if (width <= 1)
+  {
+    channel->width = width;
+    channel->center = channel_frequency(primary, data[1]);
+    channel->center2 = 0;
+  }
+  else
+    return false;
+
+  return true;
+}
+
+static void wide_channel(uint32_t primary, uint8_t segment0, uint8_t segment1, struct operating_channel *channel)
+{
+  uint32_t center0 = channel_frequency(primary, segment0), center1, distance;
+
+  channel->width = BSS_CHANNEL_WIDTH_80;
+  channel->center = center0;
+  channel->center2 = 0;
+
+  if (segment1 == 0)
+    return;
+
+  //segment 1 is the center of 160 (40 MHz from segment 0) or of the second 80 MHz segment
+  center1 = channel_frequency(primary, segment1);
+  distance = center1 > center0 ? center1 - center0 : center0 - center1;
+
+  if (distance == 40)
+  {
+    channel->width = BSS_CHANNEL_WIDTH_160;
+    channel->center = center1;
+  }
+  else if (distance > 80)
+  {
+    channel->width = BSS_CHANNEL_WIDTH_80P80;
+    channel->center2 = center1;
+  }
+}
+
+// inconsistent elements (primary outside of the channel) are ignored
+static void operating_channel_update(struct operating_channel *channel, const struct operating_channel *candidate, uint32_t primary)
+{
+  static const uint16_t HALF_WIDTH_MHZ[] = {10, 20, 40, 80, 40, 160}; //of segment, by enum bss_channel_width
+  uint32_t half;
+  bool inside;
+
+  if (candidate->width <= channel->width || candidate->width > BSS_CHANNEL_WIDTH_320)
+    return;
+
+  half = HALF_WIDTH_MHZ[candidate->width];
+  inside = primary + half >= candidate->center + 10u && primary + 10 <= candidate->center + half;
+
+  if (candidate->width == BSS_CHANNEL_WIDTH_80P80 && !inside)
+    inside = primary + half >= candidate->center2 + 10u && primary + 10 <= candidate->center2 + half;
+
+  if (inside)
+    *channel = *candidate;
+}
+
+// 2.4 GHz channel 14 and 6 GHz channel 2 are the exceptions
+static uint32_t channel_frequency(uint32_t primary, uint8_t channel)
+{
+  if (primary < 2500)
+    return channel == 14 ? 2484 : 2407 + 5 * channel;
+  if (primary >= 5925)
+    return channel == 2 ? 5935 : 5950 + 5 * channel;
+  if (primary < 5000)
+    return 4000 + 5 * channel;
+  return 5000 + 5 * channel;
+}
+
+static void parse_NL80211_BSS_BSSID(struct nlattr *attr, uint8_t bssid_out[BSSID_LENGTH])
+{
+  const char *payload = mnl_attr_get_payload(attr);
+  int len = mnl_attr_get_payload_len(attr);
+
+  if (len != BSSID_LENGTH)
+  {
+    to_log2("BSSID length != %d, ignoring", BSSID_LENGTH);
+    memset(bssid_out, 0, BSSID_LENGTH);
+    return;
+  }
+
+  memcpy(bssid_out, payload, BSSID_LENGTH);
+}
+
+// public interface
+//
+// prerequisities:
+// - buf holds whole netlink messages (as received in single recv)
+// - scanned is 0 for the first part of the dump or the value returned for previous part
+int wifi_scan_parse_scan_results(const void *buf, size_t len, struct bss_info *bss_infos, int bss_infos_length, int scanned)
+{
+  struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { bss_infos, bss_infos_length, scanned };
+  struct netlink_channel channel = { 0 };
+  channel.context = &scan_results;
+
+  //no sequence number and port id checks, the data doesn't come from our requests
+  if (mnl_cb_run(buf, len, 0, 0, handle_NL80211_CMD_NEW_SCAN_RESULTS, &channel) == MNL_CB_ERROR)
+    return -1;
+
+  return scan_results.scanned;
+}
+
+// SCANNING - flood guard
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+int wifi_scan_set_flood_guard(struct wifi_scan *wifi, const struct scan_flood_guard *guard)
+{
+  struct flood_guard *flood = NULL;
+
+  if (guard)
+  {
+    if (guard->max_bss < 0 || guard->flood_bss < 0 || guard->flood_repeats < 0
+     || guard->eviction < SCAN_EVICT_NONE || guard->eviction > SCAN_EVICT_LEAST_RECENT)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+    if ((flood = calloc(sizeof(struct flood_guard), 1)) == NULL)
+      return -1;
+
+    flood->config = *guard;
+  }
+
+  free(wifi->flood);
+  wifi->flood = flood;
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+void wifi_scan_last_flood_status(const struct wifi_scan *wifi, struct scan_flood_status *status)
+{
+  if (wifi->flood)
+    *status = wifi->flood->status;
+  else
+    memset(status, 0, sizeof(struct scan_flood_status));
+}
+
+static void flood_reset(struct flood_guard *flood)
+{
+  memset(&flood->status, 0, sizeof(flood->status));
+  memset(flood->ssids, 0, sizeof(flood->ssids));
+  memset(flood->ouis, 0, sizeof(flood->ouis));
+}
+
+// only the first IE is looked at, SSID element is always first in beacons and probe responses
+static void flood_count(struct flood_guard *flood, struct nlattr **tb)
+{
+  struct scan_flood_status *status = &flood->status;
+  int repeats;
+
+  if (tb[NL80211_BSS_BSSID])
+  {
+    const uint8_t *bssid = mnl_attr_get_payload(tb[NL80211_BSS_BSSID]);
+    //the high bits tell OUI from SSID hashes apart
+    repeats = flood_sketch_add(flood->ouis, (uint64_t)bssid[0] << 16 | bssid[1] << 8 | bssid[2]);
+    if (repeats > status->max_oui_repeats)
+      status->max_oui_repeats = repeats;
+  }
+
+  if (tb[NL80211_BSS_INFORMATION_ELEMENTS])
+  {
+    const uint8_t *ie = mnl_attr_get_payload(tb[NL80211_BSS_INFORMATION_ELEMENTS]);
+    int len = mnl_attr_get_payload_len(tb[NL80211_BSS_INFORMATION_ELEMENTS]), i;
+    uint64_t hash = 0xcbf29ce484222325ULL; //FNV-1a
+    bool hidden = true;
+
+    if (len < 2 || ie[0] != IE_SSID || ie[1] + 2 > len)
+      return;
+
+    for (i = 0; i < ie[1]; ++i)
+    {
+      hash = (hash ^ ie[2 + i]) * 0x100000001b3ULL;
+      hidden = hidden && ie[2 + i] == 0;
+    }
+
+    //hidden SSIDs come either as zero length or as zeroed bytes, there are many legitimate ones
+    if (hidden)
+      return;
+
+    repeats = flood_sketch_add(flood->ssids, hash);
+    if (repeats > status->max_ssid_repeats)
+      status->max_ssid_repeats = repeats;
+  }
+}
+
+static int flood_sketch_add(uint16_t sketch[FLOOD_SKETCH_DEPTH][FLOOD_SKETCH_WIDTH], uint64_t key)
+{
+  int row, estimate = UINT16_MAX;
+
+  for (row = 0; row < FLOOD_SKETCH_DEPTH; ++row)
+  {
+    //splitmix64 finalizer with different seed for each row
+    uint64_t h = key + (row + 1) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+
+    uint16_t *counter = &sketch[row][h >> (64 - FLOOD_SKETCH_WIDTH_BITS)];
+
+    if (*counter < UINT16_MAX)
+      ++*counter;
+    if (*counter < estimate)
+      estimate = *counter;
+  }
+
+  return estimate;
+}
+
+// BSSID and IEs of bss are decoded only if it is kept
+//
+// prerequisities:
+// - scan_results guarded with eviction other than SCAN_EVICT_NONE
+// - scanned >= bss_infos_length
+static void flood_evict(struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results, struct nlattr **tb, enum nl80211_bss_status status)
+{
+  enum scan_eviction eviction = scan_results->flood->config.eviction;
+  struct bss_info *heap = scan_results->bss_infos;
+  int length = scan_results->bss_infos_length, i;
+  int32_t signal_mbm = tb[NL80211_BSS_SIGNAL_MBM] ? (int32_t)mnl_attr_get_u32(tb[NL80211_BSS_SIGNAL_MBM]) : 0;
+  uint32_t seen_ms_ago = tb[NL80211_BSS_SEEN_MS_AGO] ? mnl_attr_get_u32(tb[NL80211_BSS_SEEN_MS_AGO]) : 0;
+
+  if (length == 0)
+    return;
+
+  //the table has just filled up, from now on the worst bss is at the top
+  if (scan_results->scanned == length)
+    for (i = length / 2 - 1; i >= 0; --i)
+      flood_sift_down(heap, length, i, eviction);
+
+  if (flood_key(eviction, status, signal_mbm, seen_ms_ago) <= flood_bss_key(eviction, heap))
+    return;
+
+  //attributes missing in bss must not be taken from the evicted one
+  memset(heap, 0, sizeof(struct bss_info));
+  parse_bss(tb, status, heap);
+  flood_sift_down(heap, length, 0, eviction);
+}
+
+static int64_t flood_key(enum scan_eviction eviction, enum nl80211_bss_status status, int32_t signal_mbm, uint32_t seen_ms_ago)
+{
+  if (status == NL80211_BSS_STATUS_ASSOCIATED || status == NL80211_BSS_STATUS_IBSS_JOINED)
+    return INT64_MAX;
+
+  return eviction == SCAN_EVICT_WEAKEST ? signal_mbm : -(int64_t)seen_ms_ago;
+}
+
+static int64_t flood_bss_key(enum scan_eviction eviction, const struct bss_info *bss)
+{
+  return flood_key(eviction, (enum nl80211_bss_status)bss->status, bss->signal_mbm, bss->seen_ms_ago);
+}
+
+static void flood_sift_down(struct bss_info *heap, int length, int i, enum scan_eviction eviction)
+{
+  struct bss_info top = heap[i];
+  int64_t key = flood_bss_key(eviction, &top);
+  int child;
+
+  while ((child = 2 * i + 1) < length)
+  {
+    if (child + 1 < length && flood_bss_key(eviction, heap + child + 1) < flood_bss_key(eviction, heap + child))
+      ++child;
+    if (key <= flood_bss_key(eviction, heap + child))
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+
+  heap[i] = top;
+}
+
+static int flood_finish(struct flood_guard *flood, struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results)
+{
+  struct scan_flood_status *status = &flood->status;
+  const struct scan_flood_guard *config = &flood->config;
+  int kept = scan_results->scanned < scan_results->bss_infos_length ? scan_results->scanned : scan_results->bss_infos_length;
+  int i;
+
+  //heap order moved associated bss somewhere
+  if (config->eviction != SCAN_EVICT_NONE && scan_results->scanned > scan_results->bss_infos_length)
+    for (i = 1; i < kept; ++i)
+      if (scan_results->bss_infos[i].status == BSS_ASSOCIATED || scan_results->bss_infos[i].status == BSS_IBSS_JOINED)
+      {
+        struct bss_info associated = scan_results->bss_infos[i];
+        scan_results->bss_infos[i] = scan_results->bss_infos[0];
+        scan_results->bss_infos[0] = associated;
+        break;
+      }
+
+  status->bss_total = scan_results->scanned;
+
+  if (config->max_bss > 0 && status->bss_total > config->max_bss)
+    status->evicted = status->bss_total - config->max_bss;
+
+  status->flood = (config->flood_bss > 0 && status->bss_total > config->flood_bss)
+   || (config->flood_repeats > 0 && (status->max_ssid_repeats > config->flood_repeats || status->max_oui_repeats > config->flood_repeats));
+
+  if (status->flood)
+    to_log2("Beacon flood suspected: %d BSSes, SSID repeats %d, OUI repeats %d", status->bss_total, status->max_ssid_repeats, status->max_oui_repeats);
+
+  return config->max_bss > 0 && status->bss_total > config->max_bss ? config->max_bss : status->bss_total;
+}
+
+// SCANNING - multiple BSSID
+
+static void multiple_bssid_collect(struct multiple_bssid_list *list, struct nlattr *attr, const struct bss_info *transmitter)
+{
+  const uint8_t *payload = mnl_attr_get_payload(attr);
+  int len = mnl_attr_get_payload_len(attr), offset, length, sub, sub_length;
+
+  for (offset = 0; offset + 2 <= len; offset += 2 + length)
+  {
+    const uint8_t *data = payload + offset + 2;
+    length = payload[offset + 1];
+
+    if (offset + 2 + length > len)
+      break;
+
+    if (payload[offset] != IE_MULTIPLE_BSSID || length < 1)
+      continue;
+
+    //MaxBSSID Indicator followed by subelements
+    for (sub = 1; sub + 2 <= length; sub += 2 + sub_length)
+    {
+      sub_length = data[sub + 1];
+
+      if (sub + 2 + sub_length > length)
+        break;
+
+      if (data[sub] != MULTIPLE_BSSID_SUBELEMENT_PROFILE)
+        continue;
+
+      if (list->length == WIFI_SCAN_MULTIPLE_BSSID_MAX)
+      {
+        to_log2("Too many nontransmitted BSS profiles (max %d), ignoring the rest", WIFI_SCAN_MULTIPLE_BSSID_MAX);
+        return;
+      }
+
+      if (multiple_bssid_profile(list, data + sub + 2, sub_length, payload, len, data[0], transmitter, &list->bss[list->length]))
+        ++list->length;
+    }
+  }
+}
+
+static bool multiple_bssid_profile(struct multiple_bssid_list *list, const uint8_t *profile, int profile_len, const uint8_t *ies, int ies_len,
+	uint8_t max_bssid_indicator, const struct bss_info *transmitter, struct bss_info *bss)
+{
+  uint8_t mask = max_bssid_indicator >= 8 ? 0xff : (1 << max_bssid_indicator) - 1, index = 0;
+  int offset, length, merged;
+  uint16_t capability_info = 0;
+  bool capability = false;
+
+  for (offset = 0; offset + 2 <= profile_len; offset += 2 + length)
+  {
+    length = profile[offset + 1];
+
+    if (offset + 2 + length > profile_len)
+      return false;
+
+    if (profile[offset] == IE_NONTRANSMITTED_BSSID_CAPABILITY && length >= 2)
+    {
+      capability_info = profile[offset + 2] | profile[offset + 3] << 8;
+      capability = true;
+    }
+    else if (profile[offset] == IE_MULTIPLE_BSSID_INDEX && length >= 1)
+      index = profile[offset + 2];
+  }
+
+  //profile split across elements (rare) is not stitched together
+  if (max_bssid_indicator == 0 || index == 0 || !capability)
+    return false;
+
+  if ((merged = multiple_bssid_inherit(profile, profile_len, ies, ies_len, list->ies, MULTIPLE_BSSID_IES_MAX)) == -1)
+  {
+    to_log2("Nontransmitted BSS profile with inherited elements over %d bytes, ignoring", MULTIPLE_BSSID_IES_MAX);
+    return false;
+  }
+
+  *bss = *transmitter;
+
+  //the n least significant bits of transmitted BSSID plus index modulo 2^n
+  bss->bssid[BSSID_LENGTH - 1] = (transmitter->bssid[BSSID_LENGTH - 1] & ~mask) | ((transmitter->bssid[BSSID_LENGTH - 1] + index) & mask);
+
+  parse_information_elements(list->ies, merged, bss);
+  bss->capability = capability_info;
+
+  //privacy without RSN or WPA element
+  if ((bss->capability & 0x10) && bss->security.protocols == 0)
+    bss->security.protocols = BSS_SECURITY_WEP;
+
+  memcpy(bss->transmitter_bssid, transmitter->bssid, BSSID_LENGTH);
+  bss->multiple_bssid = BSS_MULTIPLE_BSSID_NONTRANSMITTED | BSS_MULTIPLE_BSSID_EXPANDED;
+  bss->multiple_bssid_index = index;
+  bss->status = BSS_NONE;
+
+  return true;
+}
+
+static int multiple_bssid_inherit(const uint8_t *profile, int profile_len, const uint8_t *ies, int ies_len, uint8_t *out, int out_size)
+{
+  const uint8_t *non_inheritance = NULL;
+  int offset, length, merged = profile_len;
+
+  if (profile_len > out_size)
+    return -1;
+
+  memcpy(out, profile, profile_len);
+
+  for (offset = 0; offset + 2 <= profile_len; offset += 2 + profile[offset + 1])
+    if (profile[offset] == IE_EXTENSION && profile[offset + 1] >= 1 && profile[offset + 2] == IE_EXT_NON_INHERITANCE)
+      non_inheritance = profile + offset;
+
+  for (offset = 0; offset + 2 <= ies_len; offset += 2 + length)
+  {
+    length = ies[offset + 1];
+
+    if (offset + 2 + length > ies_len)
+      break;
+
+    if (multiple_bssid_not_inherited(profile, profile_len, non_inheritance, ies + offset))
+      continue;
+
+    if (merged + 2 + length > out_size)
+      return -1;
+
+    memcpy(out + merged, ies + offset, 2 + length);
+    merged += 2 + length;
+  }
+
+  return merged;
+}
+
+static bool multiple_bssid_not_inherited(const uint8_t *profile, int profile_len, const uint8_t *non_inheritance, const uint8_t *element)
+{
+  uint8_t id = element[0], length = element[1];
+  int offset;
+
+  if (id == IE_MULTIPLE_BSSID || (id == IE_EXTENSION && length < 1))
+    return true;
+
+  //element id list followed by element id extension list
+  if (non_inheritance)
+  {
+    const uint8_t *list = non_inheritance + 3, *end = non_inheritance + 2 + non_inheritance[1];
+    int l;
+
+    if (list < end && id != IE_EXTENSION)
+      for (l = 0; l < list[0] && list + 1 + l < end; ++l)
+        if (list[1 + l] == id)
+          return true;
+
+    if (list < end && id == IE_EXTENSION && (list += 1 + list[0]) < end)
+      for (l = 0; l < list[0] && list + 1 + l < end; ++l)
+        if (list[1 + l] == element[2])
+          return true;
+  }
+
+  //extension elements by extension id, vendor specific by OUI and type
+  for (offset = 0; offset + 2 <= profile_len; offset += 2 + profile[offset + 1])
+  {
+    if (profile[offset] != id)
+      continue;
+    if (id == IE_EXTENSION && (profile[offset + 1] < 1 || profile[offset + 2] != element[2]))
+      continue;
+    if (id == IE_VENDOR_SPECIFIC && (profile[offset + 1] < 4 || length < 4 || memcmp(profile + offset + 2, element + 2, 4)))
+      continue;
+    return true;
+  }
+
+  return false;
+}
+
+static void multiple_bssid_link(struct multiple_bssid_list *list, struct context_NL80211_CMD_NEW_SCAN_RESULTS *scan_results)
+{
+  int kept = scan_results->scanned < scan_results->bss_infos_length ? scan_results->scanned : scan_results->bss_infos_length;
+  int i, unique;
+
+  if (list->length == 0)
+    return;
+
+  qsort(list->bss, list->length, sizeof(struct bss_info), bssid_compare);
+
+  //the same profile repeated in beacon and probe response records
+  for (i = 1, unique = 1; i < list->length; ++i)
+    if (bssid_compare(&list->bss[i], &list->bss[unique - 1]))
+      list->bss[unique++] = list->bss[i];
+
+  list->length = unique;
+  memset(list->reported, 0, list->length * sizeof(bool));
+
+  for (i = 0; i < kept; ++i)
+  {
+    struct bss_info *bss = &scan_results->bss_infos[i];
+    const struct bss_info *profile = bsearch(bss, list->bss, list->length, sizeof(struct bss_info), bssid_compare);
+
+    if (profile == NULL)
+      continue;
+
+    memcpy(bss->transmitter_bssid, profile->transmitter_bssid, BSSID_LENGTH);
+    bss->multiple_bssid = BSS_MULTIPLE_BSSID_NONTRANSMITTED;
+    bss->multiple_bssid_index = profile->multiple_bssid_index;
+    list->reported[profile - list->bss] = true;
+  }
+
+  //older kernels report only transmitted BSSes, counted even if they do not fit (like the dump)
+  for (i = 0; i < list->length; ++i)
+    if (!list->reported[i])
+    {
+      if (scan_results->scanned < scan_results->bss_infos_length)
+        scan_results->bss_infos[scan_results->scanned] = list->bss[i];
+      ++scan_results->scanned;
+    }
+}
+
+static int bssid_compare(const void *a, const void *b)
+{
+  return memcmp(((const struct bss_info *)a)->bssid, ((const struct bss_info *)b)->bssid, BSSID_LENGTH);
+}
+
+// SCANNING - 6 GHz discovery
+
+// public interface
+int wifi_scan_colocated(const struct wifi_scan *wifi, struct wifi_colocated_bss *colocated, int colocated_length)
+{
+  int count;
+
+  if (wifi->colocated == NULL)
+    return 0;
+
+  count = wifi->colocated->length;
+  if (colocated_length > 0)
+    memcpy(colocated, wifi->colocated->bss, (count < colocated_length ? count : colocated_length) * sizeof(struct wifi_colocated_bss));
+
+  return count;
+}
+
+// prerequisities:
+// - frequencies of size WIFI_SCAN_COLOCATED_MAX
+static bool colocated_params(const struct colocated_list *colocated, const struct scan_params *params, struct scan_params *targeted, uint32_t *frequencies)
+{
+  int i, j, length = 0;
+
+  for (i = 0; i < colocated->length; ++i)
+  {
+    for (j = 0; j < length && frequencies[j] != colocated->bss[i].frequency; ++j)
+      ;
+    if (j == length)
+      frequencies[length++] = colocated->bss[i].frequency;
+  }
+
+  if (length == 0)
+  {
+    to_log("No 6 GHz BSSes reported, nothing to scan for");
+    errno = ENODATA;
+    return false;
+  }
+
+  *targeted = *params;
+  targeted->frequencies = frequencies;
+  targeted->frequencies_length = length;
+
+  return true;
+}
+
+// malformed IEs are reported when bss is decoded, here the rest is skipped silently
+static void colocated_collect(struct colocated_list *colocated, struct nlattr **tb)
+{
+  struct wifi_colocated_bss reporter;
+  const uint8_t *payload;
+  int len, offset, length;
+
+  if (!tb[NL80211_BSS_INFORMATION_ELEMENTS])
+    return;
+
+  payload = mnl_attr_get_payload(tb[NL80211_BSS_INFORMATION_ELEMENTS]);
+  len = mnl_attr_get_payload_len(tb[NL80211_BSS_INFORMATION_ELEMENTS]);
+
+  memset(&reporter, 0, sizeof(struct wifi_colocated_bss));
+  reporter.psd = RNR_PSD_UNKNOWN;
+
+  if (tb[NL80211_BSS_BSSID] && mnl_attr_get_payload_len(tb[NL80211_BSS_BSSID]) == BSSID_LENGTH)
+    memcpy(reporter.reporter_bssid, mnl_attr_get_payload(tb[NL80211_BSS_BSSID]), BSSID_LENGTH);
+  if (tb[NL80211_BSS_SIGNAL_MBM])
+    reporter.reporter_signal_mbm = mnl_attr_get_u32(tb[NL80211_BSS_SIGNAL_MBM]);
+
+  for (offset = 0; offset + 2 <= len; offset += 2 + length)
+  {
+    length = payload[offset + 1];
+
+    if (length > len - offset - 2)
+      break;
+
+    if (payload[offset] == IE_REDUCED_NEIGHBOR_REPORT)
+      parse_reduced_neighbor_report(payload + offset + 2, length, &reporter, colocated);
+  }
+}
+
+// Neighbor AP Information fields one after another, each is TBTT Information Header (2),
+// Operating Class (1), Channel (1) and TBTT Information fields (count and length from the header).
+// Length of TBTT Information field tells what it holds after TBTT offset (1) -
+// BSSID (6), short SSID (4), BSS parameters (1) and PSD (1) in that order, later standards append more.
+static void parse_reduced_neighbor_report(const uint8_t *data, int len, const struct wifi_colocated_bss *reporter, struct colocated_list *colocated)
+{
+  enum {TBTT_BSSID=1, TBTT_SHORT_SSID=2, TBTT_PARAMETERS=4, TBTT_PSD=8, TBTT_RESERVED=16};
+  static const uint8_t TBTT_FIELDS[] = {TBTT_RESERVED, 0, TBTT_PARAMETERS, TBTT_RESERVED, TBTT_RESERVED,
+    TBTT_SHORT_SSID, TBTT_SHORT_SSID | TBTT_PARAMETERS, TBTT_BSSID, TBTT_BSSID | TBTT_PARAMETERS, TBTT_BSSID | TBTT_PARAMETERS | TBTT_PSD,
+    TBTT_RESERVED, TBTT_BSSID | TBTT_SHORT_SSID, TBTT_BSSID | TBTT_SHORT_SSID | TBTT_PARAMETERS, TBTT_BSSID | TBTT_SHORT_SSID | TBTT_PARAMETERS | TBTT_PSD};
+  struct wifi_colocated_bss bss;
+  int offset = 0, count, info_length, i;
+  uint8_t type, fields;
+
+  while (offset + 4 <= len)
+  {
+    type = data[offset] & 0x03;
+    count = (data[offset] >> 4) + 1;
+    info_length = data[offset + 1];
+    fields = info_length < (int)sizeof(TBTT_FIELDS) ? TBTT_FIELDS[info_length] : TBTT_FIELDS[sizeof(TBTT_FIELDS) - 1];
+
+    bss = *reporter;
+    bss.operating_class = data[offset + 2];
+    bss.frequency = colocated_frequency(data[offset + 2], data[offset + 3]);
+
+    offset += 4;
+
+    if (count * info_length > len - offset)
+    {
+      to_log("Reduced Neighbor Report length > remaining payload length, ignoring the rest");
+      return;
+    }
+
+    //other than 6 GHz neighbours are found by regular scan
+    if (type != RNR_TBTT_INFO_TYPE_NEIGHBOR || bss.frequency == 0 || (fields & TBTT_RESERVED))
+    {
+      offset += count * info_length;
+      continue;
+    }
+
+    for (i = 0; i < count; ++i, offset += info_length)
+    {
+      const uint8_t *info = data + offset + 1; //after TBTT offset
+
+      if (fields & TBTT_BSSID)
+      {
+        memcpy(bss.bssid, info, BSSID_LENGTH);
+        info += BSSID_LENGTH;
+      }
+      if (fields & TBTT_SHORT_SSID)
+      {
+        bss.short_ssid = info[0] | info[1] << 8 | info[2] << 16 | (uint32_t)info[3] << 24;
+        info += 4;
+      }
+      if (fields & TBTT_PARAMETERS)
+        bss.parameters = *info++;
+      if (fields & TBTT_PSD)
+        bss.psd = (int8_t)*info;
+
+      colocated_add(colocated, &bss);
+    }
+  }
+}
+
+static void colocated_add(struct colocated_list *colocated, const struct wifi_colocated_bss *bss)
+{
+  static const uint8_t NO_BSSID[BSSID_LENGTH] = {0};
+  bool bssid = memcmp(bss->bssid, NO_BSSID, BSSID_LENGTH) != 0;
+  int i;
+
+  //2.4 and 5 GHz radios of the same AP report the same neighbours
+  for (i = 0; i < colocated->length; ++i)
+  {
+    struct wifi_colocated_bss *known = &colocated->bss[i];
+
+    if (known->frequency != bss->frequency || memcmp(known->bssid, bss->bssid, BSSID_LENGTH) != 0)
+      continue;
+    if (!bssid && known->short_ssid != bss->short_ssid)
+      continue;
+
+    //other reporters may tell more
+    if (known->short_ssid == 0)
+      known->short_ssid = bss->short_ssid;
+    if (known->psd == RNR_PSD_UNKNOWN)
+      known->psd = bss->psd;
+    return;
+  }
+
+  if (colocated->length < WIFI_SCAN_COLOCATED_MAX)
+    colocated->bss[colocated->length++] = *bss;
+}
+
+// operating classes 131-135 and 137 have channels 1, 5, ..., 233 (5950 + 5 * channel), 136 has only channel 2
+static uint32_t colocated_frequency(uint8_t operating_class, uint8_t channel)
+{
+  if (operating_class < RNR_6GHZ_CLASS_FIRST || operating_class > RNR_6GHZ_CLASS_LAST)
+    return 0;
+
+  if (operating_class == RNR_6GHZ_CLASS_CHANNEL_2)
+    return channel == 2 ? 5935 : 0;
+
+  if (channel < 1 || channel > 233 || channel % 4 != 1)
+    return 0;
+
+  return 5950 + 5 * channel;
+}
+
+// STATION
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init
+int wifi_scan_station(struct wifi_scan *wifi, struct station_info *station)
+{
+  struct netlink_channel *commands = &wifi->command_channel;
+  struct bss_info bss;
+
+  struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { &bss, 1, 0 };
+  commands->context = &scan_results;
+
+  struct scan_timings *timings = &wifi->timings;
+  struct timespec start, phase;
+  int ret;
+
+  memset(timings, 0, sizeof(struct scan_timings));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  phase = start;
+
+  ret = get_scan(commands);
+  timings->dump_retries = scan_results.interrupted;
+
+  if (ret == MNL_CB_ERROR)
+  {
+    log_error("get_scan returned an error");
+    return -1;
+  }
+
+  timings->dump_ns = elapsed_ns(&phase);
+
   if (scan_results.scanned == 0)
     return 0;
 
-  struct context_NL80211_CMD_NEW_STATION station_results = { station };
-  commands->context = &station_results;
+  struct context_NL80211_CMD_NEW_STATION station_results = { station };
+  commands->context = &station_results;
+
+  if (get_station(commands, bss.bssid) == MNL_CB_ERROR)
+  {
+    log_error("get_station returned an error");
+    return -1;
+  }
+
+  timings->station_ns = elapsed_ns(&phase);
+  timings->total_ns = elapsed_ns(&start);
+
+  memcpy(station->bssid, bss.bssid, BSSID_LENGTH);
+  memcpy(station->ssid, bss.ssid, SSID_MAX_LENGTH_WITH_NULL);
+  station->status = bss.status;
+
+  return 1;
+}
+
+// prerequisites:
+// - channel initalized with init_netlink_channel
+// - context_NL80211_CMD_NEW_STATION set for channel
+static int get_station(struct netlink_channel *channel, uint8_t bssid[BSSID_LENGTH])
+{
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_GET_STATION, channel);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+  mnl_attr_put(nlh, NL80211_ATTR_MAC, BSSID_LENGTH, bssid);
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+
+  return receive_nl_message(channel, handle_NL80211_CMD_NEW_STATION);
+}
+
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type context_NL80211_CMD_NEW_STATION
+static int handle_NL80211_CMD_NEW_STATION(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_NEW_STATION_VALIDATION, NL80211_CMD_NEW_STATION_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+
+  if (genl->cmd != NL80211_CMD_NEW_STATION)
+  {
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
+  }
+
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+
+  if (!tb[NL80211_ATTR_STA_INFO]) //or error, no station
+    return MNL_CB_OK;
+
+  parse_NL80211_ATTR_STA_INFO(tb[NL80211_ATTR_STA_INFO], channel);
+
+  return MNL_CB_OK;
+}
+
+// prerequisities:
+// - channel context of type context_NL80211_CMD_NEW_STATION
+static void parse_NL80211_ATTR_STA_INFO(struct nlattr *nested, struct netlink_channel *channel)
+{
+  struct nlattr *tb[NL80211_STA_INFO_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_STA_INFO_MAX, NL80211_STA_INFO_VALIDATION, NL80211_STA_INFO_VALIDATION_LENGTH };
+  struct context_NL80211_CMD_NEW_STATION *station_results = channel->context;
+  struct station_info *station = station_results->station;
+
+  mnl_attr_parse_nested(nested, validate, &vd);
+
+  if (tb[NL80211_STA_INFO_SIGNAL])
+    station->signal_dbm = (int8_t)mnl_attr_get_u8(tb[NL80211_STA_INFO_SIGNAL]);
+  if (tb[NL80211_STA_INFO_RX_PACKETS])
+    station->rx_packets = mnl_attr_get_u32(tb[NL80211_STA_INFO_RX_PACKETS]);
+  if (tb[NL80211_STA_INFO_TX_PACKETS])
+    station->tx_packets = mnl_attr_get_u32(tb[NL80211_STA_INFO_TX_PACKETS]);
+}
+
+// NEIGHBOR REPORT
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init or wifi_scan_init_fake
+int wifi_scan_neighbor_report(struct wifi_scan *wifi, struct wifi_neighbor *neighbors, int neighbors_length, uint32_t timeout_ms)
+{
+  struct netlink_channel *commands = &wifi->command_channel, *notifications = &wifi->notification_channel;
+  struct bss_info bss;
+  struct context_NL80211_CMD_NEW_SCAN_RESULTS scan_results = { &bss, 1, 0 };
+  struct context_NL80211_CMD_FRAME frame = { neighbors, neighbors_length, -1 };
+  int ret;
+
+  //the request comes from the interface address
+  if (wifi->wiphy == NULL)
+  {
+    to_log("Interface address unknown, can not request neighbor report");
+    errno = ENODATA;
+    return -1;
+  }
+
+  if (wifi->neighbor == NULL && (wifi->neighbor = calloc(sizeof(struct neighbor_report), 1)) == NULL)
+    return -1;
+
+  //the AP we are associated with is the first one
+  commands->context = &scan_results;
+
+  if (get_scan(commands) == MNL_CB_ERROR)
+  {
+    log_error("get_scan returned an error");
+    return -1;
+  }
+
+  if (scan_results.scanned == 0 || bss.status != BSS_ASSOCIATED)
+  {
+    errno = ENOTCONN;
+    return -1;
+  }
+
+  frame.scanning = &wifi->scan_seen;
+  commands->context = notifications->context = &frame;
+
+  if (!wifi->neighbor->registered)
+  {
+    if (register_neighbor_report(notifications) == MNL_CB_ERROR)
+    {
+      log_error("Unable to register for neighbor report responses");
+      return -1;
+    }
+    wifi->neighbor->registered = true;
+  }
+
+  //0 is for unsolicited reports
+  if (++wifi->neighbor->dialog_token == 0)
+    ++wifi->neighbor->dialog_token;
+
+  memcpy(frame.bssid, bss.bssid, BSSID_LENGTH);
+  frame.dialog_token = wifi->neighbor->dialog_token;
+
+  if ((ret = send_neighbor_report_request(commands, bss.bssid, wifi->wiphy->address, frame.dialog_token)) == MNL_CB_ERROR)
+  {
+    log_error("Unable to send neighbor report request");
+    return -1;
+  }
+
+  if (!wait_for_neighbor_report(notifications, timeout_ms))
+    return -1;
+
+  return frame.found;
+}
+
+// public interface
+int wifi_scan_neighbor_frequencies(const struct wifi_scan *wifi, const struct wifi_neighbor *neighbors, int neighbors_length,
+	uint32_t *frequencies, int frequencies_length)
+{
+  int i, j, count = 0;
+
+  for (i = 0; i < neighbors_length; ++i)
+  {
+    uint32_t frequency = neighbors[i].frequency;
+
+    if (frequency == 0 || (wifi->wiphy && !wiphy_frequency_valid(wifi->wiphy, frequency)))
+      continue;
+
+    for (j = 0; j < i && neighbors[j].frequency != frequency; ++j)
+      ;
+
+    if (j < i)
+      continue;
+
+    if (count < frequencies_length)
+      frequencies[count] = frequency;
+
+    ++count;
+  }
+
+  return count;
+}
+
+// prerequisities:
+// - channel context of type context_NL80211_CMD_FRAME
+static int register_neighbor_report(struct netlink_channel *channel)
+{
+  const uint8_t match[] = {ACTION_CATEGORY_RADIO_MEASUREMENT, ACTION_NEIGHBOR_REPORT_RESPONSE};
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_REGISTER_FRAME, channel);
+
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+  mnl_attr_put_u16(nlh, NL80211_ATTR_FRAME_TYPE, FRAME_CONTROL_ACTION);
+  mnl_attr_put(nlh, NL80211_ATTR_FRAME_MATCH, sizeof(match), match);
+
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+  return receive_nl_message(channel, handle_NL80211_CMD_FRAME);
+}
+
+// prerequisities:
+// - channel context of type context_NL80211_CMD_FRAME
+static int send_neighbor_report_request(struct netlink_channel *channel, const uint8_t bssid[BSSID_LENGTH], const uint8_t address[BSSID_LENGTH], uint8_t dialog_token)
+{
+  uint8_t frame[FRAME_HEADER_LENGTH + 3] = {FRAME_CONTROL_ACTION};
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_FRAME, channel);
+
+  //destination, source, BSSID, no SSID element asks for the current ESS
+  memcpy(frame + 4, bssid, BSSID_LENGTH);
+  memcpy(frame + 10, address, BSSID_LENGTH);
+  memcpy(frame + 16, bssid, BSSID_LENGTH);
+  frame[FRAME_HEADER_LENGTH] = ACTION_CATEGORY_RADIO_MEASUREMENT;
+  frame[FRAME_HEADER_LENGTH + 1] = ACTION_NEIGHBOR_REPORT_REQUEST;
+  frame[FRAME_HEADER_LENGTH + 2] = dialog_token;
+
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+  mnl_attr_put(nlh, NL80211_ATTR_FRAME, sizeof(frame), frame);
+  //no NL80211_CMD_FRAME_TX_STATUS to confuse the next request
+  mnl_attr_put(nlh, NL80211_ATTR_DONT_WAIT_FOR_ACK, 0, NULL);
+
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+  return receive_nl_message(channel, handle_NL80211_CMD_FRAME);
+}
+
+// prerequisities:
+// - notifications registered with register_neighbor_report
+// - notifications context of type context_NL80211_CMD_FRAME
+static bool wait_for_neighbor_report(struct netlink_channel *notifications, uint32_t timeout_ms)
+{
+  struct context_NL80211_CMD_FRAME *context = notifications->context;
+  struct timespec start, now;
+  uint64_t elapsed_ms;
+  int ret, error;
+  bool received = true;
+
+  if (!set_channel_non_blocking(notifications))
+    return false;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (context->found == -1)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (now.tv_sec - start.tv_sec) * 1000ULL + now.tv_nsec / 1000000 - start.tv_nsec / 1000000;
+
+    if (elapsed_ms >= timeout_ms)
+    {
+      errno = ETIMEDOUT;
+      received = false;
+      break;
+    }
+
+    if (!notifications->transport->wait(notifications, timeout_ms - elapsed_ms))
+      continue;
+
+    //overrun might have lost the response but it might as well come later
+    if ((ret = channel_receive(notifications)) == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS))
+      continue;
+
+    if (ret <= 0)
+    {
+      log_error("Waiting for neighbor report failed - mnl_socket_recvfrom");
+      received = false;
+      break;
+    }
+
+    if (mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_CMD_FRAME, notifications) == MNL_CB_ERROR)
+    {
+      log_error("Processing frames failed - mnl_cb_run");
+      received = false;
+      break;
+    }
+  }
+
+  error = errno;
+  set_channel_blocking(notifications);
+  errno = error;
+
+  return received;
+}
+
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type context_NL80211_CMD_FRAME
+static int handle_NL80211_CMD_FRAME(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct context_NL80211_CMD_FRAME *context = channel->context;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_FRAME_VALIDATION, NL80211_CMD_FRAME_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+
+  //scan notifications are kept for the next scan (see wifi_scan_all_params)
+  if (record_scan_notification(nlh, context->scanning))
+    return MNL_CB_OK;
+
+  if (genl->cmd != NL80211_CMD_FRAME)
+  {
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
+  }
+
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+
+  //reply to NL80211_CMD_FRAME carries only the cookie
+  if (tb[NL80211_ATTR_FRAME] && context->found == -1)
+    parse_neighbor_report_response(mnl_attr_get_payload(tb[NL80211_ATTR_FRAME]), mnl_attr_get_payload_len(tb[NL80211_ATTR_FRAME]), context);
+
+  return MNL_CB_OK;
+}
+
+static bool parse_neighbor_report_response(const uint8_t *frame, int len, struct context_NL80211_CMD_FRAME *context)
+{
+  const uint8_t *body = frame + FRAME_HEADER_LENGTH;
+  int offset, length;
+
+  if (len < FRAME_HEADER_LENGTH + 3 || frame[0] != FRAME_CONTROL_ACTION || memcmp(frame + 10, context->bssid, BSSID_LENGTH))
+    return false;
+
+  if (body[0] != ACTION_CATEGORY_RADIO_MEASUREMENT || body[1] != ACTION_NEIGHBOR_REPORT_RESPONSE || body[2] != context->dialog_token)
+    return false;
+
+  context->found = 0;
+
+  for (offset = FRAME_HEADER_LENGTH + 3; offset + 2 <= len; offset += 2 + length)
+  {
+    const uint8_t *data = frame + offset + 2;
+    length = frame[offset + 1];
+
+    if (offset + 2 + length > len)
+      break;
+
+    //BSSID, BSSID Information, operating class, channel, PHY type and optional subelements
+    if (frame[offset] != IE_NEIGHBOR_REPORT || length < NEIGHBOR_REPORT_MIN_LENGTH)
+      continue;
+
+    if (context->found < context->neighbors_length)
+    {
+      struct wifi_neighbor *neighbor = &context->neighbors[context->found];
+
+      memcpy(neighbor->bssid, data, BSSID_LENGTH);
+      neighbor->bssid_info = data[6] | data[7] << 8 | data[8] << 16 | (uint32_t)data[9] << 24;
+      neighbor->operating_class = data[10];
+      neighbor->channel = data[11];
+      neighbor->phy_type = data[12];
+      neighbor->frequency = operating_class_frequency(neighbor->operating_class, neighbor->channel);
+    }
+
+    ++context->found;
+  }
+
+  return true;
+}
+
+static uint32_t operating_class_frequency(uint8_t operating_class, uint8_t channel)
+{
+  if (operating_class >= RNR_6GHZ_CLASS_FIRST && operating_class <= RNR_6GHZ_CLASS_LAST)
+    return colocated_frequency(operating_class, channel);
+
+  //60 GHz and reserved classes
+  if (operating_class >= 180)
+    return 0;
+
+  //global 2.4 and 5 GHz classes share channel numbering with country ones
+  if (channel >= 1 && channel <= 13)
+    return 2407 + 5 * channel;
+  if (channel == 14)
+    return 2484;
+  if (channel >= 32 && channel <= 177)
+    return 5000 + 5 * channel;
+
+  return 0;
+}
+
+// FTM RANGING
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init or wifi_scan_init_fake
+int wifi_scan_ftm_start(struct wifi_scan *wifi, const struct bss_info *bss_infos, int bss_infos_length, const struct wifi_ftm_params *params)
+{
+  static const struct wifi_ftm_params DEFAULT_PARAMS = {WIFI_FTM_FTMS_PER_BURST};
+  struct netlink_channel *notifications = &wifi->notification_channel;
+  const struct bss_info *peers[WIFI_FTM_PEERS_MAX];
+  int max_peers = WIFI_FTM_PEERS_MAX, peers_length = 0, i, j;
+
+  //radio of unknown capabilities may range as well
+  if (wifi->wiphy && wifi->wiphy->capabilities.ftm_max_peers == 0)
+  {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+
+  if (wifi->wiphy && wifi->wiphy->capabilities.ftm_max_peers < max_peers)
+    max_peers = wifi->wiphy->capabilities.ftm_max_peers;
+
+  if (wifi->ftm == NULL && (wifi->ftm = calloc(sizeof(struct ftm_ranging), 1)) == NULL)
+    return -1;
+
+  if (wifi->ftm->active)
+  {
+    errno = EBUSY;
+    return -1;
+  }
+
+  for (i = 0; i < bss_infos_length && peers_length < max_peers; ++i)
+  {
+    if (!(bss_infos[i].ftm & BSS_FTM_RESPONDER))
+      continue;
+
+    //BSSes of Multiple BSSID set are the same radio at the same distance
+    for (j = 0; j < peers_length; ++j)
+      if (bss_infos[i].multiple_bssid && peers[j]->multiple_bssid && !memcmp(bss_infos[i].transmitter_bssid, peers[j]->transmitter_bssid, BSSID_LENGTH))
+        break;
+
+    if (j == peers_length)
+      peers[peers_length++] = &bss_infos[i];
+  }
+
+  if (peers_length == 0)
+  {
+    errno = ENOENT;
+    return -1;
+  }
+
+  memset(wifi->ftm, 0, sizeof(struct ftm_ranging));
+  wifi->ftm->scanning = &wifi->scan_seen;
+  notifications->context = wifi->ftm;
+
+  //the results are unicast to the socket that started ranging, so it is the one that listens
+  if (start_peer_measurement(notifications, wifi->wiphy, peers, peers_length, params ? params : &DEFAULT_PARAMS) == MNL_CB_ERROR)
+  {
+    log_error("Unable to start FTM ranging");
+    return -1;
+  }
+
+  wifi->ftm->active = true;
+
+  return peers_length;
+}
+
+// public interface
+//
+// prerequisities:
+// - ranging started with wifi_scan_ftm_start
+int wifi_scan_ftm_results(struct wifi_scan *wifi, struct wifi_ftm_result *results, int results_length, uint32_t timeout_ms)
+{
+  struct netlink_channel *notifications = &wifi->notification_channel;
+  struct ftm_ranging *ftm = wifi->ftm;
+  int count;
+
+  if (ftm == NULL || !ftm->active)
+  {
+    errno = ENOENT;
+    return -1;
+  }
+
+  notifications->context = ftm;
+
+  if (!ftm->complete && ftm->pending_length < FTM_PENDING_MAX && !wait_for_ftm_results(notifications, timeout_ms))
+    return -1;
+
+  if (ftm->complete && ftm->pending_length == 0)
+  {
+    ftm->active = false;
+    errno = ENOENT;
+    return -1;
+  }
+
+  count = results_length < ftm->pending_length ? results_length : ftm->pending_length;
+
+  if (count <= 0)
+    return 0;
+
+  memcpy(results, ftm->pending, count * sizeof(struct wifi_ftm_result));
+  memmove(ftm->pending, ftm->pending + count, (ftm->pending_length - count) * sizeof(struct wifi_ftm_result));
+  ftm->pending_length -= count;
+
+  return count;
+}
+
+// prerequisities:
+// - channel context of type struct ftm_ranging
+static int start_peer_measurement(struct netlink_channel *channel, const struct wiphy_cache *wiphy, const struct bss_info **peers, int peers_length, const struct wifi_ftm_params *params)
+{
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_PEER_MEASUREMENT_START, channel);
+  struct nlattr *measurements, *list, *peer;
+  int i;
+
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+  if (params->timeout_ms)
+    mnl_attr_put_u32(nlh, NL80211_ATTR_TIMEOUT, params->timeout_ms);
+
+  measurements = mnl_attr_nest_start(nlh, NL80211_ATTR_PEER_MEASUREMENTS);
+  list = mnl_attr_nest_start(nlh, NL80211_PMSR_ATTR_PEERS);
+
+  //peers are nested by index which means nothing
+  for (i = 0; i < peers_length; ++i)
+  {
+    peer = mnl_attr_nest_start(nlh, i + 1);
+    put_ftm_peer(nlh, wiphy, peers[i], params);
+    mnl_attr_nest_end(nlh, peer);
+  }
+
+  mnl_attr_nest_end(nlh, list);
+  mnl_attr_nest_end(nlh, measurements);
+
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+  //the cookie comes in extended ack, nothing we need
+  return receive_nl_message(channel, handle_NL80211_CMD_PEER_MEASUREMENT_RESULT);
+}
+
+static void put_ftm_peer(struct nlmsghdr *nlh, const struct wiphy_cache *wiphy, const struct bss_info *bss, const struct wifi_ftm_params *params)
+{
+  static const uint32_t CHAN_WIDTHS[] = {NL80211_CHAN_WIDTH_20, NL80211_CHAN_WIDTH_40, NL80211_CHAN_WIDTH_80, NL80211_CHAN_WIDTH_160};
+  static const uint32_t WIDTHS_MHZ[] = {20, 40, 80, 160};
+  uint32_t preambles = wiphy && wiphy->ftm_preambles ? wiphy->ftm_preambles : ~0U;
+  uint32_t bandwidths = wiphy && wiphy->ftm_bandwidths ? wiphy->ftm_bandwidths : ~0U;
+  uint32_t center = bss->center_frequency ? bss->center_frequency : bss->frequency, preamble;
+  int width = bss->center_frequency ? bss->channel_width : BSS_CHANNEL_WIDTH_20;
+  struct nlattr *chan, *req, *req_data, *ftm;
+
+  //80+80 ranges on the primary segment, 320 on the primary half
+  if (width == BSS_CHANNEL_WIDTH_80P80)
+    width = BSS_CHANNEL_WIDTH_80;
+  if (width == BSS_CHANNEL_WIDTH_320)
+  {
+    width = BSS_CHANNEL_WIDTH_160;
+    center = bss->frequency < center ? center - WIDTHS_MHZ[width] / 2 : center + WIDTHS_MHZ[width] / 2;
+  }
+
+  //narrow down to what the radio ranges with around the primary channel
+  while (width > BSS_CHANNEL_WIDTH_20 && !(bandwidths & 1 << CHAN_WIDTHS[width]))
+  {
+    --width;
+    center = bss->frequency < center ? center - WIDTHS_MHZ[width] / 2 : center + WIDTHS_MHZ[width] / 2;
+  }
+
+  //the newest preamble the channel of BSS implies, legacy if the radio can't do better
+  if (bss->frequency >= 5925)
+    preamble = NL80211_PREAMBLE_HE;
+  else if (width >= BSS_CHANNEL_WIDTH_80 && preambles & 1 << NL80211_PREAMBLE_VHT)
+    preamble = NL80211_PREAMBLE_VHT;
+  else if (preambles & 1 << NL80211_PREAMBLE_HT)
+    preamble = NL80211_PREAMBLE_HT;
+  else
+    preamble = NL80211_PREAMBLE_LEGACY;
+
+  mnl_attr_put(nlh, NL80211_PMSR_PEER_ATTR_ADDR, BSSID_LENGTH, bss->bssid);
+
+  chan = mnl_attr_nest_start(nlh, NL80211_PMSR_PEER_ATTR_CHAN);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY_FREQ, bss->frequency);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_CHANNEL_WIDTH, CHAN_WIDTHS[width]);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_CENTER_FREQ1, center);
+  mnl_attr_nest_end(nlh, chan);
+
+  req = mnl_attr_nest_start(nlh, NL80211_PMSR_PEER_ATTR_REQ);
+  req_data = mnl_attr_nest_start(nlh, NL80211_PMSR_REQ_ATTR_DATA);
+  ftm = mnl_attr_nest_start(nlh, NL80211_PMSR_TYPE_FTM);
+
+  if (wiphy == NULL || wiphy->ftm_asap)
+    mnl_attr_put(nlh, NL80211_PMSR_FTM_REQ_ATTR_ASAP, 0, NULL);
+  mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_REQ_ATTR_PREAMBLE, preamble);
+  mnl_attr_put_u8(nlh, NL80211_PMSR_FTM_REQ_ATTR_NUM_BURSTS_EXP, params->bursts_exponent);
+  if (params->burst_period)
+    mnl_attr_put_u16(nlh, NL80211_PMSR_FTM_REQ_ATTR_BURST_PERIOD, params->burst_period);
+  if (params->ftms_per_burst)
+    mnl_attr_put_u8(nlh, NL80211_PMSR_FTM_REQ_ATTR_FTMS_PER_BURST, params->ftms_per_burst);
+
+  mnl_attr_nest_end(nlh, ftm);
+  mnl_attr_nest_end(nlh, req_data);
+  mnl_attr_nest_end(nlh, req);
+}
+
+// prerequisities:
+// - ranging started with start_peer_measurement on notifications
+// - notifications context of type struct ftm_ranging
+static bool wait_for_ftm_results(struct netlink_channel *notifications, uint32_t timeout_ms)
+{
+  struct ftm_ranging *ftm = notifications->context;
+  struct timespec start, now;
+  uint64_t elapsed_ms;
+  uint32_t wait_ms;
+  int ret, error;
+  bool received = true;
+
+  if (!set_channel_non_blocking(notifications))
+    return false;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (!ftm->complete && ftm->pending_length < FTM_PENDING_MAX)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (now.tv_sec - start.tv_sec) * 1000ULL + now.tv_nsec / 1000000 - start.tv_nsec / 1000000;
+
+    //once something came only what is already there joins the batch
+    wait_ms = ftm->pending_length || elapsed_ms >= timeout_ms ? 0 : timeout_ms - elapsed_ms;
+
+    if (!notifications->transport->wait(notifications, wait_ms))
+    {
+      if (wait_ms == 0)
+        break;
+      continue;
+    }
+
+    if ((ret = channel_receive(notifications)) == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      if (wait_ms == 0)
+        break;
+      continue;
+    }
+
+    //results lost in overrun are not coming again, completion still will
+    if (ret == -1 && errno == ENOBUFS)
+    {
+      to_log("Notifications overrun, FTM results lost");
+      continue;
+    }
+
+    if (ret <= 0)
+    {
+      log_error("Waiting for FTM results failed - mnl_socket_recvfrom");
+      received = false;
+      break;
+    }
+
+    if (mnl_cb_run(notifications->buf, ret, 0, 0, handle_NL80211_CMD_PEER_MEASUREMENT_RESULT, notifications) == MNL_CB_ERROR)
+    {
+      log_error("Processing FTM results failed - mnl_cb_run");
+      received = false;
+      break;
+    }
+  }
+
+  error = errno;
+  set_channel_blocking(notifications);
+  errno = error;
+
+  return received;
+}
+
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type struct ftm_ranging
+static int handle_NL80211_CMD_PEER_MEASUREMENT_RESULT(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct ftm_ranging *ftm = channel->context;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_PEER_MEASUREMENT_VALIDATION, NL80211_CMD_PEER_MEASUREMENT_VALIDATION_LENGTH };
+  struct nlattr *pmsr[NL80211_PMSR_ATTR_MAX + 1] = {};
+  struct validation_data pmsr_vd = { pmsr, NL80211_PMSR_ATTR_MAX, NL80211_PMSR_VALIDATION, NL80211_PMSR_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+  struct nlattr *peer;
+
+  //scan notifications are kept for the next scan (see wifi_scan_all_params)
+  if (record_scan_notification(nlh, ftm->scanning))
+    return MNL_CB_OK;
+
+  if (genl->cmd == NL80211_CMD_PEER_MEASUREMENT_COMPLETE)
+  {
+    ftm->complete = true;
+    return MNL_CB_OK;
+  }
+
+  if (genl->cmd != NL80211_CMD_PEER_MEASUREMENT_RESULT)
+  {
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
+  }
+
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+
+  if (!tb[NL80211_ATTR_PEER_MEASUREMENTS])
+    return MNL_CB_OK;
+
+  mnl_attr_parse_nested(tb[NL80211_ATTR_PEER_MEASUREMENTS], validate, &pmsr_vd);
+
+  if (pmsr[NL80211_PMSR_ATTR_PEERS])
+    mnl_attr_for_each_nested(peer, pmsr[NL80211_PMSR_ATTR_PEERS])
+      parse_NL80211_PMSR_ATTR_PEERS(peer, ftm);
+
+  return MNL_CB_OK;
+}
+
+static void parse_NL80211_PMSR_ATTR_PEERS(struct nlattr *nested, struct ftm_ranging *ftm)
+{
+  struct nlattr *tb[NL80211_PMSR_PEER_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_PMSR_PEER_ATTR_MAX, NL80211_PMSR_PEER_VALIDATION, NL80211_PMSR_PEER_VALIDATION_LENGTH };
+  struct nlattr *resp[NL80211_PMSR_RESP_ATTR_MAX + 1] = {};
+  struct validation_data resp_vd = { resp, NL80211_PMSR_RESP_ATTR_MAX, NL80211_PMSR_RESP_VALIDATION, NL80211_PMSR_RESP_VALIDATION_LENGTH };
+  struct wifi_ftm_result *result;
+  struct nlattr *type;
+
+  mnl_attr_parse_nested(nested, validate, &vd);
+
+  if (!tb[NL80211_PMSR_PEER_ATTR_ADDR] || !tb[NL80211_PMSR_PEER_ATTR_RESP])
+    return;
+
+  if (ftm->pending_length == FTM_PENDING_MAX)
+  {
+    to_log("FTM results not collected, dropping the result");
+    return;
+  }
+
+  result = &ftm->pending[ftm->pending_length++];
+  memset(result, 0, sizeof(struct wifi_ftm_result));
+  memcpy(result->bssid, mnl_attr_get_payload(tb[NL80211_PMSR_PEER_ATTR_ADDR]), BSSID_LENGTH);
+
+  mnl_attr_parse_nested(tb[NL80211_PMSR_PEER_ATTR_RESP], validate, &resp_vd);
+
+  //enum nl80211_peer_measurement_status matches enum wifi_ftm_status
+  if (resp[NL80211_PMSR_RESP_ATTR_STATUS])
+    result->status = mnl_attr_get_u32(resp[NL80211_PMSR_RESP_ATTR_STATUS]);
+  if (resp[NL80211_PMSR_RESP_ATTR_HOST_TIME])
+    result->host_time_ns = mnl_attr_get_u64(resp[NL80211_PMSR_RESP_ATTR_HOST_TIME]);
+  result->final = resp[NL80211_PMSR_RESP_ATTR_FINAL] != NULL;
+
+  //data is nested by measurement type
+  if (resp[NL80211_PMSR_RESP_ATTR_DATA])
+    mnl_attr_for_each_nested(type, resp[NL80211_PMSR_RESP_ATTR_DATA])
+      if (mnl_attr_get_type(type) == NL80211_PMSR_TYPE_FTM)
+        parse_NL80211_PMSR_TYPE_FTM(type, result);
+}
+
+static void parse_NL80211_PMSR_TYPE_FTM(struct nlattr *nested, struct wifi_ftm_result *result)
+{
+  struct nlattr *tb[NL80211_PMSR_FTM_RESP_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_PMSR_FTM_RESP_ATTR_MAX, NL80211_PMSR_FTM_RESP_VALIDATION, NL80211_PMSR_FTM_RESP_VALIDATION_LENGTH };
+  //distance in mm per ps of round trip time
+  const double mm_per_ps = LIGHT_SPEED_M_PER_S / 2e9;
+
+  mnl_attr_parse_nested(nested, validate, &vd);
+
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_FAIL_REASON])
+    result->failure_reason = mnl_attr_get_u32(tb[NL80211_PMSR_FTM_RESP_ATTR_FAIL_REASON]);
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_ATTEMPTS])
+    result->attempts = mnl_attr_get_u32(tb[NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_ATTEMPTS]);
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_SUCCESSES])
+    result->successes = mnl_attr_get_u32(tb[NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_SUCCESSES]);
+  //in 0.5 dBm units
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_RSSI_AVG])
+    result->rssi_mbm = (int32_t)mnl_attr_get_u32(tb[NL80211_PMSR_FTM_RESP_ATTR_RSSI_AVG]) * 50;
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_RTT_AVG])
+    result->rtt_ps = (int64_t)mnl_attr_get_u64(tb[NL80211_PMSR_FTM_RESP_ATTR_RTT_AVG]);
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_RTT_VARIANCE])
+    result->rtt_variance_ps2 = mnl_attr_get_u64(tb[NL80211_PMSR_FTM_RESP_ATTR_RTT_VARIANCE]);
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_DIST_AVG])
+    result->distance_mm = (int64_t)mnl_attr_get_u64(tb[NL80211_PMSR_FTM_RESP_ATTR_DIST_AVG]);
+  if (tb[NL80211_PMSR_FTM_RESP_ATTR_DIST_VARIANCE])
+    result->distance_variance_mm2 = mnl_attr_get_u64(tb[NL80211_PMSR_FTM_RESP_ATTR_DIST_VARIANCE]);
+
+  //drivers report either or both, fill in the other one
+  if (!tb[NL80211_PMSR_FTM_RESP_ATTR_DIST_AVG] && tb[NL80211_PMSR_FTM_RESP_ATTR_RTT_AVG])
+  {
+    result->distance_mm = (int64_t)(result->rtt_ps * mm_per_ps);
+    result->distance_variance_mm2 = (uint64_t)(result->rtt_variance_ps2 * mm_per_ps * mm_per_ps);
+  }
+  else if (!tb[NL80211_PMSR_FTM_RESP_ATTR_RTT_AVG] && tb[NL80211_PMSR_FTM_RESP_ATTR_DIST_AVG])
+  {
+    result->rtt_ps = (int64_t)(result->distance_mm / mm_per_ps);
+    result->rtt_variance_ps2 = (uint64_t)(result->distance_variance_mm2 / mm_per_ps / mm_per_ps);
+  }
+}
+
+// SURVEY
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init or wifi_scan_init_fake
+int wifi_scan_survey(struct wifi_scan *wifi, struct channel_survey *surveys, int surveys_length)
+{
+  struct netlink_channel *commands = &wifi->command_channel;
+
+  if (surveys_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (wifi->survey == NULL && (wifi->survey = calloc(sizeof(struct survey_history), 1)) == NULL)
+    return -1;
+
+  struct context_NL80211_CMD_NEW_SURVEY_RESULTS survey_results = { surveys, surveys_length, 0, wifi->survey };
+  commands->context = &survey_results;
+
+  if (get_survey(commands) == MNL_CB_ERROR)
+  {
+    log_error("get_survey returned an error");
+    return -1;
+  }
+
+  return survey_results.surveyed;
+}
+
+// prerequisities:
+// - channel initalized with init_netlink_channel
+// - context_NL80211_CMD_NEW_SURVEY_RESULTS set for channel
+static int get_survey(struct netlink_channel *channel)
+{
+  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_DUMP | NLM_F_ACK, NL80211_CMD_GET_SURVEY, channel);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
+
+  if (!send_nl_message(nlh, channel))
+  {
+    return MNL_CB_ERROR;
+  }
+  return receive_nl_message(channel, handle_NL80211_CMD_NEW_SURVEY_RESULTS);
+}
+
+// prerequisities:
+// - netlink_channel passed as data
+// - data->context of type context_NL80211_CMD_NEW_SURVEY_RESULTS
+static int handle_NL80211_CMD_NEW_SURVEY_RESULTS(const struct nlmsghdr *nlh, void *data)
+{
+  struct netlink_channel *channel = data;
+  struct context_NL80211_CMD_NEW_SURVEY_RESULTS *survey_results = channel->context;
+  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_NEW_SURVEY_RESULTS_VALIDATION, NL80211_CMD_NEW_SURVEY_RESULTS_VALIDATION_LENGTH };
+  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+  struct channel_survey survey;
+
+  if (genl->cmd != NL80211_CMD_NEW_SURVEY_RESULTS)
+  {
+    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
+    return MNL_CB_OK;
+  }
+
+  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+
+  if (!tb[NL80211_ATTR_SURVEY_INFO] || !parse_NL80211_ATTR_SURVEY_INFO(tb[NL80211_ATTR_SURVEY_INFO], &survey))
+    return MNL_CB_OK;
+
+  //channels beyond surveys_length are still remembered for the next deltas
+  if (!survey_delta(survey_results->history, survey_results->surveyed, &survey))
+    return MNL_CB_ERROR;
+
+  if (survey_results->surveyed < survey_results->surveys_length)
+    survey_results->surveys[survey_results->surveyed] = survey;
+
+  ++survey_results->surveyed;
+
+  return MNL_CB_OK;
+}
+
+static bool parse_NL80211_ATTR_SURVEY_INFO(struct nlattr *nested, struct channel_survey *survey)
+{
+  struct nlattr *tb[NL80211_SURVEY_INFO_MAX + 1] = {};
+  struct validation_data vd = { tb, NL80211_SURVEY_INFO_MAX, NL80211_SURVEY_INFO_VALIDATION, NL80211_SURVEY_INFO_VALIDATION_LENGTH };
+
+  mnl_attr_parse_nested(nested, validate, &vd);
+
+  if (!tb[NL80211_SURVEY_INFO_FREQUENCY])
+    return false;
+
+  memset(survey, 0, sizeof(struct channel_survey));
+  survey->frequency = mnl_attr_get_u32(tb[NL80211_SURVEY_INFO_FREQUENCY]);
+  survey->in_use = tb[NL80211_SURVEY_INFO_IN_USE] != NULL;
+
+  if (tb[NL80211_SURVEY_INFO_NOISE])
+  {
+    survey->noise_dbm = (int8_t)mnl_attr_get_u8(tb[NL80211_SURVEY_INFO_NOISE]);
+    survey->fields |= SURVEY_NOISE;
+  }
+  if (tb[NL80211_SURVEY_INFO_TIME])
+  {
+    survey->time_ms = mnl_attr_get_u64(tb[NL80211_SURVEY_INFO_TIME]);
+    survey->fields |= SURVEY_TIME;
+  }
+  if (tb[NL80211_SURVEY_INFO_TIME_BUSY])
+  {
+    survey->time_busy_ms = mnl_attr_get_u64(tb[NL80211_SURVEY_INFO_TIME_BUSY]);
+    survey->fields |= SURVEY_TIME_BUSY;
+  }
+  if (tb[NL80211_SURVEY_INFO_TIME_RX])
+  {
+    survey->time_rx_ms = mnl_attr_get_u64(tb[NL80211_SURVEY_INFO_TIME_RX]);
+    survey->fields |= SURVEY_TIME_RX;
+  }
+  if (tb[NL80211_SURVEY_INFO_TIME_TX])
+  {
+    survey->time_tx_ms = mnl_attr_get_u64(tb[NL80211_SURVEY_INFO_TIME_TX]);
+    survey->fields |= SURVEY_TIME_TX;
+  }
+
+  return true;
+}
+
+// channels come in the same order each dump so the hint is nearly always right
+static bool survey_delta(struct survey_history *history, int hint, struct channel_survey *survey)
+{
+  struct survey_counters *previous = NULL;
+  bool reset;
+  int i;
+
+  if (hint < history->length && history->channels[hint].frequency == survey->frequency)
+    previous = &history->channels[hint];
+
+  for (i = 0; i < history->length && previous == NULL; ++i)
+    if (history->channels[i].frequency == survey->frequency)
+      previous = &history->channels[i];
+
+  if (previous == NULL)
+  {
+    if (history->length == history->capacity)
+    {
+      int capacity = history->capacity ? 2 * history->capacity : 64;
+      struct survey_counters *grown = realloc(history->channels, capacity * sizeof(struct survey_counters));
+      if (grown == NULL)
+        return false;
+      history->channels = grown;
+      history->capacity = capacity;
+    }
+    previous = &history->channels[history->length++];
+    memset(previous, 0, sizeof(struct survey_counters));
+    previous->frequency = survey->frequency;
+  }
+
+  //counters going back mean driver reset them (e.g. interface restarted)
+  reset = survey->time_ms < previous->time_ms;
+
+  survey->delta_time_ms = reset ? survey->time_ms : survey->time_ms - previous->time_ms;
+  survey->delta_busy_ms = reset || survey->time_busy_ms < previous->busy_ms ? survey->time_busy_ms : survey->time_busy_ms - previous->busy_ms;
+  survey->delta_rx_ms = reset || survey->time_rx_ms < previous->rx_ms ? survey->time_rx_ms : survey->time_rx_ms - previous->rx_ms;
+  survey->delta_tx_ms = reset || survey->time_tx_ms < previous->tx_ms ? survey->time_tx_ms : survey->time_tx_ms - previous->tx_ms;
+
+  survey->busy_percent = survey_percent(survey->fields & SURVEY_TIME_BUSY, survey->delta_busy_ms, survey->delta_time_ms);
+  survey->rx_percent = survey_percent(survey->fields & SURVEY_TIME_RX, survey->delta_rx_ms, survey->delta_time_ms);
+  survey->tx_percent = survey_percent(survey->fields & SURVEY_TIME_TX, survey->delta_tx_ms, survey->delta_time_ms);
+
+  previous->time_ms = survey->time_ms;
+  previous->busy_ms = survey->time_busy_ms;
+  previous->rx_ms = survey->time_rx_ms;
+  previous->tx_ms = survey->time_tx_ms;
+
+  return true;
+}
+
+static int8_t survey_percent(bool reported, uint64_t part, uint64_t whole)
+{
+  if (!reported || whole == 0)
+    return -1;
+
+  //counters are sampled at different moments, part may slightly exceed whole
+  return part >= whole ? 100 : (int8_t)(part * 100 / whole);
+}
+
+
+// NETLINK HELPERS
+
+// NETLINK HELPERS - message construction/sending/receiving
+
+// prerequisities:
+// - channel initialized with init_netlink_channel
+static struct nlmsghdr *prepare_nl_message(uint32_t type, uint16_t flags, uint8_t genl_cmd, struct netlink_channel *channel)
+{
+  struct nlmsghdr *nlh;
+  struct genlmsghdr *genl;
+
+  nlh = mnl_nlmsg_put_header(channel->buf);
+  nlh->nlmsg_type = type;
+  nlh->nlmsg_flags = flags;
+  nlh->nlmsg_seq = channel->sequence;
+
+  genl = (struct genlmsghdr*)mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+  genl->cmd = genl_cmd;
+  genl->version = 1;
+  return nlh;
+}
+
+// prerequisities:
+// - prepare_nl_message called first
+// - mnl_attr_put_xxx used if additional attributes needed
+static bool send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel)
+{
+  if (channel_send(channel, nlh, nlh->nlmsg_len) < 0)
+  {
+    log_error("mnl_socket_sendto");
+    return false;
+  }
+  return true;
+}
+
+// prerequisities:
+// - send_nl_message called first
+// - prerequisities for callback matched
+static int receive_nl_message(struct netlink_channel *channel, mnl_cb_t callback)
+{
+  int ret, error;
+  unsigned int portid = channel->transport->get_portid(channel);
+
+  ret = channel_receive(channel);
+
+  while (ret > 0)
+  {
+    //mnl_cb_run silently stops at incomplete message and we would wait for the rest forever
+    if ((error = check_nl_messages(channel->buf, ret)) != 0)
+    {
+      if (error == EBADMSG)
+        to_log("Received truncated netlink message");
+      errno = error;
+      ret = -1;
+      break;
+    }
+    ret = mnl_cb_run(channel->buf, ret, channel->sequence, portid, callback, channel);
+    if (ret <= 0)
+      break;
+    ret = channel_receive(channel);
+  }
+
+  if (ret == -1)
+  {
+    error = errno;
+    drain_nl_message(channel);
+    errno = error;
+  }
+
+  ++channel->sequence;
+
+  return ret;
+}
+
+static int check_nl_messages(const void *buf, size_t len)
+{
+  const struct nlmsghdr *nlh = buf;
+  int remaining = len;
+
+  for (; mnl_nlmsg_ok(nlh, remaining); nlh = mnl_nlmsg_next(nlh, &remaining))
+    if (nlh->nlmsg_flags & NLM_F_DUMP_INTR) //older libmnl doesn't check it
+      return EINTR;
+
+  return remaining == 0 ? 0 : EBADMSG;
+}
+
+// prerequisities:
+// - channel initialized with init_netlink_channel
+static void drain_nl_message(struct netlink_channel *channel)
+{
+  if (!set_channel_non_blocking(channel))
+    return;
+
+  //the kernel generates the next part of dump while we receive so nothing waits only when it's over
+  while (channel_receive(channel) > 0)
+    ;
+
+  set_channel_blocking(channel);
+}
+
+// NETLINK HELPERS - transport
+
+// prerequisities:
+// - channel initialized with init_netlink_channel or init_replay_channel
+static ssize_t channel_send(struct netlink_channel *channel, const void *buf, size_t len)
+{
+  ssize_t ret;
+
+  if (channel->faults && fault_send(channel, buf, len))
+    ret = len;
+  else
+    ret = channel->transport->send(channel, buf, len);
+
+  if (channel->capture)
+  {
+    int error = errno;
+    capture_record(channel->capture, channel->id, WIFI_SCAN_CAPTURE_SEND, ret < 0 ? ret : (ssize_t)len, error, buf);
+    errno = error;
+  }
+
+  return ret;
+}
+
+// prerequisities:
+// - channel initialized with init_netlink_channel or init_replay_channel
+static ssize_t channel_receive(struct netlink_channel *channel)
+{
+  ssize_t ret;
+
+  if (channel->faults && channel->faults->reply_length)
+  { //answer for the request swallowed by fault_send
+    ret = channel->faults->reply_length;
+    memcpy(channel->buf, channel->faults->reply, ret);
+    channel->faults->reply_length = 0;
+  }
+  else
+    ret = channel->transport->recv(channel, channel->buf, MNL_SOCKET_BUFFER_SIZE);
+
+  if (channel->faults && ret > 0)
+    ret = fault_receive(channel, ret);
+
+  if (channel->capture)
+  {
+    int error = errno;
+    capture_record(channel->capture, channel->id, WIFI_SCAN_CAPTURE_RECEIVE, ret, error, channel->buf);
+    errno = error;
+  }
+
+  return ret;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init or wifi_scan_init_replay
+int wifi_scan_capture_start(struct wifi_scan *wifi, const char *capture_file)
+{
+  struct wifi_scan_capture_header header = { WIFI_SCAN_CAPTURE_MAGIC, WIFI_SCAN_CAPTURE_VERSION };
+  struct netlink_capture *capture;
+
+  wifi_scan_capture_stop(wifi);
+
+  if ((capture = calloc(sizeof(struct netlink_capture), 1)) == NULL)
+    return -1;
+
+  if ((capture->file = fopen(capture_file, "wb")) == NULL)
+  {
+    log_error("Can not create capture file");
+    free(capture);
+    return -1;
+  }
+
+  header.ifindex = wifi->command_channel.ifindex;
+  header.nl80211_id = wifi->command_channel.nl80211_id;
+  header.portid[WIFI_SCAN_CHANNEL_NOTIFICATIONS] = wifi->notification_channel.transport->get_portid(&wifi->notification_channel);
+  header.portid[WIFI_SCAN_CHANNEL_COMMANDS] = wifi->command_channel.transport->get_portid(&wifi->command_channel);
+
+  if (fwrite(&header, sizeof(header), 1, capture->file) != 1)
+  {
+    log_error("Can not write capture file");
+    fclose(capture->file);
+    free(capture);
+    return -1;
+  }
+
+  wifi->capture = wifi->notification_channel.capture = wifi->command_channel.capture = capture;
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init or wifi_scan_init_replay
+void wifi_scan_capture_stop(struct wifi_scan *wifi)
+{
+  if (wifi->capture == NULL)
+    return;
+
+  if (fclose(wifi->capture->file) != 0)
+    log_error("Can not close capture file");
+
+  free(wifi->capture);
+  wifi->capture = wifi->notification_channel.capture = wifi->command_channel.capture = NULL;
+}
+
+// result is number of bytes or -1 with error set (as returned from send/recv)
+static void capture_record(struct netlink_capture *capture, uint8_t channel, uint8_t direction, ssize_t result, int error, const void *data)
+{
+  struct wifi_scan_capture_record record = { 0, channel, direction, 0, result < 0 ? -error : (int32_t)result };
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  record.timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+  if (fwrite(&record, sizeof(record), 1, capture->file) != 1
+      || (record.result > 0 && fwrite(data, record.result, 1, capture->file) != 1))
+    to_log("Can not write capture record");
+}
+
+// NETLINK HELPERS - transport - socket
+
+static ssize_t socket_send(struct netlink_channel *channel, const void *buf, size_t len)
+{
+  return mnl_socket_sendto(channel->nl, buf, len);
+}
+
+static ssize_t socket_recv(struct netlink_channel *channel, void *buf, size_t len)
+{
+  return mnl_socket_recvfrom(channel->nl, buf, len);
+}
+
+static bool socket_set_blocking(struct netlink_channel *channel, bool blocking)
+{
+  int fd = mnl_socket_get_fd(channel->nl);
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1)
+  {
+    log_error("SetChannelNonBlocking F_GETFL");
+    return false;
+  }
+  if (fcntl(fd, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK) == -1)
+  {
+    log_error("SetChannelNonBlocking F_SETFL");
+    return false;
+  }
+  return true;
+}
+
+static bool socket_subscribe(struct netlink_channel *channel, uint32_t group)
+{
+  if (mnl_socket_setsockopt(channel->nl, NETLINK_ADD_MEMBERSHIP, &group, sizeof(int)) < 0)
+  {
+    log_error("mnl_socket_set_sockopt");
+    return false;
+  }
+  return true;
+}
+
+static unsigned int socket_get_portid(struct netlink_channel *channel)
+{
+  return mnl_socket_get_portid(channel->nl);
+}
+
+static bool socket_wait(struct netlink_channel *channel, uint32_t timeout_ms)
+{
+  struct pollfd fd = { mnl_socket_get_fd(channel->nl), POLLIN, 0 };
+
+  return poll(&fd, 1, timeout_ms) > 0;
+}
+
+// NETLINK HELPERS - transport - replay
+
+// sends are not delivered anywhere, recorded send failures are reproduced
+static ssize_t replay_send(struct netlink_channel *channel, const void *buf, size_t len)
+{
+  struct netlink_replay *replay = channel->replay;
+  struct wifi_scan_capture_record record;
+  size_t next = replay_next_record(replay, channel->id, replay->cursor[channel->id], &record);
+
+  if (next == 0 || record.direction != WIFI_SCAN_CAPTURE_SEND)
+    return len;
+
+  replay->cursor[channel->id] = next;
+
+  if (record.result < 0)
+  {
+    errno = -record.result;
+    return -1;
+  }
+  return len;
+}
+
+// returns recorded data (or error) with sequence numbers matching current requests
+static ssize_t replay_recv(struct netlink_channel *channel, void *buf, size_t len)
+{
+  struct netlink_replay *replay = channel->replay;
+  struct wifi_scan_capture_record record;
+  size_t cursor = replay->cursor[channel->id], next;
+  bool rewound = false;
+
+  while ((next = replay_next_record(replay, channel->id, cursor, &record)) == 0 || record.direction != WIFI_SCAN_CAPTURE_RECEIVE)
+  {
+    if (next != 0)
+    {
+      cursor = next;
+      continue;
+    }
+    if (!replay->loop || rewound)
+    {
+      errno = ENODATA;
+      return -1;
+    }
+    cursor = sizeof(struct wifi_scan_capture_header);
+    rewound = true;
+  }
+
+  replay->cursor[channel->id] = next;
+
+  if (record.result < 0)
+  {
+    errno = -record.result;
+    return -1;
+  }
+
+  int data_length = (size_t)record.result < len ? record.result : (int)len;
+  memcpy(buf, replay->data + next - record.result, data_length);
+
+  //requests in replay are not necessarily numbered the same way as during capture
+  int remaining = data_length;
+  struct nlmsghdr *nlh = buf;
+
+  for (; mnl_nlmsg_ok(nlh, remaining); nlh = mnl_nlmsg_next(nlh, &remaining))
+    if (nlh->nlmsg_seq != 0)
+      nlh->nlmsg_seq = channel->sequence;
+
+  return data_length;
+}
+
+static bool replay_set_blocking(struct netlink_channel *channel, bool blocking)
+{
+  return true;
+}
+
+static bool replay_subscribe(struct netlink_channel *channel, uint32_t group)
+{
+  return true;
+}
+
+static unsigned int replay_get_portid(struct netlink_channel *channel)
+{
+  return channel->replay->portid[channel->id];
+}
+
+// recording already has whatever came
+static bool replay_wait(struct netlink_channel *channel, uint32_t timeout_ms)
+{
+  return true;
+}
+
+// returns offset past the found record (and its data) or 0 if there are no more records for channel
+static size_t replay_next_record(const struct netlink_replay *replay, uint8_t channel, size_t cursor, struct wifi_scan_capture_record *record)
+{
+  while (cursor + sizeof(*record) <= replay->length)
+  {
+    memcpy(record, replay->data + cursor, sizeof(*record));
+    cursor += sizeof(*record) + (record->result > 0 ? record->result : 0);
+    if (record->channel == channel)
+      return cursor;
+  }
+  return 0;
+}
+
+// NETLINK HELPERS - transport - fake
+
+// requests are answered immediately, notifications follow simulated scan time
+static ssize_t fake_send(struct netlink_channel *channel, const void *buf, size_t len)
+{
+  struct netlink_fake *fake = channel->fake;
+  const struct nlmsghdr *request = buf;
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+
+  fake_update(fake);
+
+  switch (((struct genlmsghdr *)mnl_nlmsg_get_payload(request))->cmd)
+  {
+    case NL80211_CMD_TRIGGER_SCAN:
+      fake_trigger_scan(fake, request);
+      break;
+    case NL80211_CMD_GET_SCAN:
+      fake_get_scan(fake, request);
+      break;
+    case NL80211_CMD_GET_STATION:
+      fake_get_station(fake, request);
+      break;
+    case NL80211_CMD_GET_SURVEY:
+      fake_get_survey(fake, request);
+      break;
+    case NL80211_CMD_GET_INTERFACE:
+      fake_get_interface(fake, request);
+      break;
+    case NL80211_CMD_GET_WIPHY:
+      fake_get_wiphy(fake, request);
+      break;
+    case NL80211_CMD_GET_REG:
+      fake_get_regulatory(fake, request);
+      break;
+    case NL80211_CMD_REGISTER_FRAME:
+      fake_register_frame(fake, request, channel->id);
+      break;
+    case NL80211_CMD_FRAME:
+      fake_frame(fake, request);
+      break;
+    case NL80211_CMD_PEER_MEASUREMENT_START:
+      fake_peer_measurement_start(fake, request, channel->id);
+      break;
+    default:
+      fake_put_error(reply, &length, request, -EOPNOTSUPP);
+      fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
+  }
+
+  return len;
+}
+
+// blocking receive of notifications waits for scan in progress
+// or simulates scan triggered by somebody else if nothing is happening
+static ssize_t fake_recv(struct netlink_channel *channel, void *buf, size_t len)
+{
+  struct netlink_fake *fake = channel->fake;
+  struct fake_queue *queue = &fake->queue[channel->id];
+
+  fake_update(fake);
+
+  if (queue->head == queue->length && channel->id == WIFI_SCAN_CHANNEL_NOTIFICATIONS && fake->blocking[channel->id])
+  {
+    if (fake->scanning)
+    {
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &fake->scan_done, NULL);
+      fake_update(fake);
+    }
+    else
+      fake_start_scan(fake, FAKE_FULL_SCAN_CHANNELS);
+  }
+
+  if (queue->head == queue->length)
+  { //commands channel would block forever here, better fail
+    errno = EAGAIN;
+    return -1;
+  }
+
+  size_t length;
+  memcpy(&length, queue->data + queue->head, sizeof(length));
+  memcpy(buf, queue->data + queue->head + sizeof(length), length < len ? length : len);
+  queue->head += sizeof(length) + length;
+
+  if (queue->head == queue->length)
+    queue->head = queue->length = 0;
+
+  return length < len ? length : len;
+}
+
+static bool fake_set_blocking(struct netlink_channel *channel, bool blocking)
+{
+  channel->fake->blocking[channel->id] = blocking;
+  return true;
+}
+
+static bool fake_subscribe(struct netlink_channel *channel, uint32_t group)
+{
+  return true;
+}
+
+static unsigned int fake_get_portid(struct netlink_channel *channel)
+{
+  return FAKE_PORTID + channel->id;
+}
+
+// sleeps until the first of timeout, scan completion, the AP answer or ranging result
+static bool fake_wait(struct netlink_channel *channel, uint32_t timeout_ms)
+{
+  struct netlink_fake *fake = channel->fake;
+  struct fake_queue *queue = &fake->queue[channel->id];
+  struct timespec wake;
+  uint64_t nsec;
+
+  fake_update(fake);
+
+  if (queue->head != queue->length)
+    return true;
+
+  clock_gettime(CLOCK_MONOTONIC, &wake);
+  nsec = wake.tv_nsec + timeout_ms * 1000000ULL;
+  wake.tv_sec += nsec / 1000000000ULL;
+  wake.tv_nsec = nsec % 1000000000ULL;
+
+  if (fake->scanning && fake_due(&wake, &fake->scan_done))
+    wake = fake->scan_done;
+  if (fake->frame_length && fake_due(&wake, &fake->frame_due))
+    wake = fake->frame_due;
+  if (fake->ranging && fake_due(&wake, &fake->ranging_due))
+    wake = fake->ranging_due;
+
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+  fake_update(fake);
+
+  return queue->head != queue->length;
+}
+
+static void fake_update(struct netlink_fake *fake)
+{
+  struct timespec now;
+
+  if (!fake->scanning && !fake->frame_length && !fake->ranging)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  //the answer goes to whoever registered for it
+  if (fake->frame_length && fake_due(&now, &fake->frame_due))
+  {
+    fake_queue_push(&fake->queue[fake->frames_channel], fake->frame, fake->frame_length);
+    fake->frame_length = 0;
+  }
+
+  while (fake->ranging && fake_due(&now, &fake->ranging_due))
+    fake_peer_measurement_result(fake);
+
+  if (!fake->scanning || !fake_due(&now, &fake->scan_done))
+    return;
+
+  char buf[MNL_SOCKET_BUFFER_SIZE];
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+  struct genlmsghdr *genl = mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+
+  nlh->nlmsg_type = FAKE_NL80211_ID;
+  genl->cmd = NL80211_CMD_NEW_SCAN_RESULTS;
+  genl->version = 1;
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_NOTIFICATIONS], nlh, nlh->nlmsg_len);
+  fake->scanning = false;
+}
+
+static bool fake_due(const struct timespec *now, const struct timespec *due)
+{
+  return now->tv_sec > due->tv_sec || (now->tv_sec == due->tv_sec && now->tv_nsec >= due->tv_nsec);
+}
+
+static void fake_start_scan(struct netlink_fake *fake, int channels)
+{
+  char buf[MNL_SOCKET_BUFFER_SIZE];
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+  struct genlmsghdr *genl = mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+  uint64_t duration_ns = (uint64_t)channels * fake->channel_time_ms * 1000000ULL;
+
+  nlh->nlmsg_type = FAKE_NL80211_ID;
+  genl->cmd = NL80211_CMD_TRIGGER_SCAN;
+  genl->version = 1;
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_NOTIFICATIONS], nlh, nlh->nlmsg_len);
+
+  clock_gettime(CLOCK_MONOTONIC, &fake->scan_done);
+  fake->scan_done.tv_sec += (fake->scan_done.tv_nsec + duration_ns) / 1000000000ULL;
+  fake->scan_done.tv_nsec = (fake->scan_done.tv_nsec + duration_ns) % 1000000000ULL;
+  fake->scanning = true;
+}
+
+// the device is busy if scan is in progress, otherwise scans requested frequencies (or all)
+static void fake_trigger_scan(struct netlink_fake *fake, const struct nlmsghdr *request)
+{
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  struct nlattr *attr, *pos;
+  int channels = 0;
+
+  if (fake->scanning)
+  {
+    fake_put_error(reply, &length, request, -EBUSY);
+    fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
+    return;
+  }
+
+  mnl_attr_for_each(attr, request, sizeof(struct genlmsghdr))
+    if (mnl_attr_get_type(attr) == NL80211_ATTR_SCAN_FREQUENCIES)
+      mnl_attr_for_each_nested(pos, attr)
+        ++channels;
+
+  fake_put_error(reply, &length, request, 0);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
+  fake_start_scan(fake, channels ? channels : FAKE_FULL_SCAN_CHANNELS);
+}
+
+// scan results split into parts as the kernel would do it, terminated with NLMSG_DONE
+static void fake_get_scan(struct netlink_fake *fake, const struct nlmsghdr *request)
+{
+  char part[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  const struct nlmsghdr *nlh = (const struct nlmsghdr*)fake->scan_results;
+  int remaining = fake->scan_results_length;
+
+  for (; mnl_nlmsg_ok(nlh, remaining); nlh = mnl_nlmsg_next(nlh, &remaining))
+  {
+    if (length + nlh->nlmsg_len > sizeof(part))
+    {
+      fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], part, length);
+      length = 0;
+    }
+    if (nlh->nlmsg_len > sizeof(part))
+      continue;
+
+    struct nlmsghdr *copy = (struct nlmsghdr*)(part + length);
+    memcpy(copy, nlh, nlh->nlmsg_len);
+    copy->nlmsg_flags |= NLM_F_MULTI;
+    copy->nlmsg_seq = request->nlmsg_seq;
+    copy->nlmsg_pid = FAKE_PORTID + WIFI_SCAN_CHANNEL_COMMANDS;
+    length += nlh->nlmsg_len;
+  }
+
+  if (length + MNL_NLMSG_HDRLEN + sizeof(int) > sizeof(part))
+  {
+    fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], part, length);
+    length = 0;
+  }
+
+  struct nlmsghdr *done = mnl_nlmsg_put_header(part + length);
+  done->nlmsg_type = NLMSG_DONE;
+  done->nlmsg_flags = NLM_F_MULTI;
+  done->nlmsg_seq = request->nlmsg_seq;
+  done->nlmsg_pid = FAKE_PORTID + WIFI_SCAN_CHANNEL_COMMANDS;
+  *(int*)mnl_nlmsg_put_extra_header(done, sizeof(int)) = 0;
+  length += done->nlmsg_len;
+
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], part, length);
+}
+
+// station information with some traffic since the last call, followed by acknowledgement
+static void fake_get_station(struct netlink_fake *fake, const struct nlmsghdr *request)
+{
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(reply);
+  struct genlmsghdr *genl = mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+  size_t length;
+
+  nlh->nlmsg_type = FAKE_NL80211_ID;
+  nlh->nlmsg_seq = request->nlmsg_seq;
+  nlh->nlmsg_pid = FAKE_PORTID + WIFI_SCAN_CHANNEL_COMMANDS;
+  genl->cmd = NL80211_CMD_NEW_STATION;
+  genl->version = 1;
+
+  fake->station_packets += 10;
 
-  if (get_station(commands, bss.bssid) == MNL_CB_ERROR)
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+  struct nlattr *nested = mnl_attr_nest_start(nlh, NL80211_ATTR_STA_INFO);
+  mnl_attr_put_u8(nlh, NL80211_STA_INFO_SIGNAL, (uint8_t)(-50 - (int)(fake->station_packets % 7)));
+  mnl_attr_put_u32(nlh, NL80211_STA_INFO_RX_PACKETS, fake->station_packets * 3);
+  mnl_attr_put_u32(nlh, NL80211_STA_INFO_TX_PACKETS, fake->station_packets);
+  mnl_attr_nest_end(nlh, nested);
+
+  length = nlh->nlmsg_len;
+  fake_put_error(reply, &length, request, 0);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
+}
+
+// full scan channels, the device operates on 2437 MHz and visits the rest while scanning,
+// each channel is busy its own fixed part of time, terminated with NLMSG_DONE
+static void fake_get_survey(struct netlink_fake *fake, const struct nlmsghdr *request)
+{
+  char part[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  struct timespec now;
+  uint64_t elapsed_ms;
+  uint8_t flags;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed_ms = (now.tv_sec - fake->started.tv_sec) * 1000ULL + now.tv_nsec / 1000000 - fake->started.tv_nsec / 1000000;
+
+  for (i = 0; i < FAKE_CHANNELS; ++i)
   {
-    to_log("get_station returned an error");
-    return 0;
+    uint32_t frequency = fake_channel(i, &flags);
+    bool in_use = frequency == 2437;
+
+    if (flags & WIFI_CHANNEL_DISABLED)
+      continue;
+
+    uint64_t time_ms = in_use ? elapsed_ms : elapsed_ms / FAKE_FULL_SCAN_CHANNELS;
+    uint64_t busy_ms = time_ms * (10 + i * 29 % 70) / 100;
+
+    if (length + MNL_NLMSG_HDRLEN + 256 > sizeof(part))
+    {
+      fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], part, length);
+      length = 0;
+    }
+
+    struct nlmsghdr *nlh = fake_put_header(part + length, request, NL80211_CMD_NEW_SURVEY_RESULTS, NLM_F_MULTI);
+
+    mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+    struct nlattr *nested = mnl_attr_nest_start(nlh, NL80211_ATTR_SURVEY_INFO);
+    mnl_attr_put_u32(nlh, NL80211_SURVEY_INFO_FREQUENCY, frequency);
+    mnl_attr_put_u8(nlh, NL80211_SURVEY_INFO_NOISE, (uint8_t)(-95 + i % 5));
+    if (in_use)
+      mnl_attr_put(nlh, NL80211_SURVEY_INFO_IN_USE, 0, NULL);
+    mnl_attr_put_u64(nlh, NL80211_SURVEY_INFO_TIME, time_ms);
+    mnl_attr_put_u64(nlh, NL80211_SURVEY_INFO_TIME_BUSY, busy_ms);
+    mnl_attr_put_u64(nlh, NL80211_SURVEY_INFO_TIME_RX, busy_ms * 3 / 4);
+    mnl_attr_put_u64(nlh, NL80211_SURVEY_INFO_TIME_TX, in_use ? time_ms / 20 : 0);
+    mnl_attr_nest_end(nlh, nested);
+
+    length += nlh->nlmsg_len;
   }
 
-  memcpy(station->bssid, bss.bssid, BSSID_LENGTH);
-  memcpy(station->ssid, bss.ssid, SSID_MAX_LENGTH_WITH_NULL);
-  station->status = bss.status;
+  fake_put_done(part, &length, request);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], part, length);
+}
 
-  return 1;
+// the radio of interface
+static void fake_get_interface(struct netlink_fake *fake, const struct nlmsghdr *request)
+{
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  struct nlmsghdr *nlh = fake_put_header(reply, request, NL80211_CMD_NEW_INTERFACE, 0);
+
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY, FAKE_WIPHY);
+  mnl_attr_put(nlh, NL80211_ATTR_MAC, BSSID_LENGTH, FAKE_ADDRESS);
+  length += nlh->nlmsg_len;
+
+  fake_put_error(reply, &length, request, 0);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
 }
 
-// prerequisites:
-// - channel initalized with init_netlink_channel
-// - context_NL80211_CMD_NEW_STATION set for channel
-static int get_station(struct netlink_channel *channel, uint8_t bssid[BSSID_LENGTH])
+// split dump as the kernel sends it - limits and features first, then each band in its own message
+static void fake_get_wiphy(struct netlink_fake *fake, const struct nlmsghdr *request)
 {
-  struct nlmsghdr *nlh = prepare_nl_message(channel->nl80211_id, NLM_F_REQUEST | NLM_F_ACK, NL80211_CMD_GET_STATION, channel);
-  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, channel->ifindex);
-  mnl_attr_put(nlh, NL80211_ATTR_MAC, BSSID_LENGTH, bssid);
-  if (!send_nl_message(nlh, channel))
+  char part[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  uint8_t ext_features[8] = {0}, flags;
+  struct nlmsghdr *nlh;
+  struct nlattr *bands, *band, *frequencies, *frequency, *measurements, *types, *ftm;
+  int b, i;
+
+  ext_features[NL80211_EXT_FEATURE_SCAN_START_TIME / 8] |= 1 << NL80211_EXT_FEATURE_SCAN_START_TIME % 8;
+
+  nlh = fake_put_header(part, request, NL80211_CMD_NEW_WIPHY, NLM_F_MULTI);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY, FAKE_WIPHY);
+  mnl_attr_put_u8(nlh, NL80211_ATTR_MAX_NUM_SCAN_SSIDS, 4);
+  mnl_attr_put_u16(nlh, NL80211_ATTR_MAX_SCAN_IE_LEN, 2048);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_FEATURE_FLAGS, NL80211_FEATURE_LOW_PRIORITY_SCAN | NL80211_FEATURE_SCAN_FLUSH);
+  mnl_attr_put(nlh, NL80211_ATTR_EXT_FEATURES, sizeof(ext_features), ext_features);
+  measurements = mnl_attr_nest_start(nlh, NL80211_ATTR_PEER_MEASUREMENTS);
+  mnl_attr_put_u32(nlh, NL80211_PMSR_ATTR_MAX_PEERS, FAKE_FTM_PEERS);
+  types = mnl_attr_nest_start(nlh, NL80211_PMSR_ATTR_TYPE_CAPA);
+  ftm = mnl_attr_nest_start(nlh, NL80211_PMSR_TYPE_FTM);
+  mnl_attr_put(nlh, NL80211_PMSR_FTM_CAPA_ATTR_ASAP, 0, NULL);
+  mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_CAPA_ATTR_PREAMBLES,
+    1 << NL80211_PREAMBLE_LEGACY | 1 << NL80211_PREAMBLE_HT | 1 << NL80211_PREAMBLE_VHT | 1 << NL80211_PREAMBLE_HE);
+  mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_CAPA_ATTR_BANDWIDTHS,
+    1 << NL80211_CHAN_WIDTH_20 | 1 << NL80211_CHAN_WIDTH_40 | 1 << NL80211_CHAN_WIDTH_80);
+  mnl_attr_nest_end(nlh, ftm);
+  mnl_attr_nest_end(nlh, types);
+  mnl_attr_nest_end(nlh, measurements);
+  length += nlh->nlmsg_len;
+
+  //2.4 GHz channels come first, there are no 60 GHz ones
+  for (b = NL80211_BAND_2GHZ, i = 0; b <= NL80211_BAND_6GHZ; ++b)
   {
-    return MNL_CB_ERROR;
+    if (b == NL80211_BAND_60GHZ)
+      continue;
+
+    nlh = fake_put_header(part + length, request, NL80211_CMD_NEW_WIPHY, NLM_F_MULTI);
+    mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY, FAKE_WIPHY);
+    bands = mnl_attr_nest_start(nlh, NL80211_ATTR_WIPHY_BANDS);
+    band = mnl_attr_nest_start(nlh, b);
+    frequencies = mnl_attr_nest_start(nlh, NL80211_BAND_ATTR_FREQS);
+
+    for (; i < FAKE_CHANNELS && (b == NL80211_BAND_6GHZ || (b == NL80211_BAND_5GHZ && i < FAKE_6GHZ_CHANNEL) || fake_channel(i, &flags) < 5000); ++i)
+    {
+      frequency = mnl_attr_nest_start(nlh, i);
+      mnl_attr_put_u32(nlh, NL80211_FREQUENCY_ATTR_FREQ, fake_channel(i, &flags));
+      if (flags & WIFI_CHANNEL_DISABLED)
+        mnl_attr_put(nlh, NL80211_FREQUENCY_ATTR_DISABLED, 0, NULL);
+      if (flags & WIFI_CHANNEL_NO_IR)
+        mnl_attr_put(nlh, NL80211_FREQUENCY_ATTR_NO_IR, 0, NULL);
+      if (flags & WIFI_CHANNEL_RADAR)
+        mnl_attr_put(nlh, NL80211_FREQUENCY_ATTR_RADAR, 0, NULL);
+      mnl_attr_put_u32(nlh, NL80211_FREQUENCY_ATTR_MAX_TX_POWER, i < 14 ? 3000 : i < FAKE_6GHZ_CHANNEL ? 2300 : 2400);
+      mnl_attr_nest_end(nlh, frequency);
+    }
+
+    mnl_attr_nest_end(nlh, frequencies);
+    mnl_attr_nest_end(nlh, band);
+    mnl_attr_nest_end(nlh, bands);
+    length += nlh->nlmsg_len;
   }
 
-  return receive_nl_message(channel, handle_NL80211_CMD_NEW_STATION);
+  fake_put_done(part, &length, request);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], part, length);
 }
 
-// prerequisities:
-// - netlink_channel passed as data
-// - data->context of type context_NL80211_CMD_NEW_STATION
-static int handle_NL80211_CMD_NEW_STATION(const struct nlmsghdr *nlh, void *data)
+// regulatory domain matching channel flags
+static void fake_get_regulatory(struct netlink_fake *fake, const struct nlmsghdr *request)
 {
-  struct netlink_channel *channel = data;
-  struct nlattr *tb[NL80211_ATTR_MAX + 1] = {};
-  struct validation_data vd = { tb, NL80211_ATTR_MAX, NL80211_CMD_NEW_STATION_VALIDATION, NL80211_CMD_NEW_STATION_VALIDATION_LENGTH };
-  struct genlmsghdr *genl = (struct genlmsghdr *)mnl_nlmsg_get_payload(nlh);
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  struct nlmsghdr *nlh = fake_put_header(reply, request, NL80211_CMD_GET_REG, 0);
 
-  if (genl->cmd != NL80211_CMD_NEW_STATION)
+  mnl_attr_put_strz(nlh, NL80211_ATTR_REG_ALPHA2, "US");
+  mnl_attr_put_u8(nlh, NL80211_ATTR_DFS_REGION, NL80211_DFS_FCC);
+  length += nlh->nlmsg_len;
+
+  fake_put_error(reply, &length, request, 0);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
+}
+
+// the channel will receive action frames, the library only registers for Neighbor Report Response
+static void fake_register_frame(struct netlink_fake *fake, const struct nlmsghdr *request, uint8_t channel)
+{
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = fault_error_message(reply, request, FAKE_PORTID + channel, 0);
+
+  fake->frames_channel = channel;
+  fake_queue_push(&fake->queue[channel], reply, length);
+}
+
+// transmitted frame cookie followed by acknowledgement, the AP answers Neighbor Report Request later
+static void fake_frame(struct netlink_fake *fake, const struct nlmsghdr *request)
+{
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  size_t length = 0;
+  struct nlmsghdr *nlh = fake_put_header(reply, request, NL80211_CMD_FRAME, 0);
+  struct nlattr *attr;
+
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+  mnl_attr_put_u64(nlh, NL80211_ATTR_COOKIE, ++fake->cookie);
+  length += nlh->nlmsg_len;
+
+  fake_put_error(reply, &length, request, 0);
+  fake_queue_push(&fake->queue[WIFI_SCAN_CHANNEL_COMMANDS], reply, length);
+
+  mnl_attr_for_each(attr, request, sizeof(struct genlmsghdr))
   {
-    to_log2("Ignoring generic netlink command %u seq %u pid  %u genl cmd %u\n", nlh->nlmsg_type, nlh->nlmsg_seq, nlh->nlmsg_pid, genl->cmd);
-    return MNL_CB_OK;
+    const uint8_t *frame = mnl_attr_get_payload(attr);
+    int len = mnl_attr_get_payload_len(attr);
+
+    if (mnl_attr_get_type(attr) != NL80211_ATTR_FRAME || len < FRAME_HEADER_LENGTH + 3 || fake->frames_channel == -1)
+      continue;
+
+    if (frame[FRAME_HEADER_LENGTH] == ACTION_CATEGORY_RADIO_MEASUREMENT && frame[FRAME_HEADER_LENGTH + 1] == ACTION_NEIGHBOR_REPORT_REQUEST)
+      fake_neighbor_report(fake, frame);
   }
+}
 
-  mnl_attr_parse(nlh, sizeof(*genl), validate, &vd);
+// other BSSes of the associated AP SSID in scan results after channel_time_ms, nothing if not associated with the AP asked
+static void fake_neighbor_report(struct netlink_fake *fake, const uint8_t *request)
+{
+  uint8_t action[FRAME_HEADER_LENGTH + 3 + FAKE_NEIGHBORS * (2 + NEIGHBOR_REPORT_MIN_LENGTH)] = {FRAME_CONTROL_ACTION};
+  struct bss_info *bss = malloc(FAKE_NEIGHBOR_SCAN * sizeof(struct bss_info));
+  int found, associated, i, neighbors = 0, length = FRAME_HEADER_LENGTH + 3;
 
-  if (!tb[NL80211_ATTR_STA_INFO]) //or error, no station
-    return MNL_CB_OK;
+  if (bss == NULL)
+  {
+    to_log("Can not allocate memory for fake backend");
+    return;
+  }
 
-  parse_NL80211_ATTR_STA_INFO(tb[NL80211_ATTR_STA_INFO], channel);
+  found = wifi_scan_parse_scan_results(fake->scan_results, fake->scan_results_length, bss, FAKE_NEIGHBOR_SCAN, 0);
+  found = found < FAKE_NEIGHBOR_SCAN ? found : FAKE_NEIGHBOR_SCAN;
 
-  return MNL_CB_OK;
+  for (associated = 0; associated < found; ++associated)
+    if (bss[associated].status == BSS_ASSOCIATED && !memcmp(bss[associated].bssid, request + 4, BSSID_LENGTH))
+      break;
+
+  if (associated >= found)
+  {
+    free(bss);
+    return;
+  }
+
+  //to the requester from the AP
+  memcpy(action + 4, request + 10, BSSID_LENGTH);
+  memcpy(action + 10, bss[associated].bssid, BSSID_LENGTH);
+  memcpy(action + 16, bss[associated].bssid, BSSID_LENGTH);
+  action[FRAME_HEADER_LENGTH] = ACTION_CATEGORY_RADIO_MEASUREMENT;
+  action[FRAME_HEADER_LENGTH + 1] = ACTION_NEIGHBOR_REPORT_RESPONSE;
+  action[FRAME_HEADER_LENGTH + 2] = request[FRAME_HEADER_LENGTH + 2];
+
+  for (i = 0; i < found && neighbors < FAKE_NEIGHBORS; ++i)
+  {
+    uint32_t frequency = bss[i].frequency, info = 0x0f | WIFI_NEIGHBOR_HT;
+    uint8_t *element = action + length, operating_class, channel, phy_type;
+
+    if (i == associated || bss[i].ssid[0] == '\0' || strcmp(bss[i].ssid, bss[associated].ssid))
+      continue;
+
+    if (frequency < 5000)
+    {
+      channel = frequency == 2484 ? 14 : (frequency - 2407) / 5;
+      operating_class = channel == 14 ? 82 : 81;
+      phy_type = 7;
+    }
+    else if (frequency < 5950)
+    {
+      channel = (frequency - 5000) / 5;
+      operating_class = channel <= 48 ? 115 : channel <= 64 ? 118 : channel <= 144 ? 121 : 125;
+      phy_type = 9;
+      info |= WIFI_NEIGHBOR_VHT;
+    }
+    else
+    {
+      channel = (frequency - 5950) / 5;
+      operating_class = 131;
+      phy_type = 14;
+      info |= WIFI_NEIGHBOR_HE;
+    }
+
+    element[0] = IE_NEIGHBOR_REPORT;
+    element[1] = NEIGHBOR_REPORT_MIN_LENGTH;
+    memcpy(element + 2, bss[i].bssid, BSSID_LENGTH);
+    element[8] = info;
+    element[9] = info >> 8;
+    element[10] = info >> 16;
+    element[11] = info >> 24;
+    element[12] = operating_class;
+    element[13] = channel;
+    element[14] = phy_type;
+
+    length += 2 + NEIGHBOR_REPORT_MIN_LENGTH;
+    ++neighbors;
+  }
+
+  //received frames are not answers to requests, no sequence number or port id
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(fake->frame);
+  struct genlmsghdr *genl = mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+  uint64_t nsec;
+
+  nlh->nlmsg_type = FAKE_NL80211_ID;
+  genl->cmd = NL80211_CMD_FRAME;
+  genl->version = 1;
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY_FREQ, bss[associated].frequency);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_RX_SIGNAL_DBM, bss[associated].signal_mbm / 100);
+  mnl_attr_put(nlh, NL80211_ATTR_FRAME, length, action);
+  fake->frame_length = nlh->nlmsg_len;
+
+  //the AP takes about the time of channel dwell to answer
+  clock_gettime(CLOCK_MONOTONIC, &fake->frame_due);
+  nsec = fake->frame_due.tv_nsec + fake->channel_time_ms * 1000000ULL;
+  fake->frame_due.tv_sec += nsec / 1000000000ULL;
+  fake->frame_due.tv_nsec = nsec % 1000000000ULL;
+
+  free(bss);
 }
 
-// prerequisities:
-// - channel context of type context_NL80211_CMD_NEW_STATION
-static void parse_NL80211_ATTR_STA_INFO(struct nlattr *nested, struct netlink_channel *channel)
+// the radio is busy with one ranging at a time, peers are looked up in scan results
+static void fake_peer_measurement_start(struct netlink_fake *fake, const struct nlmsghdr *request, uint8_t channel)
 {
-  struct nlattr *tb[NL80211_STA_INFO_MAX + 1] = {};
-  struct validation_data vd = { tb, NL80211_STA_INFO_MAX, NL80211_STA_INFO_VALIDATION, NL80211_STA_INFO_VALIDATION_LENGTH };
-  struct context_NL80211_CMD_NEW_STATION *station_results = channel->context;
-  struct station_info *station = station_results->station;
+  char reply[MNL_SOCKET_BUFFER_SIZE];
+  struct bss_info *bss;
+  struct nlattr *attr, *list, *peer, *nested;
+  int found, peers = 0, i;
+  uint64_t nsec;
 
-  mnl_attr_parse_nested(nested, validate, &vd);
+  if (fake->ranging || (bss = malloc(FAKE_NEIGHBOR_SCAN * sizeof(struct bss_info))) == NULL)
+  {
+    fake_queue_push(&fake->queue[channel], reply, fault_error_message(reply, request, FAKE_PORTID + channel, fake->ranging ? -EBUSY : -ENOMEM));
+    return;
+  }
 
-  if (tb[NL80211_STA_INFO_SIGNAL])
-    station->signal_dbm = (int8_t)mnl_attr_get_u8(tb[NL80211_STA_INFO_SIGNAL]);
-  if (tb[NL80211_STA_INFO_RX_PACKETS])
-    station->rx_packets = mnl_attr_get_u32(tb[NL80211_STA_INFO_RX_PACKETS]);
-  if (tb[NL80211_STA_INFO_TX_PACKETS])
-    station->tx_packets = mnl_attr_get_u32(tb[NL80211_STA_INFO_TX_PACKETS]);
+  found = wifi_scan_parse_scan_results(fake->scan_results, fake->scan_results_length, bss, FAKE_NEIGHBOR_SCAN, 0);
+  found = found < FAKE_NEIGHBOR_SCAN ? found : FAKE_NEIGHBOR_SCAN;
+  fake->ranging_peers_length = 0;
+
+  //NL80211_ATTR_PEER_MEASUREMENTS - NL80211_PMSR_ATTR_PEERS - peer - NL80211_PMSR_PEER_ATTR_ADDR
+  mnl_attr_for_each(attr, request, sizeof(struct genlmsghdr))
+  {
+    if (mnl_attr_get_type(attr) != NL80211_ATTR_PEER_MEASUREMENTS)
+      continue;
+
+    mnl_attr_for_each_nested(list, attr)
+    {
+      if (mnl_attr_get_type(list) != NL80211_PMSR_ATTR_PEERS)
+        continue;
+
+      mnl_attr_for_each_nested(peer, list)
+      {
+        ++peers;
+
+        mnl_attr_for_each_nested(nested, peer)
+        {
+          struct fake_ftm_peer *ranged = &fake->ranging_peers[fake->ranging_peers_length];
+
+          if (mnl_attr_get_type(nested) != NL80211_PMSR_PEER_ATTR_ADDR || mnl_attr_get_payload_len(nested) != BSSID_LENGTH || fake->ranging_peers_length == FAKE_FTM_PEERS)
+            continue;
+
+          memcpy(ranged->bssid, mnl_attr_get_payload(nested), BSSID_LENGTH);
+          ranged->signal_mbm = 0;
+          ranged->responder = false;
+
+          for (i = 0; i < found; ++i)
+            if (!memcmp(bss[i].bssid, ranged->bssid, BSSID_LENGTH))
+            {
+              ranged->signal_mbm = bss[i].signal_mbm;
+              ranged->responder = bss[i].ftm & BSS_FTM_RESPONDER;
+            }
+
+          ++fake->ranging_peers_length;
+        }
+      }
+    }
+  }
+
+  free(bss);
+
+  //the kernel checks the request against capabilities
+  if (peers == 0 || peers > FAKE_FTM_PEERS || fake->ranging_peers_length != peers)
+  {
+    fake_queue_push(&fake->queue[channel], reply, fault_error_message(reply, request, FAKE_PORTID + channel, -EINVAL));
+    return;
+  }
+
+  fake_queue_push(&fake->queue[channel], reply, fault_error_message(reply, request, FAKE_PORTID + channel, 0));
+
+  fake->ranging = true;
+  fake->ranging_channel = channel;
+  fake->ranging_cookie = ++fake->cookie;
+  fake->ranging_reported = 0;
+
+  //each peer takes about the time of channel dwell
+  clock_gettime(CLOCK_MONOTONIC, &fake->ranging_due);
+  nsec = fake->ranging_due.tv_nsec + fake->channel_time_ms * 1000000ULL;
+  fake->ranging_due.tv_sec += nsec / 1000000000ULL;
+  fake->ranging_due.tv_nsec = nsec % 1000000000ULL;
 }
 
+// success with distance following the signal for responders, failure otherwise
+static void fake_peer_measurement_result(struct netlink_fake *fake)
+{
+  char buf[MNL_SOCKET_BUFFER_SIZE];
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+  struct genlmsghdr *genl = mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+  struct nlattr *measurements, *list, *peer, *resp, *resp_data, *ftm;
+  const struct fake_ftm_peer *ranged;
+  struct timespec now;
+  uint64_t nsec;
+
+  //results are not answers to requests, no sequence number or port id
+  nlh->nlmsg_type = FAKE_NL80211_ID;
+  genl->version = 1;
+  mnl_attr_put_u32(nlh, NL80211_ATTR_IFINDEX, FAKE_IFINDEX);
+  mnl_attr_put_u32(nlh, NL80211_ATTR_WIPHY, FAKE_WIPHY);
+  mnl_attr_put_u64(nlh, NL80211_ATTR_COOKIE, fake->ranging_cookie);
 
-// NETLINK HELPERS
+  if (fake->ranging_reported == fake->ranging_peers_length)
+  {
+    genl->cmd = NL80211_CMD_PEER_MEASUREMENT_COMPLETE;
+    fake_queue_push(&fake->queue[fake->ranging_channel], nlh, nlh->nlmsg_len);
+    fake->ranging = false;
+    return;
+  }
 
-// NETLINK HELPERS - message construction/sending/receiving
+  ranged = &fake->ranging_peers[fake->ranging_reported++];
+  genl->cmd = NL80211_CMD_PEER_MEASUREMENT_RESULT;
 
-// prerequisities:
-// - channel initialized with init_netlink_channel
-static struct nlmsghdr *prepare_nl_message(uint32_t type, uint16_t flags, uint8_t genl_cmd, struct netlink_channel *channel)
+  measurements = mnl_attr_nest_start(nlh, NL80211_ATTR_PEER_MEASUREMENTS);
+  list = mnl_attr_nest_start(nlh, NL80211_PMSR_ATTR_PEERS);
+  peer = mnl_attr_nest_start(nlh, 1);
+  mnl_attr_put(nlh, NL80211_PMSR_PEER_ATTR_ADDR, BSSID_LENGTH, ranged->bssid);
+  resp = mnl_attr_nest_start(nlh, NL80211_PMSR_PEER_ATTR_RESP);
+
+  clock_gettime(CLOCK_BOOTTIME, &now);
+  mnl_attr_put_u32(nlh, NL80211_PMSR_RESP_ATTR_STATUS, ranged->responder ? NL80211_PMSR_STATUS_SUCCESS : NL80211_PMSR_STATUS_FAILURE);
+  mnl_attr_put_u64(nlh, NL80211_PMSR_RESP_ATTR_HOST_TIME, now.tv_sec * 1000000000ULL + now.tv_nsec);
+  mnl_attr_put(nlh, NL80211_PMSR_RESP_ATTR_FINAL, 0, NULL);
+
+  resp_data = mnl_attr_nest_start(nlh, NL80211_PMSR_RESP_ATTR_DATA);
+  ftm = mnl_attr_nest_start(nlh, NL80211_PMSR_TYPE_FTM);
+
+  if (ranged->responder)
+  {
+    int64_t distance_mm = fake_distance_mm(ranged->signal_mbm);
+    //10% standard deviation, round trip time the way drivers report it
+    uint64_t variance_mm2 = (distance_mm / 10) * (distance_mm / 10);
+    const double ps_per_mm = 2e9 / LIGHT_SPEED_M_PER_S;
+
+    mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_ATTEMPTS, WIFI_FTM_FTMS_PER_BURST);
+    mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_RESP_ATTR_NUM_FTMR_SUCCESSES, WIFI_FTM_FTMS_PER_BURST);
+    mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_RESP_ATTR_RSSI_AVG, ranged->signal_mbm / 50);
+    mnl_attr_put_u64(nlh, NL80211_PMSR_FTM_RESP_ATTR_RTT_AVG, (uint64_t)(distance_mm * ps_per_mm));
+    mnl_attr_put_u64(nlh, NL80211_PMSR_FTM_RESP_ATTR_RTT_VARIANCE, (uint64_t)(variance_mm2 * ps_per_mm * ps_per_mm));
+    mnl_attr_put_u64(nlh, NL80211_PMSR_FTM_RESP_ATTR_DIST_AVG, distance_mm);
+    mnl_attr_put_u64(nlh, NL80211_PMSR_FTM_RESP_ATTR_DIST_VARIANCE, variance_mm2);
+  }
+  else
+    mnl_attr_put_u32(nlh, NL80211_PMSR_FTM_RESP_ATTR_FAIL_REASON,
+      ranged->signal_mbm ? NL80211_PMSR_FTM_FAILURE_PEER_NOT_CAPABLE : NL80211_PMSR_FTM_FAILURE_NO_RESPONSE);
+
+  mnl_attr_nest_end(nlh, ftm);
+  mnl_attr_nest_end(nlh, resp_data);
+  mnl_attr_nest_end(nlh, resp);
+  mnl_attr_nest_end(nlh, peer);
+  mnl_attr_nest_end(nlh, list);
+  mnl_attr_nest_end(nlh, measurements);
+
+  fake_queue_push(&fake->queue[fake->ranging_channel], nlh, nlh->nlmsg_len);
+
+  //completion follows the last result right away
+  if (fake->ranging_reported == fake->ranging_peers_length)
+    return;
+
+  nsec = fake->ranging_due.tv_nsec + fake->channel_time_ms * 1000000ULL;
+  fake->ranging_due.tv_sec += nsec / 1000000000ULL;
+  fake->ranging_due.tv_nsec = nsec % 1000000000ULL;
+}
+
+// 1 m at -40 dBm and twice as far for every 9 dB less (indoor path loss), 64 m at most
+static int64_t fake_distance_mm(int32_t signal_mbm)
 {
-  struct nlmsghdr *nlh;
-  struct genlmsghdr *genl;
+  int32_t loss_mb = -4000 - signal_mbm;
+  int64_t distance_mm;
 
-  nlh = mnl_nlmsg_put_header(channel->buf);
-  nlh->nlmsg_type = type;
-  nlh->nlmsg_flags = flags;
-  nlh->nlmsg_seq = channel->sequence;
+  loss_mb = loss_mb < 0 ? 0 : loss_mb > 5400 ? 5400 : loss_mb;
+  distance_mm = 1000LL << loss_mb / 900;
 
-  genl = (struct genlmsghdr*)mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
-  genl->cmd = genl_cmd;
+  return distance_mm + distance_mm * (loss_mb % 900) / 900;
+}
+
+// 2.4 GHz 1-14 (12, 13 passive, 14 disabled), 5 GHz 36-64, 100-144 (DFS from 52) and 149-165, 6 GHz 1-233
+static uint32_t fake_channel(int i, uint8_t *flags)
+{
+  uint32_t frequency = i < 13 ? 2412 + 5 * i : i == 13 ? 2484 : i < 22 ? 5180 + 20 * (i - 14) : i < 34 ? 5500 + 20 * (i - 22) :
+    i < FAKE_6GHZ_CHANNEL ? 5745 + 20 * (i - 34) : 5955 + 20 * (i - FAKE_6GHZ_CHANNEL);
+
+  *flags = 0;
+  if (frequency == 2467 || frequency == 2472)
+    *flags = WIFI_CHANNEL_NO_IR;
+  else if (frequency == 2484)
+    *flags = WIFI_CHANNEL_DISABLED;
+  else if (frequency >= 5260 && frequency <= 5720)
+    *flags = WIFI_CHANNEL_NO_IR | WIFI_CHANNEL_RADAR;
+
+  return frequency;
+}
+
+static struct nlmsghdr *fake_put_header(char *buf, const struct nlmsghdr *request, uint8_t cmd, uint16_t flags)
+{
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+  struct genlmsghdr *genl = mnl_nlmsg_put_extra_header(nlh, sizeof(struct genlmsghdr));
+
+  nlh->nlmsg_type = FAKE_NL80211_ID;
+  nlh->nlmsg_flags = flags;
+  nlh->nlmsg_seq = request->nlmsg_seq;
+  nlh->nlmsg_pid = FAKE_PORTID + WIFI_SCAN_CHANNEL_COMMANDS;
+  genl->cmd = cmd;
   genl->version = 1;
+
   return nlh;
 }
 
+static void fake_put_done(char *buf, size_t *length, const struct nlmsghdr *request)
+{
+  struct nlmsghdr *done = mnl_nlmsg_put_header(buf + *length);
+
+  done->nlmsg_type = NLMSG_DONE;
+  done->nlmsg_flags = NLM_F_MULTI;
+  done->nlmsg_seq = request->nlmsg_seq;
+  done->nlmsg_pid = FAKE_PORTID + WIFI_SCAN_CHANNEL_COMMANDS;
+  *(int*)mnl_nlmsg_put_extra_header(done, sizeof(int)) = 0;
+  *length += done->nlmsg_len;
+}
+
+static void fake_put_error(char *buf, size_t *length, const struct nlmsghdr *request, int error)
+{
+  *length += fault_error_message(buf + *length, request, FAKE_PORTID + WIFI_SCAN_CHANNEL_COMMANDS, error);
+}
+
+static void fake_queue_push(struct fake_queue *queue, const void *data, size_t length)
+{
+  if (queue->length + sizeof(length) + length > queue->capacity)
+  {
+    size_t capacity = 2 * queue->capacity + sizeof(length) + length;
+    char *grown = realloc(queue->data, capacity);
+    if (grown == NULL)
+    {
+      to_log("Can not allocate memory for fake backend");
+      return;
+    }
+    queue->data = grown;
+    queue->capacity = capacity;
+  }
+
+  memcpy(queue->data + queue->length, &length, sizeof(length));
+  memcpy(queue->data + queue->length + sizeof(length), data, length);
+  queue->length += sizeof(length) + length;
+}
+
+// NETLINK HELPERS - fault injection
+
+// public interface
+//
+// prerequisities:
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+int wifi_scan_set_faults(struct wifi_scan *wifi, const struct scan_faults *faults)
+{
+  struct netlink_faults *injected = NULL;
+
+  if (faults)
+  {
+    if ((injected = calloc(sizeof(struct netlink_faults), 1)) == NULL)
+      return -1;
+
+    if (faults->script_length > 0)
+    {
+      if ((injected->script = malloc(faults->script_length * sizeof(struct scan_fault_rule))) == NULL)
+      {
+        free(injected);
+        return -1;
+      }
+      memcpy(injected->script, faults->script, faults->script_length * sizeof(struct scan_fault_rule));
+      injected->script_length = faults->script_length;
+    }
+
+    memcpy(injected->permille, faults->permille, sizeof(injected->permille));
+    injected->random = faults->seed ? faults->seed : 1; //xorshift never leaves 0
+  }
+
+  if (wifi->faults)
+  {
+    free(wifi->faults->script);
+    free(wifi->faults);
+  }
+
+  wifi->faults = wifi->notification_channel.faults = wifi->command_channel.faults = injected;
+  return 0;
+}
+
+// public interface
+//
 // prerequisities:
-// - prepare_nl_message called first
-// - mnl_attr_put_xxx used if additional attributes needed
-static bool send_nl_message(struct nlmsghdr *nlh, struct netlink_channel *channel)
+// - wifi initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+void wifi_scan_fault_counts(const struct wifi_scan *wifi, uint32_t injected[SCAN_FAULT_TYPES])
+{
+  if (wifi->faults)
+    memcpy(injected, wifi->faults->injected, sizeof(wifi->faults->injected));
+  else
+    memset(injected, 0, SCAN_FAULT_TYPES * sizeof(uint32_t));
+}
+
+static bool fault_fires(struct netlink_faults *faults, enum scan_fault fault)
 {
-  if (mnl_socket_sendto(channel->nl, nlh, nlh->nlmsg_len) < 0)
+  uint32_t opportunity = faults->opportunities[fault]++;
+  bool fires = false;
+  int i;
+
+  for (i = 0; i < faults->script_length && !fires; ++i)
+    if (faults->script[i].fault == fault)
+      fires = opportunity >= faults->script[i].skip && opportunity - faults->script[i].skip < faults->script[i].count;
+
+  if (!fires && faults->permille[fault])
   {
-    log_error("mnl_socket_sendto");
-    return false;
+    faults->random ^= faults->random << 13;
+    faults->random ^= faults->random >> 17;
+    faults->random ^= faults->random << 5;
+    fires = faults->random % 1000 < faults->permille[fault];
   }
+
+  if (fires)
+    ++faults->injected[fault];
+
+  return fires;
+}
+
+// prerequisities:
+// - channel->faults set with wifi_scan_set_faults
+static bool fault_send(struct netlink_channel *channel, const void *buf, size_t len)
+{
+  const struct nlmsghdr *request = buf;
+  const struct genlmsghdr *genl = mnl_nlmsg_get_payload(request);
+
+  if (len < NLMSG_HDRLEN + sizeof(struct genlmsghdr) || request->nlmsg_type != channel->nl80211_id || genl->cmd != NL80211_CMD_TRIGGER_SCAN)
+    return false;
+
+  if (!fault_fires(channel->faults, SCAN_FAULT_TRIGGER_BUSY))
+    return false;
+
+  //what the device doing something else would answer
+  channel->faults->reply_length = fault_error_message(channel->faults->reply, request, channel->transport->get_portid(channel), -EBUSY);
   return true;
 }
 
 // prerequisities:
-// - send_nl_message called first
-// - prerequisities for callback matched
-static int receive_nl_message(struct netlink_channel *channel, mnl_cb_t callback)
+// - channel->faults set with wifi_scan_set_faults
+// - len > 0 bytes received to channel buffer
+static ssize_t fault_receive(struct netlink_channel *channel, ssize_t len)
 {
-  int ret;
-  unsigned int portid = mnl_socket_get_portid(channel->nl);
+  struct netlink_faults *faults = channel->faults;
+  struct nlmsghdr *nlh = (struct nlmsghdr*)channel->buf;
+  int remaining = len;
 
-  ret = mnl_socket_recvfrom(channel->nl, channel->buf, MNL_SOCKET_BUFFER_SIZE);
+  if (channel->id == WIFI_SCAN_CHANNEL_NOTIFICATIONS)
+  {
+    if (!fault_fires(faults, SCAN_FAULT_NOTIFICATIONS_OVERRUN))
+      return len;
+    //the kernel reports overrun instead of the messages that did not fit
+    errno = ENOBUFS;
+    return -1;
+  }
 
-  while (ret > 0)
+  //part of the scan results dump
+  if (mnl_nlmsg_ok(nlh, len) && (nlh->nlmsg_flags & NLM_F_MULTI) && nlh->nlmsg_type == channel->nl80211_id)
   {
-    ret = mnl_cb_run(channel->buf, ret, channel->sequence, portid, callback, channel);
-    if (ret <= 0)
-      break;
-    ret = mnl_socket_recvfrom(channel->nl, channel->buf, MNL_SOCKET_BUFFER_SIZE);
+    if (fault_fires(faults, SCAN_FAULT_DUMP_ERROR))
+    { //like failed allocation in the kernel
+      struct nlmsghdr part = *nlh;
+      return fault_error_message(channel->buf, &part, part.nlmsg_pid, -ENOMEM);
+    }
+    if (fault_fires(faults, SCAN_FAULT_DUMP_INTERRUPTED))
+    { //the kernel flags all the messages of the part
+      for (; mnl_nlmsg_ok(nlh, remaining); nlh = mnl_nlmsg_next(nlh, &remaining))
+        nlh->nlmsg_flags |= NLM_F_DUMP_INTR;
+      return len;
+    }
   }
 
-  ++channel->sequence;
+  //odd length never ends at message boundary (messages are aligned to 4 bytes)
+  if (fault_fires(faults, SCAN_FAULT_TRUNCATED))
+    return (len / 2) | 1;
 
-  return ret;
+  return len;
+}
+
+static size_t fault_error_message(void *buf, const struct nlmsghdr *request, uint32_t portid, int error)
+{
+  struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+  struct nlmsgerr *err = mnl_nlmsg_put_extra_header(nlh, sizeof(struct nlmsgerr));
+
+  nlh->nlmsg_type = NLMSG_ERROR;
+  nlh->nlmsg_flags = NLM_F_CAPPED;
+  nlh->nlmsg_seq = request->nlmsg_seq;
+  nlh->nlmsg_pid = portid;
+  err->error = error;
+  memcpy(&err->msg, request, sizeof(struct nlmsghdr));
+
+  return nlh->nlmsg_len;
 }
 
 // NETLINK HELPERS - validation
@@ -17,15 +17,45 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h> //size_t
 
 // some constants - mac address length, mac adress string length, max length of wireless network id with null character
 enum wifi_constants {BSSID_LENGTH=6, BSSID_STRING_LENGTH=18, SSID_MAX_LENGTH_WITH_NULL=33};
 // anything >=0 should mean that your are associated with the station
 enum bss_status{BSS_NONE=-1, BSS_AUTHENTHICATED=0, BSS_ASSOCIATED=1, BSS_IBSS_JOINED=2};
 
+// how wifi_scan_all_params gets the results
+// triggered - trigger the scan unless somebody else did it already (like wifi_scan_all)
+// cached - only retrieve results cached by the driver, never wait
+// observe - never trigger, wait for the scan triggered by somebody else (may block for long)
+// colocated - trigger the scan of 6 GHz channels learned from the previous results (see 6 GHZ DISCOVERY)
+enum scan_mode {SCAN_MODE_TRIGGERED=0, SCAN_MODE_CACHED=1, SCAN_MODE_OBSERVE=2, SCAN_MODE_COLOCATED=3};
+
+// security protocols advertised by BSS (flags), WEP is privacy capability without RSN or WPA element
+enum bss_security_protocol {BSS_SECURITY_WEP=1, BSS_SECURITY_WPA=2, BSS_SECURITY_RSN=4};
+// operating channel width from HT, VHT, HE (6 GHz) and EHT operation elements
+enum bss_channel_width {BSS_CHANNEL_WIDTH_20=0, BSS_CHANNEL_WIDTH_40=1, BSS_CHANNEL_WIDTH_80=2, BSS_CHANNEL_WIDTH_160=3, BSS_CHANNEL_WIDTH_80P80=4, BSS_CHANNEL_WIDTH_320=5};
+// membership in Multiple BSSID set (flags), see MULTIPLE BSSID
+// transmitted - beacons advertise the set, nontransmitted - shares the radio of transmitted BSS,
+// expanded - record made by the library from the profile in transmitted BSS beacon (the kernel didn't report it)
+enum bss_multiple_bssid {BSS_MULTIPLE_BSSID_TRANSMITTED=1, BSS_MULTIPLE_BSSID_NONTRANSMITTED=2, BSS_MULTIPLE_BSSID_EXPANDED=4};
+// Fine Timing Measurement roles from Extended Capabilities element (flags), see FTM RANGING
+enum bss_ftm {BSS_FTM_RESPONDER=1, BSS_FTM_INITIATOR=2};
+
 // internal data used by the functions
 struct wifi_scan;
 
+// decoded RSN element (or WPA vendor element if there is no RSN)
+// suite types are these of 00-0F-AC OUI (00-50-F2 for WPA), other OUIs are ignored
+struct bss_security
+{
+	uint8_t protocols; //BSS_SECURITY_* flags, 0 for open network
+	uint8_t group_cipher; //cipher suite type, e.g. 4 for CCMP-128
+	uint16_t pairwise_ciphers; //bitmask of 1 << cipher suite type
+	uint32_t akm_suites; //bitmask of 1 << AKM suite type, e.g. 1 << 2 for PSK, 1 << 8 for SAE
+	uint16_t rsn_capabilities; //e.g. 0x40 management frame protection required, 0x80 capable
+};
+
 // a single wireless network can have multiple BSSes working as network under one SSID
 struct bss_info
 {
@@ -35,6 +65,18 @@ struct bss_info
 	enum bss_status status;  //anything >=0 means that your are connected to this station/network
 	int32_t signal_mbm;  //signal strength in mBm, divide it by 100 to get signal in dBm
 	int32_t seen_ms_ago; //when the above information was collected
+	uint16_t capability; //capability information field, e.g. 0x10 privacy
+	uint8_t channel; //primary channel from DS Parameter Set or HT Operation element, 0 if not advertised
+	uint8_t channel_width; //enum bss_channel_width
+	int16_t station_count; //associated stations from BSS Load element, -1 if not advertised
+	int16_t channel_utilization; //channel busy time 0-255 (255 is 100%) from BSS Load element, -1 if not advertised
+	uint16_t center_frequency; //center of the whole occupied channel in MHz (of the first segment for 80+80), frequency for 20 MHz
+	uint16_t center_frequency2; //center of the second 80 MHz segment for 80+80, 0 otherwise
+	struct bss_security security;
+	uint8_t transmitter_bssid[BSSID_LENGTH]; //transmitted BSSID of Multiple BSSID set (the radio), bssid if not in set
+	uint8_t multiple_bssid; //enum bss_multiple_bssid flags, 0 if not in set
+	uint8_t multiple_bssid_index; //BSSID index in the set, 0 for transmitted BSS
+	uint8_t ftm; //enum bss_ftm flags, 0 if not advertised
 };
 
 // like above
@@ -49,6 +91,29 @@ struct station_info
 };
 
 
+// what and how to scan
+struct scan_params
+{
+	enum scan_mode mode;
+	const uint32_t *frequencies; //scan only those frequencies in MHz (targeted scan), only for triggered mode
+	int frequencies_length; //0 means all channels
+	const char * const *ssids; //probe for those SSIDs (active scan, finds hidden networks), only for triggered and colocated mode
+	int ssids_length; //0 means passive scan
+};
+
+// where the time of the last wifi_scan_all_params/wifi_scan_station call went (0 for phases not executed)
+struct scan_timings
+{
+	uint64_t notifications_ns; //reading pending notifications
+	uint64_t trigger_ns; //triggering the scan until acknowledged
+	uint64_t wait_ns; //waiting for scan results notification
+	uint64_t dump_ns; //retrieving the scan results
+	uint64_t station_ns; //retrieving station information
+	uint64_t total_ns; //the whole call
+	bool triggered; //the scan was triggered by this call (not by somebody else)
+	int dump_retries; //results retrieved again because BSS list changed while retrieving
+};
+
 /*
  * Check whether there is an interface with given name
  *
@@ -116,7 +181,11 @@ int wifi_scan_station(struct wifi_scan *wifi, struct station_info *station);
  * returns:
  * -1 on error (errno is set) or the number of found BSSes, the number may be greater then bss_infos_length
  *
- * Some devices may fail with -1 and errno=EBUSY if triggering scan when another scan is in progress. You may wait and retry in that case 
+ * Some devices may fail with -1 and errno=EBUSY if triggering scan when another scan is in progress. You may wait and retry in that case
+ * If notifications were lost (socket overrun) the results available at the moment are returned (they may be older).
+ * Malformed (truncated) replies fail with -1 and errno=EBADMSG, you may retry.
+ * If BSS list changes while the results are retrieved, they are retrieved again (at most 3 times)
+ * so that there are no duplicates or missing BSSes, then it fails with -1 and errno=EINTR.
  *
  * preconditions:
  * wifi initialized with wifi_scan_init
@@ -124,6 +193,571 @@ int wifi_scan_station(struct wifi_scan *wifi, struct station_info *station);
  */
 int wifi_scan_all(struct wifi_scan *wifi, struct bss_info *bss_infos, int bss_infos_length);
 
+/* Like wifi_scan_all but with scan mode, frequencies and SSIDs
+ *
+ * Targeted scan (only some frequencies) takes a fraction of the full scan time.
+ * Cached mode doesn't need permissions and returns immediately (results may be old, see seen_ms_ago).
+ * Observe mode doesn't need permissions but waits until somebody else scans.
+ * Frequencies the radio can't scan are skipped (see RADIO CAPABILITIES).
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * params - what and how to scan
+ * bss_infos - array of bss_info of size bss_infos_length
+ * bss_infos_length - the length of passed array
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of found BSSes, the number may be greater then bss_infos_length
+ * EINVAL if none of the frequencies can be scanned or there are more SSIDs than the radio probes at once
+ * ENODATA in colocated mode if no 6 GHz BSSes were reported yet
+ *
+ * preconditions:
+ * wifi initialized with wifi_scan_init
+ *
+ */
+int wifi_scan_all_params(struct wifi_scan *wifi, const struct scan_params *params, struct bss_info *bss_infos, int bss_infos_length);
+
+/* Get phase timings of the last wifi_scan_all/wifi_scan_all_params/wifi_scan_station call
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init
+ * timings - to be filled
+ */
+void wifi_scan_last_timings(const struct wifi_scan *wifi, struct scan_timings *timings);
+
+/* CAPTURE AND REPLAY
+ *
+ * All the raw netlink traffic of the library may be recorded to a file and later fed back
+ * to the library (at full speed) instead of the kernel. This allows reproducing and profiling
+ * field workloads offline with the same parser input.
+ *
+ * Capture file layout (host byte order, like netlink itself):
+ * - struct wifi_scan_capture_header
+ * - any number of records, each is struct wifi_scan_capture_record
+ *   followed by result bytes of raw netlink data (if result > 0)
+ */
+
+#define WIFI_SCAN_CAPTURE_MAGIC "WSCAPTUR"
+
+enum wifi_scan_capture_constants {WIFI_SCAN_CAPTURE_VERSION=1};
+enum wifi_scan_channel {WIFI_SCAN_CHANNEL_NOTIFICATIONS=0, WIFI_SCAN_CHANNEL_COMMANDS=1};
+enum wifi_scan_capture_direction {WIFI_SCAN_CAPTURE_SEND=0, WIFI_SCAN_CAPTURE_RECEIVE=1};
+
+struct wifi_scan_capture_header
+{
+	char magic[8]; //WIFI_SCAN_CAPTURE_MAGIC without null character
+	uint32_t version; //WIFI_SCAN_CAPTURE_VERSION
+	uint32_t ifindex; //the wireless interface number at the time of capture
+	uint16_t nl80211_id; //generic netlink nl80211 id at the time of capture
+	uint16_t reserved;
+	uint32_t portid[2]; //netlink port id of notifications and commands channel
+};
+
+struct wifi_scan_capture_record
+{
+	uint64_t timestamp_ns; //CLOCK_REALTIME when send/receive returned
+	uint8_t channel; //enum wifi_scan_channel
+	uint8_t direction; //enum wifi_scan_capture_direction
+	uint16_t reserved;
+	int32_t result; //number of bytes of netlink data following the record or -errno if send/receive failed
+};
+
+/* Start recording all the netlink messages sent and received by the library
+ *
+ * Previous capture (if any) is stopped.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init or wifi_scan_init_replay
+ * capture_file - the file to be created (or truncated)
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_scan_capture_start(struct wifi_scan *wifi, const char *capture_file);
+
+/* Stop recording and close the capture file
+ *
+ * It is safe to call even if capture was not started.
+ * wifi_scan_close also stops capture.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init or wifi_scan_init_replay
+ */
+void wifi_scan_capture_stop(struct wifi_scan *wifi);
+
+/* Initializes the library to replay recorded traffic instead of talking to the kernel
+ *
+ * Call library functions in the same order as when capturing (e.g. wifi_scan_all in a loop).
+ * No permissions or wireless hardware are needed.
+ * When recording is exhausted functions fail with -1 and errno=ENODATA (unless loop is true).
+ *
+ * parameters:
+ * capture_file - file recorded with wifi_scan_capture_start
+ * loop - start over when recording is exhausted
+ *
+ * returns:
+ * struct wifi_scan * - pass it to all the functions in the library or NULL if unsuccessfull
+ */
+struct wifi_scan* wifi_scan_init_replay(const char *capture_file, bool loop);
+
+/* Process raw NL80211_CMD_NEW_SCAN_RESULTS netlink messages (e.g. from capture file)
+ *
+ * Parses the same way as wifi_scan_all but without any netlink communication.
+ * Dump received in multiple parts may be processed by consecutive calls passing previous result as scanned.
+ * Does not need library initialization and may be called from multiple threads.
+ *
+ * parameters:
+ * buf - whole netlink messages (e.g. single receive)
+ * len - length of buf in bytes
+ * bss_infos - array of bss_info of size bss_infos_length
+ * bss_infos_length - the length of passed array
+ * scanned - 0 for the first part of the dump, value returned for previous part otherwise
+ *
+ * returns:
+ * -1 on error (errno is set, e.g. NLMSG_ERROR in data, EINTR for part of interrupted dump) or the number of found BSSes so far, the number may be greater then bss_infos_length
+ */
+int wifi_scan_parse_scan_results(const void *buf, size_t len, struct bss_info *bss_infos, int bss_infos_length, int scanned);
+
+/* Initializes the library with local fake nl80211 backend instead of the kernel
+ *
+ * The fake answers the requests like the kernel would: acknowledges triggers (or fails with EBUSY
+ * if scan is in progress), notifies when simulated scan is finished, serves scan results,
+ * station information, neighbor reports and FTM ranging. Observed scans are simulated if nobody triggers them.
+ * No permissions or wireless hardware are needed.
+ *
+ * parameters:
+ * scan_results - raw NL80211_CMD_NEW_SCAN_RESULTS messages served as scan results (e.g. from capture)
+ * length - length of scan_results in bytes
+ * channel_time_ms - simulated time spent scanning single channel (full scan is 53 channels - 2.4 GHz, 5 GHz
+ *  and 6 GHz preferred scanning channels), also the time the associated AP takes to answer neighbor report
+ *  request (with BSSes of its SSID) and FTM ranging takes per peer (distance follows the signal)
+ *
+ * returns:
+ * struct wifi_scan * - pass it to all the functions in the library or NULL if unsuccessfull
+ */
+struct wifi_scan* wifi_scan_init_fake(const void *scan_results, size_t length, uint32_t channel_time_ms);
+
+/* FAULT INJECTION
+ *
+ * Faults may be injected between the library and any transport (kernel, replay, fake)
+ * to measure how fast the library and your retry policy recover. Each fault has its
+ * opportunities (e.g. every trigger request for SCAN_FAULT_TRIGGER_BUSY) and is injected
+ * at some of them according to script and/or probability.
+ *
+ * trigger busy - trigger request is answered with EBUSY instead of being sent
+ * notifications overrun - received notification is lost and receive fails with ENOBUFS
+ * truncated - received reply for command is cut in the middle of message
+ * dump error - received part of scan results dump is replaced with NLMSG_ERROR (ENOMEM)
+ * dump interrupted - received part of scan results dump is flagged with NLM_F_DUMP_INTR
+ */
+
+enum scan_fault {SCAN_FAULT_NONE=0, SCAN_FAULT_TRIGGER_BUSY=1, SCAN_FAULT_NOTIFICATIONS_OVERRUN=2, SCAN_FAULT_TRUNCATED=3,
+	SCAN_FAULT_DUMP_ERROR=4, SCAN_FAULT_DUMP_INTERRUPTED=5, SCAN_FAULT_TYPES=6};
+
+// let skip opportunities of the fault pass, then inject it count times
+struct scan_fault_rule
+{
+	enum scan_fault fault;
+	uint32_t skip;
+	uint32_t count;
+};
+
+struct scan_faults
+{
+	const struct scan_fault_rule *script; //scripted faults, may be NULL
+	int script_length;
+	uint16_t permille[SCAN_FAULT_TYPES]; //chance (out of 1000) of the fault at each opportunity not covered by script
+	uint32_t seed; //for the above, the same seed gives the same faults
+};
+
+/* Start injecting faults (replaces previous schedule and resets counters)
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+ * faults - what to inject, NULL stops injecting
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_scan_set_faults(struct wifi_scan *wifi, const struct scan_faults *faults);
+
+/* Get the number of faults injected since wifi_scan_set_faults
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+ * injected - to be filled with the number of injected faults of each type
+ */
+void wifi_scan_fault_counts(const struct wifi_scan *wifi, uint32_t injected[SCAN_FAULT_TYPES]);
+
+/* FLOOD GUARD
+ *
+ * Beacon flood makes the kernel report thousands of fake BSSes. With the guard the library
+ * keeps at most max_bss BSSes of the dump, whatever the dump size. The rest is counted
+ * but neither BSSID nor IEs are decoded. SSIDs and BSSID OUIs of the whole dump are counted
+ * in fixed size count-min sketches to spot flood patterns (many BSSes of the same SSID or vendor).
+ *
+ * eviction none - BSSes over the limit are dropped in dump order (as without guard)
+ * eviction weakest - the BSSes with the lowest signal are dropped
+ * eviction least recent - the BSSes with the highest seen_ms_ago are dropped (LRU)
+ *
+ * Associated BSS is never dropped and is still returned first. With eviction other than none
+ * the rest of BSSes is not in dump order if the limit was reached.
+ */
+
+enum scan_eviction {SCAN_EVICT_NONE=0, SCAN_EVICT_WEAKEST=1, SCAN_EVICT_LEAST_RECENT=2};
+
+struct scan_flood_guard
+{
+	int max_bss; //at most that many BSSes are kept and returned, 0 for no limit
+	enum scan_eviction eviction; //which BSSes are dropped over max_bss
+	int flood_bss; //flood if dump has more BSSes, 0 to disable
+	int flood_repeats; //flood if SSID or OUI repeats more times, 0 to disable
+};
+
+// what the guard has seen in the last dump
+struct scan_flood_status
+{
+	bool flood; //flood detected
+	int bss_total; //BSSes in dump
+	int evicted; //BSSes dropped by the guard
+	int max_ssid_repeats; //estimated count of the most common SSID (hidden SSIDs ignored)
+	int max_oui_repeats; //estimated count of the most common BSSID OUI
+};
+
+/* Guard scan results against beacon floods (replaces previous guard)
+ *
+ * With the guard wifi_scan_all and wifi_scan_all_params return at most max_bss (if set)
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+ * guard - limits and flood thresholds, NULL removes the guard
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_scan_set_flood_guard(struct wifi_scan *wifi, const struct scan_flood_guard *guard);
+
+/* Get flood status of the last scan (zeroed without guard)
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+ * status - to be filled
+ */
+void wifi_scan_last_flood_status(const struct wifi_scan *wifi, struct scan_flood_status *status);
+
+/* SURVEY
+ *
+ * Channel survey is the driver account of radio time on each channel - how long the radio
+ * was there and for how much of it the medium was busy, receiving or transmitting.
+ * The counters are cumulative (since the interface went up or the driver reset them).
+ * The library remembers counters of each channel and reports deltas since the previous survey,
+ * utilization percentages follow from deltas.
+ *
+ * Drivers usually update the channel in use all the time and other channels only while scanning on them.
+ * Not every driver reports every counter, fields tell which were reported.
+ */
+
+// survey values reported by the driver (flags)
+enum channel_survey_fields {SURVEY_NOISE=1, SURVEY_TIME=2, SURVEY_TIME_BUSY=4, SURVEY_TIME_RX=8, SURVEY_TIME_TX=16};
+
+struct channel_survey
+{
+	uint32_t frequency; //MHz
+	bool in_use; //the channel the interface operates on
+	uint8_t fields; //enum channel_survey_fields reported
+	int8_t noise_dbm;
+	uint64_t time_ms; //radio on channel
+	uint64_t time_busy_ms; //medium sensed busy on primary channel
+	uint64_t time_rx_ms; //receiving
+	uint64_t time_tx_ms; //transmitting
+	uint64_t delta_time_ms; //since the previous survey, since the counters started for channel surveyed first time or reset
+	uint64_t delta_busy_ms;
+	uint64_t delta_rx_ms;
+	uint64_t delta_tx_ms;
+	int8_t busy_percent; //of delta_time_ms, -1 if there is no delta time or counter was not reported
+	int8_t rx_percent;
+	int8_t tx_percent;
+};
+
+/* Get channel survey of the interface with deltas since the previous call
+ *
+ * Single NL80211_CMD_GET_SURVEY dump, no scan is triggered.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init or wifi_scan_init_fake
+ * surveys - array of channel_survey of size surveys_length, filled in driver order
+ * surveys_length - the length of passed array
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of surveyed channels, the number may be greater than surveys_length
+ * (counters of all the channels are remembered for deltas anyway)
+ */
+int wifi_scan_survey(struct wifi_scan *wifi, struct channel_survey *surveys, int surveys_length);
+
+/* RADIO CAPABILITIES
+ *
+ * wifi_scan_init queries the radio (wiphy) behind the interface and its regulatory domain once
+ * and caches what scanning needs - channels with regulatory flags, scan limits and scan features.
+ *
+ * With capabilities known wifi_scan_all_params scans only requested frequencies the radio supports
+ * and which are not disabled, it fails early with EINVAL if none is left or there are more SSIDs
+ * than the radio probes at once (the trigger would fail anyway).
+ *
+ * Replay has no capabilities (the capture may come from any radio), fake has its own.
+ */
+
+// DISABLED - not allowed at all, NO_IR - no initiating radiation (passive scan only), RADAR - DFS channel
+enum wifi_channel_flags {WIFI_CHANNEL_DISABLED=1, WIFI_CHANNEL_NO_IR=2, WIFI_CHANNEL_RADAR=4, WIFI_CHANNEL_INDOOR_ONLY=8};
+
+// scan features of the radio (flags)
+// low priority - scan yields to traffic, flush - scan can flush old results, random mac - probes from random address
+// dwell - scan duration can be set, start time - reports when the scan actually started
+enum wifi_scan_features {WIFI_SCAN_FEATURE_LOW_PRIORITY=1, WIFI_SCAN_FEATURE_FLUSH=2, WIFI_SCAN_FEATURE_RANDOM_MAC=4,
+	WIFI_SCAN_FEATURE_DWELL=8, WIFI_SCAN_FEATURE_START_TIME=16};
+
+struct wifi_channel
+{
+	uint32_t frequency; //MHz
+	uint8_t flags; //enum wifi_channel_flags
+	int32_t max_power_mbm; //maximum transmit power in mBm (100 * dBm)
+};
+
+struct wifi_capabilities
+{
+	bool known; //false if capabilities could not be retrieved (e.g. replay), nothing is checked then
+	uint32_t wiphy; //index of the radio
+	int max_scan_ssids; //SSIDs probed in single scan
+	int max_scan_ie_len; //bytes of extra IEs in probe requests
+	uint32_t scan_features; //enum wifi_scan_features
+	char country[3]; //regulatory domain ISO 3166-1 alpha2, "00" for world, empty if unknown
+	uint8_t dfs_region; //0 unset, 1 FCC, 2 ETSI, 3 JP
+	int channels; //the number of channels, see wifi_scan_channels
+	int ftm_max_peers; //peers of single FTM ranging, 0 if the radio can't range (see FTM RANGING)
+};
+
+/* Get cached capabilities of the radio
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+ * capabilities - to be filled (zeroed if unknown)
+ */
+void wifi_scan_capabilities(const struct wifi_scan *wifi, struct wifi_capabilities *capabilities);
+
+/* Get cached channels of the radio in the order reported (by band, ascending frequency)
+ *
+ * returns:
+ * the number of channels, may be greater than channels_length, 0 if capabilities are unknown
+ */
+int wifi_scan_channels(const struct wifi_scan *wifi, struct wifi_channel *channels, int channels_length);
+
+/* Get frequencies to be scanned (for struct scan_params)
+ *
+ * Disabled channels are never returned.
+ *
+ * parameters:
+ * exclude_flags - enum wifi_channel_flags of channels to skip, e.g. WIFI_CHANNEL_RADAR for no DFS channels,
+ *  WIFI_CHANNEL_NO_IR for channels where SSIDs can be probed
+ * frequencies - to be filled, frequencies_length at most
+ *
+ * returns:
+ * -1 on error (errno is set, ENODATA if capabilities are unknown) or the number of frequencies, may be greater than frequencies_length
+ */
+int wifi_scan_frequencies(const struct wifi_scan *wifi, uint8_t exclude_flags, uint32_t *frequencies, int frequencies_length);
+
+/* MULTIPLE BSSID
+ *
+ * APs with many networks (e.g. enterprise, guest, IoT) often beacon them once from a single radio.
+ * Multiple BSSID element of the transmitted BSS holds profiles of nontransmitted BSSes (SSID,
+ * capability, index and elements which differ), their BSSIDs follow from the transmitted one.
+ *
+ * wifi_scan_all and wifi_scan_all_params link the records of nontransmitted BSSes to the transmitted
+ * one (transmitter_bssid, multiple_bssid, multiple_bssid_index of struct bss_info). If the kernel doesn't
+ * report nontransmitted BSSes (older kernels, some drivers), the records are made from the profiles
+ * and returned after the reported ones as long as there is space in bss_infos (the ones that don't fit
+ * are counted in the returned value like any other).
+ * Records sharing transmitter_bssid are the same radio - count them once for radio counts and airtime.
+ *
+ * wifi_scan_parse_scan_results only sets the flags (nontransmitted BSSes by their Multiple BSSID-Index
+ * element) and leaves transmitter_bssid as bssid, linking needs the whole dump.
+ */
+
+// at most that many nontransmitted BSSes are linked or made from profiles in single scan
+enum wifi_multiple_bssid_constants {WIFI_SCAN_MULTIPLE_BSSID_MAX=256};
+
+/* 6 GHZ DISCOVERY
+ *
+ * 6 GHz APs are found mostly through Reduced Neighbor Report elements in beacons of their
+ * 2.4/5 GHz neighbours (often radios of the same AP), not by sweeping every 6 GHz channel.
+ * Scan results (other than of wifi_scan_station) are searched for those elements and 6 GHz
+ * BSSes they report are remembered.
+ *
+ * SCAN_MODE_COLOCATED triggers the scan of only those channels with the driver probing
+ * the reported BSSes, a few channels instead of 59 (or 15 preferred scanning channels).
+ * Its results add to the remembered BSSes, results of other modes replace them.
+ */
+
+// at most that many 6 GHz BSSes are remembered
+enum wifi_colocated_constants {WIFI_SCAN_COLOCATED_MAX=256};
+
+// BSS parameters reported for neighbour (flags)
+// OCT recommended - on-channel tunneling, same SSID - as the reporting BSS, multiple BSSID - part of multiple BSSID set,
+// transmitted - transmitted BSSID of the set, colocated ESS - member of ESS with 2.4/5 GHz AP colocated,
+// unsolicited probe responses - active, so no need to probe, colocated AP - radio of the reporting AP
+enum wifi_colocated_parameters {WIFI_COLOCATED_OCT_RECOMMENDED=1, WIFI_COLOCATED_SAME_SSID=2, WIFI_COLOCATED_MULTIPLE_BSSID=4,
+	WIFI_COLOCATED_TRANSMITTED_BSSID=8, WIFI_COLOCATED_ESS=16, WIFI_COLOCATED_UNSOLICITED_PROBE_RESPONSES=32, WIFI_COLOCATED_AP=64};
+
+struct wifi_colocated_bss
+{
+	uint8_t bssid[BSSID_LENGTH]; //zeroed if not reported
+	uint32_t short_ssid; //CRC-32 of SSID, 0 if not reported
+	uint32_t frequency; //of 6 GHz primary channel in MHz
+	uint8_t operating_class;
+	uint8_t parameters; //enum wifi_colocated_parameters, 0 if not reported
+	int8_t psd; //20 MHz power spectral density limit in 0.5 dBm/MHz, 127 if not reported
+	uint8_t reporter_bssid[BSSID_LENGTH]; //the BSS which reported it first
+	int32_t reporter_signal_mbm;
+};
+
+/* Get 6 GHz BSSes reported in the last scan results
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init, wifi_scan_init_replay or wifi_scan_init_fake
+ * colocated - to be filled in order of discovery, colocated_length at most
+ *
+ * returns:
+ * the number of BSSes, may be greater than colocated_length, 0 if none was reported
+ */
+int wifi_scan_colocated(const struct wifi_scan *wifi, struct wifi_colocated_bss *colocated, int colocated_length);
+
+/* NEIGHBOR REPORT
+ *
+ * AP supporting radio measurement (802.11k) knows the APs a station may roam to. wifi_scan_neighbor_report
+ * asks the associated AP with Neighbor Report Request action frame and returns the candidates of its
+ * response. Scanning only their channels takes tens of milliseconds instead of a second of full scan.
+ *
+ * The library registers its notifications socket for Neighbor Report Response frames the first time
+ * (NL80211_CMD_REGISTER_FRAME) and sends the request with NL80211_CMD_FRAME. Only one socket may receive
+ * the responses - with wpa_supplicant running the registration usually fails with EALREADY (ask it instead,
+ * e.g. wpa_cli neighbor_rep_request). Scan notifications received while waiting for the response are kept,
+ * the next wifi_scan_all or wifi_scan_all_params uses results which came meanwhile instead of triggering.
+ */
+
+// typical time the AP takes to answer in milliseconds
+enum wifi_neighbor_constants {WIFI_NEIGHBOR_TIMEOUT_MS=200};
+
+// BSSID Information of neighbour (flags), reachability is 2 bits (1 not reachable, 2 unknown, 3 reachable)
+// security - the same as the associated AP, key scope - the same authenticator, mobility domain - the same (fast BSS transition)
+enum wifi_neighbor_info {WIFI_NEIGHBOR_REACHABLE=3, WIFI_NEIGHBOR_SECURITY=4, WIFI_NEIGHBOR_KEY_SCOPE=8, WIFI_NEIGHBOR_MOBILITY_DOMAIN=0x400,
+	WIFI_NEIGHBOR_HT=0x800, WIFI_NEIGHBOR_VHT=0x1000, WIFI_NEIGHBOR_FTM=0x2000, WIFI_NEIGHBOR_HE=0x4000};
+
+struct wifi_neighbor
+{
+	uint8_t bssid[BSSID_LENGTH];
+	uint32_t bssid_info; //enum wifi_neighbor_info
+	uint8_t operating_class;
+	uint8_t channel;
+	uint8_t phy_type; //e.g. 7 HT, 9 VHT, 14 HE
+	uint32_t frequency; //of primary channel in MHz, 0 if operating class is unknown
+};
+
+/* Ask the associated AP for neighbours
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init or wifi_scan_init_fake
+ * neighbors - to be filled in order reported, neighbors_length at most
+ * timeout_ms - wait for the response at most that long, e.g. WIFI_NEIGHBOR_TIMEOUT_MS
+ *
+ * returns:
+ * -1 on error (errno is set, ENOTCONN if not associated, ETIMEDOUT if the AP didn't answer, EALREADY if another
+ * program receives the responses, ENODATA if the interface address is unknown) or the number of neighbours,
+ * may be greater than neighbors_length
+ */
+int wifi_scan_neighbor_report(struct wifi_scan *wifi, struct wifi_neighbor *neighbors, int neighbors_length, uint32_t timeout_ms);
+
+/* Get distinct frequencies of neighbours (for struct scan_params)
+ *
+ * Unknown frequencies and those the radio can not scan (if capabilities are known) are skipped.
+ *
+ * returns:
+ * the number of frequencies, may be greater than frequencies_length
+ */
+int wifi_scan_neighbor_frequencies(const struct wifi_scan *wifi, const struct wifi_neighbor *neighbors, int neighbors_length,
+	uint32_t *frequencies, int frequencies_length);
+
+/* FTM RANGING
+ *
+ * Fine Timing Measurement (802.11mc) measures round trip time of frames exchanged with AP,
+ * the distance is accurate to a metre or two where signal strength is off by several.
+ * APs advertise FTM responder role in Extended Capabilities element (BSS_FTM_RESPONDER in ftm of struct bss_info).
+ *
+ * wifi_scan_ftm_start ranges against the responders of scan results with NL80211_CMD_PEER_MEASUREMENT_START
+ * and returns immediately. The kernel reports each peer when its measurement is done, wifi_scan_ftm_results
+ * collects whatever came so far in one batch. Ranging doesn't need scanning at high rate, only the results
+ * to know the responders (and their channels).
+ *
+ * The results come to the notifications socket, don't scan (or ask for neighbor report) until ranging is complete.
+ * Scan notifications received while collecting the results are kept for the next scan (as for neighbor report).
+ * Closing the library cancels ranging in progress.
+ */
+
+// the library default of FTM frames per burst, the most peers of single request
+enum wifi_ftm_constants {WIFI_FTM_FTMS_PER_BURST=8, WIFI_FTM_PEERS_MAX=32};
+// measurement outcome, failure_reason of result tells more about failure
+enum wifi_ftm_status {WIFI_FTM_SUCCESS=0, WIFI_FTM_REFUSED=1, WIFI_FTM_TIMEOUT=2, WIFI_FTM_FAILURE=3};
+
+// how to range, zeroed fields mean responder's choice (except single burst)
+struct wifi_ftm_params
+{
+	uint8_t ftms_per_burst; //successful FTM frames per burst, more frames - lower variance
+	uint8_t bursts_exponent; //2^bursts_exponent bursts, 0 for single burst
+	uint16_t burst_period; //between bursts in 100 ms units
+	uint32_t timeout_ms; //of the whole ranging, 0 for no timeout
+};
+
+struct wifi_ftm_result
+{
+	uint8_t bssid[BSSID_LENGTH];
+	uint8_t status; //enum wifi_ftm_status
+	uint8_t failure_reason; //for WIFI_FTM_FAILURE, e.g. 1 no response, 2 rejected, 4 not capable, 6 busy
+	bool final; //the last result of the peer (bursts may be reported separately)
+	int64_t distance_mm; //average
+	uint64_t distance_variance_mm2; //standard deviation is square root of variance
+	int64_t rtt_ps; //average round trip time in picoseconds
+	uint64_t rtt_variance_ps2;
+	int32_t rssi_mbm; //average of FTM frames, 0 if not reported
+	uint32_t attempts; //FTM requests sent
+	uint32_t successes; //FTM requests acknowledged
+	uint64_t host_time_ns; //CLOCK_BOOTTIME of measurement, 0 if not reported
+};
+
+/* Start ranging against FTM responders of scan results
+ *
+ * Records without BSS_FTM_RESPONDER are skipped, so are the records of radio already ranged
+ * (the same transmitter_bssid). At most ftm_max_peers of capabilities (WIFI_FTM_PEERS_MAX) are ranged,
+ * order the records by preference (e.g. by signal) if there are more.
+ *
+ * parameters:
+ * wifi - library data initialized with wifi_scan_init or wifi_scan_init_fake
+ * bss_infos - scan results, e.g. from wifi_scan_all
+ * params - or NULL for single burst of WIFI_FTM_FTMS_PER_BURST FTMs without timeout
+ *
+ * returns:
+ * -1 on error (errno is set, EOPNOTSUPP if the radio can't range, EBUSY if ranging is in progress,
+ * ENOENT if there are no responders) or the number of peers ranged
+ */
+int wifi_scan_ftm_start(struct wifi_scan *wifi, const struct bss_info *bss_infos, int bss_infos_length, const struct wifi_ftm_params *params);
+
+/* Get results of ranging in progress
+ *
+ * Waits at most timeout_ms for the first result, then returns all the results already received.
+ * Results that didn't fit in results_length are returned by the next call.
+ *
+ * returns:
+ * -1 on error (errno is set, ENOENT if there is no ranging - never started or all the results returned already)
+ * or the number of results, 0 if nothing came within timeout_ms
+ */
+int wifi_scan_ftm_results(struct wifi_scan *wifi, struct wifi_ftm_result *results, int results_length, uint32_t timeout_ms);
+
 typedef void(*wifi_scan_log_fcn)(const char* fmt, ...);
 
 /*
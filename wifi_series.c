@@ -0,0 +1,578 @@
+/*
+ * wifi-scan library signal time series implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Series Overview
+  *
+  * The series is an array of fixed size chunks. Only the last chunk is appended to, the encoder state
+  * (last timestamp, last timestamp delta and last signal) is kept in the series so appending is just
+  * computing two small integers and writing their varints.
+  *
+  * Encoded sample (after the first one in chunk):
+  * - varint of zig-zag(timestamp delta - previous timestamp delta)
+  * - varint of zig-zag(signal delta / 100) << 1 if delta is whole dB, zig-zag(signal delta) << 1 | 1 otherwise
+  *
+  * The set maps BSSIDs to dense ids (see wifi_bssid_map.h) which index the array of series.
+  *
+  */
+
+#include "wifi_series.h"
+#include "wifi_bssid_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// longest encoded sample, 64 bit varint and 33 bit varint
+enum series_constants {SERIES_MAX_SAMPLE_BYTES=15};
+
+// internal series data passed around by user
+struct wifi_series
+{
+  struct wifi_series_chunk *chunks;
+  int count; //chunks in use
+  int capacity; //chunks allocated
+  int samples; //in all the chunks
+  uint64_t last_ms; //encoder state after the last sample
+  int64_t delta_ms;
+  int32_t last_mbm;
+};
+
+// internal set data passed around by user
+struct wifi_series_set
+{
+  struct wifi_bssid_map *bssids;
+  struct wifi_series **series; //indexed by BSSID id, NULL if it couldn't be created
+  int capacity;
+};
+
+// DECLARATIONS
+
+// SERIES
+
+// public interface - empty series
+struct wifi_series *wifi_series_new(void);
+// public interface - free series memory
+void wifi_series_free(struct wifi_series *series);
+// public interface - encode sample to the last chunk (or new one if it doesn't fit)
+int wifi_series_append(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm);
+// public interface - validate and copy the chunk, restore encoder state from it
+int wifi_series_append_chunk(struct wifi_series *series, const struct wifi_series_chunk *chunk);
+// public interface - accessors
+int wifi_series_samples(const struct wifi_series *series);
+int wifi_series_chunks(const struct wifi_series *series);
+const struct wifi_series_chunk *wifi_series_chunk(const struct wifi_series *series, int chunk);
+// start new chunk with unencoded sample
+static int new_chunk(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm);
+
+// DECODING
+
+// public interface - binary search the chunk, decode up to timestamp
+void wifi_series_seek(const struct wifi_series *series, uint64_t timestamp_ms, struct wifi_series_cursor *cursor);
+// public interface - next sample of the series
+int wifi_series_next(struct wifi_series_cursor *cursor, uint64_t *timestamp_ms, int32_t *signal_mbm);
+// public interface - the whole chunk
+int wifi_series_decode_chunk(const struct wifi_series_chunk *chunk, uint64_t *timestamps_ms, int32_t *signals_mbm);
+// decode the sample at offset of chunk data updating state, false if data is corrupted
+static bool decode_sample(const struct wifi_series_chunk *chunk, int *offset, uint64_t *timestamp_ms, int64_t *delta_ms, int32_t *signal_mbm);
+
+// SET
+
+// public interface - empty set
+struct wifi_series_set *wifi_series_set_new(void);
+// public interface - free set and its series
+void wifi_series_set_free(struct wifi_series_set *set);
+// public interface - samples from scan results
+int wifi_series_set_add_scan(struct wifi_series_set *set, uint64_t timestamp_ms, const struct bss_info *bss_infos, int bss_infos_length);
+// public interface - sample from station
+int wifi_series_set_add_station(struct wifi_series_set *set, uint64_t timestamp_ms, const struct station_info *station);
+// public interface - lookup and enumeration
+struct wifi_series *wifi_series_set_find(const struct wifi_series_set *set, const uint8_t bssid[BSSID_LENGTH]);
+int wifi_series_set_size(const struct wifi_series_set *set);
+struct wifi_series *wifi_series_set_get(const struct wifi_series_set *set, int index, uint8_t bssid[BSSID_LENGTH]);
+// series of BSSID, created if not present yet, NULL on error
+static struct wifi_series *set_series(struct wifi_series_set *set, const uint8_t bssid[BSSID_LENGTH]);
+// append sample if newer than the last one, -1 on error, number of appended samples otherwise
+static int add_sample(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm);
+
+// ENCODING HELPERS
+
+static int put_varint(uint8_t *buf, uint64_t value);
+// false if varint doesn't end before length
+static bool get_varint(const uint8_t *buf, int length, int *offset, uint64_t *value);
+static uint64_t zigzag(int64_t value);
+static int64_t unzigzag(uint64_t value);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// SERIES
+
+// public interface
+struct wifi_series *wifi_series_new(void)
+{
+  return calloc(sizeof(struct wifi_series), 1);
+}
+
+// public interface
+void wifi_series_free(struct wifi_series *series)
+{
+  if (series == NULL)
+    return;
+  free(series->chunks);
+  free(series);
+}
+
+// public interface
+//
+// prerequisities:
+// - series created with wifi_series_new or found in set
+int wifi_series_append(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm)
+{
+  struct wifi_series_chunk *chunk;
+  int64_t delta_ms, delta_mbm;
+  uint8_t *data;
+  int length;
+
+  if (series->count == 0)
+    return new_chunk(series, timestamp_ms, signal_mbm);
+
+  if (timestamp_ms < series->last_ms)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  chunk = &series->chunks[series->count - 1];
+
+  if (chunk->length + SERIES_MAX_SAMPLE_BYTES > WIFI_SERIES_CHUNK_DATA || chunk->samples == UINT16_MAX)
+    return new_chunk(series, timestamp_ms, signal_mbm);
+
+  delta_ms = timestamp_ms - series->last_ms;
+  delta_mbm = (int64_t)signal_mbm - series->last_mbm;
+  data = chunk->data + chunk->length;
+
+  length = put_varint(data, zigzag(delta_ms - series->delta_ms));
+  //signal is usually reported in whole dB
+  if (delta_mbm % 100 == 0)
+    length += put_varint(data + length, zigzag(delta_mbm / 100) << 1);
+  else
+    length += put_varint(data + length, zigzag(delta_mbm) << 1 | 1);
+
+  chunk->length += length;
+  chunk->last_ms = timestamp_ms;
+  ++chunk->samples;
+  ++series->samples;
+
+  series->last_ms = timestamp_ms;
+  series->delta_ms = delta_ms;
+  series->last_mbm = signal_mbm;
+
+  return 0;
+}
+
+static int new_chunk(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm)
+{
+  struct wifi_series_chunk *chunk;
+
+  if (series->count > 0 && timestamp_ms < series->last_ms)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (series->count == series->capacity)
+  {
+    int capacity = series->capacity ? 2 * series->capacity : 4;
+    struct wifi_series_chunk *grown = realloc(series->chunks, capacity * sizeof(struct wifi_series_chunk));
+    if (grown == NULL)
+      return -1;
+    series->chunks = grown;
+    series->capacity = capacity;
+  }
+
+  chunk = &series->chunks[series->count++];
+  //the whole chunk is zeroed so that stored chunks are deterministic
+  memset(chunk, 0, sizeof(struct wifi_series_chunk));
+  chunk->first_ms = chunk->last_ms = timestamp_ms;
+  chunk->first_mbm = signal_mbm;
+  chunk->samples = 1;
+
+  ++series->samples;
+  series->last_ms = timestamp_ms;
+  series->delta_ms = 0;
+  series->last_mbm = signal_mbm;
+
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - series created with wifi_series_new or found in set
+int wifi_series_append_chunk(struct wifi_series *series, const struct wifi_series_chunk *chunk)
+{
+  uint64_t timestamp_ms = chunk->first_ms;
+  int64_t delta_ms = 0;
+  int32_t signal_mbm = chunk->first_mbm;
+  int offset = 0, i;
+
+  if (chunk->samples == 0 || chunk->length > WIFI_SERIES_CHUNK_DATA || (series->count > 0 && chunk->first_ms < series->last_ms))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  //walk the chunk to validate it and get encoder state
+  for (i = 1; i < chunk->samples; ++i)
+    if (!decode_sample(chunk, &offset, &timestamp_ms, &delta_ms, &signal_mbm))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (offset != chunk->length || timestamp_ms != chunk->last_ms)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (new_chunk(series, chunk->first_ms, chunk->first_mbm) == -1)
+    return -1;
+
+  series->chunks[series->count - 1] = *chunk;
+  series->samples += chunk->samples - 1;
+  series->last_ms = timestamp_ms;
+  series->delta_ms = delta_ms;
+  series->last_mbm = signal_mbm;
+
+  return 0;
+}
+
+// public interface
+int wifi_series_samples(const struct wifi_series *series)
+{
+  return series->samples;
+}
+
+// public interface
+int wifi_series_chunks(const struct wifi_series *series)
+{
+  return series->count;
+}
+
+// public interface
+const struct wifi_series_chunk *wifi_series_chunk(const struct wifi_series *series, int chunk)
+{
+  if (chunk < 0 || chunk >= series->count)
+    return NULL;
+  return &series->chunks[chunk];
+}
+
+// DECODING
+
+// public interface
+//
+// prerequisities:
+// - series created with wifi_series_new or found in set
+void wifi_series_seek(const struct wifi_series *series, uint64_t timestamp_ms, struct wifi_series_cursor *cursor)
+{
+  struct wifi_series_cursor previous;
+  uint64_t sample_ms;
+  int32_t signal_mbm;
+  int first = 0, last = series->count;
+
+  //the first chunk which ends not earlier than timestamp holds the sample
+  while (first < last)
+  {
+    int middle = first + (last - first) / 2;
+    if (series->chunks[middle].last_ms < timestamp_ms)
+      first = middle + 1;
+    else
+      last = middle;
+  }
+
+  memset(cursor, 0, sizeof(struct wifi_series_cursor));
+  cursor->series = series;
+  cursor->chunk = first;
+
+  //decode up to the sample, then step back
+  for (previous = *cursor; wifi_series_next(cursor, &sample_ms, &signal_mbm) == 1 && sample_ms < timestamp_ms; previous = *cursor)
+    ;
+
+  *cursor = previous;
+}
+
+// public interface
+//
+// prerequisities:
+// - cursor initialized with wifi_series_seek
+int wifi_series_next(struct wifi_series_cursor *cursor, uint64_t *timestamp_ms, int32_t *signal_mbm)
+{
+  const struct wifi_series *series = cursor->series;
+
+  for (; cursor->chunk < series->count; ++cursor->chunk, cursor->sample = 0)
+  {
+    const struct wifi_series_chunk *chunk = &series->chunks[cursor->chunk];
+
+    if (cursor->sample == 0)
+    {
+      cursor->timestamp_ms = chunk->first_ms;
+      cursor->delta_ms = 0;
+      cursor->signal_mbm = chunk->first_mbm;
+      cursor->offset = 0;
+    }
+    else if (cursor->sample < chunk->samples)
+    {
+      if (!decode_sample(chunk, &cursor->offset, &cursor->timestamp_ms, &cursor->delta_ms, &cursor->signal_mbm))
+      {
+        errno = EINVAL;
+        return -1;
+      }
+    }
+    else
+      continue;
+
+    ++cursor->sample;
+    *timestamp_ms = cursor->timestamp_ms;
+    *signal_mbm = cursor->signal_mbm;
+    return 1;
+  }
+
+  return 0;
+}
+
+// public interface
+int wifi_series_decode_chunk(const struct wifi_series_chunk *chunk, uint64_t *timestamps_ms, int32_t *signals_mbm)
+{
+  uint64_t timestamp_ms = chunk->first_ms;
+  int64_t delta_ms = 0;
+  int32_t signal_mbm = chunk->first_mbm;
+  int offset = 0, i;
+
+  if (chunk->samples == 0 || chunk->length > WIFI_SERIES_CHUNK_DATA)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  timestamps_ms[0] = timestamp_ms;
+  signals_mbm[0] = signal_mbm;
+
+  for (i = 1; i < chunk->samples; ++i)
+  {
+    if (!decode_sample(chunk, &offset, &timestamp_ms, &delta_ms, &signal_mbm))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+    timestamps_ms[i] = timestamp_ms;
+    signals_mbm[i] = signal_mbm;
+  }
+
+  return chunk->samples;
+}
+
+static bool decode_sample(const struct wifi_series_chunk *chunk, int *offset, uint64_t *timestamp_ms, int64_t *delta_ms, int32_t *signal_mbm)
+{
+  uint64_t dod, signal;
+
+  if (!get_varint(chunk->data, chunk->length, offset, &dod) || !get_varint(chunk->data, chunk->length, offset, &signal))
+    return false;
+
+  *delta_ms += unzigzag(dod);
+  *timestamp_ms += *delta_ms;
+
+  if (signal & 1)
+    *signal_mbm += unzigzag(signal >> 1);
+  else
+    *signal_mbm += unzigzag(signal >> 1) * 100;
+
+  return true;
+}
+
+// SET
+
+// public interface
+struct wifi_series_set *wifi_series_set_new(void)
+{
+  struct wifi_series_set *set = calloc(sizeof(struct wifi_series_set), 1);
+
+  if (set == NULL)
+    return NULL;
+
+  if ((set->bssids = wifi_bssid_map_new()) == NULL)
+  {
+    free(set);
+    return NULL;
+  }
+
+  return set;
+}
+
+// public interface
+void wifi_series_set_free(struct wifi_series_set *set)
+{
+  int i;
+
+  if (set == NULL)
+    return;
+
+  for (i = 0; i < wifi_bssid_map_size(set->bssids); ++i)
+    wifi_series_free(set->series[i]);
+
+  wifi_bssid_map_free(set->bssids);
+  free(set->series);
+  free(set);
+}
+
+// public interface
+//
+// prerequisities:
+// - set created with wifi_series_set_new
+// - bss_info table of sized bss_info_length passed
+int wifi_series_set_add_scan(struct wifi_series_set *set, uint64_t timestamp_ms, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  struct wifi_series *series;
+  uint64_t seen_ms;
+  int i, added = 0, ret;
+
+  for (i = 0; i < bss_infos_length; ++i)
+  {
+    if ((series = set_series(set, bss_infos[i].bssid)) == NULL)
+      return -1;
+
+    seen_ms = bss_infos[i].seen_ms_ago > 0 && (uint64_t)bss_infos[i].seen_ms_ago < timestamp_ms ? timestamp_ms - bss_infos[i].seen_ms_ago : timestamp_ms;
+
+    if ((ret = add_sample(series, seen_ms, bss_infos[i].signal_mbm)) == -1)
+      return -1;
+    added += ret;
+  }
+
+  return added;
+}
+
+// public interface
+//
+// prerequisities:
+// - set created with wifi_series_set_new
+int wifi_series_set_add_station(struct wifi_series_set *set, uint64_t timestamp_ms, const struct station_info *station)
+{
+  struct wifi_series *series = set_series(set, station->bssid);
+
+  if (series == NULL)
+    return -1;
+
+  return add_sample(series, timestamp_ms, station->signal_dbm * 100);
+}
+
+static int add_sample(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm)
+{
+  //the same BSS not seen again since the last scan (results cached by the driver)
+  if (series->samples > 0 && timestamp_ms <= series->last_ms)
+    return 0;
+
+  return wifi_series_append(series, timestamp_ms, signal_mbm) == -1 ? -1 : 1;
+}
+
+// public interface
+struct wifi_series *wifi_series_set_find(const struct wifi_series_set *set, const uint8_t bssid[BSSID_LENGTH])
+{
+  int id = wifi_bssid_map_find(set->bssids, bssid);
+
+  return id == -1 ? NULL : set->series[id];
+}
+
+// public interface
+int wifi_series_set_size(const struct wifi_series_set *set)
+{
+  return wifi_bssid_map_size(set->bssids);
+}
+
+// public interface
+struct wifi_series *wifi_series_set_get(const struct wifi_series_set *set, int index, uint8_t bssid[BSSID_LENGTH])
+{
+  const uint8_t *mapped = wifi_bssid_map_bssid(set->bssids, index);
+
+  if (mapped == NULL)
+    return NULL;
+
+  memcpy(bssid, mapped, BSSID_LENGTH);
+  return set->series[index];
+}
+
+static struct wifi_series *set_series(struct wifi_series_set *set, const uint8_t bssid[BSSID_LENGTH])
+{
+  int id = wifi_bssid_map_add(set->bssids, bssid);
+
+  if (id == -1)
+    return NULL;
+
+  if (id >= set->capacity)
+  {
+    int capacity = set->capacity ? 2 * set->capacity : 64;
+    struct wifi_series **grown = realloc(set->series, capacity * sizeof(struct wifi_series *));
+    if (grown == NULL)
+      return NULL;
+    memset(grown + set->capacity, 0, (capacity - set->capacity) * sizeof(struct wifi_series *));
+    set->series = grown;
+    set->capacity = capacity;
+  }
+
+  //created on first sample (or again if that failed before)
+  if (set->series[id] == NULL)
+    set->series[id] = wifi_series_new();
+
+  return set->series[id];
+}
+
+// ENCODING HELPERS
+
+static int put_varint(uint8_t *buf, uint64_t value)
+{
+  int length = 0;
+
+  while (value >= 0x80)
+  {
+    buf[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  buf[length++] = (uint8_t)value;
+
+  return length;
+}
+
+static bool get_varint(const uint8_t *buf, int length, int *offset, uint64_t *value)
+{
+  int shift;
+
+  *value = 0;
+
+  for (shift = 0; *offset < length && shift < 64; shift += 7)
+  {
+    uint8_t byte = buf[(*offset)++];
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+
+  return false;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
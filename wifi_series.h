@@ -0,0 +1,199 @@
+/*
+ * wifi-scan library signal time series header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Compressed (timestamp, signal) history of single BSSID
+ *
+ * Samples are encoded as they come into fixed size chunks:
+ * - timestamp (ms) as zig-zag varint of delta-of-delta (regular scans give 1 byte)
+ * - signal (mBm) as zig-zag varint of delta, in whole dB if possible (typical change gives 1 byte)
+ *
+ * Each chunk starts with the first sample unencoded and can be decoded independently,
+ * chunks can be stored as they are and looked up by time (random access).
+ * Regular scans take 2-3 bytes per sample instead of 12-16 bytes of raw record.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+enum wifi_series_constants {WIFI_SERIES_CHUNK_SIZE=256, WIFI_SERIES_CHUNK_DATA=232};
+
+// self-contained piece of the series, may be stored as it is (host byte order)
+struct wifi_series_chunk
+{
+	uint64_t first_ms; //timestamp of the first sample
+	uint64_t last_ms; //timestamp of the last sample
+	int32_t first_mbm; //signal of the first sample
+	uint16_t samples; //the number of samples, including the first one
+	uint16_t length; //bytes used in data
+	uint8_t data[WIFI_SERIES_CHUNK_DATA]; //encoded samples after the first one
+};
+
+// position in the series for sequential decoding
+struct wifi_series_cursor
+{
+	const struct wifi_series *series;
+	int chunk; //the chunk being decoded
+	int sample; //the next sample in chunk
+	int offset; //the next byte in chunk data
+	uint64_t timestamp_ms; //of the last decoded sample
+	int64_t delta_ms; //between last two decoded samples
+	int32_t signal_mbm; //of the last decoded sample
+};
+
+// internal data used by the functions, history of single BSSID
+struct wifi_series;
+// internal data used by the functions, histories of all seen BSSIDs
+struct wifi_series_set;
+
+/* Create empty series
+ *
+ * returns:
+ * struct wifi_series * - pass it to the series functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_series *wifi_series_new(void);
+
+/* Free the series
+ *
+ * parameters:
+ * series - created with wifi_series_new, not the one owned by wifi_series_set
+ */
+void wifi_series_free(struct wifi_series *series);
+
+/* Append single sample
+ *
+ * This is a few nanoseconds, memory is allocated only when a chunk fills up.
+ *
+ * parameters:
+ * series - created with wifi_series_new or found with wifi_series_set_find
+ * timestamp_ms - not smaller than timestamp of the previous sample
+ * signal_mbm - signal in mBm (like bss_info signal_mbm)
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for timestamp going back), 0 on success
+ */
+int wifi_series_append(struct wifi_series *series, uint64_t timestamp_ms, int32_t signal_mbm);
+
+/* Append chunk (e.g. loaded from storage)
+ *
+ * The chunk must start not earlier than the last sample of the series.
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for invalid chunk), 0 on success
+ */
+int wifi_series_append_chunk(struct wifi_series *series, const struct wifi_series_chunk *chunk);
+
+/* Get the number of samples in the series */
+int wifi_series_samples(const struct wifi_series *series);
+
+/* Get the number of chunks in the series (the last one may be still filling up) */
+int wifi_series_chunks(const struct wifi_series *series);
+
+/* Get the chunk (e.g. to store it), valid until next append */
+const struct wifi_series_chunk *wifi_series_chunk(const struct wifi_series *series, int chunk);
+
+/* Position cursor at the first sample not earlier than timestamp_ms
+ *
+ * Only the chunk holding the sample is decoded (chunks are binary searched).
+ *
+ * parameters:
+ * series - series to decode
+ * timestamp_ms - 0 for the beginning of the series
+ * cursor - to be initialized, pass it to wifi_series_next
+ */
+void wifi_series_seek(const struct wifi_series *series, uint64_t timestamp_ms, struct wifi_series_cursor *cursor);
+
+/* Decode the next sample
+ *
+ * returns:
+ * 1 if sample was decoded, 0 at the end of the series, -1 for corrupted chunk (errno is EINVAL)
+ */
+int wifi_series_next(struct wifi_series_cursor *cursor, uint64_t *timestamp_ms, int32_t *signal_mbm);
+
+/* Decode all the samples of single chunk (e.g. loaded from storage)
+ *
+ * parameters:
+ * chunk - chunk to decode
+ * timestamps_ms, signals_mbm - arrays of length at least chunk->samples
+ *
+ * returns:
+ * -1 for corrupted chunk (errno is EINVAL) or the number of samples
+ */
+int wifi_series_decode_chunk(const struct wifi_series_chunk *chunk, uint64_t *timestamps_ms, int32_t *signals_mbm);
+
+/* Create empty set of series keyed by BSSID
+ *
+ * returns:
+ * struct wifi_series_set * - pass it to the set functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_series_set *wifi_series_set_new(void);
+
+/* Free the set and all its series */
+void wifi_series_set_free(struct wifi_series_set *set);
+
+/* Append scan results to the series of their BSSIDs
+ *
+ * Sample time is the scan time minus seen_ms_ago. Samples not newer than the last sample
+ * of the BSSID are skipped (e.g. old results cached by the driver).
+ *
+ * parameters:
+ * set - created with wifi_series_set_new
+ * timestamp_ms - when wifi_scan_all returned (e.g. CLOCK_REALTIME in ms)
+ * bss_infos - results of wifi_scan_all
+ * bss_infos_length - the number of results
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of appended samples
+ */
+int wifi_series_set_add_scan(struct wifi_series_set *set, uint64_t timestamp_ms, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Append station signal to the series of its BSSID
+ *
+ * parameters:
+ * set - created with wifi_series_set_new
+ * timestamp_ms - when wifi_scan_station returned
+ * station - result of wifi_scan_station
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of appended samples (0 or 1)
+ */
+int wifi_series_set_add_station(struct wifi_series_set *set, uint64_t timestamp_ms, const struct station_info *station);
+
+/* Find the series of BSSID
+ *
+ * returns:
+ * series owned by the set or NULL if BSSID was never seen
+ */
+struct wifi_series *wifi_series_set_find(const struct wifi_series_set *set, const uint8_t bssid[BSSID_LENGTH]);
+
+/* Get the number of BSSIDs in the set */
+int wifi_series_set_size(const struct wifi_series_set *set);
+
+/* Get the series of BSSIDs in the order they were first seen
+ *
+ * parameters:
+ * set - created with wifi_series_set_new
+ * index - from 0 to wifi_series_set_size - 1
+ * bssid - filled with BSSID of the series
+ *
+ * returns:
+ * series owned by the set or NULL if index is out of range
+ */
+struct wifi_series *wifi_series_set_get(const struct wifi_series_set *set, int index, uint8_t bssid[BSSID_LENGTH]);
+
+#ifdef __cplusplus
+}
+#endif
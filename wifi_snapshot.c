@@ -0,0 +1,515 @@
+/*
+ * wifi-scan library snapshot archive implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Snapshot Overview
+  *
+  * The writer streams scans to the file as they come (each scan encoded to columns in memory first)
+  * and builds SSID dictionary in memory. wifi_snapshot_finish appends the dictionary and the index
+  * of scans and finally rewrites the file header which points to both.
+  *
+  * The reader maps the whole file, validates the header, dictionary and index once and then
+  * only computes pointers to columns of requested scan.
+  *
+  */
+
+#include "wifi_snapshot.h"
+#include "wifi_ssid_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h> //open
+#include <unistd.h> //close
+#include <sys/mman.h> //mmap
+#include <sys/stat.h> //fstat
+
+// where the columns of scan with bss_count BSSes are, relative to scan header
+struct snapshot_layout
+{
+  size_t seen_ms_ago;
+  size_t ssid;
+  size_t signal_mbm;
+  size_t frequency;
+  size_t bssid;
+  size_t status;
+  size_t size; //of the whole scan with header and padding
+};
+
+// internal writer data passed around by user
+struct wifi_snapshot_writer
+{
+  FILE *file;
+  struct wifi_snapshot_header header;
+  uint64_t offset; //where the next scan goes
+  uint64_t *index; //offsets of written scans
+  uint32_t index_capacity;
+  struct wifi_ssid_map *dictionary; //SSIDs seen by the writer
+  char *scan; //the scan being encoded
+  size_t scan_capacity;
+};
+
+// internal reader data passed around by user
+struct wifi_snapshot
+{
+  const char *data; //the whole mapped file
+  size_t length;
+  const struct wifi_snapshot_header *header;
+  const uint64_t *index;
+  uint32_t ssid_count;
+  const uint32_t *ssid_offsets;
+  const char *ssids;
+};
+
+// DECLARATIONS
+
+// WRITING
+
+// public interface - create the file with placeholder header
+struct wifi_snapshot_writer *wifi_snapshot_create(const char *path);
+// public interface - encode the scan to columns and write it
+int wifi_snapshot_append(struct wifi_snapshot_writer *writer, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length);
+// public interface - write dictionary, index and the final header
+int wifi_snapshot_finish(struct wifi_snapshot_writer *writer);
+// frees the writer memory, closes the file
+static void free_writer(struct wifi_snapshot_writer *writer);
+
+// READING
+
+// public interface - map and validate the file
+struct wifi_snapshot *wifi_snapshot_open(const char *path);
+// public interface - unmap the file
+void wifi_snapshot_close(struct wifi_snapshot *snapshot);
+// public interface - the number of scans
+int wifi_snapshot_scans(const struct wifi_snapshot *snapshot);
+// public interface - pointers to columns of the scan
+int wifi_snapshot_scan(const struct wifi_snapshot *snapshot, int scan, struct wifi_snapshot_columns *columns);
+// public interface - SSID from dictionary
+const char *wifi_snapshot_ssid(const struct wifi_snapshot *snapshot, uint32_t ssid);
+// public interface - columns of the scan back to rows
+int wifi_snapshot_read(const struct wifi_snapshot *snapshot, int scan, struct bss_info *bss_infos, int bss_infos_length);
+// check that header, dictionary and index are within the file
+static bool validate_snapshot(struct wifi_snapshot *snapshot);
+
+// HELPERS
+
+// compute the layout of scan with bss_count BSSes
+static void snapshot_layout(uint32_t bss_count, struct snapshot_layout *layout);
+// round up to multiple of 8
+static uint64_t align8(uint64_t value);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// WRITING
+
+// public interface
+struct wifi_snapshot_writer *wifi_snapshot_create(const char *path)
+{
+  struct wifi_snapshot_writer *writer = calloc(sizeof(struct wifi_snapshot_writer), 1);
+
+  if (writer == NULL)
+    return NULL;
+
+  if ((writer->dictionary = wifi_ssid_map_new()) == NULL)
+  {
+    free_writer(writer);
+    return NULL;
+  }
+
+  memcpy(writer->header.magic, WIFI_SNAPSHOT_MAGIC, sizeof(writer->header.magic));
+  writer->header.version = WIFI_SNAPSHOT_VERSION;
+
+  if ((writer->file = fopen(path, "wb")) == NULL)
+  {
+    free_writer(writer);
+    return NULL;
+  }
+
+  //placeholder with index_offset 0 (unfinished) until wifi_snapshot_finish
+  if (fwrite(&writer->header, sizeof(writer->header), 1, writer->file) != 1)
+  {
+    free_writer(writer);
+    return NULL;
+  }
+
+  writer->offset = sizeof(writer->header);
+  return writer;
+}
+
+// public interface
+//
+// prerequisities:
+// - writer initialized with wifi_snapshot_create
+int wifi_snapshot_append(struct wifi_snapshot_writer *writer, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  struct snapshot_layout layout;
+  struct wifi_snapshot_scan_header *scan;
+  int ssid;
+  int i;
+
+  if (bss_infos_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  snapshot_layout(bss_infos_length, &layout);
+
+  if (layout.size > writer->scan_capacity)
+  {
+    char *grown = realloc(writer->scan, layout.size);
+    if (grown == NULL)
+      return -1;
+    writer->scan = grown;
+    writer->scan_capacity = layout.size;
+  }
+
+  if (writer->header.scan_count == writer->index_capacity)
+  {
+    uint32_t capacity = writer->index_capacity ? 2 * writer->index_capacity : 64;
+    uint64_t *grown = realloc(writer->index, capacity * sizeof(uint64_t));
+    if (grown == NULL)
+      return -1;
+    writer->index = grown;
+    writer->index_capacity = capacity;
+  }
+
+  //padding is zeroed so that the same scans always give the same file
+  memset(writer->scan, 0, layout.size);
+
+  scan = (struct wifi_snapshot_scan_header*)writer->scan;
+  scan->timestamp_ns = timestamp_ns;
+  scan->device_id = device_id;
+  scan->bss_count = bss_infos_length;
+
+  int32_t *seen_ms_ago = (int32_t*)(writer->scan + layout.seen_ms_ago);
+  uint32_t *ssids = (uint32_t*)(writer->scan + layout.ssid);
+  int16_t *signal_mbm = (int16_t*)(writer->scan + layout.signal_mbm);
+  uint16_t *frequency = (uint16_t*)(writer->scan + layout.frequency);
+  uint8_t *bssid = (uint8_t*)(writer->scan + layout.bssid);
+  int8_t *status = (int8_t*)(writer->scan + layout.status);
+
+  for (i = 0; i < bss_infos_length; ++i)
+  {
+    const struct bss_info *bss = &bss_infos[i];
+
+    if ((ssid = wifi_ssid_map_add(writer->dictionary, bss->ssid, strnlen(bss->ssid, SSID_MAX_LENGTH_WITH_NULL - 1))) == -1)
+      return -1;
+
+    seen_ms_ago[i] = bss->seen_ms_ago;
+    ssids[i] = (uint32_t)ssid;
+    //mBm of any real signal and MHz of any wifi channel fit in 16 bits
+    signal_mbm[i] = bss->signal_mbm < INT16_MIN ? INT16_MIN : bss->signal_mbm > INT16_MAX ? INT16_MAX : bss->signal_mbm;
+    frequency[i] = bss->frequency > UINT16_MAX ? UINT16_MAX : bss->frequency;
+    memcpy(bssid + i * BSSID_LENGTH, bss->bssid, BSSID_LENGTH);
+    status[i] = bss->status;
+  }
+
+  if (fwrite(writer->scan, layout.size, 1, writer->file) != 1)
+    return -1;
+
+  writer->index[writer->header.scan_count++] = writer->offset;
+  writer->header.bss_count += bss_infos_length;
+  writer->offset += layout.size;
+
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - writer initialized with wifi_snapshot_create
+int wifi_snapshot_finish(struct wifi_snapshot_writer *writer)
+{
+  const int32_t *offsets = wifi_ssid_map_offsets(writer->dictionary);
+  const char *ssids = wifi_ssid_map_data(writer->dictionary);
+  uint32_t count = wifi_ssid_map_size(writer->dictionary), offset, i;
+  static const char padding[8];
+  size_t size, length;
+  bool ok;
+
+  writer->header.dictionary_offset = writer->offset;
+
+  //the file keeps SSIDs null terminated, each one byte further than in the map
+  ok = fwrite(&count, sizeof(uint32_t), 1, writer->file) == 1;
+
+  for (i = 0; ok && i <= count; ++i)
+  {
+    offset = offsets[i] + i;
+    ok = fwrite(&offset, sizeof(uint32_t), 1, writer->file) == 1;
+  }
+
+  for (i = 0; ok && i < count; ++i)
+  {
+    length = offsets[i + 1] - offsets[i];
+    ok = fwrite(ssids + offsets[i], 1, length, writer->file) == length && fputc('\0', writer->file) != EOF;
+  }
+
+  size = sizeof(uint32_t) * (count + 2) + offsets[count] + count;
+  writer->header.index_offset = align8(writer->offset + size);
+
+  ok = ok && fwrite(padding, 1, writer->header.index_offset - writer->offset - size, writer->file) == writer->header.index_offset - writer->offset - size &&
+    fwrite(writer->index, sizeof(uint64_t), writer->header.scan_count, writer->file) == writer->header.scan_count;
+
+  //only now the file becomes readable
+  ok = ok && fseek(writer->file, 0, SEEK_SET) == 0 &&
+    fwrite(&writer->header, sizeof(writer->header), 1, writer->file) == 1;
+
+  ok = fclose(writer->file) == 0 && ok;
+  writer->file = NULL;
+
+  int error = errno;
+  free_writer(writer);
+  errno = error;
+
+  return ok ? 0 : -1;
+}
+
+static void free_writer(struct wifi_snapshot_writer *writer)
+{
+  if (writer->file)
+    fclose(writer->file);
+  free(writer->index);
+  free(writer->scan);
+  wifi_ssid_map_free(writer->dictionary);
+  free(writer);
+}
+
+// READING
+
+// public interface
+struct wifi_snapshot *wifi_snapshot_open(const char *path)
+{
+  struct wifi_snapshot *snapshot;
+  struct stat file_stat;
+  void *data;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) == -1)
+    return NULL;
+
+  if (fstat(fd, &file_stat) == -1)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  if (file_stat.st_size < (off_t)sizeof(struct wifi_snapshot_header))
+  {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); //the mapping stays
+
+  if (data == MAP_FAILED)
+    return NULL;
+
+  if ((snapshot = calloc(sizeof(struct wifi_snapshot), 1)) == NULL)
+  {
+    munmap(data, file_stat.st_size);
+    return NULL;
+  }
+
+  snapshot->data = data;
+  snapshot->length = file_stat.st_size;
+
+  if (!validate_snapshot(snapshot))
+  {
+    wifi_snapshot_close(snapshot);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  return snapshot;
+}
+
+// public interface
+//
+// prerequisities:
+// - snapshot initialized with wifi_snapshot_open
+void wifi_snapshot_close(struct wifi_snapshot *snapshot)
+{
+  munmap((void*)snapshot->data, snapshot->length);
+  free(snapshot);
+}
+
+// public interface
+//
+// prerequisities:
+// - snapshot initialized with wifi_snapshot_open
+int wifi_snapshot_scans(const struct wifi_snapshot *snapshot)
+{
+  return snapshot->header->scan_count;
+}
+
+// public interface
+//
+// prerequisities:
+// - snapshot initialized with wifi_snapshot_open
+int wifi_snapshot_scan(const struct wifi_snapshot *snapshot, int scan, struct wifi_snapshot_columns *columns)
+{
+  const struct wifi_snapshot_scan_header *header;
+  struct snapshot_layout layout;
+  uint64_t offset;
+
+  if (scan < 0 || scan >= (int)snapshot->header->scan_count)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  offset = snapshot->index[scan];
+
+  //scans lie between file header and dictionary, 8 bytes aligned
+  if (offset % 8 || offset < sizeof(struct wifi_snapshot_header) || offset > snapshot->header->dictionary_offset ||
+    snapshot->header->dictionary_offset - offset < sizeof(struct wifi_snapshot_scan_header))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  header = (const struct wifi_snapshot_scan_header*)(snapshot->data + offset);
+  snapshot_layout(header->bss_count, &layout);
+
+  if (header->bss_count > INT32_MAX || layout.size > snapshot->header->dictionary_offset - offset)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  columns->timestamp_ns = header->timestamp_ns;
+  columns->device_id = header->device_id;
+  columns->bss_count = header->bss_count;
+  columns->seen_ms_ago = (const int32_t*)((const char*)header + layout.seen_ms_ago);
+  columns->ssid = (const uint32_t*)((const char*)header + layout.ssid);
+  columns->signal_mbm = (const int16_t*)((const char*)header + layout.signal_mbm);
+  columns->frequency = (const uint16_t*)((const char*)header + layout.frequency);
+  columns->bssid = (const uint8_t(*)[BSSID_LENGTH])((const char*)header + layout.bssid);
+  columns->status = (const int8_t*)((const char*)header + layout.status);
+
+  return 0;
+}
+
+// public interface
+//
+// prerequisities:
+// - snapshot initialized with wifi_snapshot_open
+const char *wifi_snapshot_ssid(const struct wifi_snapshot *snapshot, uint32_t ssid)
+{
+  if (ssid >= snapshot->ssid_count)
+    return NULL;
+  return snapshot->ssids + snapshot->ssid_offsets[ssid];
+}
+
+// public interface
+//
+// prerequisities:
+// - snapshot initialized with wifi_snapshot_open
+// - bss_info table of sized bss_info_length passed
+int wifi_snapshot_read(const struct wifi_snapshot *snapshot, int scan, struct bss_info *bss_infos, int bss_infos_length)
+{
+  struct wifi_snapshot_columns columns;
+  const char *ssid;
+  int i;
+
+  if (wifi_snapshot_scan(snapshot, scan, &columns) == -1)
+    return -1;
+
+  for (i = 0; i < columns.bss_count && i < bss_infos_length; ++i)
+  {
+    struct bss_info *bss = &bss_infos[i];
+
+    memcpy(bss->bssid, columns.bssid[i], BSSID_LENGTH);
+    bss->frequency = columns.frequency[i];
+    bss->status = columns.status[i];
+    bss->signal_mbm = columns.signal_mbm[i];
+    bss->seen_ms_ago = columns.seen_ms_ago[i];
+
+    if ((ssid = wifi_snapshot_ssid(snapshot, columns.ssid[i])) == NULL)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+    strncpy(bss->ssid, ssid, SSID_MAX_LENGTH_WITH_NULL - 1);
+    bss->ssid[SSID_MAX_LENGTH_WITH_NULL - 1] = '\0';
+  }
+
+  return columns.bss_count;
+}
+
+// prerequisities:
+// - snapshot data mapped, length of at least file header
+static bool validate_snapshot(struct wifi_snapshot *snapshot)
+{
+  const struct wifi_snapshot_header *header = (const struct wifi_snapshot_header*)snapshot->data;
+  uint64_t dictionary = header->dictionary_offset;
+  uint32_t count, i;
+
+  snapshot->header = header;
+
+  if (memcmp(header->magic, WIFI_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != WIFI_SNAPSHOT_VERSION)
+    return false;
+
+  //unfinished file has no dictionary and index
+  if (header->index_offset == 0 || header->index_offset % 8 || header->index_offset > snapshot->length ||
+    header->scan_count > (snapshot->length - header->index_offset) / sizeof(uint64_t))
+    return false;
+
+  //subtract rather than add, offsets from the file may be anything and the sum wraps around
+  if (dictionary < sizeof(struct wifi_snapshot_header) || dictionary % 8 || dictionary > header->index_offset ||
+    header->index_offset - dictionary < 2 * sizeof(uint32_t))
+    return false;
+
+  memcpy(&count, snapshot->data + dictionary, sizeof(count));
+
+  if (count > (header->index_offset - dictionary) / sizeof(uint32_t) - 2)
+    return false;
+
+  snapshot->index = (const uint64_t*)(snapshot->data + header->index_offset);
+  snapshot->ssid_count = count;
+  snapshot->ssid_offsets = (const uint32_t*)(snapshot->data + dictionary + sizeof(uint32_t));
+  snapshot->ssids = (const char*)(snapshot->ssid_offsets + count + 1);
+
+  //offsets grow, the last one is the end of SSIDs, each SSID is null terminated
+  //count above leaves the offsets before index_offset so the region length doesn't wrap
+  if (snapshot->ssid_offsets[count] > header->index_offset - (snapshot->ssids - snapshot->data))
+    return false;
+
+  for (i = 0; i < count; ++i)
+    if (snapshot->ssid_offsets[i] >= snapshot->ssid_offsets[i + 1] || snapshot->ssids[snapshot->ssid_offsets[i + 1] - 1] != '\0')
+      return false;
+
+  return true;
+}
+
+// HELPERS
+
+static void snapshot_layout(uint32_t bss_count, struct snapshot_layout *layout)
+{
+  //widest columns first so that each is naturally aligned
+  layout->seen_ms_ago = sizeof(struct wifi_snapshot_scan_header);
+  layout->ssid = layout->seen_ms_ago + (size_t)bss_count * sizeof(int32_t);
+  layout->signal_mbm = layout->ssid + (size_t)bss_count * sizeof(uint32_t);
+  layout->frequency = layout->signal_mbm + (size_t)bss_count * sizeof(int16_t);
+  layout->bssid = layout->frequency + (size_t)bss_count * sizeof(uint16_t);
+  layout->status = layout->bssid + (size_t)bss_count * BSSID_LENGTH;
+  layout->size = align8(layout->status + (size_t)bss_count * sizeof(int8_t));
+}
+
+static uint64_t align8(uint64_t value)
+{
+  return (value + 7) & ~(uint64_t)7;
+}
@@ -0,0 +1,173 @@
+/*
+ * wifi-scan library snapshot archive header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Compact columnar archive of scan results (struct bss_info arrays)
+ *
+ * The file is meant to be memory mapped, columns are read in place without any parsing.
+ * A BSS takes 20 bytes (plus SSID once per file) instead of 60 bytes of bss_info or 100+ bytes of CSV/JSON.
+ *
+ * File layout (host byte order, all offsets from the beginning of the file):
+ * - struct wifi_snapshot_header
+ * - scans, each is struct wifi_snapshot_scan_header followed by columns of bss_count elements
+ *   (in this order, each column naturally aligned, the scan padded to 8 bytes):
+ *   int32_t seen_ms_ago, uint32_t ssid (index to SSID dictionary), int16_t signal_mbm,
+ *   uint16_t frequency, uint8_t bssid[BSSID_LENGTH], int8_t status
+ * - SSID dictionary: uint32_t count, uint32_t offsets[count + 1] (from the first SSID), null terminated SSIDs
+ * - scan index: uint64_t offsets[scan_count] of scan headers
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+#define WIFI_SNAPSHOT_MAGIC "WSSNAPSH"
+
+enum wifi_snapshot_constants {WIFI_SNAPSHOT_VERSION=1};
+
+struct wifi_snapshot_header
+{
+	char magic[8]; //WIFI_SNAPSHOT_MAGIC without null character
+	uint32_t version; //WIFI_SNAPSHOT_VERSION
+	uint32_t scan_count;
+	uint64_t bss_count; //in all the scans
+	uint64_t dictionary_offset;
+	uint64_t index_offset; //0 if the file was not finished
+	uint8_t reserved[24];
+};
+
+struct wifi_snapshot_scan_header
+{
+	uint64_t timestamp_ns; //whatever the writer passed, e.g. CLOCK_REALTIME of the scan
+	uint32_t device_id; //whatever the writer passed, e.g. the device which scanned
+	uint32_t bss_count;
+};
+
+// the scan as stored in the file, pointers to the memory mapped file
+struct wifi_snapshot_columns
+{
+	uint64_t timestamp_ns;
+	uint32_t device_id;
+	int bss_count; //the length of each column
+	const int32_t *seen_ms_ago;
+	const uint32_t *ssid; //pass to wifi_snapshot_ssid
+	const int16_t *signal_mbm;
+	const uint16_t *frequency;
+	const uint8_t (*bssid)[BSSID_LENGTH];
+	const int8_t *status;
+};
+
+// data used by the writer
+struct wifi_snapshot_writer;
+// data used by the reader
+struct wifi_snapshot;
+
+/* Create snapshot archive
+ *
+ * parameters:
+ * path - the file to be created (or truncated)
+ *
+ * returns:
+ * struct wifi_snapshot_writer * - pass it to the writer functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_snapshot_writer *wifi_snapshot_create(const char *path);
+
+/* Append scan results to the archive
+ *
+ * parameters:
+ * writer - initialized with wifi_snapshot_create
+ * timestamp_ns - stored with the scan (e.g. CLOCK_REALTIME)
+ * device_id - stored with the scan (e.g. the device which scanned)
+ * bss_infos - results of wifi_scan_all
+ * bss_infos_length - the number of results
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_snapshot_append(struct wifi_snapshot_writer *writer, uint64_t timestamp_ns, uint32_t device_id, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Write SSID dictionary and index, close the file and free the writer
+ *
+ * The archive can't be read until it is finished.
+ *
+ * parameters:
+ * writer - initialized with wifi_snapshot_create, it is freed even on error
+ *
+ * returns:
+ * -1 on error (errno is set), 0 on success
+ */
+int wifi_snapshot_finish(struct wifi_snapshot_writer *writer);
+
+/* Memory map snapshot archive for reading
+ *
+ * The structure of the file is validated, the data is not read.
+ *
+ * parameters:
+ * path - finished archive
+ *
+ * returns:
+ * struct wifi_snapshot * - pass it to the reader functions or NULL if unsuccessfull (errno is set, EINVAL for invalid file)
+ */
+struct wifi_snapshot *wifi_snapshot_open(const char *path);
+
+/* Unmap the archive
+ *
+ * parameters:
+ * snapshot - initialized with wifi_snapshot_open
+ */
+void wifi_snapshot_close(struct wifi_snapshot *snapshot);
+
+/* Get the number of scans in the archive */
+int wifi_snapshot_scans(const struct wifi_snapshot *snapshot);
+
+/* Get columns of the scan, without any copying or parsing
+ *
+ * parameters:
+ * snapshot - initialized with wifi_snapshot_open
+ * scan - from 0 to wifi_snapshot_scans - 1
+ * columns - to be filled, valid until wifi_snapshot_close
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for invalid file), 0 on success
+ */
+int wifi_snapshot_scan(const struct wifi_snapshot *snapshot, int scan, struct wifi_snapshot_columns *columns);
+
+/* Get SSID from dictionary
+ *
+ * parameters:
+ * snapshot - initialized with wifi_snapshot_open
+ * ssid - index from the ssid column
+ *
+ * returns:
+ * null terminated SSID valid until wifi_snapshot_close or NULL if there is no such index
+ */
+const char *wifi_snapshot_ssid(const struct wifi_snapshot *snapshot, uint32_t ssid);
+
+/* Decode the scan back to struct bss_info array
+ *
+ * parameters:
+ * snapshot - initialized with wifi_snapshot_open
+ * scan - from 0 to wifi_snapshot_scans - 1
+ * bss_infos - array of bss_info of size bss_infos_length
+ * bss_infos_length - the length of passed array
+ *
+ * returns:
+ * -1 on error (errno is set) or the number of BSSes in the scan, the number may be greater then bss_infos_length
+ */
+int wifi_snapshot_read(const struct wifi_snapshot *snapshot, int scan, struct bss_info *bss_infos, int bss_infos_length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,334 @@
+/*
+ * wifi-scan library spectrum interference map implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * Spectrum Overview
+  *
+  * Occupied segments [low, high) MHz of BSSes are sorted by low. The sorted array is implicit
+  * balanced binary search tree - the middle element of range is the root, halves are subtrees.
+  * Each element keeps the maximum high of its subtree, query skips subtrees ending below
+  * the channel and stops going right when elements start above it.
+  *
+  * BSS on 80+80 has two segments, it is reported once (at the lower overlapping segment)
+  * with overlap of both segments.
+  *
+  */
+
+#include "wifi_spectrum.h"
+#include "wifi_mb.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+enum spectrum_constants {MAX_SEGMENTS=2};
+
+// indexed BSS
+struct spectrum_bss
+{
+  int index; //in bss_infos
+  int32_t signal_mbm;
+  uint16_t primary; //frequency of primary 20 MHz
+  uint16_t width_mhz; //all segments
+  int32_t width_mb; //1000 * log10(width_mhz)
+  uint16_t low[MAX_SEGMENTS];
+  uint16_t high[MAX_SEGMENTS];
+  uint8_t segments;
+};
+
+// element of interval index
+struct spectrum_segment
+{
+  uint16_t low;
+  uint16_t high;
+  uint16_t max_high; //of subtree rooted here
+  uint8_t segment; //of bss
+  int bss; //in spectrum bss
+};
+
+// internal data passed around by user
+struct wifi_spectrum
+{
+  struct spectrum_bss *bss;
+  int bss_count;
+  int bss_capacity;
+  struct spectrum_segment *segments; //sorted by low
+  int segments_count;
+  int segments_capacity;
+};
+
+// query state passed down the tree
+struct spectrum_query
+{
+  uint32_t low;
+  uint32_t high;
+  struct wifi_spectrum_overlap *overlaps;
+  int overlaps_length;
+  int found;
+};
+
+// DECLARATIONS
+
+// public interface - empty map
+struct wifi_spectrum *wifi_spectrum_new(void);
+// public interface - free map memory
+void wifi_spectrum_free(struct wifi_spectrum *spectrum);
+// public interface - index scan
+int wifi_spectrum_build(struct wifi_spectrum *spectrum, const struct bss_info *bss_infos, int bss_infos_length);
+// public interface - BSSes overlapping channel
+int wifi_spectrum_query(const struct wifi_spectrum *spectrum, uint32_t center_frequency, uint32_t width_mhz,
+	struct wifi_spectrum_overlap *overlaps, int overlaps_length);
+
+// INDEX HELPERS
+
+// occupied segments of BSS from its channel, false if BSS is not in spectrum
+static bool bss_segments(const struct bss_info *bss_info, struct spectrum_bss *bss);
+// qsort comparator of segments by low
+static int segment_compare(const void *a, const void *b);
+// fill max_high of subtree [from, to), returns it
+static uint16_t index_build(struct spectrum_segment *segments, int from, int to);
+// visit segments of subtree [from, to) overlapping query in low order
+static void index_query(const struct wifi_spectrum *spectrum, int from, int to, struct spectrum_query *query);
+
+// OVERLAP HELPERS
+
+// overlap in MHz of [low, high) with [low2, high2)
+static uint32_t overlap_mhz(uint32_t low, uint32_t high, uint32_t low2, uint32_t high2);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_spectrum *wifi_spectrum_new(void)
+{
+  return calloc(1, sizeof(struct wifi_spectrum));
+}
+
+// public interface
+void wifi_spectrum_free(struct wifi_spectrum *spectrum)
+{
+  if (spectrum == NULL)
+    return;
+
+  free(spectrum->bss);
+  free(spectrum->segments);
+  free(spectrum);
+}
+
+// public interface
+int wifi_spectrum_build(struct wifi_spectrum *spectrum, const struct bss_info *bss_infos, int bss_infos_length)
+{
+  int i, s;
+
+  if (bss_infos_length < 0 || (bss_infos_length > 0 && bss_infos == NULL))
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (bss_infos_length > spectrum->bss_capacity)
+  {
+    struct spectrum_bss *bss = realloc(spectrum->bss, bss_infos_length * sizeof(struct spectrum_bss));
+    if (bss == NULL)
+      return -1;
+    spectrum->bss = bss;
+    spectrum->bss_capacity = bss_infos_length;
+  }
+
+  if (bss_infos_length * MAX_SEGMENTS > spectrum->segments_capacity)
+  {
+    struct spectrum_segment *segments = realloc(spectrum->segments, bss_infos_length * MAX_SEGMENTS * sizeof(struct spectrum_segment));
+    if (segments == NULL)
+      return -1;
+    spectrum->segments = segments;
+    spectrum->segments_capacity = bss_infos_length * MAX_SEGMENTS;
+  }
+
+  spectrum->bss_count = spectrum->segments_count = 0;
+
+  for (i = 0; i < bss_infos_length; ++i)
+  {
+    struct spectrum_bss *bss = &spectrum->bss[spectrum->bss_count];
+
+    if (!bss_segments(&bss_infos[i], bss))
+      continue;
+
+    bss->index = i;
+    bss->width_mb = wifi_log10_mb(bss->width_mhz);
+
+    for (s = 0; s < bss->segments; ++s)
+    {
+      struct spectrum_segment *segment = &spectrum->segments[spectrum->segments_count++];
+      segment->low = bss->low[s];
+      segment->high = bss->high[s];
+      segment->segment = s;
+      segment->bss = spectrum->bss_count;
+    }
+
+    ++spectrum->bss_count;
+  }
+
+  qsort(spectrum->segments, spectrum->segments_count, sizeof(struct spectrum_segment), segment_compare);
+  index_build(spectrum->segments, 0, spectrum->segments_count);
+
+  return spectrum->bss_count;
+}
+
+// public interface
+int wifi_spectrum_query(const struct wifi_spectrum *spectrum, uint32_t center_frequency, uint32_t width_mhz,
+	struct wifi_spectrum_overlap *overlaps, int overlaps_length)
+{
+  struct spectrum_query query;
+
+  if (width_mhz == 0 || center_frequency < width_mhz / 2 || overlaps_length < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  query.low = center_frequency - width_mhz / 2;
+  query.high = query.low + width_mhz;
+  query.overlaps = overlaps;
+  query.overlaps_length = overlaps_length;
+  query.found = 0;
+
+  index_query(spectrum, 0, spectrum->segments_count, &query);
+
+  return query.found;
+}
+
+static bool bss_segments(const struct bss_info *bss_info, struct spectrum_bss *bss)
+{
+  static const uint16_t SEGMENT_WIDTH_MHZ[] = {20, 40, 80, 160, 80, 320}; //by enum bss_channel_width
+  uint32_t center = bss_info->center_frequency, center2 = bss_info->center_frequency2, width;
+  uint8_t channel_width = bss_info->channel_width;
+
+  if (bss_info->frequency < 10 || bss_info->frequency > UINT16_MAX - 10)
+    return false;
+
+  //older records without occupied channel
+  if (center == 0 || channel_width > BSS_CHANNEL_WIDTH_320)
+  {
+    center = bss_info->frequency;
+    channel_width = BSS_CHANNEL_WIDTH_20;
+  }
+
+  width = SEGMENT_WIDTH_MHZ[channel_width];
+
+  if (center < width / 2 || center + width / 2 > UINT16_MAX)
+    return false;
+
+  bss->signal_mbm = bss_info->signal_mbm;
+  bss->primary = bss_info->frequency;
+  bss->width_mhz = width;
+  bss->low[0] = center - width / 2;
+  bss->high[0] = center + width / 2;
+  bss->segments = 1;
+
+  if (channel_width == BSS_CHANNEL_WIDTH_80P80 && center2 >= width / 2 && center2 + width / 2 <= UINT16_MAX)
+  {
+    int second = center2 > center; //segment 0 is the lower one
+
+    bss->low[second] = center2 - width / 2;
+    bss->high[second] = center2 + width / 2;
+    bss->low[!second] = center - width / 2;
+    bss->high[!second] = center + width / 2;
+    bss->width_mhz = 2 * width;
+    bss->segments = 2;
+  }
+
+  return true;
+}
+
+static int segment_compare(const void *a, const void *b)
+{
+  const struct spectrum_segment *x = a, *y = b;
+  return (x->low > y->low) - (x->low < y->low);
+}
+
+static uint16_t index_build(struct spectrum_segment *segments, int from, int to)
+{
+  int middle = from + (to - from) / 2;
+  uint16_t left, right;
+
+  if (from >= to)
+    return 0;
+
+  left = index_build(segments, from, middle);
+  right = index_build(segments, middle + 1, to);
+
+  segments[middle].max_high = segments[middle].high;
+  if (left > segments[middle].max_high)
+    segments[middle].max_high = left;
+  if (right > segments[middle].max_high)
+    segments[middle].max_high = right;
+
+  return segments[middle].max_high;
+}
+
+static void index_query(const struct wifi_spectrum *spectrum, int from, int to, struct spectrum_query *query)
+{
+  const struct spectrum_segment *segment;
+  const struct spectrum_bss *bss;
+  uint32_t overlap = 0;
+  int middle, s;
+
+  //tail recursion on the right subtree is a loop
+  while (from < to)
+  {
+    middle = from + (to - from) / 2;
+    segment = &spectrum->segments[middle];
+
+    //nothing in subtree ends above the channel start
+    if (segment->max_high <= query->low)
+      return;
+
+    index_query(spectrum, from, middle, query);
+
+    //this and the right subtree start at or above the channel end
+    if (segment->low >= query->high)
+      return;
+
+    from = middle + 1;
+
+    if (segment->high <= query->low)
+      continue;
+
+    bss = &spectrum->bss[segment->bss];
+
+    //80+80 overlapping with the lower segment too was already reported
+    if (segment->segment > 0 && overlap_mhz(bss->low[0], bss->high[0], query->low, query->high))
+      continue;
+
+    for (s = 0, overlap = 0; s < bss->segments; ++s)
+      overlap += overlap_mhz(bss->low[s], bss->high[s], query->low, query->high);
+
+    if (query->found < query->overlaps_length)
+    {
+      struct wifi_spectrum_overlap *result = &query->overlaps[query->found];
+
+      result->bss = bss->index;
+      result->overlap_mhz = overlap;
+      result->width_mhz = bss->width_mhz;
+      result->signal_mbm = bss->signal_mbm;
+      result->interference_mbm = overlap == bss->width_mhz ? bss->signal_mbm : bss->signal_mbm - (bss->width_mb - wifi_log10_mb(overlap));
+      result->flags = bss->primary >= query->low + 10 && bss->primary + 10u <= query->high ? WIFI_SPECTRUM_PRIMARY : 0;
+    }
+
+    ++query->found;
+  }
+}
+
+static uint32_t overlap_mhz(uint32_t low, uint32_t high, uint32_t low2, uint32_t high2)
+{
+  uint32_t from = low > low2 ? low : low2, to = high < high2 ? high : high2;
+  return to > from ? to - from : 0;
+}
+
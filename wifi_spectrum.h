@@ -0,0 +1,83 @@
+/*
+ * wifi-scan library spectrum interference map header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Which BSSes of scan overlap given channel in spectrum and how strongly
+ *
+ * Each BSS occupies its whole operating channel (center_frequency and channel_width of struct bss_info,
+ * two segments for 80+80), not only the primary 20 MHz. In 2.4 GHz 20 MHz channels 5 MHz apart overlap too.
+ * Occupied segments are kept in interval index, query of any channel (e.g. 20/40/80/160 MHz candidate
+ * of channel planner) takes O(log n + overlapping BSSes).
+ *
+ * Strength of overlap assumes BSS spreads its power evenly over its channel, so the part received
+ * within queried channel is signal scaled by the overlapping fraction of BSS bandwidth.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+// WIFI_SPECTRUM_PRIMARY - primary 20 MHz of BSS is inside the queried channel (contends for the medium, not only adds noise)
+enum wifi_spectrum_overlap_flags {WIFI_SPECTRUM_PRIMARY=1};
+
+struct wifi_spectrum_overlap
+{
+	int bss; //index in bss_infos passed to wifi_spectrum_build
+	uint16_t overlap_mhz; //of BSS channel inside the queried channel
+	uint16_t width_mhz; //of BSS channel (both segments for 80+80)
+	int32_t signal_mbm; //of BSS
+	int32_t interference_mbm; //signal_mbm + 10 * log10(overlap_mhz / width_mhz) dBm in mBm, the part received within queried channel
+	uint8_t flags; //WIFI_SPECTRUM_* flags
+};
+
+// internal data used by the functions
+struct wifi_spectrum;
+
+/* Create empty interference map
+ *
+ * returns:
+ * struct wifi_spectrum * - pass it to the spectrum functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_spectrum *wifi_spectrum_new(void);
+
+/* Free the interference map */
+void wifi_spectrum_free(struct wifi_spectrum *spectrum);
+
+/* Index scan results, replaces what was indexed before (memory is reused)
+ *
+ * BSSes with frequency 0 are ignored. BSS with center_frequency 0 (e.g. decoded from older records)
+ * is assumed to occupy 20 MHz around its frequency.
+ *
+ * returns:
+ * -1 on error (errno is set), the number of indexed BSSes on success
+ */
+int wifi_spectrum_build(struct wifi_spectrum *spectrum, const struct bss_info *bss_infos, int bss_infos_length);
+
+/* Get BSSes overlapping channel in the order of their lowest frequency
+ *
+ * parameters:
+ * center_frequency - of the channel in MHz
+ * width_mhz - of the channel, e.g. 20, 40, 80, 160
+ * overlaps - to be filled, overlaps_length at most
+ *
+ * returns:
+ * -1 on error (errno is set, EINVAL for width 0) or the number of overlapping BSSes, may be greater than overlaps_length
+ */
+int wifi_spectrum_query(const struct wifi_spectrum *spectrum, uint32_t center_frequency, uint32_t width_mhz,
+	struct wifi_spectrum_overlap *overlaps, int overlaps_length);
+
+#ifdef __cplusplus
+}
+#endif
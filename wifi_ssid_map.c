@@ -0,0 +1,208 @@
+/*
+ * wifi-scan library SSID map implementation
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+ /*
+  * SSID Map Overview
+  *
+  * SSIDs are stored one after another in the order of ids, offsets[id] to offsets[id + 1].
+  * Open addressing hash table with linear probing holds id + 1 (0 for empty slot)
+  * and is kept at most half full.
+  *
+  */
+
+#include "wifi_ssid_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// internal data passed around by user
+struct wifi_ssid_map
+{
+  char *data; //SSIDs one after another without terminators
+  size_t length; //bytes used in data
+  size_t capacity; //bytes allocated for data
+  int32_t *offsets; //count + 1 offsets to data
+  int count;
+  int offsets_capacity; //of offsets, without the last one
+  uint32_t *table; //id + 1, 0 for empty slot
+  uint32_t table_size; //power of 2, at least twice the count
+};
+
+// DECLARATIONS
+
+// public interface - empty map
+struct wifi_ssid_map *wifi_ssid_map_new(void);
+// public interface - free map memory
+void wifi_ssid_map_free(struct wifi_ssid_map *map);
+// public interface - find or insert
+int wifi_ssid_map_add(struct wifi_ssid_map *map, const char *ssid, size_t length);
+// public interface - find
+int wifi_ssid_map_find(const struct wifi_ssid_map *map, const char *ssid, size_t length);
+// public interface - accessors
+int wifi_ssid_map_size(const struct wifi_ssid_map *map);
+const char *wifi_ssid_map_data(const struct wifi_ssid_map *map);
+const int32_t *wifi_ssid_map_offsets(const struct wifi_ssid_map *map);
+// rebuild hash table with twice the size
+static bool map_grow(struct wifi_ssid_map *map);
+// FNV-1a of SSID
+static uint32_t hash_ssid(const char *ssid, size_t length);
+
+// #####################################################################
+// IMPLEMENTATION
+
+// public interface
+struct wifi_ssid_map *wifi_ssid_map_new(void)
+{
+  return calloc(sizeof(struct wifi_ssid_map), 1);
+}
+
+// public interface
+void wifi_ssid_map_free(struct wifi_ssid_map *map)
+{
+  if (map == NULL)
+    return;
+
+  free(map->data);
+  free(map->offsets);
+  free(map->table);
+  free(map);
+}
+
+// public interface
+//
+// prerequisities:
+// - map created with wifi_ssid_map_new
+int wifi_ssid_map_add(struct wifi_ssid_map *map, const char *ssid, size_t length)
+{
+  int id = wifi_ssid_map_find(map, ssid, length);
+  uint32_t slot;
+
+  if (id != -1)
+    return id;
+
+  //offsets are int32_t as in Arrow
+  if (length > INT32_MAX - map->length)
+  {
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  //keep the table at most half full
+  if (2 * (map->count + 1) > (int)map->table_size && !map_grow(map))
+    return -1;
+
+  //at least one byte spare, data is never NULL once something is added (even empty SSID)
+  if (map->length + length >= map->capacity)
+  {
+    size_t capacity = 2 * map->capacity + length + 1;
+    char *grown = realloc(map->data, capacity);
+    if (grown == NULL)
+      return -1;
+    map->data = grown;
+    map->capacity = capacity;
+  }
+
+  if (map->count == map->offsets_capacity)
+  {
+    int capacity = map->offsets_capacity ? 2 * map->offsets_capacity : 64;
+    int32_t *grown = realloc(map->offsets, (capacity + 1) * sizeof(int32_t));
+    if (grown == NULL)
+      return -1;
+    grown[0] = 0;
+    map->offsets = grown;
+    map->offsets_capacity = capacity;
+  }
+
+  for (slot = hash_ssid(ssid, length) & (map->table_size - 1); map->table[slot]; slot = (slot + 1) & (map->table_size - 1))
+    ;
+
+  memcpy(map->data + map->length, ssid, length);
+  map->length += length;
+  map->offsets[map->count + 1] = map->length;
+  map->table[slot] = map->count + 1;
+
+  return map->count++;
+}
+
+// public interface
+int wifi_ssid_map_find(const struct wifi_ssid_map *map, const char *ssid, size_t length)
+{
+  uint32_t slot;
+  int id;
+
+  if (map->table_size == 0)
+    return -1;
+
+  for (slot = hash_ssid(ssid, length) & (map->table_size - 1); map->table[slot]; slot = (slot + 1) & (map->table_size - 1))
+  {
+    id = map->table[slot] - 1;
+    if ((size_t)(map->offsets[id + 1] - map->offsets[id]) == length &&
+      memcmp(map->data + map->offsets[id], ssid, length) == 0)
+      return id;
+  }
+
+  return -1;
+}
+
+// public interface
+int wifi_ssid_map_size(const struct wifi_ssid_map *map)
+{
+  return map->count;
+}
+
+// public interface
+const char *wifi_ssid_map_data(const struct wifi_ssid_map *map)
+{
+  return map->data;
+}
+
+// public interface
+const int32_t *wifi_ssid_map_offsets(const struct wifi_ssid_map *map)
+{
+  static const int32_t empty[1] = {0};
+
+  return map->offsets ? map->offsets : empty;
+}
+
+static bool map_grow(struct wifi_ssid_map *map)
+{
+  uint32_t table_size = map->table_size ? 2 * map->table_size : 256;
+  uint32_t *table = calloc(table_size, sizeof(uint32_t));
+  uint32_t slot;
+  int i;
+
+  if (table == NULL)
+    return false;
+
+  for (i = 0; i < map->count; ++i)
+  {
+    for (slot = hash_ssid(map->data + map->offsets[i], map->offsets[i + 1] - map->offsets[i]) & (table_size - 1); table[slot]; slot = (slot + 1) & (table_size - 1))
+      ;
+    table[slot] = i + 1;
+  }
+
+  free(map->table);
+  map->table = table;
+  map->table_size = table_size;
+  return true;
+}
+
+static uint32_t hash_ssid(const char *ssid, size_t length)
+{
+  uint32_t hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < length; ++i)
+    hash = (hash ^ (uint8_t)ssid[i]) * 16777619u;
+
+  return hash;
+}
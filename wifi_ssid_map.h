@@ -0,0 +1,78 @@
+/*
+ * wifi-scan library SSID map header
+ *
+ * Copyright 2016-2018 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Interning of SSIDs to dense ids (0, 1, 2, ... in the order of first appearance)
+ *
+ * SSIDs are stored one after another without terminators with offsets in Arrow layout
+ * (size + 1 offsets, the first one 0) so that dictionaries of file formats may be written directly.
+ * SSIDs are compared byte by byte, with the length given (they may contain null bytes).
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "wifi_scan.h"
+
+#include <stddef.h> //size_t
+
+// internal data used by the functions
+struct wifi_ssid_map;
+
+/* Create empty map
+ *
+ * returns:
+ * struct wifi_ssid_map * - pass it to the map functions or NULL if unsuccessfull (errno is set)
+ */
+struct wifi_ssid_map *wifi_ssid_map_new(void);
+
+/* Free the map */
+void wifi_ssid_map_free(struct wifi_ssid_map *map);
+
+/* Get id of SSID of length bytes, adding it if not present
+ *
+ * returns:
+ * -1 on error (errno is set) or id of SSID
+ */
+int wifi_ssid_map_add(struct wifi_ssid_map *map, const char *ssid, size_t length);
+
+/* Get id of SSID of length bytes
+ *
+ * returns:
+ * -1 if SSID is not in the map or id of SSID
+ */
+int wifi_ssid_map_find(const struct wifi_ssid_map *map, const char *ssid, size_t length);
+
+/* Get the number of SSIDs (ids are from 0 to size - 1) */
+int wifi_ssid_map_size(const struct wifi_ssid_map *map);
+
+/* Get SSIDs one after another without terminators
+ *
+ * SSID of id is from offsets[id] to offsets[id + 1] (see wifi_ssid_map_offsets)
+ *
+ * returns:
+ * data valid until next wifi_ssid_map_add (NULL for empty map)
+ */
+const char *wifi_ssid_map_data(const struct wifi_ssid_map *map);
+
+/* Get offsets of SSIDs in data
+ *
+ * returns:
+ * size + 1 offsets, the first one 0, valid until next wifi_ssid_map_add
+ */
+const int32_t *wifi_ssid_map_offsets(const struct wifi_ssid_map *map);
+
+#ifdef __cplusplus
+}
+#endif